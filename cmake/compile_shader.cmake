@@ -8,8 +8,53 @@ macro(compile_shader target source output)
         COMMAND
             ${glslc_executable}
             -MD -MF ${output}.d
+            --target-env=vulkan1.1
             -o ${output}
             ${source}
     )
     add_custom_target(${target} DEPENDS ${output})
-endmacro()
\ No newline at end of file
+endmacro()
+# assemble SPIR-V assembly (`.spvasm`), used for modules that can not be
+# expressed in GLSL such as modules with multiple entry points
+macro(assemble_shader target source output)
+    add_custom_command(
+        OUTPUT ${output}
+        DEPENDS ${source}
+        COMMAND
+            ${glslc_executable}
+            --target-env=vulkan1.1
+            -o ${output}
+            ${source}
+    )
+    add_custom_target(${target} DEPENDS ${output})
+endmacro()
+# pack compiled shaders into a shader bundle loadable with
+# `sccl_open_shader_bundle`, usage:
+# pack_shader_bundle(target output SHADERS name=path.spv... DEPENDS targets...)
+function(pack_shader_bundle target output)
+    set(options "")
+    set(oneValueArgs "")
+    set(multiValueArgs SHADERS DEPENDS)
+    cmake_parse_arguments(PACK_SHADER_BUNDLE "${options}" "${oneValueArgs}" "${multiValueArgs}" ${ARGN})
+
+    set(shader_files "")
+    foreach(shader ${PACK_SHADER_BUNDLE_SHADERS})
+        string(FIND ${shader} "=" separator)
+        math(EXPR path_begin "${separator} + 1")
+        string(SUBSTRING ${shader} ${path_begin} -1 shader_file)
+        list(APPEND shader_files ${shader_file})
+    endforeach()
+
+    add_custom_command(
+        OUTPUT ${output}
+        DEPENDS shader_bundle_packer ${shader_files}
+        COMMAND
+            $<TARGET_FILE:shader_bundle_packer>
+            ${output}
+            ${PACK_SHADER_BUNDLE_SHADERS}
+    )
+    add_custom_target(${target} DEPENDS ${output})
+    if (PACK_SHADER_BUNDLE_DEPENDS) # check if not empty
+        add_dependencies(${target} ${PACK_SHADER_BUNDLE_DEPENDS})
+    endif()
+endfunction()
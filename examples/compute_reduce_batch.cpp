@@ -189,11 +189,10 @@ int main(int argc, char **argv)
     sccl_set_buffer_layout_binding(input_device_buffer, 0, 0,
                                    &input_buffer_layout, NULL);
     UNWRAP_SCCL_ERROR(sccl_create_buffer(device, &input_staging_buffer,
-                                         sccl_buffer_type_host_storage,
+                                         sccl_buffer_type_upload_storage,
                                          input_staging_buffer_size_bytes));
-    UNWRAP_SCCL_ERROR(sccl_host_map_buffer(input_staging_buffer,
-                                           (void **)&input_data, 0,
-                                           input_staging_buffer_size_bytes));
+    UNWRAP_SCCL_ERROR(sccl_get_buffer_host_pointer(input_staging_buffer,
+                                                   (void **)&input_data));
 
     /* create output buffers */
     const size_t output_staging_buffer_size_bytes = rank_size_bytes;
@@ -209,11 +208,10 @@ int main(int argc, char **argv)
     sccl_set_buffer_layout_binding(output_device_buffer, 1, 0,
                                    &output_buffer_layout, NULL);
     UNWRAP_SCCL_ERROR(sccl_create_buffer(device, &output_staging_buffer,
-                                         sccl_buffer_type_host_storage,
+                                         sccl_buffer_type_readback_storage,
                                          output_staging_buffer_size_bytes));
-    UNWRAP_SCCL_ERROR(sccl_host_map_buffer(output_staging_buffer,
-                                           (void **)&output_data, 0,
-                                           output_staging_buffer_size_bytes));
+    UNWRAP_SCCL_ERROR(sccl_get_buffer_host_pointer(output_staging_buffer,
+                                                   (void **)&output_data));
 
     /* fill input buffer */
     fill_array_random(input_data, rank_size * number_of_ranks);
@@ -221,6 +219,12 @@ int main(int argc, char **argv)
     /* clear output buffer */
     std::memset(output_data, 0, output_staging_buffer_size_bytes);
 
+    /* staging memory may not be host coherent */
+    UNWRAP_SCCL_ERROR(
+        sccl_flush_buffer_range(input_staging_buffer, 0, SCCL_WHOLE_SIZE));
+    UNWRAP_SCCL_ERROR(
+        sccl_flush_buffer_range(output_staging_buffer, 0, SCCL_WHOLE_SIZE));
+
     /* create UBOs */
     const size_t uniform_buffer_size_bytes = sizeof(UniformBufferObject);
     std::vector<sccl_buffer_t> uniform_buffers(batch_count);
@@ -231,14 +235,12 @@ int main(int argc, char **argv)
                                              uniform_buffer_size_bytes));
         sccl_buffer_t ubo = uniform_buffers[i];
 
-        /* assign buffer offset to each ubo */
+        /* assign buffer offset to each ubo, ubos stay mapped */
         UniformBufferObject *ubo_ptr = nullptr;
-        UNWRAP_SCCL_ERROR(sccl_host_map_buffer(ubo, (void **)&ubo_ptr, 0,
-                                               sizeof(UniformBufferObject)));
+        UNWRAP_SCCL_ERROR(sccl_get_buffer_host_pointer(ubo, (void **)&ubo_ptr));
         ubo_ptr->numberOfRanks = number_of_ranks;
         ubo_ptr->batchOffset = i * batch_size;
         ubo_ptr->batchSize = batch_size;
-        sccl_host_unmap_buffer(ubo);
     }
 
     /* prepare specialization constants */
@@ -346,12 +348,10 @@ int main(int argc, char **argv)
         /* prepare ubo */
         UniformBufferObject *ubo_ptr = nullptr;
         sccl_shader_buffer_binding_t ubo_binding = {};
-        UNWRAP_SCCL_ERROR(sccl_host_map_buffer(ubo, (void **)&ubo_ptr, 0,
-                                               sizeof(UniformBufferObject)));
+        UNWRAP_SCCL_ERROR(sccl_get_buffer_host_pointer(ubo, (void **)&ubo_ptr));
         const size_t batch_offset_bytes =
             ubo_ptr->batchOffset * sizeof(ReduceDataType);
         const size_t batch_index = ubo_ptr->batchOffset / batch_size;
-        sccl_host_unmap_buffer(ubo);
         sccl_set_buffer_layout_binding(ubo, 2, 0, nullptr, &ubo_binding);
 
         sccl_shader_buffer_binding_t input_buffer_binding = {};
@@ -408,6 +408,8 @@ int main(int argc, char **argv)
     /* wait for remaining streams */
     UNWRAP_SCCL_ERROR(sccl_wait_streams_all(device, pending_streams.data(),
                                             pending_streams.size()));
+    UNWRAP_SCCL_ERROR(sccl_invalidate_buffer_range(output_staging_buffer, 0,
+                                                   SCCL_WHOLE_SIZE));
 
     STOP_TIMER(Shader);
 
@@ -443,8 +445,6 @@ int main(int argc, char **argv)
     for (size_t i = 0; i < uniform_buffers.size(); ++i) {
         sccl_destroy_buffer(uniform_buffers[i]);
     }
-    sccl_host_unmap_buffer(output_staging_buffer);
-    sccl_host_unmap_buffer(input_staging_buffer);
     sccl_destroy_buffer(output_staging_buffer);
     sccl_destroy_buffer(input_staging_buffer);
     sccl_destroy_buffer(output_device_buffer);
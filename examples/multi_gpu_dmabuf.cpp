@@ -5,7 +5,6 @@
 #include <inttypes.h>
 #include <stdio.h>
 #include <string.h>
-#include <unistd.h>
 
 #define OPT_GPU_0 1000
 #define OPT_GPU_1 1001
@@ -81,7 +80,6 @@ int main(int argc, char **argv)
     sccl_buffer_t device_1_staging_buffer;
     sccl_buffer_t device_0_dmabuf_buffer;
     sccl_buffer_t device_1_dmabuf_buffer;
-    sccl_buffer_t device_0_external_buffer;
 
     UNWRAP_SCCL_ERROR(sccl_create_buffer(device_0, &device_0_staging_buffer,
                                          sccl_buffer_type_host_storage,
@@ -96,16 +94,6 @@ int main(int argc, char **argv)
         device_1, &device_1_dmabuf_buffer,
         sccl_buffer_type_device_dmabuf_storage, buffer_size));
 
-    /* export device_buf 1 dmabuf fd */
-    int device_1_fd;
-    UNWRAP_SCCL_ERROR(
-        sccl_export_dmabuf_buffer(device_1_dmabuf_buffer, &device_1_fd));
-
-    /* import dmabuf on device 0 */
-    UNWRAP_SCCL_ERROR(sccl_import_dmabuf_buffer(
-        device_0, &device_0_external_buffer, device_1_fd,
-        sccl_buffer_type_external_dmabuf_storage, buffer_size));
-
     /* init staging buffers */
     const size_t element_count = buffer_size / sizeof(uint32_t);
     uint32_t *device_0_staging_buffer_ptr = nullptr;
@@ -127,8 +115,9 @@ int main(int argc, char **argv)
 
     sccl_copy_buffer(stream_0, device_0_staging_buffer, 0,
                      device_0_dmabuf_buffer, 0, buffer_size);
-    sccl_copy_buffer(stream_0, device_0_dmabuf_buffer, 0,
-                     device_0_external_buffer, 0, buffer_size);
+    /* device 1 dmabuf buffer is imported on device 0 and copied directly */
+    sccl_copy_peer(stream_0, device_0_dmabuf_buffer, 0, device_1_dmabuf_buffer,
+                   0, buffer_size);
     sccl_dispatch_stream(stream_0);
     sccl_join_stream(stream_0);
     sccl_copy_buffer(stream_1, device_1_dmabuf_buffer, 0,
@@ -149,8 +138,6 @@ int main(int argc, char **argv)
     sccl_destroy_stream(stream_0);
     sccl_host_unmap_buffer(device_1_staging_buffer);
     sccl_host_unmap_buffer(device_0_staging_buffer);
-    sccl_destroy_buffer(device_0_external_buffer);
-    close(device_1_fd);
     sccl_destroy_buffer(device_1_dmabuf_buffer);
     sccl_destroy_buffer(device_0_dmabuf_buffer);
     sccl_destroy_buffer(device_1_staging_buffer);
@@ -1,10 +1,123 @@
-
 #include "alloc.h"
+#include <pthread.h>
+#include <stdalign.h>
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
+
+/* process wide allocator, set by the first instance created with one and
+ * removed when the last instance is destroyed */
+static pthread_mutex_t allocator_mutex = PTHREAD_MUTEX_INITIALIZER;
+static size_t allocator_instance_count = 0;
+static bool allocator_set = false;
+static sccl_allocator_t allocator;
+static VkAllocationCallbacks vk_allocation_callbacks;
+
+/* calls of `sccl_calloc` and `sccl_reallocarray`, Vulkan allocations are not
+ * included */
+static atomic_size_t allocation_count = 0;
+
+static void *VKAPI_CALL vk_allocation(void *user_data, size_t size,
+                                      size_t alignment,
+                                      VkSystemAllocationScope scope)
+{
+    (void)scope;
+    return allocator.allocate(user_data, size, alignment);
+}
+
+static void *VKAPI_CALL vk_reallocation(void *user_data, void *original,
+                                        size_t size, size_t alignment,
+                                        VkSystemAllocationScope scope)
+{
+    (void)scope;
+    return allocator.reallocate(user_data, original, size, alignment);
+}
+
+static void VKAPI_CALL vk_free(void *user_data, void *memory)
+{
+    allocator.free(user_data, memory);
+}
+
+static bool is_same_allocator(const sccl_allocator_t *a,
+                              const sccl_allocator_t *b)
+{
+    return a->user_data == b->user_data && a->allocate == b->allocate &&
+           a->reallocate == b->reallocate && a->free == b->free;
+}
+
+sccl_error_t sccl_acquire_allocator(const sccl_allocator_t *instance_allocator)
+{
+    if (instance_allocator != NULL &&
+        (instance_allocator->allocate == NULL ||
+         instance_allocator->reallocate == NULL ||
+         instance_allocator->free == NULL)) {
+        return sccl_invalid_argument;
+    }
+
+    sccl_error_t error = sccl_success;
+    pthread_mutex_lock(&allocator_mutex);
+    if (instance_allocator == NULL) {
+        /* use whatever allocator is installed, libc if there is no instance */
+    } else if (allocator_instance_count == 0) {
+        allocator = *instance_allocator;
+        allocator_set = true;
+        memset(&vk_allocation_callbacks, 0, sizeof(VkAllocationCallbacks));
+        vk_allocation_callbacks.pUserData = allocator.user_data;
+        vk_allocation_callbacks.pfnAllocation = vk_allocation;
+        vk_allocation_callbacks.pfnReallocation = vk_reallocation;
+        vk_allocation_callbacks.pfnFree = vk_free;
+    } else if (!allocator_set ||
+               !is_same_allocator(&allocator, instance_allocator)) {
+        /* allocations can not be moved to another allocator */
+        error = sccl_invalid_argument;
+    }
+    if (error == sccl_success) {
+        allocator_instance_count++;
+    }
+    pthread_mutex_unlock(&allocator_mutex);
+
+    return error;
+}
+
+void sccl_release_allocator(void)
+{
+    pthread_mutex_lock(&allocator_mutex);
+    allocator_instance_count--;
+    /* all allocations were freed with the last instance, the next instance may
+     * use another allocator or libc */
+    if (allocator_instance_count == 0) {
+        allocator_set = false;
+        memset(&allocator, 0, sizeof(sccl_allocator_t));
+        memset(&vk_allocation_callbacks, 0, sizeof(VkAllocationCallbacks));
+    }
+    pthread_mutex_unlock(&allocator_mutex);
+}
+
+const VkAllocationCallbacks *sccl_get_vk_allocator(void)
+{
+    return allocator_set ? &vk_allocation_callbacks : NULL;
+}
+
+/* allocator callbacks are never called with size 0, reallocate would free */
+static size_t get_allocation_size(size_t size) { return size == 0 ? 1 : size; }
 
 sccl_error_t sccl_calloc(void **ptr, size_t nmem, size_t size)
 {
-    *ptr = calloc(nmem, size);
+    atomic_fetch_add_explicit(&allocation_count, 1, memory_order_relaxed);
+    if (!allocator_set) {
+        *ptr = calloc(nmem, size);
+    } else if (size != 0 && nmem > SIZE_MAX / size) {
+        *ptr = NULL;
+    } else {
+        *ptr = allocator.allocate(allocator.user_data,
+                                  get_allocation_size(nmem * size),
+                                  alignof(max_align_t));
+        if (*ptr != NULL) {
+            memset(*ptr, 0, nmem * size);
+        }
+    }
     if (*ptr == NULL) {
         return sccl_system_error;
     }
@@ -13,8 +126,15 @@ sccl_error_t sccl_calloc(void **ptr, size_t nmem, size_t size)
 
 sccl_error_t sccl_reallocarray(void **ptr, size_t nmemb, size_t size)
 {
+    atomic_fetch_add_explicit(&allocation_count, 1, memory_order_relaxed);
     void *new_ptr = NULL;
-    new_ptr = reallocarray(*ptr, nmemb, size);
+    if (!allocator_set) {
+        new_ptr = reallocarray(*ptr, nmemb, size);
+    } else if (size == 0 || nmemb <= SIZE_MAX / size) {
+        new_ptr = allocator.reallocate(allocator.user_data, *ptr,
+                                       get_allocation_size(nmemb * size),
+                                       alignof(max_align_t));
+    }
     if (new_ptr == NULL) {
         return sccl_system_error;
     }
@@ -22,4 +142,16 @@ sccl_error_t sccl_reallocarray(void **ptr, size_t nmemb, size_t size)
     return sccl_success;
 }
 
-void sccl_free(void *ptr) { free(ptr); }
+void sccl_free(void *ptr)
+{
+    if (!allocator_set) {
+        free(ptr);
+    } else if (ptr != NULL) {
+        allocator.free(allocator.user_data, ptr);
+    }
+}
+
+size_t sccl_get_allocation_count(void)
+{
+    return atomic_load_explicit(&allocation_count, memory_order_relaxed);
+}
@@ -3,6 +3,8 @@
 #define ALLOC_HEADER
 
 #include "error.h"
+#include "sccl.h"
+#include <vulkan/vulkan.h>
 
 /**
  * Internal heap alloc.
@@ -14,4 +16,25 @@ sccl_error_t sccl_reallocarray(void **ptr, size_t nmemb, size_t size);
 
 void sccl_free(void *ptr);
 
+/**
+ * Number of heap allocations made by SCCL itself since the process started,
+ * allocations of the Vulkan driver are not counted.
+ */
+size_t sccl_get_allocation_count(void);
+
+/**
+ * Register an instance using `instance_allocator`, NULL to use the installed
+ * allocator. The allocator is installed if no instance exists, otherwise it
+ * must be the installed one. All allocations are freed before the last
+ * instance releases the allocator, which then uninstalls it.
+ */
+sccl_error_t sccl_acquire_allocator(const sccl_allocator_t *instance_allocator);
+
+void sccl_release_allocator(void);
+
+/**
+ * Allocation callbacks to pass to Vulkan, NULL if no allocator is installed.
+ */
+const VkAllocationCallbacks *sccl_get_vk_allocator(void);
+
 #endif // ALLOC_HEADER
@@ -3,25 +3,82 @@
 #include "alloc.h"
 #include "device.h"
 #include "error.h"
+#include "host_memory.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+typedef struct {
+    VkMemoryPropertyFlags required;
+    VkMemoryPropertyFlags preferred;
+    VkMemoryPropertyFlags avoided;
+} memory_property_preference_t;
+
+static uint32_t count_bits(VkMemoryPropertyFlags flags)
+{
+    uint32_t count = 0;
+    for (; flags != 0; flags &= flags - 1) {
+        count++;
+    }
+    return count;
+}
 
-static sccl_error_t find_memory_type(VkPhysicalDevice physical_device,
-                                     uint32_t type_filter,
-                                     VkMemoryPropertyFlags properties,
-                                     uint32_t *output_index)
+/* heaps at or below this size are the host visible window of device memory on
+ * devices without resizable BAR, they are easily exhausted */
+#define SMALL_HEAP_SIZE ((VkDeviceSize)256 << 20) /* 256 MiB */
+
+static int
+score_memory_type(const VkPhysicalDeviceMemoryProperties *mem_properties,
+                  uint32_t index,
+                  const memory_property_preference_t *preference)
 {
-    VkPhysicalDeviceMemoryProperties mem_properties;
-    vkGetPhysicalDeviceMemoryProperties(physical_device, &mem_properties);
+    const VkMemoryType *type = &mem_properties->memoryTypes[index];
+    int score = (int)count_bits(type->propertyFlags & preference->preferred) -
+                (int)count_bits(type->propertyFlags & preference->avoided);
+    if (mem_properties->memoryHeaps[type->heapIndex].size <= SMALL_HEAP_SIZE) {
+        score--;
+    }
+    return score;
+}
 
-    for (uint32_t i = 0; i < mem_properties.memoryTypeCount; i++) {
-        if ((type_filter & (1 << i)) &&
-            (mem_properties.memoryTypes[i].propertyFlags & properties) ==
-                properties) {
+/* find memory type with all required properties in a heap large enough for
+ * `size`. Types are scored by the number of preferred minus avoided
+ * properties, with a penalty for small heaps. Ties go to the larger heap, then
+ * to the lowest index since drivers order memory types by performance. */
+static sccl_error_t
+find_memory_type(const VkPhysicalDeviceMemoryProperties *mem_properties,
+                 uint32_t type_filter, VkDeviceSize size,
+                 const memory_property_preference_t *preference,
+                 uint32_t *output_index)
+{
+    bool found = false;
+    int best_score = 0;
+    VkDeviceSize best_heap_size = 0;
+
+    for (uint32_t i = 0; i < mem_properties->memoryTypeCount; i++) {
+        const VkMemoryType *type = &mem_properties->memoryTypes[i];
+        const VkDeviceSize heap_size =
+            mem_properties->memoryHeaps[type->heapIndex].size;
+        if (!(type_filter & (1 << i)) ||
+            (type->propertyFlags & preference->required) !=
+                preference->required ||
+            heap_size < size) {
+            continue;
+        }
+        const int score = score_memory_type(mem_properties, i, preference);
+        if (!found || score > best_score ||
+            (score == best_score && heap_size > best_heap_size)) {
+            found = true;
+            best_score = score;
+            best_heap_size = heap_size;
             *output_index = i;
-            return sccl_success;
         }
     }
 
-    return sccl_unsupported_error;
+    return found ? sccl_success : sccl_unsupported_error;
 }
 
 static VkBufferUsageFlags get_buffer_usage_flags(sccl_buffer_type_t type)
@@ -42,27 +99,57 @@ static VkBufferUsageFlags get_buffer_usage_flags(sccl_buffer_type_t type)
     return buffer_usage_flags;
 }
 
-static VkMemoryPropertyFlags get_memory_property_flags(sccl_buffer_type_t type)
+/* auto buffers accessed through a staging buffer, leave the small host visible
+ * window of device memory to upload buffers */
+static const memory_property_preference_t staged_auto_preference = {
+    .required = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+    .avoided = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT};
+
+static memory_property_preference_t
+get_memory_property_preference(const sccl_device_t device,
+                               sccl_buffer_type_t type)
 {
     /* determine memory property flags */
-    VkMemoryPropertyFlags memory_property_flags = 0;
+    memory_property_preference_t preference = {0};
 
     if (is_buffer_type_host(type)) {
-        memory_property_flags = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
-                                VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+        preference.required = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                              VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
     } else if (is_buffer_type_device(type)) {
-        memory_property_flags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+        preference.required = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
     } else if (is_buffer_type_shared(type)) {
-        memory_property_flags = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
-                                VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+        preference.required = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                              VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
     } else if (is_buffer_type_external(type)) {
-        memory_property_flags = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
-                                VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+        preference.required = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                              VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+    } else if (is_buffer_type_readback(type)) {
+        /* cpu reads from uncached memory are very slow, which includes the
+         * host visible window of device memory */
+        preference.required = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;
+        preference.preferred = VK_MEMORY_PROPERTY_HOST_CACHED_BIT |
+                               VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+        preference.avoided = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+    } else if (is_buffer_type_upload(type)) {
+        /* write-combined memory, in device memory if it is host visible */
+        preference.required = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;
+        preference.preferred = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT |
+                               VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+        preference.avoided = VK_MEMORY_PROPERTY_HOST_CACHED_BIT;
+    } else if (is_buffer_type_auto(type)) {
+        if (device->memory_allocator.host_visible_device_memory) {
+            /* mapped directly, coherent so no flush or invalidate is needed */
+            preference.required = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT |
+                                  VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                                  VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+        } else {
+            preference = staged_auto_preference;
+        }
     } else {
         assert(false);
     }
 
-    return memory_property_flags;
+    return preference;
 }
 
 static sccl_error_t
@@ -78,21 +165,31 @@ allocate_buffer_internal(const sccl_device_t device,
     return sccl_success;
 }
 
+/* `out_memory_allocated` is set once memory was allocated with
+ * `memory_allocate_info_pnext`, an imported handle is then owned by the memory
+ * and released with it even if creation fails later. May be NULL. */
 static sccl_error_t create_buffer_internal(const sccl_device_t device,
                                            struct sccl_buffer **buffer_internal,
                                            sccl_buffer_type_t type, size_t size,
                                            void *buffer_create_info_pnext,
-                                           void *memory_allocate_info_pnext)
+                                           void *memory_allocate_info_pnext,
+                                           bool *out_memory_allocated)
 {
     sccl_error_t error = sccl_success;
+    bool memory_allocated = false;
+    if (out_memory_allocated != NULL) {
+        *out_memory_allocated = false;
+    }
 
     CHECK_SCCL_ERROR_GOTO(
         allocate_buffer_internal(device, buffer_internal, type), error_return,
         error);
 
     VkBufferUsageFlags buffer_usage_flags = get_buffer_usage_flags(type);
-    VkMemoryPropertyFlags memory_property_flags =
-        get_memory_property_flags(type);
+    const memory_property_preference_t memory_property_preference =
+        get_memory_property_preference(device, type);
+
+    (*buffer_internal)->size = size;
 
     /* create buffer */
     VkBufferCreateInfo buffer_create_info = {0};
@@ -102,52 +199,152 @@ static sccl_error_t create_buffer_internal(const sccl_device_t device,
     buffer_create_info.usage = buffer_usage_flags;
     buffer_create_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
     CHECK_VKRESULT_GOTO(vkCreateBuffer((*buffer_internal)->device->device,
-                                       &buffer_create_info, NULL,
+                                       &buffer_create_info,
+                                       sccl_get_vk_allocator(),
                                        &(*buffer_internal)->buffer),
                         error_return, error);
 
     /* get memory requirements */
-    VkMemoryRequirements mem_requirements = {0};
-    vkGetBufferMemoryRequirements((*buffer_internal)->device->device,
-                                  (*buffer_internal)->buffer,
-                                  &mem_requirements);
+    VkMemoryDedicatedRequirements dedicated_requirements = {0};
+    dedicated_requirements.sType =
+        VK_STRUCTURE_TYPE_MEMORY_DEDICATED_REQUIREMENTS;
+    VkMemoryRequirements2 mem_requirements = {0};
+    mem_requirements.sType = VK_STRUCTURE_TYPE_MEMORY_REQUIREMENTS_2;
+    mem_requirements.pNext = &dedicated_requirements;
+    VkBufferMemoryRequirementsInfo2 buffer_memory_requirements_info = {0};
+    buffer_memory_requirements_info.sType =
+        VK_STRUCTURE_TYPE_BUFFER_MEMORY_REQUIREMENTS_INFO_2;
+    buffer_memory_requirements_info.buffer = (*buffer_internal)->buffer;
+    vkGetBufferMemoryRequirements2((*buffer_internal)->device->device,
+                                   &buffer_memory_requirements_info,
+                                   &mem_requirements);
 
     /* find memory type */
     uint32_t memory_type_index;
-    CHECK_SCCL_ERROR_GOTO(find_memory_type(device->physical_device,
-                                           mem_requirements.memoryTypeBits,
-                                           memory_property_flags,
-                                           &memory_type_index),
-                          error_return, error);
-
-    /* allocate memory */
-    VkMemoryAllocateInfo memory_allocate_info = {0};
-    memory_allocate_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-    memory_allocate_info.pNext = memory_allocate_info_pnext;
-    memory_allocate_info.allocationSize = mem_requirements.size;
-    memory_allocate_info.memoryTypeIndex = memory_type_index;
-    CHECK_VKRESULT_GOTO(vkAllocateMemory((*buffer_internal)->device->device,
-                                         &memory_allocate_info, NULL,
-                                         &(*buffer_internal)->device_memory),
-                        error_return, error);
+    CHECK_SCCL_ERROR_GOTO(
+        find_memory_type(&device->memory_allocator.memory_properties,
+                         mem_requirements.memoryRequirements.memoryTypeBits,
+                         mem_requirements.memoryRequirements.size,
+                         &memory_property_preference, &memory_type_index),
+        error_return, error);
+
+    /* external memory always needs its own allocation, regular buffers are
+     * sub-allocated unless they are large or the driver asks for dedicated
+     * memory */
+    VkMemoryDedicatedAllocateInfo dedicated_allocate_info = {0};
+    bool dedicated = memory_allocate_info_pnext != NULL;
+    if (!dedicated &&
+        (dedicated_requirements.requiresDedicatedAllocation ||
+         dedicated_requirements.prefersDedicatedAllocation ||
+         mem_requirements.memoryRequirements.size >
+             MEMORY_DEDICATED_THRESHOLD)) {
+        dedicated_allocate_info.sType =
+            VK_STRUCTURE_TYPE_MEMORY_DEDICATED_ALLOCATE_INFO;
+        dedicated_allocate_info.buffer = (*buffer_internal)->buffer;
+        memory_allocate_info_pnext = &dedicated_allocate_info;
+        dedicated = true;
+    }
+
+    /* allocate memory, preferred memory type may be in a small heap such as
+     * the host visible part of device memory without resizable BAR, fall back
+     * to any memory type with the required properties */
+    error = memory_allocate(&device->memory_allocator,
+                            &mem_requirements.memoryRequirements,
+                            memory_type_index, dedicated,
+                            memory_allocate_info_pnext,
+                            &(*buffer_internal)->memory);
+    if (error != sccl_success && (memory_property_preference.preferred != 0 ||
+                                  memory_property_preference.avoided != 0)) {
+        const memory_property_preference_t required_only = {
+            .required = memory_property_preference.required};
+        CHECK_SCCL_ERROR_GOTO(
+            find_memory_type(&device->memory_allocator.memory_properties,
+                             mem_requirements.memoryRequirements.memoryTypeBits,
+                             mem_requirements.memoryRequirements.size,
+                             &required_only, &memory_type_index),
+            error_return, error);
+        error = memory_allocate(&device->memory_allocator,
+                                &mem_requirements.memoryRequirements,
+                                memory_type_index, dedicated,
+                                memory_allocate_info_pnext,
+                                &(*buffer_internal)->memory);
+    }
+    /* host visible device memory may be exhausted, auto buffers then move to
+     * device memory behind a staging buffer */
+    if (error != sccl_success && is_buffer_type_auto(type) &&
+        device->memory_allocator.host_visible_device_memory) {
+        CHECK_SCCL_ERROR_GOTO(
+            find_memory_type(&device->memory_allocator.memory_properties,
+                             mem_requirements.memoryRequirements.memoryTypeBits,
+                             mem_requirements.memoryRequirements.size,
+                             &staged_auto_preference, &memory_type_index),
+            error_return, error);
+        error = memory_allocate(&device->memory_allocator,
+                                &mem_requirements.memoryRequirements,
+                                memory_type_index, dedicated,
+                                memory_allocate_info_pnext,
+                                &(*buffer_internal)->memory);
+    }
+    if (error != sccl_success) {
+        goto error_return;
+    }
+    memory_allocated = true;
+    if (out_memory_allocated != NULL) {
+        *out_memory_allocated = true;
+    }
 
     /* bind */
     CHECK_VKRESULT_GOTO(vkBindBufferMemory((*buffer_internal)->device->device,
                                            (*buffer_internal)->buffer,
-                                           (*buffer_internal)->device_memory,
-                                           0),
+                                           (*buffer_internal)->memory.memory,
+                                           (*buffer_internal)->memory.offset),
                         error_return, error);
 
+    /* host visible buffers stay mapped for their whole lifetime, sub-allocated
+     * memory is already mapped by the allocator. dmabuf memory is mapped on
+     * demand since importers may not allow mapping. */
+    const bool host_visible =
+        device->memory_allocator.memory_properties
+            .memoryTypes[(*buffer_internal)->memory.memory_type_index]
+            .propertyFlags &
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;
+    if ((*buffer_internal)->memory.mapped == NULL && host_visible &&
+        !is_buffer_type_device(type) && !is_buffer_type_dmabuf(type)) {
+        void *mapped = NULL;
+        CHECK_VKRESULT_GOTO(vkMapMemory((*buffer_internal)->device->device,
+                                        (*buffer_internal)->memory.memory, 0,
+                                        VK_WHOLE_SIZE, 0, &mapped),
+                            error_return, error);
+        (*buffer_internal)->memory.mapped = mapped;
+    }
+
+    /* auto buffers in memory the host can not see are accessed through a
+     * staging buffer of the same size, as are all auto buffers on devices
+     * where most of device memory is not host visible */
+    if (is_buffer_type_auto(type) &&
+        (!host_visible ||
+         !device->memory_allocator.host_visible_device_memory)) {
+        CHECK_SCCL_ERROR_GOTO(
+            create_buffer_internal(device, &(*buffer_internal)->staging,
+                                   sccl_buffer_type_host_storage, size, NULL,
+                                   NULL, NULL),
+            error_return, error);
+    }
+
+    atomic_fetch_add(&device->usage.buffer_count, 1);
+    atomic_fetch_add(&device->usage.buffer_bytes[type], size);
+
     return sccl_success;
 
 error_return:
     if (*buffer_internal != NULL) {
-        if ((*buffer_internal)->device_memory != VK_NULL_HANDLE) {
-            vkFreeMemory(device->device, (*buffer_internal)->device_memory,
-                         NULL);
+        if (memory_allocated) {
+            memory_free(&device->memory_allocator,
+                        &(*buffer_internal)->memory);
         }
         if ((*buffer_internal)->buffer != VK_NULL_HANDLE) {
-            vkDestroyBuffer(device->device, (*buffer_internal)->buffer, NULL);
+            vkDestroyBuffer(device->device, (*buffer_internal)->buffer,
+                            sccl_get_vk_allocator());
         }
         sccl_free(*buffer_internal);
     }
@@ -166,6 +363,10 @@ bool is_buffer_type_storage(sccl_buffer_type_t type)
     case sccl_buffer_type_device_dmabuf_storage:
     case sccl_buffer_type_shared_dmabuf_storage:
     case sccl_buffer_type_external_dmabuf_storage:
+    case sccl_buffer_type_readback_storage:
+    case sccl_buffer_type_upload_storage:
+    case sccl_buffer_type_auto_storage:
+    case sccl_buffer_type_managed_storage:
         return true;
     default:
         return false;
@@ -183,6 +384,8 @@ bool is_buffer_type_uniform(sccl_buffer_type_t type)
     case sccl_buffer_type_device_dmabuf_uniform:
     case sccl_buffer_type_shared_dmabuf_uniform:
     case sccl_buffer_type_external_dmabuf_uniform:
+    case sccl_buffer_type_readback_uniform:
+    case sccl_buffer_type_upload_uniform:
         return true;
     default:
         return false;
@@ -250,6 +453,56 @@ bool is_buffer_type_regular(sccl_buffer_type_t type)
     case sccl_buffer_type_host_uniform:
     case sccl_buffer_type_device_uniform:
     case sccl_buffer_type_shared_uniform:
+    case sccl_buffer_type_readback_storage:
+    case sccl_buffer_type_upload_storage:
+    case sccl_buffer_type_readback_uniform:
+    case sccl_buffer_type_upload_uniform:
+    case sccl_buffer_type_auto_storage:
+    case sccl_buffer_type_managed_storage:
+        return true;
+    default:
+        return false;
+    }
+}
+
+bool is_buffer_type_readback(sccl_buffer_type_t type)
+{
+    switch (type) {
+    case sccl_buffer_type_readback_storage:
+    case sccl_buffer_type_readback_uniform:
+        return true;
+    default:
+        return false;
+    }
+}
+
+bool is_buffer_type_upload(sccl_buffer_type_t type)
+{
+    switch (type) {
+    case sccl_buffer_type_upload_storage:
+    case sccl_buffer_type_upload_uniform:
+        return true;
+    default:
+        return false;
+    }
+}
+
+/* managed buffers are placed and staged like auto buffers */
+bool is_buffer_type_auto(sccl_buffer_type_t type)
+{
+    switch (type) {
+    case sccl_buffer_type_auto_storage:
+    case sccl_buffer_type_managed_storage:
+        return true;
+    default:
+        return false;
+    }
+}
+
+bool is_buffer_type_managed(sccl_buffer_type_t type)
+{
+    switch (type) {
+    case sccl_buffer_type_managed_storage:
         return true;
     default:
         return false;
@@ -284,6 +537,10 @@ bool is_buffer_type_dmabuf(sccl_buffer_type_t type)
     }
 }
 
+static sccl_error_t create_host_memory_buffer(
+    const sccl_device_t device, struct sccl_buffer **buffer_internal,
+    sccl_buffer_type_t type, size_t size);
+
 sccl_error_t sccl_create_buffer(const sccl_device_t device,
                                 sccl_buffer_t *buffer, sccl_buffer_type_t type,
                                 size_t size)
@@ -291,14 +548,17 @@ sccl_error_t sccl_create_buffer(const sccl_device_t device,
 
     struct sccl_buffer *buffer_internal = NULL;
 
-    /* check buffer type is regular */
-    if (!is_buffer_type_regular(type)) {
+    if (is_buffer_type_host_pointer(type)) {
+        CHECK_SCCL_ERROR_RET(
+            create_host_memory_buffer(device, &buffer_internal, type, size));
+    } else if (is_buffer_type_regular(type)) {
+        CHECK_SCCL_ERROR_RET(create_buffer_internal(device, &buffer_internal,
+                                                    type, size, NULL, NULL,
+                                                    NULL));
+    } else {
         return sccl_invalid_argument;
     }
 
-    CHECK_SCCL_ERROR_RET(create_buffer_internal(device, &buffer_internal, type,
-                                                size, NULL, NULL));
-
     /* set public handle */
     *buffer = (sccl_buffer_t)buffer_internal;
 
@@ -338,7 +598,8 @@ sccl_error_t sccl_create_external_host_pointer_buffer(
 
     CHECK_SCCL_ERROR_RET(create_buffer_internal(
         device, &buffer_internal, type, size,
-        &external_memory_buffer_create_info, &import_memory_host_pointer_info));
+        &external_memory_buffer_create_info, &import_memory_host_pointer_info,
+        NULL));
 
     /* set public handle */
     *buffer = (sccl_buffer_t)buffer_internal;
@@ -376,7 +637,8 @@ sccl_error_t sccl_create_dmabuf_buffer(const sccl_device_t device,
 
     CHECK_SCCL_ERROR_RET(create_buffer_internal(
         device, &buffer_internal, type, size,
-        &external_memory_buffer_create_info, &export_memory_allocate_info));
+        &external_memory_buffer_create_info, &export_memory_allocate_info,
+        NULL));
 
     /* set public handle */
     *buffer = (sccl_buffer_t)buffer_internal;
@@ -391,14 +653,14 @@ sccl_error_t sccl_export_dmabuf_buffer(const sccl_buffer_t buffer, int *out_fd)
         return sccl_unsupported_error;
     }
 
-    /* check if type is dmabuf */
-    if (!is_buffer_type_dmabuf(buffer->type)) {
+    /* check if type is dmabuf, views can not be exported */
+    if (!is_buffer_type_dmabuf(buffer->type) || buffer->parent != NULL) {
         return sccl_invalid_argument;
     }
 
     VkMemoryGetFdInfoKHR memory_get_fd_info = {0};
     memory_get_fd_info.sType = VK_STRUCTURE_TYPE_MEMORY_GET_FD_INFO_KHR;
-    memory_get_fd_info.memory = buffer->device_memory;
+    memory_get_fd_info.memory = buffer->memory.memory;
     memory_get_fd_info.handleType =
         VK_EXTERNAL_MEMORY_HANDLE_TYPE_DMA_BUF_BIT_EXT;
     CHECK_VKRESULT_RET(buffer->device->pfn_vk_get_memory_fd_khr(
@@ -407,22 +669,10 @@ sccl_error_t sccl_export_dmabuf_buffer(const sccl_buffer_t buffer, int *out_fd)
     return sccl_success;
 }
 
-sccl_error_t sccl_import_dmabuf_buffer(const sccl_device_t device,
-                                       sccl_buffer_t *buffer, int in_fd,
-                                       sccl_buffer_type_t type, size_t size)
+static sccl_error_t import_dmabuf(const sccl_device_t device, int in_fd,
+                                  sccl_buffer_type_t type, size_t size,
+                                  struct sccl_buffer **buffer_internal)
 {
-    struct sccl_buffer *buffer_internal = NULL;
-
-    /* check if supported */
-    if (!device->dmabuf_buffer_supported) {
-        return sccl_unsupported_error;
-    }
-
-    /* check if type is dmabuf */
-    if (!is_buffer_type_dmabuf(type)) {
-        return sccl_invalid_argument;
-    }
-
     /* query memory import info */
     VkMemoryFdPropertiesKHR memory_fd_properties = {0};
     memory_fd_properties.sType = VK_STRUCTURE_TYPE_MEMORY_FD_PROPERTIES_KHR;
@@ -444,11 +694,467 @@ sccl_error_t sccl_import_dmabuf_buffer(const sccl_device_t device,
     import_memory_fd_info.sType = VK_STRUCTURE_TYPE_IMPORT_MEMORY_FD_INFO_KHR;
     import_memory_fd_info.handleType =
         VK_EXTERNAL_MEMORY_HANDLE_TYPE_DMA_BUF_BIT_EXT;
-    import_memory_fd_info.fd = in_fd;
+    /* a successful import transfers ownership of the descriptor to the
+     * driver, the caller keeps `in_fd` */
+    import_memory_fd_info.fd = fcntl(in_fd, F_DUPFD_CLOEXEC, 0);
+    if (import_memory_fd_info.fd < 0) {
+        return sccl_system_error;
+    }
+
+    bool imported = false;
+    sccl_error_t error = create_buffer_internal(
+        device, buffer_internal, type, size,
+        &external_memory_buffer_create_info, &import_memory_fd_info, &imported);
+    /* after a successful import the descriptor is closed with the memory */
+    if (error != sccl_success && !imported) {
+        close(import_memory_fd_info.fd);
+    }
+    return error;
+}
+
+sccl_error_t sccl_import_dmabuf_buffer(const sccl_device_t device,
+                                       sccl_buffer_t *buffer, int in_fd,
+                                       sccl_buffer_type_t type, size_t size)
+{
+    struct sccl_buffer *buffer_internal = NULL;
+
+    /* check if supported */
+    if (!device->dmabuf_buffer_supported) {
+        return sccl_unsupported_error;
+    }
+
+    /* check if type is dmabuf */
+    if (!is_buffer_type_dmabuf(type)) {
+        return sccl_invalid_argument;
+    }
+
+    /* all descriptors of a dmabuf refer to the same inode, which is not
+     * reused while the cached import holds a reference to the dmabuf */
+    struct stat fd_stat;
+    if (fstat(in_fd, &fd_stat) != 0) {
+        return sccl_system_error;
+    }
+    dmabuf_import_key_t key;
+    memset(&key, 0, sizeof(key));
+    key.dev = fd_stat.st_dev;
+    key.ino = fd_stat.st_ino;
+    key.type = type;
+    key.size = size;
+
+    pthread_mutex_lock(&device->dmabuf_imports_mutex);
+    struct sccl_buffer **cached =
+        hash_map_find(&device->dmabuf_imports, &key, sizeof(key));
+    if (cached != NULL) {
+        ++(*cached)->import_references;
+        *buffer = (sccl_buffer_t)*cached;
+        pthread_mutex_unlock(&device->dmabuf_imports_mutex);
+        return sccl_success;
+    }
+
+    sccl_error_t error =
+        import_dmabuf(device, in_fd, type, size, &buffer_internal);
+    if (error == sccl_success) {
+        error = hash_map_insert(&device->dmabuf_imports, &key, sizeof(key),
+                                &buffer_internal);
+        if (error != sccl_success) {
+            sccl_destroy_buffer(buffer_internal);
+        }
+    }
+    if (error == sccl_success) {
+        buffer_internal->import_references = 1;
+        buffer_internal->import_key = key;
+        /* set public handle */
+        *buffer = (sccl_buffer_t)buffer_internal;
+    }
+    pthread_mutex_unlock(&device->dmabuf_imports_mutex);
+
+    return error;
+}
+
+/* drop a handle of a cached dmabuf import, returns true if it was the last */
+static bool release_dmabuf_import(struct sccl_buffer *buffer)
+{
+    const sccl_device_t device = buffer->device;
+
+    pthread_mutex_lock(&device->dmabuf_imports_mutex);
+    const bool last = --buffer->import_references == 0;
+    if (last) {
+        hash_map_remove(&device->dmabuf_imports, &buffer->import_key,
+                        sizeof(buffer->import_key));
+    }
+    pthread_mutex_unlock(&device->dmabuf_imports_mutex);
+
+    return last;
+}
+
+static sccl_error_t create_buffer_view_internal(const sccl_buffer_t parent,
+                                                size_t offset, size_t size,
+                                                struct sccl_buffer **view)
+{
+    CHECK_SCCL_ERROR_RET(
+        allocate_buffer_internal(parent->device, view, parent->type));
+
+    /* views of views alias the root buffer directly */
+    struct sccl_buffer *root = parent->parent != NULL ? parent->parent : parent;
+    (*view)->buffer = root->buffer;
+    (*view)->memory = root->memory;
+    (*view)->staging = root->staging;
+    (*view)->wrapped_host_pointer = root->wrapped_host_pointer;
+    (*view)->size = size;
+    (*view)->parent = root;
+    (*view)->view_offset = parent->view_offset + offset;
+
+    return sccl_success;
+}
+
+sccl_error_t sccl_create_buffer_view(const sccl_buffer_t parent, size_t offset,
+                                     size_t size, sccl_buffer_t *view)
+{
+    struct sccl_buffer *view_internal = NULL;
+
+    CHECK_SCCL_NULL_RET(parent);
+    CHECK_SCCL_NULL_RET(view);
+    if (size == 0 || offset > parent->size || size > parent->size - offset) {
+        return sccl_invalid_argument;
+    }
+    if (offset % sccl_get_buffer_min_offset_alignment(parent) != 0) {
+        return sccl_invalid_argument;
+    }
+
+    CHECK_SCCL_ERROR_RET(
+        create_buffer_view_internal(parent, offset, size, &view_internal));
+
+    /* set public handle */
+    *view = (sccl_buffer_t)view_internal;
 
+    return sccl_success;
+}
+
+/* import the aligned range enclosing `host_pointer` and return a view of the
+ * user range */
+static sccl_error_t import_host_memory(const sccl_device_t device,
+                                       struct sccl_buffer **buffer_internal,
+                                       sccl_buffer_type_t type,
+                                       void *host_pointer, size_t size)
+{
+    sccl_device_properties_t device_properties = {0};
+    sccl_get_device_properties(device, &device_properties);
+    const uintptr_t alignment =
+        device_properties.min_external_buffer_host_pointer_alignment;
+    const uintptr_t begin = (uintptr_t)host_pointer;
+    const uintptr_t aligned_begin = begin - begin % alignment;
+    const uintptr_t aligned_end =
+        (begin + size + alignment - 1) / alignment * alignment;
+
+    sccl_buffer_t imported = NULL;
+    CHECK_SCCL_ERROR_RET(sccl_create_external_host_pointer_buffer(
+        device, &imported, type, (void *)aligned_begin,
+        aligned_end - aligned_begin));
+    if (aligned_begin == begin && aligned_end - aligned_begin == size) {
+        *buffer_internal = imported;
+        return sccl_success;
+    }
+
+    sccl_error_t error = create_buffer_view_internal(
+        imported, begin - aligned_begin, size, buffer_internal);
+    if (error != sccl_success) {
+        sccl_destroy_buffer(imported);
+        return error;
+    }
+    (*buffer_internal)->owns_parent = true;
+
+    return sccl_success;
+}
+
+sccl_error_t sccl_wrap_host_memory(const sccl_device_t device,
+                                   sccl_buffer_t *buffer,
+                                   sccl_buffer_type_t type, void *host_pointer,
+                                   size_t size)
+{
+    struct sccl_buffer *buffer_internal = NULL;
+
+    if (!is_buffer_type_host_pointer(type) || host_pointer == NULL ||
+        size == 0) {
+        return sccl_invalid_argument;
+    }
+
+    /* zero copy if the driver can import host memory */
+    if (device->host_pointer_supported &&
+        import_host_memory(device, &buffer_internal, type, host_pointer,
+                           size) == sccl_success) {
+        *buffer = (sccl_buffer_t)buffer_internal;
+        return sccl_success;
+    }
+
+    /* otherwise mirror user memory in a host visible buffer */
+    CHECK_SCCL_ERROR_RET(create_buffer_internal(device, &buffer_internal, type,
+                                                size, NULL, NULL, NULL));
+    memcpy(buffer_internal->memory.mapped, host_pointer, size);
+    buffer_internal->wrapped_host_pointer = host_pointer;
+
+    /* set public handle */
+    *buffer = (sccl_buffer_t)buffer_internal;
+
+    return sccl_success;
+}
+
+/* transfer ownership of imported host memory to the root buffer */
+static void set_host_mapping(struct sccl_buffer *buffer, void *mapping,
+                             size_t size)
+{
+    struct sccl_buffer *root =
+        buffer->parent != NULL ? buffer->parent : buffer;
+    root->host_mapping = mapping;
+    root->host_mapping_size = size;
+}
+
+/* import host memory from the host allocator, huge pages on the NUMA node of
+ * the device */
+static sccl_error_t create_host_memory_buffer(
+    const sccl_device_t device, struct sccl_buffer **buffer_internal,
+    sccl_buffer_type_t type, size_t size)
+{
+    if (!device->host_pointer_supported) {
+        return sccl_unsupported_error;
+    }
+
+    sccl_device_properties_t device_properties = {0};
+    sccl_get_device_properties(device, &device_properties);
+
+    void *mapping = NULL;
+    size_t mapping_size = 0;
+    CHECK_SCCL_ERROR_RET(host_memory_allocate(
+        device->numa_node, size,
+        device_properties.min_external_buffer_host_pointer_alignment,
+        &mapping, &mapping_size));
+
+    sccl_error_t error =
+        import_host_memory(device, buffer_internal, type, mapping, size);
+    if (error != sccl_success) {
+        host_memory_free(mapping, mapping_size);
+        return error;
+    }
+    set_host_mapping(*buffer_internal, mapping, mapping_size);
+
+    return sccl_success;
+}
+
+/* map fd at `alignment`, which can be larger than a page, by reserving address
+ * space first */
+static sccl_error_t map_aligned(int fd, size_t offset, size_t size,
+                               size_t alignment, int flags, void **mapping)
+{
+    const size_t reserved_size = size + alignment;
+    char *reserved = mmap(NULL, reserved_size, PROT_NONE,
+                          MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (reserved == MAP_FAILED) {
+        return sccl_system_error;
+    }
+    char *aligned = reserved + (alignment - (uintptr_t)reserved % alignment) %
+                                   alignment;
+    void *data = mmap(aligned, size, PROT_READ | PROT_WRITE,
+                      flags | MAP_FIXED, fd, (off_t)offset);
+    if (data == MAP_FAILED) {
+        munmap(reserved, reserved_size);
+        return sccl_system_error;
+    }
+    if (aligned > reserved) {
+        munmap(reserved, (size_t)(aligned - reserved));
+    }
+    if (aligned + size < reserved + reserved_size) {
+        munmap(aligned + size,
+               (size_t)(reserved + reserved_size - (aligned + size)));
+    }
+
+    *mapping = data;
+    return sccl_success;
+}
+
+/* page size or import granularity of host memory, whichever is larger */
+static size_t get_host_mapping_alignment(const sccl_device_t device)
+{
+    sccl_device_properties_t device_properties = {0};
+    sccl_get_device_properties(device, &device_properties);
+    const size_t import_alignment =
+        device_properties.min_external_buffer_host_pointer_alignment;
+    const size_t page_size = (size_t)sysconf(_SC_PAGESIZE);
+    return import_alignment > page_size ? import_alignment : page_size;
+}
+
+/* map file range and import the mapping */
+static sccl_error_t map_file(const sccl_device_t device, int fd, size_t offset,
+                             size_t length,
+                             struct sccl_buffer **buffer_internal)
+{
+    /* the imported range is rounded to the import alignment, so the mapping
+     * must cover it. Drivers reject pages past the end of file, the file is
+     * read instead then */
+    const size_t alignment = get_host_mapping_alignment(device);
+    const size_t map_offset = offset - offset % alignment;
+    const size_t map_size =
+        (offset - map_offset + length + alignment - 1) / alignment * alignment;
+
+    /* private mapping, device writes never reach the file. Pages are copied
+     * from the page cache when they are first written, or when the driver
+     * pins them for device writes */
+    void *mapping = NULL;
+    CHECK_SCCL_ERROR_RET(map_aligned(fd, map_offset, map_size, alignment,
+                                     MAP_PRIVATE, &mapping));
+
+    sccl_error_t error = import_host_memory(
+        device, buffer_internal, sccl_buffer_type_external_host_pointer_storage,
+        (char *)mapping + (offset - map_offset), length);
+    if (error != sccl_success) {
+        munmap(mapping, map_size);
+        return error;
+    }
+
+    set_host_mapping(*buffer_internal, mapping, map_size);
+
+    return sccl_success;
+}
+
+/* read file range into a host visible buffer */
+static sccl_error_t read_file(const sccl_device_t device, int fd,
+                              size_t offset, size_t length,
+                              struct sccl_buffer **buffer_internal)
+{
     CHECK_SCCL_ERROR_RET(create_buffer_internal(
-        device, &buffer_internal, type, size,
-        &external_memory_buffer_create_info, &import_memory_fd_info));
+        device, buffer_internal, sccl_buffer_type_external_host_pointer_storage,
+        length, NULL, NULL, NULL));
+
+    char *data = (*buffer_internal)->memory.mapped;
+    size_t read_size = 0;
+    while (read_size < length) {
+        const ssize_t result = pread(fd, data + read_size, length - read_size,
+                                     (off_t)(offset + read_size));
+        if (result < 0 && errno == EINTR) {
+            continue;
+        }
+        if (result <= 0) {
+            /* error or file truncated while reading */
+            sccl_destroy_buffer(*buffer_internal);
+            return sccl_system_error;
+        }
+        read_size += (size_t)result;
+    }
+
+    return sccl_success;
+}
+
+sccl_error_t sccl_create_buffer_from_file(const sccl_device_t device,
+                                          const char *path, size_t offset,
+                                          size_t length, sccl_buffer_t *buffer)
+{
+    sccl_error_t error = sccl_success;
+    struct sccl_buffer *buffer_internal = NULL;
+
+    const int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return sccl_system_error;
+    }
+
+    struct stat file_stat;
+    if (fstat(fd, &file_stat) != 0) {
+        error = sccl_system_error;
+        goto error_return;
+    }
+    if (length == 0 || offset > (size_t)file_stat.st_size ||
+        length > (size_t)file_stat.st_size - offset) {
+        error = sccl_invalid_argument;
+        goto error_return;
+    }
+
+    /* read the file directly if the driver can import the mapping, some
+     * drivers only import anonymous memory */
+    if (!device->host_pointer_supported ||
+        map_file(device, fd, offset, length, &buffer_internal) !=
+            sccl_success) {
+        CHECK_SCCL_ERROR_GOTO(
+            read_file(device, fd, offset, length, &buffer_internal),
+            error_return, error);
+    }
+
+    /* mapping stays valid after the file is closed */
+    close(fd);
+
+    /* set public handle */
+    *buffer = (sccl_buffer_t)buffer_internal;
+
+    return sccl_success;
+
+error_return:
+    close(fd);
+    return error;
+}
+
+/* grow shared memory to the import granularity and map it */
+static sccl_error_t map_shared_memory(const sccl_device_t device, int fd,
+                                      size_t size, void **mapping,
+                                      size_t *mapping_size)
+{
+    const size_t alignment = get_host_mapping_alignment(device);
+    const size_t map_size = (size + alignment - 1) / alignment * alignment;
+
+    /* every imported page must be backed by the region, a process attaching
+     * to an existing region never shrinks it */
+    struct stat file_stat;
+    if (fstat(fd, &file_stat) != 0) {
+        return sccl_system_error;
+    }
+    if ((size_t)file_stat.st_size < map_size &&
+        ftruncate(fd, (off_t)map_size) != 0) {
+        return sccl_system_error;
+    }
+
+    CHECK_SCCL_ERROR_RET(
+        map_aligned(fd, 0, map_size, alignment, MAP_SHARED, mapping));
+    *mapping_size = map_size;
+    return sccl_success;
+}
+
+sccl_error_t sccl_create_shm_buffer(const sccl_device_t device,
+                                    const char *name, int memfd, size_t size,
+                                    sccl_buffer_t *buffer)
+{
+    struct sccl_buffer *buffer_internal = NULL;
+
+    if (size == 0 || (name == NULL) == (memfd < 0)) {
+        return sccl_invalid_argument;
+    }
+    /* a copy would defeat the purpose of sharing the region */
+    if (!device->host_pointer_supported) {
+        return sccl_unsupported_error;
+    }
+
+    int fd = memfd;
+    if (name != NULL) {
+        fd = shm_open(name, O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+        if (fd < 0) {
+            return sccl_system_error;
+        }
+    }
+
+    void *mapping = NULL;
+    size_t mapping_size = 0;
+    sccl_error_t error =
+        map_shared_memory(device, fd, size, &mapping, &mapping_size);
+    /* mapping stays valid after the shared memory object is closed */
+    if (name != NULL) {
+        close(fd);
+    }
+    if (error != sccl_success) {
+        return error;
+    }
+
+    error = import_host_memory(device, &buffer_internal,
+                               sccl_buffer_type_external_host_pointer_storage,
+                               mapping, size);
+    if (error != sccl_success) {
+        munmap(mapping, mapping_size);
+        return error;
+    }
+    set_host_mapping(buffer_internal, mapping, mapping_size);
 
     /* set public handle */
     *buffer = (sccl_buffer_t)buffer_internal;
@@ -456,10 +1162,114 @@ sccl_error_t sccl_import_dmabuf_buffer(const sccl_device_t device,
     return sccl_success;
 }
 
+size_t get_dirty_page_count(size_t size)
+{
+    return (size + SCCL_MIRRORED_BUFFER_PAGE_SIZE - 1) /
+           SCCL_MIRRORED_BUFFER_PAGE_SIZE;
+}
+
+sccl_error_t sccl_create_mirrored_buffer(const sccl_device_t device,
+                                         sccl_buffer_t *buffer, size_t size)
+{
+    sccl_error_t error = sccl_success;
+    struct sccl_buffer *buffer_internal = NULL;
+
+    CHECK_SCCL_ERROR_RET(create_buffer_internal(device, &buffer_internal,
+                                                sccl_buffer_type_auto_storage,
+                                                size, NULL, NULL, NULL));
+
+    /* directly mapped buffers have nothing to upload */
+    if (buffer_internal->staging != NULL) {
+        const size_t word_count = (get_dirty_page_count(size) + 63) / 64;
+        CHECK_SCCL_ERROR_GOTO(
+            sccl_calloc((void **)&buffer_internal->dirty_pages, word_count,
+                        sizeof(uint64_t)),
+            error_return, error);
+    }
+
+    /* set public handle */
+    *buffer = (sccl_buffer_t)buffer_internal;
+
+    return sccl_success;
+
+error_return:
+    sccl_destroy_buffer(buffer_internal);
+    return error;
+}
+
+sccl_error_t sccl_mark_buffer_dirty(const sccl_buffer_t buffer, size_t offset,
+                                    size_t size)
+{
+    if (offset > buffer->size) {
+        return sccl_invalid_argument;
+    }
+    if (size == SCCL_WHOLE_SIZE) {
+        size = buffer->size - offset;
+    }
+    if (size > buffer->size - offset) {
+        return sccl_invalid_argument;
+    }
+
+    struct sccl_buffer *root = buffer->parent != NULL ? buffer->parent : buffer;
+    if (root->dirty_pages == NULL || size == 0) {
+        return sccl_success;
+    }
+
+    /* set bits of pages in [first, last] a word at a time */
+    const size_t begin = buffer->view_offset + offset;
+    size_t page = begin / SCCL_MIRRORED_BUFFER_PAGE_SIZE;
+    const size_t last = (begin + size - 1) / SCCL_MIRRORED_BUFFER_PAGE_SIZE;
+    while (page <= last) {
+        const size_t bit = page % 64;
+        size_t count = 64 - bit;
+        if (count > last - page + 1) {
+            count = last - page + 1;
+        }
+        const uint64_t mask =
+            (count == 64) ? ~UINT64_C(0) : ((UINT64_C(1) << count) - 1) << bit;
+        root->dirty_pages[page / 64] |= mask;
+        page += count;
+    }
+
+    return sccl_success;
+}
+
 void sccl_destroy_buffer(sccl_buffer_t buffer)
 {
-    vkFreeMemory(buffer->device->device, buffer->device_memory, NULL);
-    vkDestroyBuffer(buffer->device->device, buffer->buffer, NULL);
+    if (buffer->parent != NULL) {
+        if (buffer->owns_parent) {
+            sccl_destroy_buffer(buffer->parent);
+        }
+        sccl_free(buffer);
+        return;
+    }
+    if (buffer->import_references > 0 && !release_dmabuf_import(buffer)) {
+        return;
+    }
+    if (vector_is_initilized(&buffer->peer_imports)) {
+        for (size_t i = 0; i < vector_get_size(&buffer->peer_imports); ++i) {
+            peer_import_t *e = vector_get_element(&buffer->peer_imports, i);
+            if (e->import != NULL) {
+                sccl_destroy_buffer(e->import);
+            }
+        }
+        vector_destroy(&buffer->peer_imports);
+    }
+    if (buffer->staging != NULL) {
+        sccl_destroy_buffer(buffer->staging);
+    }
+    atomic_fetch_sub(&buffer->device->usage.buffer_count, 1);
+    atomic_fetch_sub(&buffer->device->usage.buffer_bytes[buffer->type],
+                     buffer->size);
+    vkDestroyBuffer(buffer->device->device, buffer->buffer,
+                    sccl_get_vk_allocator());
+    memory_free(&buffer->device->memory_allocator, &buffer->memory);
+    if (buffer->host_mapping != NULL) {
+        munmap(buffer->host_mapping, buffer->host_mapping_size);
+    }
+    if (buffer->dirty_pages != NULL) {
+        sccl_free(buffer->dirty_pages);
+    }
     sccl_free(buffer);
 }
 
@@ -483,20 +1293,188 @@ size_t sccl_get_buffer_min_offset_alignment(const sccl_buffer_t buffer)
     return 0;
 }
 
+/* memory holding the host mapping, auto buffers in device memory are accessed
+ * through their staging buffer */
+static const memory_allocation_t *get_host_memory(const sccl_buffer_t buffer)
+{
+    return buffer->staging != NULL ? &buffer->staging->memory
+                                   : &buffer->memory;
+}
+
+/**
+ * Make the host copy of a managed buffer valid before the host accesses it,
+ * copies the device copy back through the device's migration stream if it was
+ * written. The device copy is stale afterwards since the host may write.
+ */
+static sccl_error_t
+prepare_managed_buffer_host_access(const sccl_buffer_t buffer)
+{
+    sccl_error_t error = sccl_success;
+    struct sccl_buffer *root = buffer->parent != NULL ? buffer->parent : buffer;
+    sccl_device_t device = root->device;
+
+    if (!is_buffer_type_managed(root->type) || root->staging == NULL) {
+        return sccl_success;
+    }
+
+    if (root->host_copy_stale) {
+        pthread_mutex_lock(&device->migration_mutex);
+        if (device->migration_stream == NULL) {
+            CHECK_SCCL_ERROR_GOTO(
+                sccl_create_stream(device, &device->migration_stream),
+                error_return, error);
+        }
+        CHECK_SCCL_ERROR_GOTO(sccl_copy_buffer(device->migration_stream, root,
+                                               0, root->staging, 0, root->size),
+                              error_return, error);
+        CHECK_SCCL_ERROR_GOTO(sccl_dispatch_stream(device->migration_stream),
+                              error_return, error);
+        CHECK_SCCL_ERROR_GOTO(sccl_join_stream(device->migration_stream),
+                              error_return, error);
+        pthread_mutex_unlock(&device->migration_mutex);
+        root->host_copy_stale = false;
+    }
+    root->device_copy_stale = true;
+
+    return sccl_success;
+
+error_return:
+    pthread_mutex_unlock(&device->migration_mutex);
+    return error;
+}
+
 sccl_error_t sccl_host_map_buffer(const sccl_buffer_t buffer, void **data,
                                   size_t offset, size_t size)
 {
+    const memory_allocation_t *host_memory = get_host_memory(buffer);
+
     if (buffer->type == sccl_buffer_type_device) {
         return sccl_invalid_argument;
     }
+    /* the persistent mapping covers more than the buffer */
+    if (offset > buffer->size || size > buffer->size - offset) {
+        return sccl_invalid_argument;
+    }
+    CHECK_SCCL_ERROR_RET(prepare_managed_buffer_host_access(buffer));
+
+    /* persistently mapped */
+    if (host_memory->mapped != NULL) {
+        *data = (char *)host_memory->mapped + buffer->view_offset + offset;
+        return sccl_success;
+    }
+    if (buffer->memory.block != NULL) {
+        return sccl_invalid_argument;
+    }
 
     CHECK_VKRESULT_RET(vkMapMemory(
-        buffer->device->device, buffer->device_memory, offset, size, 0, data));
+        buffer->device->device, buffer->memory.memory,
+        buffer->memory.offset + buffer->view_offset + offset, size, 0, data));
 
     return sccl_success;
 }
 
 void sccl_host_unmap_buffer(const sccl_buffer_t buffer)
 {
-    vkUnmapMemory(buffer->device->device, buffer->device_memory);
+    if (get_host_memory(buffer)->mapped != NULL ||
+        buffer->memory.block != NULL) {
+        return;
+    }
+    vkUnmapMemory(buffer->device->device, buffer->memory.memory);
+}
+
+sccl_error_t sccl_get_buffer_host_pointer(const sccl_buffer_t buffer,
+                                          void **data)
+{
+    const memory_allocation_t *host_memory = get_host_memory(buffer);
+
+    if (is_buffer_type_device(buffer->type) || host_memory->mapped == NULL) {
+        return sccl_invalid_argument;
+    }
+    CHECK_SCCL_ERROR_RET(prepare_managed_buffer_host_access(buffer));
+
+    *data = (char *)host_memory->mapped + buffer->view_offset;
+
+    return sccl_success;
+}
+
+/* range of buffer memory expanded to `nonCoherentAtomSize`, sets `needed` to
+ * false if no flush or invalidate is needed */
+static sccl_error_t get_non_coherent_range(const sccl_buffer_t buffer,
+                                           size_t offset, size_t size,
+                                           VkMappedMemoryRange *range,
+                                           bool *needed)
+{
+    const struct memory_allocator *allocator =
+        &buffer->device->memory_allocator;
+    const memory_allocation_t *host_memory = get_host_memory(buffer);
+
+    if (host_memory->mapped == NULL) {
+        return sccl_invalid_argument;
+    }
+    if (size == SCCL_WHOLE_SIZE) {
+        if (offset > buffer->size) {
+            return sccl_invalid_argument;
+        }
+        size = buffer->size - offset;
+    }
+    if (offset > buffer->size || size > buffer->size - offset) {
+        return sccl_invalid_argument;
+    }
+
+    *needed = !(allocator->memory_properties
+                    .memoryTypes[host_memory->memory_type_index]
+                    .propertyFlags &
+                VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+    if (!*needed || size == 0) {
+        *needed = false;
+        return sccl_success;
+    }
+
+    /* buddies and dedicated allocations are aligned to the atom size, so the
+     * expanded range never leaves the allocation except at the end of a
+     * dedicated allocation */
+    const VkDeviceSize atom = allocator->non_coherent_atom_size;
+    const VkDeviceSize begin =
+        host_memory->offset + buffer->view_offset + offset;
+    const VkDeviceSize end = begin + size;
+    const VkDeviceSize aligned_begin = begin - begin % atom;
+    const VkDeviceSize aligned_end = (end + atom - 1) / atom * atom;
+
+    range->sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+    range->memory = host_memory->memory;
+    range->offset = aligned_begin;
+    range->size = (host_memory->block == NULL &&
+                   aligned_end > host_memory->size)
+                      ? VK_WHOLE_SIZE
+                      : aligned_end - aligned_begin;
+
+    return sccl_success;
+}
+
+sccl_error_t sccl_flush_buffer_range(const sccl_buffer_t buffer, size_t offset,
+                                     size_t size)
+{
+    VkMappedMemoryRange range = {0};
+    bool needed = false;
+    CHECK_SCCL_ERROR_RET(
+        get_non_coherent_range(buffer, offset, size, &range, &needed));
+    if (needed) {
+        CHECK_VKRESULT_RET(
+            vkFlushMappedMemoryRanges(buffer->device->device, 1, &range));
+    }
+    return sccl_success;
+}
+
+sccl_error_t sccl_invalidate_buffer_range(const sccl_buffer_t buffer,
+                                          size_t offset, size_t size)
+{
+    VkMappedMemoryRange range = {0};
+    bool needed = false;
+    CHECK_SCCL_ERROR_RET(
+        get_non_coherent_range(buffer, offset, size, &range, &needed));
+    if (needed) {
+        CHECK_VKRESULT_RET(
+            vkInvalidateMappedMemoryRanges(buffer->device->device, 1, &range));
+    }
+    return sccl_success;
 }
@@ -2,17 +2,93 @@
 #ifndef BUFFER_HEADER
 #define BUFFER_HEADER
 
+#include "memory.h"
 #include "sccl.h"
+#include "vector.h"
 #include <stdbool.h>
+#include <stdint.h>
+#include <sys/types.h>
 #include <vulkan/vulkan.h>
 
+/* key of the device cache of dmabuf imports, hashed as bytes so padding must
+ * be zeroed */
+typedef struct {
+    dev_t dev;
+    ino_t ino;
+    sccl_buffer_type_t type;
+    size_t size;
+} dmabuf_import_key_t;
+
+/* import of a dmabuf buffer on another device for `sccl_copy_peer` */
+typedef struct {
+    sccl_device_t device;
+    struct sccl_buffer *import; /* NULL if it can not be imported there */
+} peer_import_t;
+
 struct sccl_buffer {
     sccl_device_t device;
     sccl_buffer_type_t type;
     VkBuffer buffer;
-    VkDeviceMemory device_memory;
+    memory_allocation_t memory;
+    VkDeviceSize size; /* in bytes */
+
+    /* views alias a range of `parent` and share its `VkBuffer` and memory,
+     * `parent` is NULL for buffers that own their memory */
+    struct sccl_buffer *parent;
+    VkDeviceSize view_offset; /* offset in `buffer`, 0 if not a view */
+    /* views returned by `sccl_wrap_host_memory` own their parent */
+    bool owns_parent;
+
+    /* host storage buffer of the same size as the root buffer for auto buffers
+     * in memory that is not host visible, otherwise NULL. Owned by the root
+     * buffer and shared with its views. */
+    struct sccl_buffer *staging;
+
+    /* user memory mirrored by a buffer from `sccl_wrap_host_memory` when host
+     * memory could not be imported, corresponds to offset 0 of the root
+     * buffer. NULL otherwise. */
+    void *wrapped_host_pointer;
+
+    /* imported host memory owned by the buffer, a file mapping from
+     * `sccl_create_buffer_from_file`, a shared memory mapping from
+     * `sccl_create_shm_buffer` or memory from the host allocator for external
+     * host pointer buffers created by `sccl_create_buffer`. Unmapped when the
+     * buffer is destroyed. NULL otherwise. */
+    void *host_mapping;
+    size_t host_mapping_size;
+
+    /* one bit per `SCCL_MIRRORED_BUFFER_PAGE_SIZE` page of the staging buffer
+     * written by the host since the last `sccl_sync_dirty_to_device`. Only set
+     * on root buffers from `sccl_create_mirrored_buffer` that have a staging
+     * buffer, NULL otherwise. */
+    uint64_t *dirty_pages;
+
+    /* coherence state of managed buffers with a staging buffer, which holds
+     * the host copy. Only used on root buffers, both copies are valid after
+     * creation. Not protected by a lock, managed buffers are used by one
+     * thread at a time. */
+    bool host_copy_stale;
+    bool device_copy_stale;
+
+    /* handles of a cached import from `sccl_import_dmabuf_buffer`, the buffer
+     * is destroyed when the last one is. 0 for other buffers. Protected by
+     * `dmabuf_imports_mutex` of the device. */
+    size_t import_references;
+    dmabuf_import_key_t import_key;
+
+    /* `peer_import_t` of a root dmabuf buffer on other devices, created by
+     * `sccl_copy_peer` and destroyed with the buffer. Initialized on first
+     * use, protected by `peer_mutex` of the device. */
+    vector_t peer_imports;
+
+    /* pool the buffer was acquired from with `sccl_buffer_pool_acquire`, NULL
+     * for other buffers */
+    struct sccl_buffer_pool *pool;
 };
 
+/* number of tracked pages of a buffer of `size` bytes */
+size_t get_dirty_page_count(size_t size);
+
 bool is_buffer_type_storage(sccl_buffer_type_t type);
 
 bool is_buffer_type_uniform(sccl_buffer_type_t type);
@@ -27,6 +103,14 @@ bool is_buffer_type_external(sccl_buffer_type_t type);
 
 bool is_buffer_type_regular(sccl_buffer_type_t type);
 
+bool is_buffer_type_readback(sccl_buffer_type_t type);
+
+bool is_buffer_type_upload(sccl_buffer_type_t type);
+
+bool is_buffer_type_auto(sccl_buffer_type_t type);
+
+bool is_buffer_type_managed(sccl_buffer_type_t type);
+
 bool is_buffer_type_host_pointer(sccl_buffer_type_t type);
 
 bool is_buffer_type_dmabuf(sccl_buffer_type_t type);
@@ -0,0 +1,202 @@
+#include "buffer_pool.h"
+#include "alloc.h"
+#include "buffer.h"
+#include "error.h"
+#include "stream.h"
+
+/* round up to one of four size classes per power of two, at most 25% of a
+ * pooled buffer is unused */
+static size_t get_size_class(size_t size)
+{
+    if (size <= BUFFER_POOL_MIN_SIZE) {
+        return BUFFER_POOL_MIN_SIZE;
+    }
+    size_t power = BUFFER_POOL_MIN_SIZE;
+    while (power < size / 2) {
+        power *= 2;
+    }
+    const size_t step = power / 4;
+    return (size + step - 1) / step * step;
+}
+
+/* destroy oldest idle buffers until `idle_size` is at most `max_idle_size`,
+ * must hold pool mutex */
+static void trim_idle_buffers(struct sccl_buffer_pool *pool,
+                              size_t max_idle_size)
+{
+    size_t removed = 0;
+    while (removed < vector_get_size(&pool->idle_buffers) &&
+           pool->idle_size > max_idle_size) {
+        buffer_pool_entry_t *e =
+            vector_get_element(&pool->idle_buffers, removed);
+        pool->idle_size -= e->size;
+        sccl_destroy_buffer(e->buffer);
+        removed++;
+    }
+    if (removed == 0) {
+        return;
+    }
+
+    /* keep remaining buffers in release order */
+    const size_t remaining = vector_get_size(&pool->idle_buffers) - removed;
+    for (size_t i = 0; i < remaining; ++i) {
+        *(buffer_pool_entry_t *)vector_get_element(&pool->idle_buffers, i) =
+            *(buffer_pool_entry_t *)vector_get_element(&pool->idle_buffers,
+                                                       i + removed);
+    }
+    for (size_t i = 0; i < removed; ++i) {
+        vector_remove_last_element(&pool->idle_buffers);
+    }
+}
+
+/* add buffer to idle buffers, destroys it if that fails */
+static void return_buffer(struct sccl_buffer_pool *pool, sccl_buffer_t buffer)
+{
+    buffer_pool_entry_t entry = {0};
+    entry.type = buffer->type;
+    entry.size = buffer->size;
+    entry.buffer = buffer;
+
+    pthread_mutex_lock(&pool->mutex);
+    if (vector_add_element(&pool->idle_buffers, &entry) == sccl_success) {
+        pool->idle_size += entry.size;
+        trim_idle_buffers(pool, pool->max_idle_size);
+    } else {
+        sccl_destroy_buffer(buffer);
+    }
+    pthread_mutex_unlock(&pool->mutex);
+}
+
+void buffer_pool_complete_release(struct buffer_pool_release *release)
+{
+    if (atomic_fetch_sub(&release->pending_streams, 1) == 1) {
+        return_buffer(release->pool, release->buffer);
+        sccl_free(release);
+    }
+}
+
+sccl_error_t sccl_create_buffer_pool(const sccl_device_t device,
+                                     sccl_buffer_pool_t *pool,
+                                     size_t max_idle_size)
+{
+    sccl_error_t error = sccl_success;
+    bool mutex_initialized = false;
+
+    struct sccl_buffer_pool *pool_internal = NULL;
+    CHECK_SCCL_ERROR_GOTO(sccl_calloc((void **)&pool_internal, 1,
+                                      sizeof(struct sccl_buffer_pool)),
+                          error_return, error);
+
+    pool_internal->device = device;
+    pool_internal->max_idle_size = max_idle_size;
+
+    if (pthread_mutex_init(&pool_internal->mutex, NULL) != 0) {
+        error = sccl_system_error;
+        goto error_return;
+    }
+    mutex_initialized = true;
+
+    CHECK_SCCL_ERROR_GOTO(vector_init(&pool_internal->idle_buffers,
+                                      sizeof(buffer_pool_entry_t)),
+                          error_return, error);
+
+    /* set public handle */
+    *pool = (sccl_buffer_pool_t)pool_internal;
+
+    return sccl_success;
+
+error_return:
+    if (pool_internal != NULL) {
+        if (mutex_initialized) {
+            pthread_mutex_destroy(&pool_internal->mutex);
+        }
+        sccl_free(pool_internal);
+    }
+    return error;
+}
+
+void sccl_destroy_buffer_pool(sccl_buffer_pool_t pool)
+{
+    trim_idle_buffers(pool, 0);
+    vector_destroy(&pool->idle_buffers);
+    pthread_mutex_destroy(&pool->mutex);
+    sccl_free(pool);
+}
+
+sccl_error_t sccl_buffer_pool_acquire(const sccl_buffer_pool_t pool,
+                                      sccl_buffer_t *buffer,
+                                      sccl_buffer_type_t type, size_t size)
+{
+    const size_t size_class = get_size_class(size);
+
+    /* most recently released buffer of the class first, its memory is more
+     * likely to still be cached */
+    pthread_mutex_lock(&pool->mutex);
+    const size_t idle_count = vector_get_size(&pool->idle_buffers);
+    for (size_t i = idle_count; i > 0; --i) {
+        buffer_pool_entry_t *e =
+            vector_get_element(&pool->idle_buffers, i - 1);
+        if (e->type != type || e->size != size_class) {
+            continue;
+        }
+        *buffer = e->buffer;
+        pool->idle_size -= e->size;
+        /* keep remaining buffers in release order */
+        for (size_t j = i; j < idle_count; ++j) {
+            *(buffer_pool_entry_t *)vector_get_element(&pool->idle_buffers,
+                                                       j - 1) =
+                *(buffer_pool_entry_t *)vector_get_element(
+                    &pool->idle_buffers, j);
+        }
+        vector_remove_last_element(&pool->idle_buffers);
+        pthread_mutex_unlock(&pool->mutex);
+        return sccl_success;
+    }
+    pthread_mutex_unlock(&pool->mutex);
+
+    CHECK_SCCL_ERROR_RET(
+        sccl_create_buffer(pool->device, buffer, type, size_class));
+    (*buffer)->pool = pool;
+
+    return sccl_success;
+}
+
+sccl_error_t sccl_buffer_pool_release(const sccl_buffer_pool_t pool,
+                                      sccl_buffer_t buffer,
+                                      const sccl_stream_t *streams,
+                                      size_t streams_count)
+{
+    if (buffer->pool != pool) {
+        return sccl_invalid_argument;
+    }
+
+    if (streams_count == 0) {
+        return_buffer(pool, buffer);
+        return sccl_success;
+    }
+
+    struct buffer_pool_release *release = NULL;
+    CHECK_SCCL_ERROR_RET(sccl_calloc((void **)&release, 1,
+                                     sizeof(struct buffer_pool_release)));
+    release->pool = pool;
+    release->buffer = buffer;
+    /* one extra reference until the release was added to all streams, the
+     * streams must not be reset concurrently */
+    atomic_init(&release->pending_streams, streams_count + 1);
+
+    for (size_t i = 0; i < streams_count; ++i) {
+        const sccl_error_t error =
+            add_buffer_pool_release_to_stream(streams[i], release);
+        if (error != sccl_success) {
+            /* buffer stays with the caller */
+            for (size_t j = 0; j < i; ++j) {
+                remove_buffer_pool_release_from_stream(streams[j], release);
+            }
+            sccl_free(release);
+            return error;
+        }
+    }
+    buffer_pool_complete_release(release);
+
+    return sccl_success;
+}
@@ -0,0 +1,45 @@
+#pragma once
+#ifndef BUFFER_POOL_HEADER
+#define BUFFER_POOL_HEADER
+
+#include "sccl.h"
+#include "vector.h"
+#include <pthread.h>
+#include <stdatomic.h>
+
+/* smallest size class, smaller buffers are rounded up to this size */
+#define BUFFER_POOL_MIN_SIZE ((size_t)4096)
+
+typedef struct {
+    sccl_buffer_type_t type;
+    size_t size; /* size class */
+    sccl_buffer_t buffer;
+} buffer_pool_entry_t;
+
+struct sccl_buffer_pool {
+    sccl_device_t device;
+    size_t max_idle_size;
+
+    pthread_mutex_t mutex;
+    /* idle buffers in release order, contains `buffer_pool_entry_t` */
+    vector_t idle_buffers;
+    size_t idle_size;
+};
+
+/**
+ * Buffer released with `sccl_buffer_pool_release` while streams may still use
+ * it, returned to the pool when the last of these streams is reset or
+ * destroyed.
+ */
+struct buffer_pool_release {
+    struct sccl_buffer_pool *pool;
+    sccl_buffer_t buffer;
+    atomic_size_t pending_streams;
+};
+
+/**
+ * Called by a stream the release was added to when it is reset or destroyed.
+ */
+void buffer_pool_complete_release(struct buffer_pool_release *release);
+
+#endif // BUFFER_POOL_HEADER
@@ -1,8 +1,10 @@
 
 #include "device.h"
 #include "alloc.h"
+#include "environment_variables.h"
 #include "error.h"
 #include "instance.h"
+#include <stdio.h>
 #include <string.h>
 
 #define QUEUE_COUNT 2
@@ -131,8 +133,10 @@ error_return:
 static const char *all_wanted_device_extension_names[] = {
     VK_EXT_EXTERNAL_MEMORY_HOST_EXTENSION_NAME,
     VK_KHR_EXTERNAL_MEMORY_FD_EXTENSION_NAME,
-    VK_EXT_EXTERNAL_MEMORY_DMA_BUF_EXTENSION_NAME};
-static const uint32_t all_wanted_device_extension_names_count = 3;
+    VK_EXT_EXTERNAL_MEMORY_DMA_BUF_EXTENSION_NAME,
+    VK_EXT_SUBGROUP_SIZE_CONTROL_EXTENSION_NAME,
+    VK_EXT_MEMORY_BUDGET_EXTENSION_NAME};
+static const uint32_t all_wanted_device_extension_names_count = 5;
 
 /**
  * device_extension_names must of of size
@@ -142,7 +146,8 @@ static const uint32_t all_wanted_device_extension_names_count = 3;
 static sccl_error_t determine_device_extensions(
     VkPhysicalDevice physical_device, char **device_extension_names,
     size_t *device_extension_names_count, bool *host_pointer_supported,
-    bool *dmabuf_buffer_supported)
+    bool *dmabuf_buffer_supported, bool *subgroup_size_control_available,
+    bool *memory_budget_supported)
 {
     (void)all_wanted_device_extension_names;
     assert(all_wanted_device_extension_names_count ==
@@ -180,9 +185,149 @@ static sccl_error_t determine_device_extensions(
         *device_extension_names_count += dmabuf_ext_names_count;
     }
 
+    /* check subgroup size control support, core since vulkan 1.3 */
+    VkPhysicalDeviceProperties physical_device_properties = {0};
+    vkGetPhysicalDeviceProperties(physical_device, &physical_device_properties);
+    if (physical_device_properties.apiVersion >= VK_API_VERSION_1_3) {
+        *subgroup_size_control_available = true;
+    } else {
+        const char *subgroup_size_control_ext_names[] = {
+            VK_EXT_SUBGROUP_SIZE_CONTROL_EXTENSION_NAME};
+        const size_t subgroup_size_control_ext_names_count =
+            sizeof(subgroup_size_control_ext_names) / sizeof(char *);
+        CHECK_SCCL_ERROR_RET(check_device_extension_support(
+            physical_device, subgroup_size_control_ext_names,
+            subgroup_size_control_ext_names_count,
+            subgroup_size_control_available));
+        if (*subgroup_size_control_available) {
+            memcpy((void *)(device_extension_names +
+                            *device_extension_names_count),
+                   subgroup_size_control_ext_names,
+                   subgroup_size_control_ext_names_count *
+                       sizeof(const char *));
+            *device_extension_names_count +=
+                subgroup_size_control_ext_names_count;
+        }
+    }
+
+    /* check memory budget support */
+    const char *memory_budget_ext_names[] = {
+        VK_EXT_MEMORY_BUDGET_EXTENSION_NAME};
+    const size_t memory_budget_ext_names_count =
+        sizeof(memory_budget_ext_names) / sizeof(char *);
+    CHECK_SCCL_ERROR_RET(check_device_extension_support(
+        physical_device, memory_budget_ext_names, memory_budget_ext_names_count,
+        memory_budget_supported));
+    if (*memory_budget_supported) {
+        memcpy((void *)(device_extension_names + *device_extension_names_count),
+               memory_budget_ext_names,
+               memory_budget_ext_names_count * sizeof(const char *));
+        *device_extension_names_count += memory_budget_ext_names_count;
+    }
+
     return sccl_success;
 }
 
+/**
+ * Query subgroup size control features and properties. Must only be called if
+ * subgroup size control is available on the physical device. Sets
+ * `enabled_features` to the features that should be enabled on device
+ * creation.
+ */
+static void query_subgroup_size_control(
+    struct sccl_device *device,
+    VkPhysicalDeviceSubgroupSizeControlFeatures *enabled_features)
+{
+    VkPhysicalDeviceSubgroupSizeControlFeatures
+        subgroup_size_control_features = {0};
+    subgroup_size_control_features.sType =
+        VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SUBGROUP_SIZE_CONTROL_FEATURES;
+    VkPhysicalDeviceFeatures2 physical_device_features = {0};
+    physical_device_features.sType =
+        VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+    physical_device_features.pNext = &subgroup_size_control_features;
+    vkGetPhysicalDeviceFeatures2(device->physical_device,
+                                 &physical_device_features);
+
+    VkPhysicalDeviceSubgroupSizeControlProperties
+        subgroup_size_control_properties = {0};
+    subgroup_size_control_properties.sType =
+        VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SUBGROUP_SIZE_CONTROL_PROPERTIES;
+    VkPhysicalDeviceProperties2 physical_device_properties = {0};
+    physical_device_properties.sType =
+        VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+    physical_device_properties.pNext = &subgroup_size_control_properties;
+    vkGetPhysicalDeviceProperties2(device->physical_device,
+                                   &physical_device_properties);
+
+    device->subgroup_size_control_supported =
+        subgroup_size_control_features.subgroupSizeControl &&
+        (subgroup_size_control_properties.requiredSubgroupSizeStages &
+         VK_SHADER_STAGE_COMPUTE_BIT);
+    device->compute_full_subgroups_supported =
+        subgroup_size_control_features.computeFullSubgroups;
+    device->min_subgroup_size =
+        subgroup_size_control_properties.minSubgroupSize;
+    device->max_subgroup_size =
+        subgroup_size_control_properties.maxSubgroupSize;
+    device->max_compute_work_group_subgroups =
+        subgroup_size_control_properties.maxComputeWorkgroupSubgroups;
+
+    memset(enabled_features, 0,
+           sizeof(VkPhysicalDeviceSubgroupSizeControlFeatures));
+    enabled_features->sType =
+        VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SUBGROUP_SIZE_CONTROL_FEATURES;
+    enabled_features->subgroupSizeControl =
+        device->subgroup_size_control_supported;
+    enabled_features->computeFullSubgroups =
+        device->compute_full_subgroups_supported;
+}
+
+/**
+ * Find the NUMA node of the PCI device from sysfs. Returns -1 if unknown, for
+ * example for devices that are not on a PCI bus or hosts without NUMA.
+ */
+static int query_numa_node(VkPhysicalDevice physical_device)
+{
+    const char *pci_bus_info_ext_names[] = {VK_EXT_PCI_BUS_INFO_EXTENSION_NAME};
+    bool pci_bus_info_supported = false;
+    if (check_device_extension_support(physical_device,
+                                       pci_bus_info_ext_names, 1,
+                                       &pci_bus_info_supported) !=
+            sccl_success ||
+        !pci_bus_info_supported) {
+        return -1;
+    }
+
+    VkPhysicalDevicePCIBusInfoPropertiesEXT pci_bus_info_properties = {0};
+    pci_bus_info_properties.sType =
+        VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PCI_BUS_INFO_PROPERTIES_EXT;
+    VkPhysicalDeviceProperties2 physical_device_properties = {0};
+    physical_device_properties.sType =
+        VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+    physical_device_properties.pNext = &pci_bus_info_properties;
+    vkGetPhysicalDeviceProperties2(physical_device,
+                                   &physical_device_properties);
+
+    char path[64];
+    snprintf(path, sizeof(path),
+             "/sys/bus/pci/devices/%04x:%02x:%02x.%x/numa_node",
+             pci_bus_info_properties.pciDomain, pci_bus_info_properties.pciBus,
+             pci_bus_info_properties.pciDevice,
+             pci_bus_info_properties.pciFunction);
+    FILE *file = fopen(path, "r");
+    if (file == NULL) {
+        return -1;
+    }
+    int numa_node = -1;
+    if (fscanf(file, "%d", &numa_node) != 1) {
+        numa_node = -1;
+    }
+    fclose(file);
+
+    return numa_node;
+}
+
 bool has_seperate_transfer_queue(const sccl_device_t device)
 {
     return device->compute_queue_family_index !=
@@ -198,6 +343,13 @@ sccl_error_t sccl_create_device(const sccl_instance_t instance,
 
     char **device_extensions = NULL;
     size_t device_extensions_count = 0;
+    bool subgroup_size_control_available = false;
+    bool memory_allocator_initialized = false;
+    bool upload_ring_initialized = false;
+    bool migration_mutex_initialized = false;
+    bool file_io_initialized = false;
+    bool dmabuf_imports_initialized = false;
+    bool peer_mutex_initialized = false;
 
     CHECK_SCCL_ERROR_GOTO(
         sccl_calloc((void **)&device_internal, 1, sizeof(struct sccl_device)),
@@ -248,6 +400,8 @@ sccl_error_t sccl_create_device(const sccl_instance_t instance,
     physical_device_vulkan_1_2_features.sType =
         VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
     physical_device_vulkan_1_2_features.timelineSemaphore = true;
+    VkPhysicalDeviceSubgroupSizeControlFeatures
+        physical_device_subgroup_size_control_features = {0};
 
     /* enable extentions if available */
     CHECK_SCCL_ERROR_GOTO(sccl_calloc((void **)&device_extensions,
@@ -258,9 +412,19 @@ sccl_error_t sccl_create_device(const sccl_instance_t instance,
         determine_device_extensions(physical_device, device_extensions,
                                     &device_extensions_count,
                                     &device_internal->host_pointer_supported,
-                                    &device_internal->dmabuf_buffer_supported),
+                                    &device_internal->dmabuf_buffer_supported,
+                                    &subgroup_size_control_available,
+                                    &device_internal->memory_budget_supported),
         error_return, error);
 
+    /* enable subgroup size control features if available */
+    if (subgroup_size_control_available) {
+        query_subgroup_size_control(
+            device_internal, &physical_device_subgroup_size_control_features);
+        physical_device_vulkan_1_2_features.pNext =
+            &physical_device_subgroup_size_control_features;
+    }
+
     VkDeviceCreateInfo device_create_info = {0};
     device_create_info.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
     device_create_info.pNext = &physical_device_vulkan_1_2_features;
@@ -274,7 +438,8 @@ sccl_error_t sccl_create_device(const sccl_instance_t instance,
     device_create_info.enabledExtensionCount = device_extensions_count;
 
     CHECK_VKRESULT_GOTO(vkCreateDevice(physical_device, &device_create_info,
-                                       NULL, &device_internal->device),
+                                       sccl_get_vk_allocator(),
+                                       &device_internal->device),
                         error_return, error);
 
     /* dynamically load extension API calls */
@@ -287,6 +452,64 @@ sccl_error_t sccl_create_device(const sccl_instance_t instance,
                 device_internal->device, "vkGetMemoryFdPropertiesKHR");
     }
 
+    CHECK_SCCL_ERROR_GOTO(
+        memory_allocator_init(&device_internal->memory_allocator,
+                              physical_device, device_internal->device),
+        error_return, error);
+    memory_allocator_initialized = true;
+    if (is_force_staged_buffers_set()) {
+        device_internal->memory_allocator.host_visible_device_memory = false;
+    }
+
+    if (pthread_mutex_init(&device_internal->migration_mutex, NULL) != 0) {
+        error = sccl_system_error;
+        goto error_return;
+    }
+    migration_mutex_initialized = true;
+
+    CHECK_SCCL_ERROR_GOTO(file_io_ring_init(&device_internal->file_io),
+                          error_return, error);
+    file_io_initialized = true;
+
+    if (pthread_mutex_init(&device_internal->dmabuf_imports_mutex, NULL) !=
+        0) {
+        error = sccl_system_error;
+        goto error_return;
+    }
+    error = hash_map_init(&device_internal->dmabuf_imports,
+                          sizeof(struct sccl_buffer *));
+    if (error != sccl_success) {
+        pthread_mutex_destroy(&device_internal->dmabuf_imports_mutex);
+        goto error_return;
+    }
+    dmabuf_imports_initialized = true;
+
+    if (pthread_mutex_init(&device_internal->peer_mutex, NULL) != 0) {
+        error = sccl_system_error;
+        goto error_return;
+    }
+    peer_mutex_initialized = true;
+
+    device_internal->numa_node = query_numa_node(physical_device);
+
+    /* on NUMA hosts staging memory is allocated by SCCL on the node of the
+     * device, uploads still go through host visible device memory if most
+     * of it is mappable */
+    const bool host_memory_staging = device_internal->host_pointer_supported &&
+                                     device_internal->numa_node >= 0;
+    CHECK_SCCL_ERROR_GOTO(
+        staging_ring_init(
+            &device_internal->upload_ring, sccl_buffer_type_upload_storage,
+            host_memory_staging && !device_internal->memory_allocator
+                                        .host_visible_device_memory),
+        error_return, error);
+    upload_ring_initialized = true;
+    CHECK_SCCL_ERROR_GOTO(
+        staging_ring_init(&device_internal->download_ring,
+                          sccl_buffer_type_readback_storage,
+                          host_memory_staging),
+        error_return, error);
+
     /* cleanup */
     sccl_free(device_extensions);
 
@@ -302,8 +525,27 @@ error_return:
     }
 
     if (device_internal != NULL) {
+        if (upload_ring_initialized) {
+            staging_ring_destroy(&device_internal->upload_ring);
+        }
+        if (peer_mutex_initialized) {
+            pthread_mutex_destroy(&device_internal->peer_mutex);
+        }
+        if (dmabuf_imports_initialized) {
+            hash_map_destroy(&device_internal->dmabuf_imports);
+            pthread_mutex_destroy(&device_internal->dmabuf_imports_mutex);
+        }
+        if (file_io_initialized) {
+            file_io_ring_destroy(&device_internal->file_io);
+        }
+        if (migration_mutex_initialized) {
+            pthread_mutex_destroy(&device_internal->migration_mutex);
+        }
+        if (memory_allocator_initialized) {
+            memory_allocator_destroy(&device_internal->memory_allocator);
+        }
         if (device_internal->device != VK_NULL_HANDLE) {
-            vkDestroyDevice(device_internal->device, NULL);
+            vkDestroyDevice(device_internal->device, sccl_get_vk_allocator());
         }
         sccl_free(device_internal);
     }
@@ -313,7 +555,27 @@ error_return:
 
 void sccl_destroy_device(sccl_device_t device)
 {
-    vkDestroyDevice(device->device, NULL);
+    if (device->migration_stream != NULL) {
+        sccl_destroy_stream(device->migration_stream);
+    }
+    pthread_mutex_destroy(&device->migration_mutex);
+    for (size_t i = 0; i < PEER_COPY_STREAMS; ++i) {
+        if (device->peer_streams[i] != NULL) {
+            sccl_destroy_stream(device->peer_streams[i]);
+        }
+    }
+    pthread_mutex_destroy(&device->peer_mutex);
+    file_io_ring_destroy(&device->file_io);
+    /* all imported buffers must have been destroyed */
+    assert(hash_map_get_size(&device->dmabuf_imports) == 0);
+    hash_map_destroy(&device->dmabuf_imports);
+    pthread_mutex_destroy(&device->dmabuf_imports_mutex);
+
+    /* ring buffers are allocated from the memory allocator */
+    staging_ring_destroy(&device->download_ring);
+    staging_ring_destroy(&device->upload_ring);
+    memory_allocator_destroy(&device->memory_allocator);
+    vkDestroyDevice(device->device, sccl_get_vk_allocator());
 
     sccl_free(device);
 }
@@ -354,6 +616,33 @@ void sccl_get_device_properties(const sccl_device_t device,
             .maxComputeWorkGroupInvocations;
     device_properties->native_work_group_size =
         physical_device_subgroup_properties.subgroupSize;
+    device_properties->subgroup_supported_operations =
+        physical_device_subgroup_properties.supportedOperations;
+    device_properties->subgroup_supported_stages =
+        physical_device_subgroup_properties.supportedStages;
+    device_properties->subgroup_size_control_supported =
+        device->subgroup_size_control_supported;
+    device_properties->compute_full_subgroups_supported =
+        device->compute_full_subgroups_supported;
+    if (device->max_subgroup_size > 0) {
+        device_properties->min_subgroup_size = device->min_subgroup_size;
+        device_properties->max_subgroup_size = device->max_subgroup_size;
+        device_properties->max_work_group_subgroups =
+            device->max_compute_work_group_subgroups;
+    } else {
+        /* no subgroup size control, only native subgroup size is used */
+        device_properties->min_subgroup_size =
+            physical_device_subgroup_properties.subgroupSize;
+        device_properties->max_subgroup_size =
+            physical_device_subgroup_properties.subgroupSize;
+        device_properties->max_work_group_subgroups =
+            physical_device_properties.properties.limits
+                .maxComputeWorkGroupInvocations /
+            physical_device_subgroup_properties.subgroupSize;
+    }
+    device_properties->host_visible_device_memory =
+        device->memory_allocator.host_visible_device_memory;
+    device_properties->numa_node = device->numa_node;
     device_properties->max_storage_buffer_size =
         physical_device_properties.properties.limits.maxStorageBufferRange;
     device_properties->max_uniform_buffer_size =
@@ -370,3 +659,51 @@ void sccl_get_device_properties(const sccl_device_t device,
         physical_device_external_memory_host_properties
             .minImportedHostPointerAlignment;
 }
+
+void sccl_get_memory_usage(const sccl_device_t device,
+                           sccl_memory_usage_t *usage)
+{
+    memset(usage, 0, sizeof(sccl_memory_usage_t));
+
+    VkPhysicalDeviceMemoryBudgetPropertiesEXT memory_budget_properties = {0};
+    memory_budget_properties.sType =
+        VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+    VkPhysicalDeviceMemoryProperties2 memory_properties = {0};
+    memory_properties.sType =
+        VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2;
+    if (device->memory_budget_supported) {
+        memory_properties.pNext = &memory_budget_properties;
+    }
+    vkGetPhysicalDeviceMemoryProperties2(device->physical_device,
+                                         &memory_properties);
+
+    usage->memory_budget_supported = device->memory_budget_supported;
+    usage->heaps_count = memory_properties.memoryProperties.memoryHeapCount;
+    for (uint32_t i = 0; i < usage->heaps_count; ++i) {
+        const VkMemoryHeap *heap =
+            &memory_properties.memoryProperties.memoryHeaps[i];
+        sccl_memory_heap_usage_t *heap_usage = &usage->heaps[i];
+        heap_usage->size = heap->size;
+        heap_usage->device_local =
+            (heap->flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) != 0;
+        heap_usage->allocated_size =
+            atomic_load(&device->memory_allocator.heap_allocated_size[i]);
+        if (device->memory_budget_supported) {
+            heap_usage->budget = memory_budget_properties.heapBudget[i];
+            heap_usage->usage = memory_budget_properties.heapUsage[i];
+        } else {
+            heap_usage->budget = heap->size;
+            heap_usage->usage = heap_usage->allocated_size;
+        }
+    }
+
+    usage->buffer_count = atomic_load(&device->usage.buffer_count);
+    for (size_t i = 0; i < SCCL_BUFFER_TYPE_COUNT; ++i) {
+        usage->buffer_bytes[i] = atomic_load(&device->usage.buffer_bytes[i]);
+    }
+    usage->descriptor_pool_count =
+        atomic_load(&device->usage.descriptor_pool_count);
+    usage->descriptor_count = atomic_load(&device->usage.descriptor_count);
+    usage->command_buffer_count =
+        atomic_load(&device->usage.command_buffer_count);
+}
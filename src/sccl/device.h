@@ -2,13 +2,31 @@
 #ifndef DEVICE_HEADER
 #define DEVICE_HEADER
 
+#include "file_io.h"
+#include "hash_map.h"
+#include "memory.h"
 #include "sccl.h"
+#include "staging_ring.h"
+#include <pthread.h>
+#include <stdatomic.h>
 #include <stdbool.h>
 #include <vulkan/vulkan.h>
 
 /* always select queue at index 0 */
 #define SCCL_QUEUE_INDEX 0
 
+/* streams alternating between chunks of host staged `sccl_copy_peer` */
+#define PEER_COPY_STREAMS 2
+
+/* object counters reported by `sccl_get_memory_usage` */
+struct device_usage {
+    atomic_size_t buffer_count;
+    atomic_size_t buffer_bytes[SCCL_BUFFER_TYPE_COUNT];
+    atomic_size_t descriptor_pool_count;
+    atomic_size_t descriptor_count;
+    atomic_size_t command_buffer_count;
+};
+
 struct sccl_device {
     VkPhysicalDevice physical_device;
     VkDevice device;
@@ -18,6 +36,19 @@ struct sccl_device {
     /* supported capabilities */
     bool host_pointer_supported;
     bool dmabuf_buffer_supported;
+    bool subgroup_size_control_supported; /**< `requiredSubgroupSize` can be
+                                             used for compute pipelines. */
+    bool compute_full_subgroups_supported;
+    bool memory_budget_supported; /**< `VK_EXT_memory_budget` is enabled. */
+
+    /* subgroup size range, only valid if `subgroup_size_control_supported`
+     * is true. */
+    uint32_t min_subgroup_size;
+    uint32_t max_subgroup_size;
+    uint32_t max_compute_work_group_subgroups;
+
+    /* NUMA node closest to the device, -1 if unknown */
+    int numa_node;
 
     /* dynamically loaded device extension API calls */
     PFN_vkGetMemoryFdKHR
@@ -27,6 +58,33 @@ struct sccl_device {
         pfn_vk_get_memory_fd_properties_khr; /**< only valid if
                                                 `dmabuf_buffer_supported` is
                                                 true. */
+
+    struct memory_allocator memory_allocator;
+    struct device_usage usage;
+
+    /* staging for `sccl_upload` and `sccl_download` */
+    struct staging_ring upload_ring;
+    struct staging_ring download_ring;
+
+    /* copies managed buffers back to the host when they are mapped, created
+     * on first use. Protected by `migration_mutex`. */
+    sccl_stream_t migration_stream;
+    pthread_mutex_t migration_mutex;
+
+    /* io_uring for `sccl_read_file_into_buffer` and
+     * `sccl_write_buffer_to_file` */
+    struct file_io_ring file_io;
+
+    /* buffers imported by `sccl_import_dmabuf_buffer` by
+     * `dmabuf_import_key_t`, values are `struct sccl_buffer *` */
+    hash_map_t dmabuf_imports;
+    pthread_mutex_t dmabuf_imports_mutex;
+
+    /* streams for host staged `sccl_copy_peer` transfers to and from buffers
+     * of this device, created on first use. `peer_mutex` protects them and
+     * the `peer_imports` of buffers of this device. */
+    sccl_stream_t peer_streams[PEER_COPY_STREAMS];
+    pthread_mutex_t peer_mutex;
 };
 
 bool has_seperate_transfer_queue(const sccl_device_t device);
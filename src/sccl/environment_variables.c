@@ -24,3 +24,15 @@ bool is_assert_on_validation_error_set()
     const char *str = getenv(SCCL_ASSERT_ON_VALIDATION_ERROR);
     return parse_input(str);
 }
+
+bool is_force_staged_buffers_set()
+{
+    const char *str = getenv(SCCL_FORCE_STAGED_BUFFERS);
+    return parse_input(str);
+}
+
+bool is_disable_io_uring_set()
+{
+    const char *str = getenv(SCCL_DISABLE_IO_URING);
+    return parse_input(str);
+}
@@ -8,4 +8,8 @@ bool is_enable_validation_layers_set();
 
 bool is_assert_on_validation_error_set();
 
+bool is_force_staged_buffers_set();
+
+bool is_disable_io_uring_set();
+
 #endif // ENVIRONMENT_VARIABLES_HEADER
\ No newline at end of file
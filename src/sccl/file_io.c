@@ -0,0 +1,321 @@
+#include "file_io.h"
+#include "environment_variables.h"
+#include "error.h"
+#include <errno.h>
+#include <linux/io_uring.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+/* there is no libc wrapper for the io_uring system calls */
+static int sys_io_uring_setup(unsigned entries, struct io_uring_params *params)
+{
+    return (int)syscall(__NR_io_uring_setup, entries, params);
+}
+
+/* returns the number of submitted entries or a negative errno */
+static int sys_io_uring_enter(int ring_fd, unsigned to_submit,
+                              unsigned min_complete)
+{
+    const unsigned flags = min_complete > 0 ? IORING_ENTER_GETEVENTS : 0;
+    for (;;) {
+        const long result = syscall(__NR_io_uring_enter, ring_fd, to_submit,
+                                    min_complete, flags, NULL, 0);
+        if (result >= 0) {
+            return (int)result;
+        }
+        if (errno != EINTR) {
+            return -errno;
+        }
+    }
+}
+
+static void unmap_rings(struct file_io_ring *ring)
+{
+    if (ring->sqes != NULL) {
+        munmap(ring->sqes, ring->sqes_size);
+    }
+    if (ring->cq_ring != NULL && ring->cq_ring != ring->sq_ring) {
+        munmap(ring->cq_ring, ring->cq_ring_size);
+    }
+    if (ring->sq_ring != NULL) {
+        munmap(ring->sq_ring, ring->sq_ring_size);
+    }
+    ring->sqes = NULL;
+    ring->cq_ring = NULL;
+    ring->sq_ring = NULL;
+}
+
+static void *map_ring(int ring_fd, size_t size, off_t offset)
+{
+    void *data = mmap(NULL, size, PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_POPULATE, ring_fd, offset);
+    return data == MAP_FAILED ? NULL : data;
+}
+
+/* must hold ring mutex, leaves `ring_fd` at -1 if io_uring is not usable */
+static void setup_ring(struct file_io_ring *ring)
+{
+    ring->setup_done = true;
+
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    ring->ring_fd = sys_io_uring_setup(FILE_IO_RING_ENTRIES, &params);
+    if (ring->ring_fd < 0) {
+        /* not supported by the kernel or blocked by a seccomp filter */
+        ring->ring_fd = -1;
+        return;
+    }
+
+    /* `IORING_OP_READ` and `IORING_OP_WRITE` were added in the same kernel
+     * release as this feature */
+    if ((params.features & IORING_FEAT_RW_CUR_POS) == 0) {
+        goto fallback;
+    }
+
+    ring->sq_ring_size =
+        params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    ring->cq_ring_size =
+        params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    const bool single_mmap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if (single_mmap && ring->cq_ring_size > ring->sq_ring_size) {
+        ring->sq_ring_size = ring->cq_ring_size;
+    }
+
+    ring->sq_ring =
+        map_ring(ring->ring_fd, ring->sq_ring_size, IORING_OFF_SQ_RING);
+    if (ring->sq_ring == NULL) {
+        goto fallback;
+    }
+    ring->cq_ring = single_mmap ? ring->sq_ring
+                                : map_ring(ring->ring_fd, ring->cq_ring_size,
+                                           IORING_OFF_CQ_RING);
+    if (ring->cq_ring == NULL) {
+        goto fallback;
+    }
+    ring->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+    ring->sqes = map_ring(ring->ring_fd, ring->sqes_size, IORING_OFF_SQES);
+    if (ring->sqes == NULL) {
+        goto fallback;
+    }
+
+    char *sq = ring->sq_ring;
+    ring->sq_head = (unsigned *)(sq + params.sq_off.head);
+    ring->sq_tail = (unsigned *)(sq + params.sq_off.tail);
+    ring->sq_array = (unsigned *)(sq + params.sq_off.array);
+    ring->sq_mask = *(unsigned *)(sq + params.sq_off.ring_mask);
+    ring->sq_entries = params.sq_entries;
+
+    char *cq = ring->cq_ring;
+    ring->cq_head = (unsigned *)(cq + params.cq_off.head);
+    ring->cq_tail = (unsigned *)(cq + params.cq_off.tail);
+    ring->cq_mask = *(unsigned *)(cq + params.cq_off.ring_mask);
+    ring->cqes = (struct io_uring_cqe *)(cq + params.cq_off.cqes);
+
+    return;
+
+fallback:
+    unmap_rings(ring);
+    close(ring->ring_fd);
+    ring->ring_fd = -1;
+}
+
+sccl_error_t file_io_ring_init(struct file_io_ring *ring)
+{
+    memset(ring, 0, sizeof(*ring));
+    ring->ring_fd = -1;
+    /* transfers fall back to pread and pwrite */
+    ring->setup_done = is_disable_io_uring_set();
+    if (pthread_mutex_init(&ring->mutex, NULL) != 0) {
+        return sccl_system_error;
+    }
+    return sccl_success;
+}
+
+void file_io_ring_destroy(struct file_io_ring *ring)
+{
+    assert(ring->in_flight == 0);
+    unmap_rings(ring);
+    if (ring->ring_fd >= 0) {
+        close(ring->ring_fd);
+    }
+    pthread_mutex_destroy(&ring->mutex);
+}
+
+/* must hold ring mutex, completions may belong to requests of any stream */
+static void reap_completions(struct file_io_ring *ring)
+{
+    unsigned head = *ring->cq_head;
+    const unsigned tail = __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE);
+    for (; head != tail; ++head) {
+        const struct io_uring_cqe *cqe = &ring->cqes[head & ring->cq_mask];
+        file_io_request_t *request =
+            (file_io_request_t *)(uintptr_t)cqe->user_data;
+        if (cqe->res < 0) {
+            if (request->error == 0) {
+                request->error = -cqe->res;
+            }
+        } else {
+            request->completed_size += (size_t)cqe->res;
+        }
+        --request->pending_chunks;
+        --ring->in_flight;
+    }
+    __atomic_store_n(ring->cq_head, head, __ATOMIC_RELEASE);
+}
+
+/**
+ * Must hold ring mutex. Hand `queued` entries to the kernel, entries it did not
+ * take are removed from the submission queue again. Returns false on failure.
+ */
+static bool submit_queued(struct file_io_ring *ring, unsigned queued,
+                          file_io_request_t *request)
+{
+    const int result = sys_io_uring_enter(ring->ring_fd, queued, 0);
+    const unsigned submitted = result < 0 ? 0 : (unsigned)result;
+    ring->in_flight += submitted;
+    if (submitted == queued) {
+        return true;
+    }
+
+    /* only this thread writes the tail, so it can be moved back */
+    const unsigned rejected = queued - submitted;
+    __atomic_store_n(ring->sq_tail, *ring->sq_tail - rejected,
+                     __ATOMIC_RELEASE);
+    request->pending_chunks -= rejected;
+    if (request->error == 0) {
+        request->error = result < 0 ? -result : EAGAIN;
+    }
+    return false;
+}
+
+/* must hold ring mutex */
+static void queue_chunk(struct file_io_ring *ring, bool write, int fd,
+                        size_t file_offset, void *data, size_t size,
+                        file_io_request_t *request)
+{
+    const unsigned tail = *ring->sq_tail;
+    const unsigned index = tail & ring->sq_mask;
+    struct io_uring_sqe *sqe = &ring->sqes[index];
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = write ? IORING_OP_WRITE : IORING_OP_READ;
+    sqe->fd = fd;
+    sqe->off = file_offset;
+    sqe->addr = (uint64_t)(uintptr_t)data;
+    sqe->len = (uint32_t)size;
+    sqe->user_data = (uint64_t)(uintptr_t)request;
+    ring->sq_array[index] = index;
+    __atomic_store_n(ring->sq_tail, tail + 1, __ATOMIC_RELEASE);
+    ++request->pending_chunks;
+}
+
+/* must hold ring mutex */
+static void submit_chunks(struct file_io_ring *ring, bool write, int fd,
+                          size_t file_offset, char *data, size_t size,
+                          file_io_request_t *request)
+{
+    unsigned queued = 0;
+    for (size_t offset = 0; offset < size; offset += FILE_IO_CHUNK_SIZE) {
+        /* completions of all entries in flight must fit into the completion
+         * queue, which is at least as large as the submission queue */
+        while (ring->in_flight + queued >= ring->sq_entries) {
+            if (queued > 0) {
+                const bool submitted = submit_queued(ring, queued, request);
+                queued = 0;
+                if (!submitted) {
+                    return;
+                }
+                continue;
+            }
+            const int result = sys_io_uring_enter(ring->ring_fd, 0, 1);
+            if (result < 0) {
+                request->error = -result;
+                return;
+            }
+            reap_completions(ring);
+        }
+
+        size_t chunk_size = size - offset;
+        if (chunk_size > FILE_IO_CHUNK_SIZE) {
+            chunk_size = FILE_IO_CHUNK_SIZE;
+        }
+        queue_chunk(ring, write, fd, file_offset + offset, data + offset,
+                    chunk_size, request);
+        ++queued;
+    }
+
+    if (queued > 0) {
+        submit_queued(ring, queued, request);
+    }
+}
+
+static void transfer_sync(bool write, int fd, size_t file_offset, char *data,
+                          size_t size, file_io_request_t *request)
+{
+    while (request->completed_size < size) {
+        const size_t done = request->completed_size;
+        const ssize_t result =
+            write ? pwrite(fd, data + done, size - done,
+                           (off_t)(file_offset + done))
+                  : pread(fd, data + done, size - done,
+                          (off_t)(file_offset + done));
+        if (result < 0 && errno == EINTR) {
+            continue;
+        }
+        if (result < 0) {
+            request->error = errno;
+            return;
+        }
+        if (result == 0) {
+            /* end of file, reported as short transfer */
+            return;
+        }
+        request->completed_size += (size_t)result;
+    }
+}
+
+void file_io_submit(struct file_io_ring *ring, bool write, int fd,
+                    size_t file_offset, void *data, size_t size,
+                    file_io_request_t *request)
+{
+    memset(request, 0, sizeof(*request));
+    request->size = size;
+
+    pthread_mutex_lock(&ring->mutex);
+    if (!ring->setup_done) {
+        setup_ring(ring);
+    }
+    if (ring->ring_fd >= 0) {
+        submit_chunks(ring, write, fd, file_offset, data, size, request);
+        pthread_mutex_unlock(&ring->mutex);
+        return;
+    }
+    pthread_mutex_unlock(&ring->mutex);
+
+    transfer_sync(write, fd, file_offset, data, size, request);
+}
+
+sccl_error_t file_io_wait(struct file_io_ring *ring,
+                          file_io_request_t *request)
+{
+    pthread_mutex_lock(&ring->mutex);
+    while (request->pending_chunks > 0) {
+        reap_completions(ring);
+        if (request->pending_chunks == 0) {
+            break;
+        }
+        /* the kernel still writes to the request's memory, so keep waiting
+         * even if waiting fails */
+        sys_io_uring_enter(ring->ring_fd, 0, 1);
+    }
+    pthread_mutex_unlock(&ring->mutex);
+
+    if (request->error == EINVAL) {
+        return sccl_invalid_argument;
+    }
+    if (request->error != 0 || request->completed_size != request->size) {
+        return sccl_system_error;
+    }
+    return sccl_success;
+}
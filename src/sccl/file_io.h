@@ -0,0 +1,82 @@
+#pragma once
+#ifndef FILE_IO_HEADER
+#define FILE_IO_HEADER
+
+#include "sccl.h"
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * io_uring instance shared by all streams of a device for
+ * `sccl_read_file_into_buffer` and `sccl_write_buffer_to_file`. Requests are
+ * split into chunks so several of them are in flight on the storage device at
+ * once. If io_uring is not available or disabled with `SCCL_DISABLE_IO_URING`
+ * requests are served with `pread` and `pwrite` when they are submitted.
+ */
+
+#define FILE_IO_RING_ENTRIES 64
+#define FILE_IO_CHUNK_SIZE ((size_t)1 << 20) /* 1 MiB */
+
+struct io_uring_sqe;
+struct io_uring_cqe;
+
+struct file_io_ring {
+    pthread_mutex_t mutex;
+    bool setup_done; /* io_uring setup was attempted, on first use */
+    int ring_fd;     /* -1 if io_uring is not available */
+
+    /* kernel shared rings, `cq_ring` equals `sq_ring` if the kernel maps both
+     * at once */
+    void *sq_ring;
+    size_t sq_ring_size;
+    void *cq_ring;
+    size_t cq_ring_size;
+    struct io_uring_sqe *sqes;
+    size_t sqes_size;
+
+    unsigned *sq_head;
+    unsigned *sq_tail;
+    unsigned *sq_array;
+    unsigned sq_mask;
+    unsigned sq_entries;
+    unsigned *cq_head;
+    unsigned *cq_tail;
+    unsigned cq_mask;
+    struct io_uring_cqe *cqes;
+
+    unsigned in_flight; /* submitted chunks without completion */
+};
+
+/* a read or write, completed by `file_io_wait` */
+typedef struct {
+    size_t size;
+    size_t completed_size; /* bytes transferred by completed chunks */
+    size_t pending_chunks;
+    int error; /* errno of the first failed chunk, 0 if none */
+} file_io_request_t;
+
+sccl_error_t file_io_ring_init(struct file_io_ring *ring);
+
+void file_io_ring_destroy(struct file_io_ring *ring);
+
+/**
+ * Start transferring `size` bytes between `data` and `fd` at `file_offset`.
+ * Errors are stored in `request`, which must be passed to `file_io_wait`
+ * before `request` or `data` are released.
+ */
+void file_io_submit(struct file_io_ring *ring, bool write, int fd,
+                    size_t file_offset, void *data, size_t size,
+                    file_io_request_t *request);
+
+/**
+ * Block until all chunks of `request` have completed. Returns
+ * `sccl_invalid_argument` if the kernel rejected the transfer, which happens
+ * for misaligned `O_DIRECT` transfers, and `sccl_system_error` for other
+ * failures or if fewer than `size` bytes were transferred.
+ */
+sccl_error_t file_io_wait(struct file_io_ring *ring,
+                          file_io_request_t *request);
+
+#endif // FILE_IO_HEADER
@@ -0,0 +1,180 @@
+#include "hash_map.h"
+#include "alloc.h"
+#include <string.h>
+
+#define HASH_MAP_INITIAL_CAPACITY 8
+
+/* FNV-1a */
+static uint64_t hash_bytes(const void *key, size_t key_size)
+{
+    uint64_t hash = 0xcbf29ce484222325ull;
+    for (size_t i = 0; i < key_size; ++i) {
+        hash ^= ((const uint8_t *)key)[i];
+        hash *= 0x100000001b3ull;
+    }
+    return hash;
+}
+
+static void *get_value_internal(const hash_map_t *map, size_t index)
+{
+    return (void *)(((uint8_t *)map->values) + index * map->value_size);
+}
+
+/**
+ * Returns index of slot containing key, or index of the empty slot where key
+ * should be inserted. Capacity is always a power of two and never full.
+ */
+static size_t find_slot(const hash_map_t *map, uint64_t hash, const void *key,
+                        size_t key_size)
+{
+    size_t mask = map->capacity - 1;
+    size_t index = hash & mask;
+    while (map->slots[index].occupied) {
+        hash_map_slot_t *slot = &map->slots[index];
+        if (slot->hash == hash && slot->key_size == key_size &&
+            memcmp(slot->key, key, key_size) == 0) {
+            break;
+        }
+        index = (index + 1) & mask;
+    }
+    return index;
+}
+
+/* `map` is only changed on success */
+static sccl_error_t alloc_storage(hash_map_t *map, size_t capacity)
+{
+    hash_map_slot_t *slots = NULL;
+    void *values = NULL;
+    CHECK_SCCL_ERROR_RET(
+        sccl_calloc((void **)&slots, capacity, sizeof(hash_map_slot_t)));
+    sccl_error_t error = sccl_calloc(&values, capacity, map->value_size);
+    if (error != sccl_success) {
+        sccl_free(slots);
+        return error;
+    }
+    map->slots = slots;
+    map->values = values;
+    map->capacity = capacity;
+    return sccl_success;
+}
+
+static sccl_error_t grow(hash_map_t *map)
+{
+    hash_map_t old_map = *map;
+    /* old storage stays in use if the allocation fails */
+    CHECK_SCCL_ERROR_RET(alloc_storage(map, old_map.capacity * 2));
+
+    /* move keys and values to new storage, keys are not reallocated */
+    for (size_t i = 0; i < old_map.capacity; ++i) {
+        hash_map_slot_t *old_slot = &old_map.slots[i];
+        if (!old_slot->occupied) {
+            continue;
+        }
+        size_t index =
+            find_slot(map, old_slot->hash, old_slot->key, old_slot->key_size);
+        map->slots[index] = *old_slot;
+        memcpy(get_value_internal(map, index),
+               get_value_internal(&old_map, i), map->value_size);
+    }
+
+    sccl_free(old_map.slots);
+    sccl_free(old_map.values);
+    return sccl_success;
+}
+
+sccl_error_t hash_map_init(hash_map_t *map, size_t value_size)
+{
+    memset(map, 0, sizeof(hash_map_t));
+    map->value_size = value_size;
+    return alloc_storage(map, HASH_MAP_INITIAL_CAPACITY);
+}
+
+void *hash_map_find(const hash_map_t *map, const void *key, size_t key_size)
+{
+    uint64_t hash = hash_bytes(key, key_size);
+    size_t index = find_slot(map, hash, key, key_size);
+    if (!map->slots[index].occupied) {
+        return NULL;
+    }
+    return get_value_internal(map, index);
+}
+
+sccl_error_t hash_map_insert(hash_map_t *map, const void *key, size_t key_size,
+                             const void *value)
+{
+    assert(hash_map_find(map, key, key_size) == NULL);
+
+    /* keep load factor below 3/4 */
+    if ((map->size + 1) * 4 > map->capacity * 3) {
+        CHECK_SCCL_ERROR_RET(grow(map));
+    }
+
+    void *key_copy = NULL;
+    CHECK_SCCL_ERROR_RET(sccl_calloc(&key_copy, key_size > 0 ? key_size : 1,
+                                     sizeof(uint8_t)));
+    memcpy(key_copy, key, key_size);
+
+    uint64_t hash = hash_bytes(key, key_size);
+    size_t index = find_slot(map, hash, key, key_size);
+    hash_map_slot_t *slot = &map->slots[index];
+    slot->hash = hash;
+    slot->key = key_copy;
+    slot->key_size = key_size;
+    slot->occupied = true;
+    memcpy(get_value_internal(map, index), value, map->value_size);
+    ++map->size;
+
+    return sccl_success;
+}
+
+void hash_map_remove(hash_map_t *map, const void *key, size_t key_size)
+{
+    uint64_t hash = hash_bytes(key, key_size);
+    size_t hole = find_slot(map, hash, key, key_size);
+    if (!map->slots[hole].occupied) {
+        return;
+    }
+    sccl_free(map->slots[hole].key);
+
+    /* shift following entries of the probe sequence back into the hole, so
+     * lookups never stop early and no tombstones are needed */
+    size_t mask = map->capacity - 1;
+    for (size_t index = (hole + 1) & mask; map->slots[index].occupied;
+         index = (index + 1) & mask) {
+        size_t home = map->slots[index].hash & mask;
+        /* entry may move if the hole lies between its home slot and it */
+        if (((index - home) & mask) >= ((index - hole) & mask)) {
+            map->slots[hole] = map->slots[index];
+            memcpy(get_value_internal(map, hole),
+                   get_value_internal(map, index), map->value_size);
+            hole = index;
+        }
+    }
+    memset(&map->slots[hole], 0, sizeof(hash_map_slot_t));
+    --map->size;
+}
+
+size_t hash_map_get_size(const hash_map_t *map) { return map->size; }
+
+size_t hash_map_get_capacity(const hash_map_t *map) { return map->capacity; }
+
+void *hash_map_get_value_at(const hash_map_t *map, size_t index)
+{
+    assert(index < map->capacity);
+    if (!map->slots[index].occupied) {
+        return NULL;
+    }
+    return get_value_internal(map, index);
+}
+
+void hash_map_destroy(hash_map_t *map)
+{
+    assert(map != NULL);
+    for (size_t i = 0; i < map->capacity; ++i) {
+        if (map->slots[i].occupied) {
+            sccl_free(map->slots[i].key);
+        }
+    }
+    sccl_free(map->slots);
+    sccl_free(map->values);
+}
@@ -0,0 +1,60 @@
+#pragma once
+#ifndef SCCL_HASH_MAP_HEADER
+#define SCCL_HASH_MAP_HEADER
+
+#include "sccl.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/**
+ * Open addressing hash map with variable length byte keys and fixed size
+ * values. Keys are copied into the map.
+ */
+typedef struct {
+    uint64_t hash;
+    void *key;
+    size_t key_size;
+    bool occupied;
+} hash_map_slot_t;
+
+typedef struct {
+    hash_map_slot_t *slots;
+    void *values;
+    size_t size;
+    size_t capacity;
+    size_t value_size;
+} hash_map_t;
+
+sccl_error_t hash_map_init(hash_map_t *map, size_t value_size);
+
+/**
+ * Returns pointer to value stored for key, or NULL if key is not in map.
+ */
+void *hash_map_find(const hash_map_t *map, const void *key, size_t key_size);
+
+/**
+ * Insert value for key, key must not already be in map.
+ */
+sccl_error_t hash_map_insert(hash_map_t *map, const void *key, size_t key_size,
+                             const void *value);
+
+/**
+ * Remove key and its value, does nothing if key is not in map. Pointers to
+ * other values may be invalidated.
+ */
+void hash_map_remove(hash_map_t *map, const void *key, size_t key_size);
+
+size_t hash_map_get_size(const hash_map_t *map);
+
+/**
+ * Iterate over map slots by index in range `[0, hash_map_get_capacity)`.
+ * Returns NULL if slot at index is empty.
+ */
+size_t hash_map_get_capacity(const hash_map_t *map);
+
+void *hash_map_get_value_at(const hash_map_t *map, size_t index);
+
+void hash_map_destroy(hash_map_t *map);
+
+#endif // SCCL_HASH_MAP_HEADER
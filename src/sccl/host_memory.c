@@ -0,0 +1,108 @@
+#include "host_memory.h"
+#include <linux/mempolicy.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+/* nodes that can be set in the `mbind` node mask */
+#define HOST_MEMORY_MAX_NUMA_NODES 1024
+#define BITS_PER_LONG (sizeof(unsigned long) * 8)
+
+static size_t align_up(size_t size, size_t alignment)
+{
+    return (size + alignment - 1) / alignment * alignment;
+}
+
+/* map anonymous memory aligned to `alignment` by trimming a larger mapping */
+static void *map_aligned(size_t size, size_t alignment)
+{
+    const size_t page_size = (size_t)sysconf(_SC_PAGESIZE);
+    const size_t slack = alignment > page_size ? alignment - page_size : 0;
+    char *mapping = mmap(NULL, size + slack, PROT_READ | PROT_WRITE,
+                         MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (mapping == MAP_FAILED) {
+        return NULL;
+    }
+
+    char *aligned = (char *)align_up((uintptr_t)mapping, alignment);
+    const size_t head = aligned - mapping;
+    if (head > 0) {
+        munmap(mapping, head);
+    }
+    if (slack - head > 0) {
+        munmap(aligned + size, slack - head);
+    }
+    return aligned;
+}
+
+/* prefer `numa_node`, the kernel falls back to other nodes when it is full */
+static void bind_numa_node(void *pointer, size_t size, int numa_node)
+{
+    if (numa_node < 0 || numa_node >= HOST_MEMORY_MAX_NUMA_NODES) {
+        return;
+    }
+
+    unsigned long node_mask[HOST_MEMORY_MAX_NUMA_NODES / BITS_PER_LONG] = {0};
+    node_mask[numa_node / BITS_PER_LONG] = 1UL << (numa_node % BITS_PER_LONG);
+    /* best effort, fails without NUMA support in the kernel */
+    syscall(SYS_mbind, pointer, size, MPOL_PREFERRED, node_mask,
+            (unsigned long)HOST_MEMORY_MAX_NUMA_NODES, 0);
+}
+
+sccl_error_t host_memory_allocate(int numa_node, size_t size, size_t alignment,
+                                  void **pointer, size_t *allocated_size)
+{
+    const size_t page_size = (size_t)sysconf(_SC_PAGESIZE);
+    const bool huge = size >= HOST_MEMORY_HUGE_PAGE_SIZE;
+    if (alignment < page_size) {
+        alignment = page_size;
+    }
+    if (huge && alignment < HOST_MEMORY_HUGE_PAGE_SIZE) {
+        alignment = HOST_MEMORY_HUGE_PAGE_SIZE;
+    }
+    const size_t mapping_size = align_up(size, alignment);
+
+    void *mapping = NULL;
+    if (huge) {
+        /* explicit huge pages need a reserved pool, which is usually empty */
+        mapping = mmap(NULL, mapping_size, PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (mapping == MAP_FAILED ||
+            (uintptr_t)mapping % alignment != 0) {
+            if (mapping != MAP_FAILED) {
+                munmap(mapping, mapping_size);
+            }
+            mapping = NULL;
+        }
+    }
+    if (mapping == NULL) {
+        mapping = map_aligned(mapping_size, alignment);
+        if (mapping == NULL) {
+            return sccl_system_error;
+        }
+        if (huge) {
+            /* transparent huge pages, ignored if disabled */
+            madvise(mapping, mapping_size, MADV_HUGEPAGE);
+        }
+    }
+
+    bind_numa_node(mapping, mapping_size, numa_node);
+
+    /* fault in pages now, so they are placed by the NUMA policy and not on
+     * first use by the device */
+    for (size_t offset = 0; offset < mapping_size; offset += page_size) {
+        ((volatile char *)mapping)[offset] = 0;
+    }
+
+    *pointer = mapping;
+    *allocated_size = mapping_size;
+
+    return sccl_success;
+}
+
+void host_memory_free(void *pointer, size_t allocated_size)
+{
+    munmap(pointer, allocated_size);
+}
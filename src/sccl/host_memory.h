@@ -0,0 +1,28 @@
+#pragma once
+#ifndef HOST_MEMORY_HEADER
+#define HOST_MEMORY_HEADER
+
+#include "error.h"
+#include <stddef.h>
+
+/**
+ * Host memory allocated by SCCL for staging and external host pointer
+ * buffers. Large allocations are backed by huge pages and memory is placed on
+ * the NUMA node closest to the device, so DMA does not cross sockets.
+ */
+
+/* allocations of at least this size use huge pages */
+#define HOST_MEMORY_HUGE_PAGE_SIZE ((size_t)2 << 20) /* 2 MiB */
+
+/**
+ * Allocate at least `size` bytes aligned to `alignment`, which must be a power
+ * of two. Memory is zero initialized and already faulted in. `numa_node` is
+ * the preferred node or -1 to use the default policy. `allocated_size` is set
+ * to the size that must be passed to `host_memory_free`.
+ */
+sccl_error_t host_memory_allocate(int numa_node, size_t size, size_t alignment,
+                                  void **pointer, size_t *allocated_size);
+
+void host_memory_free(void *pointer, size_t allocated_size);
+
+#endif // HOST_MEMORY_HEADER
@@ -78,8 +78,8 @@ static VkResult setup_debug_messenger(VkInstance instance,
     VkDebugUtilsMessengerCreateInfoEXT createInfo;
     populate_debug_messenger_create_info(&createInfo);
 
-    return create_debug_utils_messenger_ext(instance, &createInfo, NULL,
-                                            debug_messenger);
+    return create_debug_utils_messenger_ext(
+        instance, &createInfo, sccl_get_vk_allocator(), debug_messenger);
 }
 
 static sccl_error_t check_validation_layer_support(bool *supported)
@@ -143,10 +143,21 @@ static sccl_error_t update_physical_device_list(sccl_instance_t instance)
 }
 
 sccl_error_t sccl_create_instance(sccl_instance_t *instance)
+{
+    const sccl_instance_config_t config = {0};
+    return sccl_create_instance_with_config(&config, instance);
+}
+
+sccl_error_t
+sccl_create_instance_with_config(const sccl_instance_config_t *config,
+                                 sccl_instance_t *instance)
 {
     sccl_error_t error = sccl_success;
 
     struct sccl_instance *instance_internal = NULL;
+
+    /* install allocator before the first allocation */
+    CHECK_SCCL_ERROR_RET(sccl_acquire_allocator(config->allocator));
     CHECK_SCCL_ERROR_GOTO(sccl_calloc((void **)&instance_internal, 1,
                                       sizeof(struct sccl_instance)),
                           error_return, error);
@@ -172,7 +183,8 @@ sccl_error_t sccl_create_instance(sccl_instance_t *instance)
         CHECK_SCCL_ERROR_GOTO(check_validation_layer_support(&supported),
                               error_return, error);
         if (!supported) {
-            return sccl_unsupported_error;
+            error = sccl_unsupported_error;
+            goto error_return;
         }
 
         create_info.enabledExtensionCount = 1;
@@ -181,9 +193,9 @@ sccl_error_t sccl_create_instance(sccl_instance_t *instance)
         create_info.ppEnabledLayerNames = validation_layers;
     }
 
-    CHECK_VKRESULT_GOTO(
-        vkCreateInstance(&create_info, NULL, &instance_internal->instance),
-        error_return, error);
+    CHECK_VKRESULT_GOTO(vkCreateInstance(&create_info, sccl_get_vk_allocator(),
+                                         &instance_internal->instance),
+                        error_return, error);
 
     if (is_enable_validation_layers_set()) {
         CHECK_VKRESULT_GOTO(
@@ -211,13 +223,15 @@ error_return:
             instance_internal->debug_messenger != VK_NULL_HANDLE) {
             destroy_debug_utils_messenger_ext(
                 instance_internal->instance, instance_internal->debug_messenger,
-                NULL);
+                sccl_get_vk_allocator());
         }
         if (instance_internal->instance != VK_NULL_HANDLE) {
-            vkDestroyInstance(instance_internal->instance, NULL);
+            vkDestroyInstance(instance_internal->instance,
+                              sccl_get_vk_allocator());
         }
         sccl_free(instance_internal);
     }
+    sccl_release_allocator();
 
     return error;
 }
@@ -230,12 +244,14 @@ void sccl_destroy_instance(sccl_instance_t instance)
 
     if (is_enable_validation_layers_set()) {
         destroy_debug_utils_messenger_ext(instance->instance,
-                                          instance->debug_messenger, NULL);
+                                          instance->debug_messenger,
+                                          sccl_get_vk_allocator());
     }
 
-    vkDestroyInstance(instance->instance, NULL);
+    vkDestroyInstance(instance->instance, sccl_get_vk_allocator());
 
     sccl_free(instance);
+    sccl_release_allocator();
 }
 
 sccl_error_t sccl_get_device_count(const sccl_instance_t instance,
@@ -0,0 +1,414 @@
+#include "memory.h"
+#include "alloc.h"
+#include "error.h"
+
+#define MEMORY_NODE_NONE UINT32_MAX
+
+static uint32_t get_node_level(uint32_t node)
+{
+    uint32_t level = 0;
+    while (node + 1 >= (2u << level)) {
+        level++;
+    }
+    return level;
+}
+
+static uint32_t get_node_order(uint32_t node)
+{
+    return MEMORY_MAX_ORDER - get_node_level(node);
+}
+
+static VkDeviceSize get_node_offset(uint32_t node)
+{
+    const uint32_t level = get_node_level(node);
+    const uint32_t index = node - ((1u << level) - 1);
+    return (VkDeviceSize)index
+           << (MEMORY_MIN_ALLOCATION_SHIFT + get_node_order(node));
+}
+
+static uint32_t get_buddy_node(uint32_t node)
+{
+    return ((node - 1) ^ 1) + 1;
+}
+
+static uint32_t get_parent_node(uint32_t node) { return (node - 1) / 2; }
+
+static uint32_t get_left_child_node(uint32_t node) { return 2 * node + 1; }
+
+/* smallest order with buddy size >= size, buddies are aligned to their size */
+static uint32_t get_allocation_order(VkDeviceSize size)
+{
+    uint32_t order = 0;
+    while (((VkDeviceSize)1 << (MEMORY_MIN_ALLOCATION_SHIFT + order)) < size) {
+        order++;
+    }
+    return order;
+}
+
+static void push_free_node(struct memory_block *block, uint32_t node)
+{
+    const uint32_t order = get_node_order(node);
+    const uint32_t head = block->free_lists[order];
+    block->nodes[node].free = true;
+    block->nodes[node].prev = MEMORY_NODE_NONE;
+    block->nodes[node].next = head;
+    if (head != MEMORY_NODE_NONE) {
+        block->nodes[head].prev = node;
+    }
+    block->free_lists[order] = node;
+}
+
+static void remove_free_node(struct memory_block *block, uint32_t node)
+{
+    const uint32_t order = get_node_order(node);
+    memory_node_t *entry = &block->nodes[node];
+    if (entry->prev != MEMORY_NODE_NONE) {
+        block->nodes[entry->prev].next = entry->next;
+    } else {
+        block->free_lists[order] = entry->next;
+    }
+    if (entry->next != MEMORY_NODE_NONE) {
+        block->nodes[entry->next].prev = entry->prev;
+    }
+    entry->free = false;
+}
+
+static bool block_allocate(struct memory_block *block, uint32_t order,
+                           uint32_t *out_node)
+{
+    /* find smallest free buddy that fits */
+    uint32_t free_order = order;
+    while (free_order <= MEMORY_MAX_ORDER &&
+           block->free_lists[free_order] == MEMORY_NODE_NONE) {
+        free_order++;
+    }
+    if (free_order > MEMORY_MAX_ORDER) {
+        return false;
+    }
+
+    uint32_t node = block->free_lists[free_order];
+    remove_free_node(block, node);
+
+    /* split until requested order, keep right halves free */
+    while (free_order > order) {
+        const uint32_t left = get_left_child_node(node);
+        push_free_node(block, left + 1);
+        node = left;
+        free_order--;
+    }
+
+    block->allocated_size += (VkDeviceSize)1
+                             << (MEMORY_MIN_ALLOCATION_SHIFT + order);
+    *out_node = node;
+    return true;
+}
+
+static void block_free(struct memory_block *block, uint32_t node)
+{
+    block->allocated_size -=
+        (VkDeviceSize)1 << (MEMORY_MIN_ALLOCATION_SHIFT + get_node_order(node));
+
+    /* merge with free buddies */
+    while (node != 0) {
+        const uint32_t buddy = get_buddy_node(node);
+        if (!block->nodes[buddy].free) {
+            break;
+        }
+        remove_free_node(block, buddy);
+        node = get_parent_node(node);
+    }
+    push_free_node(block, node);
+}
+
+static _Atomic uint64_t *
+get_heap_allocated_size(struct memory_allocator *allocator,
+                        uint32_t memory_type_index)
+{
+    const uint32_t heap_index =
+        allocator->memory_properties.memoryTypes[memory_type_index].heapIndex;
+    return &allocator->heap_allocated_size[heap_index];
+}
+
+static void destroy_block(struct memory_allocator *allocator,
+                          struct memory_block *block)
+{
+    if (block->mapped != NULL) {
+        vkUnmapMemory(allocator->device, block->memory);
+    }
+    if (block->memory != VK_NULL_HANDLE) {
+        vkFreeMemory(allocator->device, block->memory, sccl_get_vk_allocator());
+        atomic_fetch_sub(
+            get_heap_allocated_size(allocator, block->memory_type_index),
+            MEMORY_BLOCK_SIZE);
+    }
+    if (block->nodes != NULL) {
+        sccl_free(block->nodes);
+    }
+    sccl_free(block);
+}
+
+static sccl_error_t create_block(struct memory_allocator *allocator,
+                                 uint32_t memory_type_index,
+                                 struct memory_block **block)
+{
+    sccl_error_t error = sccl_success;
+
+    CHECK_SCCL_ERROR_RET(
+        sccl_calloc((void **)block, 1, sizeof(struct memory_block)));
+    (*block)->memory_type_index = memory_type_index;
+
+    CHECK_SCCL_ERROR_GOTO(sccl_calloc((void **)&(*block)->nodes,
+                                      MEMORY_NODE_COUNT,
+                                      sizeof(memory_node_t)),
+                          error_return, error);
+    for (uint32_t order = 0; order <= MEMORY_MAX_ORDER; order++) {
+        (*block)->free_lists[order] = MEMORY_NODE_NONE;
+    }
+    push_free_node(*block, 0);
+
+    VkMemoryAllocateInfo memory_allocate_info = {0};
+    memory_allocate_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    memory_allocate_info.allocationSize = MEMORY_BLOCK_SIZE;
+    memory_allocate_info.memoryTypeIndex = memory_type_index;
+    CHECK_VKRESULT_GOTO(vkAllocateMemory(allocator->device,
+                                         &memory_allocate_info,
+                                         sccl_get_vk_allocator(),
+                                         &(*block)->memory),
+                        error_return, error);
+    atomic_fetch_add(get_heap_allocated_size(allocator, memory_type_index),
+                     MEMORY_BLOCK_SIZE);
+
+    /* persistently map host visible blocks, memory can only be mapped once */
+    if (allocator->memory_properties.memoryTypes[memory_type_index]
+            .propertyFlags &
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) {
+        CHECK_VKRESULT_GOTO(vkMapMemory(allocator->device, (*block)->memory, 0,
+                                        VK_WHOLE_SIZE, 0, &(*block)->mapped),
+                            error_return, error);
+    }
+
+    return sccl_success;
+
+error_return:
+    destroy_block(allocator, *block);
+    *block = NULL;
+    return error;
+}
+
+static sccl_error_t allocate_dedicated(struct memory_allocator *allocator,
+                                       const VkMemoryRequirements *requirements,
+                                       uint32_t memory_type_index,
+                                       const void *memory_allocate_info_pnext,
+                                       memory_allocation_t *allocation)
+{
+    VkMemoryAllocateInfo memory_allocate_info = {0};
+    memory_allocate_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    memory_allocate_info.pNext = memory_allocate_info_pnext;
+    memory_allocate_info.allocationSize = requirements->size;
+    memory_allocate_info.memoryTypeIndex = memory_type_index;
+    CHECK_VKRESULT_RET(vkAllocateMemory(allocator->device,
+                                        &memory_allocate_info,
+                                        sccl_get_vk_allocator(),
+                                        &allocation->memory));
+    atomic_fetch_add(get_heap_allocated_size(allocator, memory_type_index),
+                     requirements->size);
+    allocation->offset = 0;
+    allocation->size = requirements->size;
+    allocation->mapped = NULL;
+    allocation->block = NULL;
+    allocation->node = 0;
+    allocation->memory_type_index = memory_type_index;
+    return sccl_success;
+}
+
+/* must hold allocator mutex */
+static sccl_error_t
+allocate_from_blocks(struct memory_allocator *allocator,
+                     const VkMemoryRequirements *requirements,
+                     uint32_t memory_type_index,
+                     memory_allocation_t *allocation)
+{
+    vector_t *blocks = &allocator->blocks[memory_type_index];
+    const VkDeviceSize size = requirements->size > requirements->alignment
+                                  ? requirements->size
+                                  : requirements->alignment;
+    const uint32_t order = get_allocation_order(size);
+
+    struct memory_block *block = NULL;
+    uint32_t node = 0;
+    for (size_t i = 0; i < vector_get_size(blocks); i++) {
+        struct memory_block *candidate =
+            *(struct memory_block **)vector_get_element(blocks, i);
+        if (block_allocate(candidate, order, &node)) {
+            block = candidate;
+            break;
+        }
+    }
+
+    if (block == NULL) {
+        CHECK_SCCL_ERROR_RET(
+            create_block(allocator, memory_type_index, &block));
+        sccl_error_t error = vector_add_element(blocks, &block);
+        if (error != sccl_success) {
+            destroy_block(allocator, block);
+            return error;
+        }
+        block_allocate(block, order, &node);
+    }
+
+    allocation->memory = block->memory;
+    allocation->offset = get_node_offset(node);
+    allocation->size = requirements->size;
+    allocation->mapped = block->mapped != NULL
+                             ? (char *)block->mapped + allocation->offset
+                             : NULL;
+    allocation->block = block;
+    allocation->node = node;
+    allocation->memory_type_index = memory_type_index;
+    return sccl_success;
+}
+
+static bool has_host_visible_device_memory(
+    const VkPhysicalDeviceMemoryProperties *memory_properties)
+{
+    const VkMemoryPropertyFlags host_visible_device_flags =
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT |
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+        VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+
+    VkDeviceSize largest_device_heap_size = 0;
+    for (uint32_t i = 0; i < memory_properties->memoryHeapCount; i++) {
+        const VkMemoryHeap *heap = &memory_properties->memoryHeaps[i];
+        if ((heap->flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) &&
+            heap->size > largest_device_heap_size) {
+            largest_device_heap_size = heap->size;
+        }
+    }
+
+    /* without resizable BAR only a small window (typically 256 MiB) of device
+     * memory is host visible */
+    for (uint32_t i = 0; i < memory_properties->memoryTypeCount; i++) {
+        const VkMemoryType *type = &memory_properties->memoryTypes[i];
+        if ((type->propertyFlags & host_visible_device_flags) ==
+                host_visible_device_flags &&
+            memory_properties->memoryHeaps[type->heapIndex].size >=
+                largest_device_heap_size / 2) {
+            return true;
+        }
+    }
+    return false;
+}
+
+sccl_error_t memory_allocator_init(struct memory_allocator *allocator,
+                                   VkPhysicalDevice physical_device,
+                                   VkDevice device)
+{
+    allocator->device = device;
+    vkGetPhysicalDeviceMemoryProperties(physical_device,
+                                        &allocator->memory_properties);
+    VkPhysicalDeviceProperties physical_device_properties;
+    vkGetPhysicalDeviceProperties(physical_device, &physical_device_properties);
+    allocator->non_coherent_atom_size =
+        physical_device_properties.limits.nonCoherentAtomSize;
+    allocator->host_visible_device_memory =
+        has_host_visible_device_memory(&allocator->memory_properties);
+
+    for (uint32_t i = 0; i < VK_MAX_MEMORY_HEAPS; i++) {
+        atomic_init(&allocator->heap_allocated_size[i], 0);
+    }
+
+    if (pthread_mutex_init(&allocator->mutex, NULL) != 0) {
+        return sccl_system_error;
+    }
+
+    for (uint32_t i = 0; i < VK_MAX_MEMORY_TYPES; i++) {
+        sccl_error_t error =
+            vector_init(&allocator->blocks[i], sizeof(struct memory_block *));
+        if (error != sccl_success) {
+            for (uint32_t j = 0; j < i; j++) {
+                vector_destroy(&allocator->blocks[j]);
+            }
+            pthread_mutex_destroy(&allocator->mutex);
+            return error;
+        }
+    }
+
+    return sccl_success;
+}
+
+void memory_allocator_destroy(struct memory_allocator *allocator)
+{
+    for (uint32_t i = 0; i < VK_MAX_MEMORY_TYPES; i++) {
+        vector_t *blocks = &allocator->blocks[i];
+        for (size_t j = 0; j < vector_get_size(blocks); j++) {
+            destroy_block(allocator, *(struct memory_block **)
+                                         vector_get_element(blocks, j));
+        }
+        vector_destroy(blocks);
+    }
+    pthread_mutex_destroy(&allocator->mutex);
+}
+
+sccl_error_t memory_allocate(struct memory_allocator *allocator,
+                             const VkMemoryRequirements *requirements,
+                             uint32_t memory_type_index, bool dedicated,
+                             const void *memory_allocate_info_pnext,
+                             memory_allocation_t *allocation)
+{
+    if (dedicated || requirements->size > MEMORY_DEDICATED_THRESHOLD ||
+        requirements->alignment > MEMORY_DEDICATED_THRESHOLD) {
+        return allocate_dedicated(allocator, requirements, memory_type_index,
+                                  memory_allocate_info_pnext, allocation);
+    }
+
+    pthread_mutex_lock(&allocator->mutex);
+    sccl_error_t error = allocate_from_blocks(allocator, requirements,
+                                              memory_type_index, allocation);
+    pthread_mutex_unlock(&allocator->mutex);
+
+    /* heap may be too small or fragmented for a new block */
+    if (error == sccl_unhandled_vulkan_error) {
+        return allocate_dedicated(allocator, requirements, memory_type_index,
+                                  NULL, allocation);
+    }
+    return error;
+}
+
+void memory_free(struct memory_allocator *allocator,
+                 const memory_allocation_t *allocation)
+{
+    if (allocation->block == NULL) {
+        if (allocation->mapped != NULL) {
+            vkUnmapMemory(allocator->device, allocation->memory);
+        }
+        vkFreeMemory(allocator->device, allocation->memory,
+                     sccl_get_vk_allocator());
+        atomic_fetch_sub(get_heap_allocated_size(
+                             allocator, allocation->memory_type_index),
+                         allocation->size);
+        return;
+    }
+
+    pthread_mutex_lock(&allocator->mutex);
+
+    struct memory_block *block = allocation->block;
+    block_free(block, allocation->node);
+
+    /* release empty blocks, but keep one per memory type to avoid thrashing
+     * when a single buffer is repeatedly created and destroyed */
+    vector_t *blocks = &allocator->blocks[block->memory_type_index];
+    if (block->allocated_size == 0 && vector_get_size(blocks) > 1) {
+        for (size_t i = 0; i < vector_get_size(blocks); i++) {
+            struct memory_block **entry = vector_get_element(blocks, i);
+            if (*entry == block) {
+                *entry =
+                    *(struct memory_block **)vector_get_last_element(blocks);
+                vector_remove_last_element(blocks);
+                break;
+            }
+        }
+        destroy_block(allocator, block);
+    }
+
+    pthread_mutex_unlock(&allocator->mutex);
+}
@@ -0,0 +1,94 @@
+#pragma once
+#ifndef MEMORY_HEADER
+#define MEMORY_HEADER
+
+#include "sccl.h"
+#include "vector.h"
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <vulkan/vulkan.h>
+
+/**
+ * Device memory sub-allocator. Memory is allocated in large blocks per memory
+ * type and split between buffers with a buddy allocator. Host visible blocks
+ * are persistently mapped.
+ */
+
+#define MEMORY_BLOCK_SIZE ((VkDeviceSize)64 << 20) /* 64 MiB */
+/* smallest buddy is 4 KiB */
+#define MEMORY_MIN_ALLOCATION_SHIFT 12
+/* orders [0, MEMORY_MAX_ORDER], order `MEMORY_MAX_ORDER` is a whole block */
+#define MEMORY_MAX_ORDER 14
+#define MEMORY_NODE_COUNT ((1u << (MEMORY_MAX_ORDER + 1)) - 1)
+/* allocations larger than this get their own `VkDeviceMemory` */
+#define MEMORY_DEDICATED_THRESHOLD (MEMORY_BLOCK_SIZE / 2)
+
+typedef struct {
+    uint32_t next;
+    uint32_t prev;
+    bool free;
+} memory_node_t;
+
+struct memory_block {
+    VkDeviceMemory memory;
+    void *mapped; /* NULL if memory type is not host visible */
+    uint32_t memory_type_index;
+    VkDeviceSize allocated_size;
+    /* head of free node list for each order */
+    uint32_t free_lists[MEMORY_MAX_ORDER + 1];
+    /* complete binary tree of buddies, node 0 is the whole block */
+    memory_node_t *nodes;
+};
+
+struct memory_allocator {
+    VkDevice device;
+    VkPhysicalDeviceMemoryProperties memory_properties;
+    VkDeviceSize non_coherent_atom_size;
+    /* true if host visible and coherent device local memory spans most of
+     * device memory, as on UMA devices and with resizable BAR */
+    bool host_visible_device_memory;
+    pthread_mutex_t mutex;
+    vector_t blocks[VK_MAX_MEMORY_TYPES]; /* struct memory_block * */
+    /* bytes of `VkDeviceMemory` allocated per heap, blocks and dedicated */
+    _Atomic uint64_t heap_allocated_size[VK_MAX_MEMORY_HEAPS];
+};
+
+typedef struct {
+    VkDeviceMemory memory;
+    VkDeviceSize offset;
+    VkDeviceSize size;
+    /* host address of `offset`, NULL if not mapped. Owner of a dedicated
+     * allocation may map it persistently and set this, it is then unmapped by
+     * `memory_free`. */
+    void *mapped;
+    struct memory_block *block; /* NULL for dedicated allocations */
+    uint32_t node;
+    uint32_t memory_type_index;
+} memory_allocation_t;
+
+sccl_error_t memory_allocator_init(struct memory_allocator *allocator,
+                                   VkPhysicalDevice physical_device,
+                                   VkDevice device);
+
+/**
+ * All allocations must be freed before the allocator is destroyed.
+ */
+void memory_allocator_destroy(struct memory_allocator *allocator);
+
+/**
+ * Allocate memory satisfying `requirements` from `memory_type_index`.
+ * If `dedicated` is true the allocation gets its own `VkDeviceMemory` allocated
+ * with `memory_allocate_info_pnext`, this is required for external memory.
+ * Large allocations are always dedicated.
+ */
+sccl_error_t memory_allocate(struct memory_allocator *allocator,
+                             const VkMemoryRequirements *requirements,
+                             uint32_t memory_type_index, bool dedicated,
+                             const void *memory_allocate_info_pnext,
+                             memory_allocation_t *allocation);
+
+void memory_free(struct memory_allocator *allocator,
+                 const memory_allocation_t *allocation);
+
+#endif // MEMORY_HEADER
@@ -7,6 +7,7 @@
 extern "C" {
 #endif
 
+#include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
 
@@ -85,14 +86,74 @@ typedef enum {
     sccl_buffer_type_external_dmabuf_storage =
         15, /**< Buffer type for external dmabuf storage memory. */
     sccl_buffer_type_external_dmabuf_uniform =
-        16 /**< Buffer type for external dmabuf uniform memory. */
+        16, /**< Buffer type for external dmabuf uniform memory. */
+    sccl_buffer_type_readback_storage =
+        17, /**< Buffer type for host storage memory that is read by the host,
+               prefers host cached memory. */
+    sccl_buffer_type_upload_storage =
+        18, /**< Buffer type for host storage memory that is written by the
+               host, prefers write-combined or host visible device memory. */
+    sccl_buffer_type_readback_uniform =
+        19, /**< Buffer type for host uniform memory that is read by the host,
+               prefers host cached memory. */
+    sccl_buffer_type_upload_uniform =
+        20, /**< Buffer type for host uniform memory that is written by the
+               host, prefers write-combined or host visible device memory. */
+    sccl_buffer_type_auto_storage =
+        21, /**< Buffer type for device storage memory that is also accessed by
+               the host. Mapped directly on UMA and resizable BAR devices,
+               otherwise or if host visible device memory is exhausted
+               accessed through an internal staging buffer, see
+               `sccl_sync_buffer_to_device`. */
+    sccl_buffer_type_managed_storage =
+        22 /**< Buffer type for device storage memory with a host copy that
+               is kept coherent by SCCL. Data is copied to the device when the
+               buffer is used by a stream and back to the host when it is
+               mapped, see `sccl_host_map_buffer`. The coherence state is not
+               synchronized, a managed buffer must not be mapped or used by
+               streams from several threads at the same time. */
 } sccl_buffer_type_t;
 
+/* one past the largest `sccl_buffer_type_t` value */
+#define SCCL_BUFFER_TYPE_COUNT 23
+
+/**
+ * @brief Enum representing subgroup operation bits.
+ *
+ * Values match `VkSubgroupFeatureFlagBits` from
+ * https://registry.khronos.org/vulkan/specs/1.3-extensions/man/html/VkSubgroupFeatureFlagBits.html
+ */
+typedef enum {
+    sccl_subgroup_feature_basic = 0x1,      /**< `subgroupBarrier`,
+                                               `subgroupElect` etc. */
+    sccl_subgroup_feature_vote = 0x2,       /**< `subgroupAll`, `subgroupAny`
+                                               etc. */
+    sccl_subgroup_feature_arithmetic = 0x4, /**< `subgroupAdd`, `subgroupMax`
+                                               etc. */
+    sccl_subgroup_feature_ballot = 0x8,     /**< `subgroupBallot`,
+                                               `subgroupBroadcast` etc. */
+    sccl_subgroup_feature_shuffle = 0x10,   /**< `subgroupShuffle` etc. */
+    sccl_subgroup_feature_shuffle_relative =
+        0x20, /**< `subgroupShuffleUp`, `subgroupShuffleDown` etc. */
+    sccl_subgroup_feature_clustered =
+        0x40, /**< `subgroupClusteredAdd` etc. */
+    sccl_subgroup_feature_quad = 0x80 /**< `subgroupQuadBroadcast` etc. */
+} sccl_subgroup_feature_t;
+
+/**
+ * Compute shader stage bit, value matches `VK_SHADER_STAGE_COMPUTE_BIT`.
+ */
+typedef enum { sccl_shader_stage_compute = 0x20 } sccl_shader_stage_t;
+
 typedef struct sccl_instance *sccl_instance_t; /* opaque handle */
 typedef struct sccl_device *sccl_device_t;     /* opaque handle */
 typedef struct sccl_buffer *sccl_buffer_t;     /* opaque handle */
 typedef struct sccl_stream *sccl_stream_t;     /* opaque handle */
 typedef struct sccl_shader *sccl_shader_t;     /* opaque handle */
+typedef struct sccl_shader_module *sccl_shader_module_t;   /* opaque handle */
+typedef struct sccl_shader_bundle *sccl_shader_bundle_t;   /* opaque handle */
+typedef struct sccl_buffer_pool *sccl_buffer_pool_t;       /* opaque handle */
+typedef struct sccl_tiled_executor *sccl_tiled_executor_t; /* opaque handle */
 
 typedef struct {
     uint32_t constant_id;
@@ -120,6 +181,18 @@ typedef struct {
 } sccl_shader_buffer_layout_t;
 
 #define SCCL_BIND_WHOLE_BUFFER (~0ul)
+#define SCCL_WHOLE_SIZE (~0ul)
+
+/* one range copied by `sccl_copy_buffer_regions`, offsets are in bytes */
+typedef struct {
+    size_t src_offset;
+    size_t dst_offset;
+    size_t size;
+} sccl_buffer_copy_region_t;
+
+/* granularity of dirty tracking of buffers from
+ * `sccl_create_mirrored_buffer`, in bytes */
+#define SCCL_MIRRORED_BUFFER_PAGE_SIZE 4096
 
 typedef struct {
     sccl_shader_buffer_position_t position;
@@ -135,9 +208,47 @@ typedef struct {
 
 #define SCCL_DEFAULT_MAX_CONCURRENT_BUFFER_BINDINGS 8
 
+/**
+ * Tag a range of push constant data as specializable. When the same tagged
+ * values are seen in more than `auto_specialization_threshold` dispatches, a
+ * pipeline variant with the values baked in as specialization constant
+ * `constant_id` is compiled in the background, and used for later dispatches
+ * with the same values.
+ *
+ * Since the push constant is still pushed, shaders should prefer the
+ * specialization constant when it differs from a sentinel default, letting the
+ * compiler fold the value in specialized variants:
+ *
+ * ```glsl
+ * layout(constant_id = 3) const uint c_number_of_ranks = 0;
+ * layout(push_constant) uniform PushConstants { uint number_of_ranks; } pc;
+ * ...
+ * uint number_of_ranks = (c_number_of_ranks != 0) ? c_number_of_ranks
+ *                                                 : pc.number_of_ranks;
+ * ```
+ */
+typedef struct {
+    /* index of push constant layout in `sccl_shader_config_t` */
+    uint32_t push_constant_index;
+    /* offset in bytes into the push constant data */
+    size_t offset;
+    /* size in bytes of the tagged value */
+    size_t size;
+    /* specialization constant id the value is bound to */
+    uint32_t constant_id;
+} sccl_shader_auto_specialization_t;
+
+#define SCCL_DEFAULT_AUTO_SPECIALIZATION_THRESHOLD 16
+
 typedef struct {
-    char *shader_source_code;         /* required */
+    /* SPIR-V code, required if `shader_module` is NULL */
+    char *shader_source_code;
     size_t shader_source_code_length; /* must be larger than 0 */
+    /* shared shader module, alternative to `shader_source_code`. Exactly one
+     * of `shader_source_code` and `shader_module` must be set. */
+    sccl_shader_module_t shader_module;
+    /* name of compute entry point in shader, if NULL then "main" is used */
+    const char *entry_point;
     sccl_shader_specialization_constant_t
         *specialization_constants; /* optional */
     size_t specialization_constants_count;
@@ -148,8 +259,41 @@ typedef struct {
     /* maximum number of concurrent buffer bindings for this shader, if 0 then
      * `SCCL_DEFAULT_MAX_CONCURRENT_BUFFER_BINDINGS` is used */
     size_t max_concurrent_buffer_bindings;
+    /* if not 0, pin the subgroup size of the shader. Must be a power of two
+     * between `sccl_device_properties_t::min_subgroup_size` and
+     * `sccl_device_properties_t::max_subgroup_size`, otherwise
+     * `sccl_invalid_argument` is returned. Requires
+     * `sccl_device_properties_t::subgroup_size_control_supported`, otherwise
+     * `sccl_unsupported_error` is returned. */
+    uint32_t required_subgroup_size;
+    /* if true, all subgroups in a work group are guaranteed to be full. The
+     * work group size in x must be a multiple of `required_subgroup_size`, or
+     * of `sccl_device_properties_t::max_subgroup_size` if no size is required.
+     * Requires `sccl_device_properties_t::compute_full_subgroups_supported`,
+     * otherwise `sccl_unsupported_error` is returned. */
+    bool require_full_subgroups;
+    /* push constant ranges to automatically specialize, see
+     * `sccl_shader_auto_specialization_t` (optional) */
+    sccl_shader_auto_specialization_t *auto_specializations;
+    size_t auto_specializations_count;
+    /* number of dispatches with equal tagged values before a specialized
+     * variant is built, if 0 then `SCCL_DEFAULT_AUTO_SPECIALIZATION_THRESHOLD`
+     * is used */
+    size_t auto_specialization_threshold;
 } sccl_shader_config_t;
 
+/**
+ * Statistics about a single shader dispatch.
+ */
+typedef struct {
+    /* true if a specialization variant was used, either automatically or
+     * through `sccl_run_shader_specialized` */
+    bool specialized;
+    /* 0 for the pipeline created by `sccl_create_shader`, otherwise the
+     * variant number, starting at 1 in order of creation */
+    size_t variant_index;
+} sccl_shader_run_statistics_t;
+
 typedef struct {
     uint32_t group_count_x;
     uint32_t group_count_y;
@@ -160,6 +304,8 @@ typedef struct {
     sccl_shader_push_constant_binding_t
         *push_constant_bindings; /* required if set in `sccl_shader_config_t` */
     size_t push_constant_bindings_count;
+    /* if not NULL, statistics about the dispatch are written here */
+    sccl_shader_run_statistics_t *statistics;
 } sccl_shader_run_params_t;
 
 /**
@@ -182,6 +328,41 @@ typedef struct {
      * https://registry.khronos.org/vulkan/specs/1.3-extensions/man/html/VkPhysicalDeviceSubgroupProperties.html
      */
     uint32_t native_work_group_size;
+    /* `minSubgroupSize` from
+     * https://registry.khronos.org/vulkan/specs/1.3-extensions/man/html/VkPhysicalDeviceSubgroupSizeControlProperties.html
+     * equal to `native_work_group_size` if subgroup size control is not
+     * supported.
+     */
+    uint32_t min_subgroup_size;
+    /* `maxSubgroupSize` from
+     * https://registry.khronos.org/vulkan/specs/1.3-extensions/man/html/VkPhysicalDeviceSubgroupSizeControlProperties.html
+     * equal to `native_work_group_size` if subgroup size control is not
+     * supported.
+     */
+    uint32_t max_subgroup_size;
+    /* `maxComputeWorkgroupSubgroups` from
+     * https://registry.khronos.org/vulkan/specs/1.3-extensions/man/html/VkPhysicalDeviceSubgroupSizeControlProperties.html
+     */
+    uint32_t max_work_group_subgroups;
+    /* `supportedOperations` from
+     * https://registry.khronos.org/vulkan/specs/1.3-extensions/man/html/VkPhysicalDeviceSubgroupProperties.html
+     * bitmask of `sccl_subgroup_feature_t`.
+     */
+    uint32_t subgroup_supported_operations;
+    /* `supportedStages` from
+     * https://registry.khronos.org/vulkan/specs/1.3-extensions/man/html/VkPhysicalDeviceSubgroupProperties.html
+     * bitmask of shader stages, check for `sccl_shader_stage_compute`.
+     */
+    uint32_t subgroup_supported_stages;
+    /* `subgroupSizeControl` from
+     * https://registry.khronos.org/vulkan/specs/1.3-extensions/man/html/VkPhysicalDeviceSubgroupSizeControlFeatures.html
+     * and compute stage in `requiredSubgroupSizeStages`.
+     */
+    bool subgroup_size_control_supported;
+    /* `computeFullSubgroups` from
+     * https://registry.khronos.org/vulkan/specs/1.3-extensions/man/html/VkPhysicalDeviceSubgroupSizeControlFeatures.html
+     */
+    bool compute_full_subgroups_supported;
     /* `maxStorageBufferRange` from
      * https://registry.khronos.org/vulkan/specs/1.3-extensions/man/html/VkPhysicalDeviceLimits.html
      */
@@ -206,8 +387,57 @@ typedef struct {
      * https://registry.khronos.org/vulkan/specs/1.3-extensions/man/html/VkPhysicalDeviceExternalMemoryHostPropertiesEXT.html
      */
     size_t min_external_buffer_host_pointer_alignment;
+    /* true if most of device memory is host visible, as on UMA devices and
+     * with resizable BAR. `sccl_buffer_type_auto_storage` buffers are then
+     * mapped directly instead of using a staging buffer.
+     */
+    bool host_visible_device_memory;
+    /* NUMA node of the PCI bus the device is attached to, from
+     * `VK_EXT_pci_bus_info`. Host memory allocated by SCCL for staging and
+     * external host pointer buffers is placed on this node. -1 if unknown.
+     */
+    int32_t numa_node;
 } sccl_device_properties_t;
 
+#define SCCL_MAX_MEMORY_HEAPS 16
+
+typedef struct {
+    /* `size` and `flags` from
+     * https://registry.khronos.org/vulkan/specs/1.3-extensions/man/html/VkMemoryHeap.html
+     */
+    uint64_t size;
+    bool device_local;
+    /* `heapBudget` and `heapUsage` from
+     * https://registry.khronos.org/vulkan/specs/1.3-extensions/man/html/VkPhysicalDeviceMemoryBudgetPropertiesEXT.html
+     * of the whole process. Without `VK_EXT_memory_budget` budget is the heap
+     * size and usage is `allocated_size`.
+     */
+    uint64_t budget;
+    uint64_t usage;
+    /* bytes of device memory allocated by this device, including unused parts
+     * of sub-allocated blocks */
+    uint64_t allocated_size;
+} sccl_memory_heap_usage_t;
+
+typedef struct {
+    /* true if `budget` and `usage` of heaps are reported by the driver */
+    bool memory_budget_supported;
+    uint32_t heaps_count;
+    sccl_memory_heap_usage_t heaps[SCCL_MAX_MEMORY_HEAPS];
+    /* buffers that own memory including internal staging buffers, views are
+     * not counted */
+    size_t buffer_count;
+    /* requested bytes of buffers per `sccl_buffer_type_t`, internal staging
+     * buffers are counted as `sccl_buffer_type_host_storage` */
+    size_t buffer_bytes[SCCL_BUFFER_TYPE_COUNT];
+    /* descriptor pools of shaders and descriptors reserved in them, driver
+     * memory of pools is proportional to the descriptor count */
+    size_t descriptor_pool_count;
+    size_t descriptor_count;
+    /* command buffers allocated by streams, including ones kept for reuse */
+    size_t command_buffer_count;
+} sccl_memory_usage_t;
+
 /**
  * To enable validation layers, set enviroment variable
  * `SCCL_ENABLE_VALIDATION_LAYERS=1`
@@ -218,6 +448,21 @@ typedef struct {
 #define SCCL_ENABLE_VALIDATION_LAYERS "SCCL_ENABLE_VALIDATION_LAYERS"
 #define SCCL_ASSERT_ON_VALIDATION_ERROR "SCCL_ASSERT_ON_VALIDATION_ERROR"
 
+/**
+ * To make devices behave as if most of device memory was not host visible, set
+ * environment variable `SCCL_FORCE_STAGED_BUFFERS=1` before creating the
+ * device. `sccl_buffer_type_auto_storage` buffers then always use a staging
+ * buffer, which allows testing that path on UMA and resizable BAR devices.
+ */
+#define SCCL_FORCE_STAGED_BUFFERS "SCCL_FORCE_STAGED_BUFFERS"
+
+/**
+ * To serve `sccl_read_file_into_buffer` and `sccl_write_buffer_to_file` with
+ * `pread` and `pwrite` instead of io_uring, set environment variable
+ * `SCCL_DISABLE_IO_URING=1` before creating the device.
+ */
+#define SCCL_DISABLE_IO_URING "SCCL_DISABLE_IO_URING"
+
 /**
  * @brief Retrieve a human-readable error message for a given error code.
  *
@@ -234,6 +479,34 @@ typedef struct {
  */
 const char *sccl_get_error_string(sccl_error_t error);
 
+/**
+ * @brief Host allocator used for all SCCL and driver heap allocations.
+ *
+ * The callbacks must be thread safe. They are also passed to Vulkan as
+ * `VkAllocationCallbacks`, see
+ * https://registry.khronos.org/vulkan/specs/1.3-extensions/man/html/VkAllocationCallbacks.html
+ */
+typedef struct {
+    void *user_data; /**< passed to all callbacks */
+    /* allocate `size` bytes aligned to `alignment`, return NULL on failure */
+    void *(*allocate)(void *user_data, size_t size, size_t alignment);
+    /* resize an allocation, `pointer` may be NULL. Return NULL on failure
+     * and leave the original allocation untouched. If `size` is 0, free
+     * `pointer` and return NULL */
+    void *(*reallocate)(void *user_data, void *pointer, size_t size,
+                        size_t alignment);
+    /* free an allocation, `pointer` may be NULL */
+    void (*free)(void *user_data, void *pointer);
+} sccl_allocator_t;
+
+typedef struct {
+    /* host allocator, NULL to use libc. The allocator is process wide, all
+     * instances that exist at the same time must use the same allocator or
+     * NULL. It is used until all SCCL objects are destroyed and must stay
+     * valid until then. */
+    const sccl_allocator_t *allocator;
+} sccl_instance_config_t;
+
 /**
  * @brief Create and initialize an SCCL instance.
  *
@@ -252,6 +525,26 @@ const char *sccl_get_error_string(sccl_error_t error);
  */
 sccl_error_t sccl_create_instance(sccl_instance_t *instance);
 
+/**
+ * @brief Create and initialize an SCCL instance with a configuration.
+ *
+ * Same as `sccl_create_instance`, with a custom host allocator for SCCL's own
+ * allocations and for the driver.
+ *
+ * @param[in] config A pointer to an `sccl_instance_config_t` structure. This
+ *                   parameter cannot be NULL.
+ * @param[out] instance A pointer to an `sccl_instance_t` structure that will
+ *                      be initialized by this function. This parameter
+ *                      cannot be NULL.
+ *
+ * @return An `sccl_error_t` code indicating the success or failure of the
+ *         instance creation. `sccl_invalid_argument` is returned if a
+ *         callback is NULL or another instance uses a different allocator.
+ */
+sccl_error_t
+sccl_create_instance_with_config(const sccl_instance_config_t *config,
+                                 sccl_instance_t *instance);
+
 /**
  * @brief Destroy and clean up an SCCL instance.
  *
@@ -332,13 +625,34 @@ void sccl_destroy_device(sccl_device_t device);
 void sccl_get_device_properties(const sccl_device_t device,
                                 sccl_device_properties_t *device_properties);
 
+/**
+ * @brief Retrieve memory budget and allocation accounting of a device.
+ *
+ * Heap budget and usage come from `VK_EXT_memory_budget` and include memory
+ * allocated by other processes and devices. The remaining fields only count
+ * objects created through this device. Can be used for admission control
+ * before creating large buffers.
+ *
+ * @param[in] device The `sccl_device_t` device to query. This parameter must be
+ * a valid device created by `sccl_create_device`.
+ * @param[out] usage A pointer to an `sccl_memory_usage_t` structure where the
+ * report will be stored. This parameter cannot be NULL.
+ */
+void sccl_get_memory_usage(const sccl_device_t device,
+                           sccl_memory_usage_t *usage);
+
 /**
  * @brief Create a buffer allocated by SCCL on the specified device.
  *
  * This function creates a buffer on the given SCCL device with the specified
  * size. The buffer can be of different types, as defined by
- * `sccl_buffer_type_t`. Note that this function does not support creating
- * external buffers; use `sccl_register_host_pointer_buffer` for that purpose.
+ * `sccl_buffer_type_t`. Dmabuf buffers are created with
+ * `sccl_create_dmabuf_buffer`. External host pointer buffers are backed by
+ * host memory allocated by SCCL, using huge pages for large buffers and placed
+ * on the NUMA node of the device, see
+ * `sccl_device_properties_t::numa_node`. Use
+ * `sccl_create_external_host_pointer_buffer` to import memory owned by the
+ * caller instead.
  *
  * @param[in] device The `sccl_device_t` device on which the buffer will be
  * created. This parameter must be a valid device created by
@@ -350,7 +664,8 @@ void sccl_get_device_properties(const sccl_device_t device,
  * @param[in] size The size of the buffer to be allocated, in bytes.
  *
  * @return An `sccl_error_t` code indicating the success or failure of the
- * buffer creation.
+ * buffer creation. `sccl_unsupported_error` is returned for external host
+ * pointer buffers if the device does not support host pointer buffers.
  */
 sccl_error_t sccl_create_buffer(const sccl_device_t device,
                                 sccl_buffer_t *buffer, sccl_buffer_type_t type,
@@ -391,6 +706,154 @@ sccl_error_t sccl_create_external_host_pointer_buffer(
     const sccl_device_t device, sccl_buffer_t *buffer, sccl_buffer_type_t type,
     void *host_pointer, size_t size);
 
+/**
+ * @brief Wrap user memory of any alignment and size in a buffer.
+ *
+ * If the device can import host memory, the aligned range enclosing
+ * `host_pointer` is imported and a view of the user range is returned, so the
+ * device accesses user memory directly. Otherwise the buffer is a host visible
+ * copy of user memory, use `sccl_sync_buffer_to_device` and
+ * `sccl_sync_buffer_to_host` to copy between them. Those calls do nothing for
+ * imported memory, so code using them works in both cases.
+ *
+ * Copies can use any offset. Binding the buffer to a shader requires
+ * `host_pointer` plus the binding offset to be aligned to
+ * `sccl_get_buffer_min_offset_alignment`.
+ *
+ * @note Buffer handles created by this call must be destroyed using
+ * `sccl_destroy_buffer`. User memory must stay valid until then.
+ *
+ * @param[in] device The `sccl_device_t` device to create the buffer on. This
+ * parameter must be a valid device created by `sccl_create_device`.
+ * @param[out] buffer A pointer to an `sccl_buffer_t` that will be initialized
+ * by this function. This parameter cannot be NULL.
+ * @param[in] type Buffer type, must be
+ * `sccl_buffer_type_external_host_pointer_storage` or
+ * `sccl_buffer_type_external_host_pointer_uniform`.
+ * @param[in] host_pointer User memory to wrap, no alignment is required.
+ * @param[in] size Size of user memory in bytes, must be larger than 0.
+ *
+ * @return An `sccl_error_t` code indicating the success or failure of the
+ * operation.
+ */
+sccl_error_t sccl_wrap_host_memory(const sccl_device_t device,
+                                   sccl_buffer_t *buffer,
+                                   sccl_buffer_type_t type, void *host_pointer,
+                                   size_t size);
+
+/**
+ * @brief Create a buffer with the contents of a range of a file.
+ *
+ * If the device can import host memory, the file is mapped privately and the
+ * mapping is imported instead of reading the range into a host visible
+ * buffer. The buffer is writable, so drivers that pin the mapping for device
+ * writes copy its pages out of the page cache when it is imported. Device
+ * writes to the buffer never reach the file. The buffer type is
+ * `sccl_buffer_type_external_host_pointer_storage`.
+ *
+ * @note Buffer handles created by this call must be destroyed using
+ * `sccl_destroy_buffer`. The file must not be truncated while the buffer
+ * exists.
+ *
+ * @param[in] device The `sccl_device_t` device to create the buffer on. This
+ * parameter must be a valid device created by `sccl_create_device`.
+ * @param[in] path Path of file to read.
+ * @param[in] offset Offset of range in file, in bytes. No alignment is
+ * required.
+ * @param[in] length Length of range in bytes, must be larger than 0.
+ * @param[out] buffer A pointer to an `sccl_buffer_t` that will be initialized
+ * by this function. This parameter cannot be NULL.
+ *
+ * @return An `sccl_error_t` code indicating the success or failure of the
+ * operation. `sccl_invalid_argument` is returned if the range is outside of
+ * the file, `sccl_system_error` if the file could not be opened or read.
+ */
+sccl_error_t sccl_create_buffer_from_file(const sccl_device_t device,
+                                          const char *path, size_t offset,
+                                          size_t length, sccl_buffer_t *buffer);
+
+/**
+ * @brief Create a buffer in POSIX shared memory that other processes can map.
+ *
+ * The region is either the shared memory object `name`, created if it does not
+ * exist, or the memory file descriptor `memfd`, for example from
+ * `memfd_create` and passed between processes over a unix socket. It is
+ * mapped shared and imported as host memory, so the device and every process
+ * mapping the region access the same pages without copies. A second process
+ * attaches with the same `name` or a received `memfd` on its own device.
+ * Synchronizing accesses between processes is up to the caller.
+ *
+ * The region is grown to `size` rounded up to the host pointer import
+ * alignment if it is smaller. Remove named regions with `shm_unlink` once all
+ * processes have attached.
+ *
+ * @note Buffer handles created by this call must be destroyed using
+ * `sccl_destroy_buffer`. The buffer type is
+ * `sccl_buffer_type_external_host_pointer_storage`, access the region with
+ * `sccl_get_buffer_host_pointer`.
+ *
+ * @param[in] device The `sccl_device_t` device to create the buffer on. This
+ * parameter must be a valid device created by `sccl_create_device`.
+ * @param[in] name Name of the shared memory object as for `shm_open`, or NULL
+ * to use `memfd`.
+ * @param[in] memfd File descriptor of the region if `name` is NULL, otherwise
+ * -1. It is not closed by this function.
+ * @param[in] size Size of the buffer in bytes, must be larger than 0.
+ * @param[out] buffer A pointer to an `sccl_buffer_t` that will be initialized
+ * by this function. This parameter cannot be NULL.
+ *
+ * @return An `sccl_error_t` code indicating the success or failure of the
+ * operation. `sccl_unsupported_error` is returned if the device can not import
+ * host memory, `sccl_system_error` if the region could not be opened, grown or
+ * mapped.
+ */
+sccl_error_t sccl_create_shm_buffer(const sccl_device_t device,
+                                    const char *name, int memfd, size_t size,
+                                    sccl_buffer_t *buffer);
+
+/**
+ * @brief Create an auto storage buffer whose host mirror tracks written pages.
+ *
+ * The buffer is accessed like any auto buffer through
+ * `sccl_get_buffer_host_pointer`. After writing to the host mirror, mark the
+ * written ranges with `sccl_mark_buffer_dirty`, `sccl_sync_dirty_to_device`
+ * then uploads only those pages, in `SCCL_MIRRORED_BUFFER_PAGE_SIZE` units. On
+ * devices where the buffer is mapped directly no tracking is needed and both
+ * calls do nothing.
+ *
+ * @param[in] device The `sccl_device_t` device. This parameter must be a valid
+ * device.
+ * @param[out] buffer Pointer to a `sccl_buffer_t` that receives the buffer.
+ * This parameter cannot be NULL.
+ * @param[in] size Size of the buffer in bytes.
+ *
+ * @return An `sccl_error_t` code indicating the success or failure of the
+ * operation.
+ */
+sccl_error_t sccl_create_mirrored_buffer(const sccl_device_t device,
+                                         sccl_buffer_t *buffer, size_t size);
+
+/**
+ * @brief Mark a range of the host mirror of a buffer as written.
+ *
+ * Pages overlapping the range are uploaded by the next
+ * `sccl_sync_dirty_to_device`. Does nothing for buffers that are mapped
+ * directly or not mirrored, so it can be called unconditionally. Marking the
+ * same buffer from several threads must be synchronized by the caller.
+ *
+ * @param[in] buffer The `sccl_buffer_t` buffer. This parameter must be a valid
+ * buffer.
+ * @param[in] offset Offset of range in buffer, in bytes.
+ * @param[in] size Size of range in bytes, or `SCCL_WHOLE_SIZE` for the rest of
+ * the buffer.
+ *
+ * @return An `sccl_error_t` code indicating the success or failure of the
+ * operation. `sccl_invalid_argument` is returned if the range is outside of
+ * the buffer.
+ */
+sccl_error_t sccl_mark_buffer_dirty(const sccl_buffer_t buffer, size_t offset,
+                                    size_t size);
+
 /**
  * @return An `sccl_error_t` code indicating the success or failure of the
  * buffer creation. `sccl_unsupported_error` is returned if device does not
@@ -405,10 +868,54 @@ sccl_error_t sccl_create_dmabuf_buffer(const sccl_device_t device,
  */
 sccl_error_t sccl_export_dmabuf_buffer(const sccl_buffer_t buffer, int *out_fd);
 
+/**
+ * @brief Import a dmabuf as a buffer.
+ *
+ * Imports are cached per device by the inode of the dmabuf, its type and
+ * size. Importing a dmabuf that is already imported returns the same handle
+ * without calling the driver, each handle returned must be destroyed with
+ * `sccl_destroy_buffer` and the import is released with the last one. Any
+ * descriptor of the dmabuf hits the cache, for example one received again from
+ * a peer process. Since repeated imports share one handle, the rule that only
+ * one map operation of a dmabuf buffer can be active at a time, see
+ * `sccl_host_map_buffer`, applies across all importers of the dmabuf.
+ *
+ * @note `in_fd` is not consumed and has to be closed by the caller.
+ *
+ * @return An `sccl_error_t` code indicating the success or failure of the
+ * import. `sccl_unsupported_error` is returned if device does not support
+ * dmabuf buffers.
+ */
 sccl_error_t sccl_import_dmabuf_buffer(const sccl_device_t device,
                                        sccl_buffer_t *buffer, int in_fd,
                                        sccl_buffer_type_t type, size_t size);
 
+/**
+ * @brief Create a view aliasing a range of an existing buffer.
+ *
+ * The view shares memory with `parent` and can be used anywhere a buffer can,
+ * offsets passed together with the view are relative to the start of the view.
+ * The view has the same type as `parent`. Mapping a view follows the same
+ * rules as mapping `parent`.
+ *
+ * @note The view must be destroyed with `sccl_destroy_buffer` before `parent`
+ * is destroyed.
+ *
+ * @param[in] parent The `sccl_buffer_t` to create a view of, can itself be a
+ * view.
+ * @param[in] offset Offset of the view in `parent`, in bytes. Must be aligned
+ * to `sccl_get_buffer_min_offset_alignment(parent)`.
+ * @param[in] size Size of the view in bytes, must be larger than 0.
+ * @param[out] view A pointer to an `sccl_buffer_t` that will be initialized by
+ * this function. This parameter cannot be NULL.
+ *
+ * @return An `sccl_error_t` code indicating the success or failure of the
+ * view creation. `sccl_invalid_argument` is returned if the offset is not
+ * aligned or the range is outside of `parent`.
+ */
+sccl_error_t sccl_create_buffer_view(const sccl_buffer_t parent, size_t offset,
+                                     size_t size, sccl_buffer_t *view);
+
 /**
  * @brief Destroy the specified buffer.
  *
@@ -418,7 +925,8 @@ sccl_error_t sccl_import_dmabuf_buffer(const sccl_device_t device,
  *
  * @param[in] buffer The `sccl_buffer_t` buffer to be destroyed. This parameter
  *                   must be a valid buffer created by `sccl_create_buffer` or
- *                   `sccl_register_host_pointer_buffer`.
+ *                   `sccl_register_host_pointer_buffer` or a view created by
+ *                   `sccl_create_buffer_view`.
  */
 void sccl_destroy_buffer(sccl_buffer_t buffer);
 
@@ -453,10 +961,20 @@ size_t sccl_get_buffer_min_offset_alignment(const sccl_buffer_t buffer);
  * @brief Map buffer memory on the host.
  *
  * This function maps a portion of the buffer memory onto the host, allowing
- * access to the data from the CPU. Only one map operation can be active at
- * any time per buffer. It is not possible to map buffers of type
+ * access to the data from the CPU. It is not possible to map buffers of type
  * `sccl_buffer_type_device`.
  *
+ * Host and shared buffers are persistently mapped, for those this returns a
+ * pointer into the existing mapping and may be called concurrently. For auto
+ * buffers this is the staging buffer if there is one. For dmabuf
+ * buffers only one map operation can be active at any time per buffer.
+ *
+ * Managed buffers whose device copy was written by a stream are first copied
+ * back to the host, this waits for the copy and requires that the streams
+ * using the buffer have completed. Mapping marks the device copy as stale, it
+ * is uploaded again the next time a stream uses the buffer. The same applies
+ * to `sccl_get_buffer_host_pointer`. Views migrate the whole buffer.
+ *
  * @param[in] buffer The `sccl_buffer_t` buffer to map on the host.
  *                   This parameter must be a valid buffer.
  * @param[out] data A pointer to a pointer where the mapped memory will be
@@ -484,6 +1002,67 @@ sccl_error_t sccl_host_map_buffer(const sccl_buffer_t buffer, void **data,
  */
 void sccl_host_unmap_buffer(const sccl_buffer_t buffer);
 
+/**
+ * @brief Get the persistent host mapping of a buffer.
+ *
+ * Host, shared, external host pointer and auto buffers are mapped once when
+ * created and stay mapped until destroyed. For auto buffers with a staging
+ * buffer the pointer is to the staging buffer. The returned pointer is valid
+ * for the lifetime of the buffer and does not need to be unmapped, several
+ * threads may access disjoint ranges concurrently.
+ *
+ * @param[in] buffer The `sccl_buffer_t` buffer to get the host pointer of.
+ *                   This parameter must be a valid buffer.
+ * @param[out] data A pointer to a pointer that will be set to the start of the
+ * buffer. This parameter cannot be NULL.
+ *
+ * @return An `sccl_error_t` code indicating the success or failure of the
+ * operation. `sccl_invalid_argument` is returned if the buffer is not
+ * persistently mapped, such as device and dmabuf buffers.
+ */
+sccl_error_t sccl_get_buffer_host_pointer(const sccl_buffer_t buffer,
+                                          void **data);
+
+/**
+ * @brief Make host writes to a range of a buffer visible to the device.
+ *
+ * Must be called after the host writes to a readback or upload buffer and
+ * before the device reads the written range, since their memory may not be
+ * host coherent. Does nothing for host coherent memory.
+ *
+ * @param[in] buffer The `sccl_buffer_t` buffer to flush. This parameter must
+ * be a valid host visible buffer.
+ * @param[in] offset Offset of range in buffer, in bytes.
+ * @param[in] size Size of range in bytes, or `SCCL_WHOLE_SIZE` for the rest of
+ * the buffer.
+ *
+ * @return An `sccl_error_t` code indicating the success or failure of the
+ * flush. `sccl_invalid_argument` is returned if the buffer is not persistently
+ * mapped or the range is outside of the buffer.
+ */
+sccl_error_t sccl_flush_buffer_range(const sccl_buffer_t buffer, size_t offset,
+                                     size_t size);
+
+/**
+ * @brief Make device writes to a range of a buffer visible to the host.
+ *
+ * Must be called after the device writes to a readback or upload buffer has
+ * completed and before the host reads the range, since their memory may not be
+ * host coherent. Does nothing for host coherent memory.
+ *
+ * @param[in] buffer The `sccl_buffer_t` buffer to invalidate. This parameter
+ * must be a valid host visible buffer.
+ * @param[in] offset Offset of range in buffer, in bytes.
+ * @param[in] size Size of range in bytes, or `SCCL_WHOLE_SIZE` for the rest of
+ * the buffer.
+ *
+ * @return An `sccl_error_t` code indicating the success or failure of the
+ * invalidation. `sccl_invalid_argument` is returned if the buffer is not
+ * persistently mapped or the range is outside of the buffer.
+ */
+sccl_error_t sccl_invalidate_buffer_range(const sccl_buffer_t buffer,
+                                          size_t offset, size_t size);
+
 /**
  * @brief Create a stream on the specified device.
  *
@@ -551,6 +1130,8 @@ sccl_error_t sccl_join_stream(const sccl_stream_t stream);
  *
  * This function resets the specified stream, allowing it to be reused for
  * future operations. Any pending commands in the stream are discarded.
+ * Commands that were already dispatched can not be discarded, this blocks
+ * until they have completed.
  *
  * @param[in] stream The `sccl_stream_t` stream to be reset.
  *                   This parameter must be a valid stream created by
@@ -642,6 +1223,488 @@ sccl_error_t sccl_copy_buffer(const sccl_stream_t stream,
                               const sccl_buffer_t dst, size_t dst_offset,
                               size_t size);
 
+/**
+ * @brief Add a command copying several ranges between two buffers.
+ *
+ * Like `sccl_copy_buffer`, but all ranges are recorded as a single copy
+ * command. Ranges in `dst` must not overlap.
+ *
+ * @param[in] stream The `sccl_stream_t` stream to which to add the copy
+ * command. This parameter must be a valid stream created by
+ * `sccl_create_stream`.
+ * @param[in] src The source `sccl_buffer_t` buffer. This parameter must be a
+ * valid buffer.
+ * @param[in] dst The destination `sccl_buffer_t` buffer. This parameter must
+ * be a valid buffer.
+ * @param[in] regions Ranges to copy. This parameter cannot be NULL if
+ * `regions_count` is larger than 0.
+ * @param[in] regions_count Number of elements in `regions`.
+ *
+ * @return An `sccl_error_t` code indicating the success or failure of the
+ * operation. `sccl_invalid_argument` is returned if a range is outside of
+ * `src` or `dst`.
+ */
+sccl_error_t sccl_copy_buffer_regions(const sccl_stream_t stream,
+                                      const sccl_buffer_t src,
+                                      const sccl_buffer_t dst,
+                                      const sccl_buffer_copy_region_t *regions,
+                                      size_t regions_count);
+
+/**
+ * @brief Add a command copying between buffers of different devices.
+ *
+ * One of the buffers must be on the device of `stream`, the other one is the
+ * peer buffer. The fastest available path is used:
+ * - If the peer buffer is a dmabuf buffer created by
+ *   `sccl_create_dmabuf_buffer` and both devices support dmabuf, it is imported
+ *   on the stream's device and copied directly. The import is cached and
+ *   destroyed with the peer buffer.
+ * - Otherwise the data is staged through host memory in chunks, pipelined
+ *   over internal streams of the peer device. A peer source is read when this
+ *   function is called, so work writing it must have completed. A peer
+ *   destination is written when `stream` is reset after completing, for
+ *   example by `sccl_join_stream`.
+ * Buffers on the same device are copied like `sccl_copy_buffer`.
+ *
+ * @note Peer buffers that were imported on another device must be destroyed
+ * before that device.
+ *
+ * @param[in] stream The `sccl_stream_t` stream to record to. This parameter
+ * must be a valid stream on the device of `src` or `dst`.
+ * @param[in] src The source `sccl_buffer_t` buffer. This parameter must be a
+ * valid buffer.
+ * @param[in] src_offset Offset in source buffer, in bytes.
+ * @param[in] dst The destination `sccl_buffer_t` buffer. This parameter must
+ * be a valid buffer.
+ * @param[in] dst_offset Offset in destination buffer, in bytes.
+ * @param[in] size Size of data in bytes.
+ *
+ * @return An `sccl_error_t` code indicating the success or failure of the
+ * operation. `sccl_invalid_argument` is returned if a range is outside of its
+ * buffer or neither buffer is on the device of `stream`.
+ */
+sccl_error_t sccl_copy_peer(const sccl_stream_t stream,
+                            const sccl_buffer_t src, size_t src_offset,
+                            const sccl_buffer_t dst, size_t dst_offset,
+                            size_t size);
+
+/**
+ * @brief Add commands making host writes to an auto buffer visible to the
+ * device.
+ *
+ * For auto buffers with a staging buffer this records a copy of the range from
+ * the staging buffer to device memory. For buffers from
+ * `sccl_wrap_host_memory` that mirror user memory the range is copied from
+ * user memory before this function returns. Does nothing if the buffer is
+ * mapped directly or has no staging buffer, so it can be called
+ * unconditionally.
+ *
+ * @param[in] stream The `sccl_stream_t` stream to record to. This parameter
+ * must be a valid stream created by `sccl_create_stream`.
+ * @param[in] buffer The `sccl_buffer_t` buffer to synchronize. This parameter
+ * must be a valid buffer.
+ * @param[in] offset Offset of range in buffer, in bytes.
+ * @param[in] size Size of range in bytes, or `SCCL_WHOLE_SIZE` for the rest of
+ * the buffer.
+ *
+ * @return An `sccl_error_t` code indicating the success or failure of the
+ * operation. `sccl_invalid_argument` is returned if the range is outside of
+ * the buffer.
+ */
+sccl_error_t sccl_sync_buffer_to_device(const sccl_stream_t stream,
+                                        const sccl_buffer_t buffer,
+                                        size_t offset, size_t size);
+
+/**
+ * @brief Add commands making device writes to an auto buffer visible to the
+ * host.
+ *
+ * For auto buffers with a staging buffer this records a copy of the range from
+ * device memory to the staging buffer, the data can be read on the host once
+ * the stream has completed. For buffers from `sccl_wrap_host_memory` that
+ * mirror user memory the range is copied to user memory when the stream is
+ * reset after completing, the buffer must not be destroyed before then. Does
+ * nothing if the buffer is mapped directly or has no staging buffer.
+ *
+ * @param[in] stream The `sccl_stream_t` stream to record to. This parameter
+ * must be a valid stream created by `sccl_create_stream`.
+ * @param[in] buffer The `sccl_buffer_t` buffer to synchronize. This parameter
+ * must be a valid buffer.
+ * @param[in] offset Offset of range in buffer, in bytes.
+ * @param[in] size Size of range in bytes, or `SCCL_WHOLE_SIZE` for the rest of
+ * the buffer.
+ *
+ * @return An `sccl_error_t` code indicating the success or failure of the
+ * operation. `sccl_invalid_argument` is returned if the range is outside of
+ * the buffer.
+ */
+sccl_error_t sccl_sync_buffer_to_host(const sccl_stream_t stream,
+                                      const sccl_buffer_t buffer,
+                                      size_t offset, size_t size);
+
+/**
+ * @brief Add a command uploading the dirty pages of a mirrored buffer.
+ *
+ * Records one copy of all pages marked with `sccl_mark_buffer_dirty` since
+ * the last call from the host mirror to device memory, consecutive pages are
+ * merged into a single range. Pages are marked clean when the copy is
+ * recorded, the host must not write to the mirror until the stream has
+ * completed. Views synchronize the dirty pages of the whole underlying buffer.
+ * Does nothing for buffers that are mapped directly or not mirrored.
+ *
+ * @param[in] stream The `sccl_stream_t` stream to record to. This parameter
+ * must be a valid stream created by `sccl_create_stream`.
+ * @param[in] buffer The `sccl_buffer_t` buffer to synchronize. This parameter
+ * must be a valid buffer.
+ *
+ * @return An `sccl_error_t` code indicating the success or failure of the
+ * operation.
+ */
+sccl_error_t sccl_sync_dirty_to_device(const sccl_stream_t stream,
+                                       const sccl_buffer_t buffer);
+
+/**
+ * @brief Add a command uploading host memory to a buffer.
+ *
+ * The data is copied from `host_pointer` into a staging ring buffer owned by
+ * the device before this function returns, so `host_pointer` can be reused
+ * immediately. Staging memory is returned to the ring when the stream is
+ * reset, if the ring is full a temporary staging buffer is used instead.
+ *
+ * @param[in] stream The `sccl_stream_t` stream to record to. This parameter
+ * must be a valid stream created by `sccl_create_stream`.
+ * @param[in] dst The destination `sccl_buffer_t` buffer. This parameter must
+ * be a valid buffer.
+ * @param[in] dst_offset Offset in destination buffer, in bytes.
+ * @param[in] host_pointer Data to upload. This parameter cannot be NULL.
+ * @param[in] size Size of data in bytes.
+ *
+ * @return An `sccl_error_t` code indicating the success or failure of the
+ * operation. `sccl_invalid_argument` is returned if the range is outside of
+ * `dst`.
+ */
+sccl_error_t sccl_upload(const sccl_stream_t stream, const sccl_buffer_t dst,
+                         size_t dst_offset, const void *host_pointer,
+                         size_t size);
+
+/**
+ * @brief Add a command downloading a range of a buffer to host memory.
+ *
+ * The range is copied to a staging ring buffer owned by the device, and from
+ * there to `host_pointer` when the stream is reset after it has completed, for
+ * example by `sccl_join_stream`. `host_pointer` must stay valid until then.
+ * If the stream is reset without completing nothing is written.
+ *
+ * @param[in] stream The `sccl_stream_t` stream to record to. This parameter
+ * must be a valid stream created by `sccl_create_stream`.
+ * @param[in] src The source `sccl_buffer_t` buffer. This parameter must be a
+ * valid buffer.
+ * @param[in] src_offset Offset in source buffer, in bytes.
+ * @param[out] host_pointer Destination of the data. This parameter cannot be
+ * NULL.
+ * @param[in] size Size of data in bytes.
+ *
+ * @return An `sccl_error_t` code indicating the success or failure of the
+ * operation. `sccl_invalid_argument` is returned if the range is outside of
+ * `src`.
+ */
+sccl_error_t sccl_download(const sccl_stream_t stream, const sccl_buffer_t src,
+                           size_t src_offset, void *host_pointer, size_t size);
+
+/**
+ * @brief Read a file range directly into the host mapping of a buffer.
+ *
+ * The read is started before this function returns and completes
+ * asynchronously through io_uring, so the storage device works while further
+ * commands are recorded. `sccl_dispatch_stream` blocks until all reads of the
+ * stream have finished before submitting, so commands recorded to the same
+ * stream, for example a `sccl_copy_buffer` from `dst` or
+ * `sccl_sync_buffer_to_device`, see the data. Reads therefore do not overlap
+ * with device work of the stream, use a separate stream to read ahead. If
+ * io_uring is not available the file is read with `pread` instead.
+ *
+ * Open `fd` with `O_DIRECT` to transfer between the storage device and the
+ * buffer without a copy in the page cache. The file offset, size and host
+ * address then have to be aligned to the logical block size of the file
+ * system, persistently mapped staging buffers and page aligned host pointer
+ * buffers are suitable.
+ *
+ * @param[in] stream The `sccl_stream_t` stream whose commands depend on the
+ * data. This parameter must be a valid stream created by `sccl_create_stream`.
+ * @param[in] fd File descriptor open for reading. It must stay open until the
+ * stream is dispatched or reset.
+ * @param[in] file_offset Offset of range in file, in bytes.
+ * @param[in] dst The destination `sccl_buffer_t` buffer. This parameter must
+ * be a valid buffer with a host mapping. Managed buffers and auto buffers with
+ * a staging buffer are not supported, copy through a host buffer instead.
+ * @param[in] dst_offset Offset in destination buffer, in bytes.
+ * @param[in] size Size of range in bytes.
+ *
+ * @return An `sccl_error_t` code indicating the success or failure of the
+ * operation. `sccl_invalid_argument` is returned if the range is outside of
+ * `dst`, `dst` is not host visible or not supported. Errors of the read
+ * itself are returned by `sccl_dispatch_stream` or `sccl_reset_stream`, reads
+ * past the end of the file fail with `sccl_system_error`.
+ */
+sccl_error_t sccl_read_file_into_buffer(const sccl_stream_t stream, int fd,
+                                        size_t file_offset,
+                                        const sccl_buffer_t dst,
+                                        size_t dst_offset, size_t size);
+
+/**
+ * @brief Write a range of the host mapping of a buffer to a file once the
+ * stream completes.
+ *
+ * The range is written through io_uring when the stream is reset after it has
+ * completed, for example by `sccl_join_stream`, so it contains the results of
+ * the recorded commands. Writes of one stream are in flight together. If the
+ * stream is reset without completing nothing is written. The alignment rules
+ * of `sccl_read_file_into_buffer` apply if `fd` was opened with `O_DIRECT`.
+ *
+ * @param[in] stream The `sccl_stream_t` stream producing the data. This
+ * parameter must be a valid stream created by `sccl_create_stream`.
+ * @param[in] src The source `sccl_buffer_t` buffer. This parameter must be a
+ * valid buffer with a host mapping. Managed buffers and auto buffers with a
+ * staging buffer are not supported, copy through a host buffer instead.
+ * @param[in] src_offset Offset in source buffer, in bytes.
+ * @param[in] fd File descriptor open for writing. It must stay open until the
+ * stream is reset.
+ * @param[in] file_offset Offset of range in file, in bytes.
+ * @param[in] size Size of range in bytes.
+ *
+ * @return An `sccl_error_t` code indicating the success or failure of the
+ * operation. `sccl_invalid_argument` is returned if the range is outside of
+ * `src`, `src` is not host visible or not supported. Errors of the write
+ * itself are returned by `sccl_reset_stream`.
+ */
+sccl_error_t sccl_write_buffer_to_file(const sccl_stream_t stream,
+                                       const sccl_buffer_t src,
+                                       size_t src_offset, int fd,
+                                       size_t file_offset, size_t size);
+
+/**
+ * @brief Create a pool recycling buffers of the same type and size class.
+ *
+ * Acquiring a buffer from the pool reuses an idle buffer if one is available,
+ * avoiding buffer creation and memory allocation for short lived buffers.
+ * Sizes are rounded up to size classes, four per power of two.
+ *
+ * @note The pool must be destroyed using `sccl_destroy_buffer_pool` after all
+ * streams with pending releases have been reset or destroyed.
+ *
+ * @param[in] device The `sccl_device_t` device to create buffers on. This
+ * parameter must be a valid device created by `sccl_create_device`.
+ * @param[out] pool A pointer to an `sccl_buffer_pool_t` that will be
+ * initialized by this function. This parameter cannot be NULL.
+ * @param[in] max_idle_size High-water mark of idle buffer memory in bytes.
+ * When idle buffers exceed it, the least recently released ones are
+ * destroyed. 0 disables recycling.
+ *
+ * @return An `sccl_error_t` code indicating the success or failure of the
+ * operation.
+ */
+sccl_error_t sccl_create_buffer_pool(const sccl_device_t device,
+                                     sccl_buffer_pool_t *pool,
+                                     size_t max_idle_size);
+
+/**
+ * @brief Destroy a buffer pool and all idle buffers in it.
+ *
+ * Buffers acquired from the pool and not released stay valid and must be
+ * destroyed with `sccl_destroy_buffer`.
+ *
+ * @param[in] pool The `sccl_buffer_pool_t` pool to destroy.
+ */
+void sccl_destroy_buffer_pool(sccl_buffer_pool_t pool);
+
+/**
+ * @brief Acquire a buffer from the pool, or create one if no idle buffer of
+ * the type and size class is available.
+ *
+ * The contents of a recycled buffer are undefined. The buffer is at least
+ * `size` bytes, rounded up to its size class.
+ *
+ * @param[in] pool The `sccl_buffer_pool_t` pool to acquire from.
+ * @param[out] buffer A pointer to an `sccl_buffer_t` that will be initialized
+ * by this function. This parameter cannot be NULL.
+ * @param[in] type Buffer type, see `sccl_create_buffer`.
+ * @param[in] size Minimum size of the buffer in bytes.
+ *
+ * @return An `sccl_error_t` code indicating the success or failure of the
+ * operation.
+ */
+sccl_error_t sccl_buffer_pool_acquire(const sccl_buffer_pool_t pool,
+                                      sccl_buffer_t *buffer,
+                                      sccl_buffer_type_t type, size_t size);
+
+/**
+ * @brief Return a buffer acquired from the pool.
+ *
+ * The buffer becomes idle once every stream in `streams` has been reset or
+ * destroyed, for example by `sccl_join_stream`, so commands recorded to these
+ * streams can still use it. The buffer must not be used by the caller after
+ * this call.
+ *
+ * @param[in] pool The `sccl_buffer_pool_t` pool the buffer was acquired from.
+ * @param[in] buffer The `sccl_buffer_t` buffer to release.
+ * @param[in] streams Streams that have recorded commands using the buffer.
+ * Can be NULL if `streams_count` is 0.
+ * @param[in] streams_count The number of streams in the `streams` array. If
+ * 0 the buffer becomes idle immediately.
+ *
+ * @return An `sccl_error_t` code indicating the success or failure of the
+ * operation. `sccl_invalid_argument` is returned if the buffer was not
+ * acquired from `pool`. On failure the buffer is not released and can still
+ * be used by the caller.
+ */
+sccl_error_t sccl_buffer_pool_release(const sccl_buffer_pool_t pool,
+                                      sccl_buffer_t buffer,
+                                      const sccl_stream_t *streams,
+                                      size_t streams_count);
+
+#define SCCL_DEFAULT_TILED_EXECUTOR_DEPTH 3
+
+/* tile passed to `sccl_record_tile_fn_t` */
+typedef struct {
+    size_t index;
+    /* range of the tile in the run input, in bytes */
+    size_t input_offset;
+    size_t input_size;
+    /* range of the tile in the run output, in bytes. `output_size` is 0 if
+     * the tile has no output. */
+    size_t output_offset;
+    size_t output_size;
+    /* device storage buffers holding the tile input at offset 0 and receiving
+     * the tile output at offset 0. `output_buffer` is NULL if the executor
+     * was created without output. */
+    sccl_buffer_t input_buffer;
+    sccl_buffer_t output_buffer;
+} sccl_tile_t;
+
+/**
+ * Record the commands processing one tile to `stream`, typically
+ * `sccl_run_shader` with `tile->input_buffer` and `tile->output_buffer` bound.
+ * Returning an error stops the run.
+ */
+typedef sccl_error_t (*sccl_record_tile_fn_t)(void *user_data,
+                                              sccl_stream_t stream,
+                                              const sccl_tile_t *tile);
+
+typedef struct {
+    /* input bytes per tile, the last tile of a run may be smaller */
+    size_t input_tile_size;
+    /* output bytes per tile, 0 if tiles produce no host output */
+    size_t output_tile_size;
+    /* number of tiles in flight, 0 for
+     * `SCCL_DEFAULT_TILED_EXECUTOR_DEPTH` */
+    size_t depth;
+    sccl_record_tile_fn_t record_tile;
+    void *user_data; /* passed to `record_tile` */
+} sccl_tiled_executor_config_t;
+
+typedef struct {
+    /* host input, NULL to read the input from `input_fd` */
+    const void *input;
+    /* file descriptor read at `input_file_offset` if `input` is NULL */
+    int input_fd;
+    size_t input_file_offset;
+    size_t input_size; /* in bytes */
+    /* output of tile `i` is written at `i * output_tile_size`, clipped to
+     * `output_size`. Can be NULL if `output_tile_size` is 0. */
+    void *output;
+    size_t output_size; /* in bytes */
+} sccl_tiled_run_params_t;
+
+/**
+ * @brief Create an executor processing inputs larger than device memory in
+ * tiles.
+ *
+ * The executor owns `depth` sets of staging buffers, device buffers and
+ * streams. While the device processes a tile the host reads the input of the
+ * next tiles into their staging buffers, so upload, compute and readback of
+ * consecutive tiles overlap across the transfer and compute queues.
+ *
+ * @param[in] device The `sccl_device_t` device. This parameter must be a valid
+ * device created by `sccl_create_device`.
+ * @param[in] config Tile sizes, pipeline depth and record callback. This
+ * parameter cannot be NULL.
+ * @param[out] executor A pointer to an `sccl_tiled_executor_t` that will be
+ * initialized by this function. This parameter cannot be NULL.
+ *
+ * @return An `sccl_error_t` code indicating the success or failure of the
+ * operation. `sccl_invalid_argument` is returned if `input_tile_size` is 0 or
+ * `record_tile` is NULL.
+ */
+sccl_error_t
+sccl_create_tiled_executor(const sccl_device_t device,
+                           const sccl_tiled_executor_config_t *config,
+                           sccl_tiled_executor_t *executor);
+
+/**
+ * @brief Destroy a tiled executor.
+ *
+ * @param[in] executor The `sccl_tiled_executor_t` executor to destroy.
+ */
+void sccl_destroy_tiled_executor(sccl_tiled_executor_t executor);
+
+/**
+ * @brief Process an input tile by tile and wait for all tiles to complete.
+ *
+ * Tile `i` covers `input_tile_size` bytes of the input starting at
+ * `i * input_tile_size`. For each tile the input is uploaded to
+ * `tile->input_buffer`, `record_tile` is called and the output buffer is read
+ * back to `output`. On error the tiles in flight are waited for before
+ * returning.
+ *
+ * @param[in] executor The `sccl_tiled_executor_t` executor to run.
+ * @param[in] params Input and output of the run. This parameter cannot be
+ * NULL.
+ *
+ * @return An `sccl_error_t` code indicating the success or failure of the
+ * operation. `sccl_system_error` is returned if the input file could not be
+ * read, `sccl_invalid_argument` if `output` is NULL while tiles produce
+ * output.
+ */
+sccl_error_t sccl_tiled_executor_run(const sccl_tiled_executor_t executor,
+                                     const sccl_tiled_run_params_t *params);
+
+/**
+ * @brief Create a shader module from SPIR-V code on the specified device.
+ *
+ * A shader module can contain several compute entry points and be shared by
+ * multiple shaders, see `sccl_shader_config_t::shader_module` and
+ * `sccl_shader_config_t::entry_point`. This way the SPIR-V code is only parsed
+ * once by the driver.
+ *
+ * @param[in] device The `sccl_device_t` device on which to create the shader
+ * module. This parameter must be a valid device created by
+ * `sccl_create_device`.
+ * @param[out] shader_module A pointer to an `sccl_shader_module_t` that will be
+ * initialized by this function. This parameter cannot be NULL.
+ * @param[in] shader_source_code SPIR-V code.
+ * @param[in] shader_source_code_length Size of `shader_source_code` in bytes,
+ * must be larger than 0.
+ *
+ * @return An `sccl_error_t` code indicating the success or failure of the
+ *         shader module creation.
+ */
+sccl_error_t sccl_create_shader_module(const sccl_device_t device,
+                                       sccl_shader_module_t *shader_module,
+                                       const char *shader_source_code,
+                                       size_t shader_source_code_length);
+
+/**
+ * @brief Destroy the specified shader module.
+ *
+ * Shaders created from the module keep it alive, so the module can be
+ * destroyed as soon as all shaders using it are created.
+ *
+ * @param[in] shader_module The `sccl_shader_module_t` to be destroyed. This
+ * parameter must be a valid shader module created by
+ * `sccl_create_shader_module`.
+ */
+void sccl_destroy_shader_module(sccl_shader_module_t shader_module);
+
 /**
  * @brief Create a shader on the specified device.
  *
@@ -708,6 +1771,94 @@ sccl_error_t sccl_run_shader(const sccl_stream_t stream,
                              const sccl_shader_t shader,
                              const sccl_shader_run_params_t *params);
 
+/**
+ * @brief Add a shader run command using a specialization variant of the
+ * shader.
+ *
+ * Same as `sccl_run_shader`, but the provided specialization constants
+ * override the constants set in `sccl_shader_config_t` for this dispatch.
+ * Constants not set in the config are added. The pipeline for each unique set
+ * of constant values is compiled on first use and cached in the shader, the
+ * shader module, descriptor set layouts and pipeline layout are shared by all
+ * variants. Variants are destroyed by `sccl_destroy_shader`.
+ *
+ * @param[in] stream The `sccl_stream_t` stream to which to add the shader run
+ * command. This parameter must be a valid stream created by
+ * `sccl_create_stream`.
+ * @param[in] shader The `sccl_shader_t` shader to execute. This parameter must
+ * be a valid shader created by `sccl_create_shader`.
+ * @param[in] specialization_constants Array of specialization constants for
+ * this dispatch, constant ids must be unique. Can be NULL if
+ * `specialization_constants_count` is 0.
+ * @param[in] specialization_constants_count Number of elements in
+ * `specialization_constants`.
+ * @param[in] params A pointer to an `sccl_shader_run_params_t` structure that
+ *                   describes how to execute the shader.
+ *
+ * @return An `sccl_error_t` code indicating the success or failure of the
+ *         shader run command.
+ */
+sccl_error_t sccl_run_shader_specialized(
+    const sccl_stream_t stream, const sccl_shader_t shader,
+    const sccl_shader_specialization_constant_t *specialization_constants,
+    size_t specialization_constants_count,
+    const sccl_shader_run_params_t *params);
+
+/**
+ * @brief Open a shader bundle file.
+ *
+ * A shader bundle packs many SPIR-V modules into one indexed file together
+ * with their reflected buffer layouts, push constant size and default
+ * specialization constant values. Bundles are created with the
+ * `shader_bundle_packer` tool, see `pack_shader_bundle` in
+ * `cmake/compile_shader.cmake`. The file is memory mapped, shaders are created
+ * directly from the mapping without copying.
+ *
+ * @param[in] path Path to bundle file.
+ * @param[out] bundle A pointer to an `sccl_shader_bundle_t` that will be
+ * initialized by this function. This parameter cannot be NULL.
+ *
+ * @return An `sccl_error_t` code indicating the success or failure of the
+ * operation. `sccl_system_error` is returned if the file can not be opened or
+ * mapped, `sccl_invalid_argument` if the file is not a valid bundle.
+ */
+sccl_error_t sccl_open_shader_bundle(const char *path,
+                                     sccl_shader_bundle_t *bundle);
+
+/**
+ * @brief Close a shader bundle.
+ *
+ * Shaders created from the bundle remain valid after it is closed.
+ *
+ * @param[in] bundle The `sccl_shader_bundle_t` to close. This parameter must
+ * be a valid bundle opened by `sccl_open_shader_bundle`.
+ */
+void sccl_close_shader_bundle(sccl_shader_bundle_t bundle);
+
+/**
+ * @brief Create a shader from a named entry in a shader bundle.
+ *
+ * Buffer layouts, push constant layout and specialization constants are taken
+ * from the bundle, unless the corresponding field is set in `config`.
+ *
+ * @param[in] device The `sccl_device_t` device on which to create the shader.
+ * @param[in] bundle The `sccl_shader_bundle_t` containing the shader.
+ * @param[in] name Name of shader in bundle.
+ * @param[in] config Optional config with additional settings, can be NULL.
+ * `shader_source_code` and `shader_module` must not be set.
+ * @param[out] shader A pointer to an `sccl_shader_t` that will be initialized
+ * by this function. This parameter cannot be NULL.
+ *
+ * @return An `sccl_error_t` code indicating the success or failure of the
+ * shader creation. `sccl_invalid_argument` is returned if `name` is not in the
+ * bundle.
+ */
+sccl_error_t sccl_create_shader_from_bundle(const sccl_device_t device,
+                                            const sccl_shader_bundle_t bundle,
+                                            const char *name,
+                                            const sccl_shader_config_t *config,
+                                            sccl_shader_t *shader);
+
 /**
  * @brief Set `buffer_layout` and `buffer_binding` according to the contents of
  * `buffer`.
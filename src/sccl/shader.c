@@ -4,14 +4,19 @@
 #include "buffer.h"
 #include "device.h"
 #include "error.h"
+#include "hash_map.h"
 #include "sccl.h"
 #include "stream.h"
 #include "vector.h"
 
 #include <inttypes.h>
+#include <pthread.h>
 #include <stdio.h>
 #include <string.h>
 
+/* limit number of distinct tagged values counted per shader */
+#define AUTO_SPECIALIZATION_MAX_TRACKED_VALUES 256
+
 typedef struct {
     uint32_t set;
     vector_t buffer_layouts;
@@ -228,7 +233,7 @@ static sccl_error_t create_descriptor_set_layouts(
             vector_get_size(&entry->buffer_layouts);
 
         CHECK_VKRESULT_RET(vkCreateDescriptorSetLayout(
-            device, &descriptor_set_layout_create_info, NULL,
+            device, &descriptor_set_layout_create_info, sccl_get_vk_allocator(),
             &(*descriptor_set_layouts)[i]));
 
         sccl_free(descriptor_set_bindings);
@@ -280,8 +285,10 @@ static sccl_error_t create_descriptor_pool(VkDevice device,
         actual_descriptor_pool_sizes_count;
     descriptor_pool_create_info.pPoolSizes = descriptor_pool_sizes;
     descriptor_pool_create_info.maxSets = max_descriptor_sets;
-    CHECK_VKRESULT_RET(vkCreateDescriptorPool(
-        device, &descriptor_pool_create_info, NULL, descriptor_pool));
+    CHECK_VKRESULT_RET(vkCreateDescriptorPool(device,
+                                              &descriptor_pool_create_info,
+                                              sccl_get_vk_allocator(),
+                                              descriptor_pool));
     return sccl_success;
 }
 
@@ -304,6 +311,446 @@ static bool verify_specialization_constants(
     return true;
 }
 
+void retain_shader_module(struct sccl_shader_module *shader_module)
+{
+    atomic_fetch_add(&shader_module->reference_count, 1);
+}
+
+void release_shader_module(struct sccl_shader_module *shader_module)
+{
+    if (atomic_fetch_sub(&shader_module->reference_count, 1) == 1) {
+        vkDestroyShaderModule(shader_module->device,
+                              shader_module->shader_module,
+                              sccl_get_vk_allocator());
+        sccl_free(shader_module);
+    }
+}
+
+sccl_error_t sccl_create_shader_module(const sccl_device_t device,
+                                       sccl_shader_module_t *shader_module,
+                                       const char *shader_source_code,
+                                       size_t shader_source_code_length)
+{
+    sccl_error_t error = sccl_success;
+
+    struct sccl_shader_module *shader_module_internal = NULL;
+
+    CHECK_SCCL_NULL_RET(shader_source_code);
+    if (shader_source_code_length <= 0) {
+        return sccl_invalid_argument;
+    }
+
+    CHECK_SCCL_ERROR_GOTO(sccl_calloc((void **)&shader_module_internal, 1,
+                                      sizeof(struct sccl_shader_module)),
+                          error_return, error);
+    shader_module_internal->device = device->device;
+    atomic_init(&shader_module_internal->reference_count, 1);
+
+    VkShaderModuleCreateInfo shader_module_create_info = {0};
+    shader_module_create_info.sType =
+        VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+    shader_module_create_info.codeSize = shader_source_code_length;
+    shader_module_create_info.pCode = (const uint32_t *)shader_source_code;
+    CHECK_VKRESULT_GOTO(vkCreateShaderModule(
+                            device->device, &shader_module_create_info,
+                            sccl_get_vk_allocator(),
+                            &shader_module_internal->shader_module),
+                        error_return, error);
+
+    /* set public handle */
+    *shader_module = (sccl_shader_module_t)shader_module_internal;
+
+    return sccl_success;
+
+error_return:
+    if (shader_module_internal != NULL) {
+        sccl_free(shader_module_internal);
+    }
+
+    return error;
+}
+
+void sccl_destroy_shader_module(sccl_shader_module_t shader_module)
+{
+    release_shader_module(shader_module);
+}
+
+/**
+ * Check that requested subgroup size and full subgroups are supported by
+ * device.
+ */
+static sccl_error_t validate_subgroup_config(const sccl_device_t device,
+                                             const sccl_shader_config_t *config)
+{
+    if (config->required_subgroup_size != 0) {
+        if (!device->subgroup_size_control_supported) {
+            return sccl_unsupported_error;
+        }
+        /* must be power of two */
+        if ((config->required_subgroup_size &
+             (config->required_subgroup_size - 1)) != 0) {
+            return sccl_invalid_argument;
+        }
+        if (config->required_subgroup_size < device->min_subgroup_size ||
+            config->required_subgroup_size > device->max_subgroup_size) {
+            return sccl_invalid_argument;
+        }
+    }
+    if (config->require_full_subgroups &&
+        !device->compute_full_subgroups_supported) {
+        return sccl_unsupported_error;
+    }
+    return sccl_success;
+}
+
+/**
+ * Copy specialization constants and their data into shader, data is stored in
+ * a single allocation.
+ */
+static sccl_error_t store_specialization_constants(
+    struct sccl_shader *shader,
+    const sccl_shader_specialization_constant_t *specialization_constants,
+    size_t specialization_constants_count)
+{
+    if (specialization_constants_count == 0) {
+        return sccl_success;
+    }
+
+    size_t total_size = 0;
+    for (size_t i = 0; i < specialization_constants_count; ++i) {
+        total_size += specialization_constants[i].size;
+    }
+
+    CHECK_SCCL_ERROR_RET(sccl_calloc((void **)&shader->specialization_constants,
+                                     specialization_constants_count,
+                                     sizeof(sccl_shader_specialization_constant_t)));
+    CHECK_SCCL_ERROR_RET(sccl_calloc(&shader->specialization_data,
+                                     total_size > 0 ? total_size : 1,
+                                     sizeof(uint8_t)));
+    shader->specialization_constants_count = specialization_constants_count;
+
+    size_t offset = 0;
+    for (size_t i = 0; i < specialization_constants_count; ++i) {
+        void *data = (uint8_t *)shader->specialization_data + offset;
+        memcpy(data, specialization_constants[i].data,
+               specialization_constants[i].size);
+        shader->specialization_constants[i] = specialization_constants[i];
+        shader->specialization_constants[i].data = data;
+        offset += specialization_constants[i].size;
+    }
+
+    return sccl_success;
+}
+
+/**
+ * Create compute pipeline from shader module and pipeline layout stored in
+ * shader, specialized with provided constants.
+ */
+static sccl_error_t create_compute_pipeline(
+    const struct sccl_shader *shader,
+    const sccl_shader_specialization_constant_t *specialization_constants,
+    size_t specialization_constants_count, VkPipeline *pipeline)
+{
+    sccl_error_t error = sccl_success;
+
+    VkSpecializationMapEntry *specialization_map_entries = NULL;
+    void *specialization_data = NULL;
+
+    /* count total data size (in bytes) */
+    size_t total_specialization_constant_size = 0;
+    for (size_t i = 0; i < specialization_constants_count; ++i) {
+        total_specialization_constant_size += specialization_constants[i].size;
+    }
+    /* allocate specialization data memory and entries */
+    CHECK_SCCL_ERROR_GOTO(sccl_calloc(&specialization_data,
+                                      total_specialization_constant_size,
+                                      sizeof(uint8_t)),
+                          error_return, error);
+
+    CHECK_SCCL_ERROR_GOTO(sccl_calloc((void **)&specialization_map_entries,
+                                      specialization_constants_count,
+                                      sizeof(VkSpecializationMapEntry)),
+                          error_return, error);
+    /* init entries and copy data */
+    size_t offset = 0;
+    for (size_t i = 0; i < specialization_constants_count; ++i) {
+        const sccl_shader_specialization_constant_t *constant =
+            &specialization_constants[i];
+        memcpy((uint8_t *)specialization_data + offset, constant->data,
+               constant->size);
+        specialization_map_entries[i].constantID = constant->constant_id;
+        specialization_map_entries[i].offset = offset;
+        specialization_map_entries[i].size = constant->size;
+        offset += constant->size;
+    }
+    VkSpecializationInfo specialization_info = {};
+    specialization_info.mapEntryCount = specialization_constants_count;
+    specialization_info.pMapEntries = specialization_map_entries;
+    specialization_info.dataSize = total_specialization_constant_size;
+    specialization_info.pData = specialization_data;
+
+    VkPipelineShaderStageCreateInfo pipeline_shader_stage_create_info = {0};
+    pipeline_shader_stage_create_info.sType =
+        VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    pipeline_shader_stage_create_info.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+    pipeline_shader_stage_create_info.module =
+        shader->shader_module->shader_module;
+    pipeline_shader_stage_create_info.pName = shader->entry_point;
+    pipeline_shader_stage_create_info.pSpecializationInfo =
+        &specialization_info;
+
+    /* subgroup size control */
+    VkPipelineShaderStageRequiredSubgroupSizeCreateInfo
+        required_subgroup_size_create_info = {0};
+    if (shader->required_subgroup_size != 0) {
+        required_subgroup_size_create_info.sType =
+            VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_REQUIRED_SUBGROUP_SIZE_CREATE_INFO;
+        required_subgroup_size_create_info.requiredSubgroupSize =
+            shader->required_subgroup_size;
+        pipeline_shader_stage_create_info.pNext =
+            &required_subgroup_size_create_info;
+    }
+    if (shader->require_full_subgroups) {
+        pipeline_shader_stage_create_info.flags |=
+            VK_PIPELINE_SHADER_STAGE_CREATE_REQUIRE_FULL_SUBGROUPS_BIT;
+    }
+
+    VkComputePipelineCreateInfo compute_pipeline_create_info = {0};
+    compute_pipeline_create_info.sType =
+        VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    compute_pipeline_create_info.layout = shader->pipeline_layout;
+    compute_pipeline_create_info.stage = pipeline_shader_stage_create_info;
+    CHECK_VKRESULT_GOTO(vkCreateComputePipelines(shader->device, NULL, 1,
+                                                 &compute_pipeline_create_info,
+                                                 sccl_get_vk_allocator(),
+                                                 pipeline),
+                        error_return, error);
+
+error_return:
+    if (specialization_map_entries != NULL) {
+        sccl_free(specialization_map_entries);
+    }
+    if (specialization_data != NULL) {
+        sccl_free(specialization_data);
+    }
+
+    return error;
+}
+
+/**
+ * Check that tagged push constant ranges are inside declared push constant
+ * layouts and that constant ids are unique.
+ */
+static bool validate_auto_specializations(const sccl_shader_config_t *config)
+{
+    if (config->auto_specializations_count == 0) {
+        return true;
+    }
+    if (config->auto_specializations == NULL) {
+        return false;
+    }
+    for (size_t i = 0; i < config->auto_specializations_count; ++i) {
+        const sccl_shader_auto_specialization_t *tag =
+            &config->auto_specializations[i];
+        if (tag->push_constant_index >= config->push_constant_layouts_count) {
+            return false;
+        }
+        if (tag->size == 0 ||
+            tag->offset + tag->size >
+                config->push_constant_layouts[tag->push_constant_index].size) {
+            return false;
+        }
+        for (size_t j = 0; j < i; ++j) {
+            if (config->auto_specializations[j].constant_id ==
+                tag->constant_id) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+static void *auto_specialization_worker(void *arg);
+
+static sccl_error_t init_auto_specialization(struct sccl_shader *shader,
+                                             const sccl_shader_config_t *config)
+{
+    shader->auto_specialization_threshold =
+        (config->auto_specialization_threshold == 0)
+            ? SCCL_DEFAULT_AUTO_SPECIALIZATION_THRESHOLD
+            : config->auto_specialization_threshold;
+
+    CHECK_SCCL_ERROR_RET(sccl_calloc((void **)&shader->auto_specializations,
+                                     config->auto_specializations_count,
+                                     sizeof(sccl_shader_auto_specialization_t)));
+    memcpy(shader->auto_specializations, config->auto_specializations,
+           config->auto_specializations_count *
+               sizeof(sccl_shader_auto_specialization_t));
+    shader->auto_specializations_count = config->auto_specializations_count;
+
+    CHECK_SCCL_ERROR_RET(
+        sccl_calloc((void **)&shader->auto_specialization_constants,
+                    config->auto_specializations_count,
+                    sizeof(sccl_shader_specialization_constant_t)));
+    CHECK_SCCL_ERROR_RET(
+        hash_map_init(&shader->auto_specialization_counters,
+                      sizeof(auto_specialization_counter_t)));
+    CHECK_SCCL_ERROR_RET(vector_init(&shader->auto_specialization_jobs,
+                                     sizeof(auto_specialization_job_t)));
+
+    if (pthread_cond_init(&shader->worker_cond, NULL) != 0) {
+        return sccl_system_error;
+    }
+    if (pthread_create(&shader->worker_thread, NULL,
+                       auto_specialization_worker, shader) != 0) {
+        pthread_cond_destroy(&shader->worker_cond);
+        return sccl_system_error;
+    }
+    shader->worker_started = true;
+
+    return sccl_success;
+}
+
+/**
+ * Stop worker and free auto specialization state, queued jobs are discarded.
+ * Safe to call on partially initialized shader.
+ */
+static void destroy_auto_specialization(struct sccl_shader *shader)
+{
+    if (shader->worker_started) {
+        pthread_mutex_lock(&shader->mutex);
+        shader->worker_stop = true;
+        pthread_cond_signal(&shader->worker_cond);
+        pthread_mutex_unlock(&shader->mutex);
+        pthread_join(shader->worker_thread, NULL);
+        pthread_cond_destroy(&shader->worker_cond);
+        shader->worker_started = false;
+    }
+    if (vector_is_initilized(&shader->auto_specialization_jobs)) {
+        for (size_t i = 0;
+             i < vector_get_size(&shader->auto_specialization_jobs); ++i) {
+            auto_specialization_job_t *job =
+                vector_get_element(&shader->auto_specialization_jobs, i);
+            sccl_free(job->key);
+        }
+        vector_destroy(&shader->auto_specialization_jobs);
+        shader->auto_specialization_jobs.data = NULL;
+    }
+    if (shader->auto_specialization_counters.slots != NULL) {
+        hash_map_destroy(&shader->auto_specialization_counters);
+        shader->auto_specialization_counters.slots = NULL;
+    }
+    if (shader->auto_specialization_constants != NULL) {
+        sccl_free(shader->auto_specialization_constants);
+        shader->auto_specialization_constants = NULL;
+    }
+    if (shader->auto_specializations != NULL) {
+        sccl_free(shader->auto_specializations);
+        shader->auto_specializations = NULL;
+    }
+}
+
+static sccl_error_t init_descriptor_set_cache(struct sccl_shader *shader)
+{
+    if (pthread_mutex_init(&shader->descriptor_sets_mutex, NULL) != 0) {
+        return sccl_system_error;
+    }
+    shader->descriptor_sets_mutex_initialized = true;
+
+    CHECK_SCCL_ERROR_RET(sccl_calloc((void **)&shader->free_descriptor_sets,
+                                     shader->descriptor_set_layouts_count,
+                                     sizeof(vector_t)));
+    for (size_t i = 0; i < shader->descriptor_set_layouts_count; ++i) {
+        CHECK_SCCL_ERROR_RET(vector_init(&shader->free_descriptor_sets[i],
+                                         sizeof(VkDescriptorSet)));
+    }
+
+    return sccl_success;
+}
+
+/* cached sets are freed with the descriptor pool */
+static void destroy_descriptor_set_cache(struct sccl_shader *shader)
+{
+    if (shader->free_descriptor_sets != NULL) {
+        for (size_t i = 0; i < shader->descriptor_set_layouts_count; ++i) {
+            if (vector_is_initilized(&shader->free_descriptor_sets[i])) {
+                vector_destroy(&shader->free_descriptor_sets[i]);
+            }
+        }
+        sccl_free(shader->free_descriptor_sets);
+        shader->free_descriptor_sets = NULL;
+    }
+    if (shader->descriptor_sets_mutex_initialized) {
+        pthread_mutex_destroy(&shader->descriptor_sets_mutex);
+        shader->descriptor_sets_mutex_initialized = false;
+    }
+}
+
+/**
+ * Take descriptor sets for all layouts of `shader` from the cache, allocates
+ * from the descriptor pool if the cache is empty.
+ */
+static sccl_error_t acquire_descriptor_sets(struct sccl_shader *shader,
+                                            VkDescriptorSet *descriptor_sets)
+{
+    sccl_error_t error = sccl_success;
+    size_t acquired_count = 0;
+
+    if (shader->descriptor_set_layouts_count == 0) {
+        return sccl_success;
+    }
+
+    pthread_mutex_lock(&shader->descriptor_sets_mutex);
+    for (; acquired_count < shader->descriptor_set_layouts_count;
+         ++acquired_count) {
+        const size_t i = acquired_count;
+        vector_t *free_sets = &shader->free_descriptor_sets[i];
+        if (vector_get_size(free_sets) > 0) {
+            descriptor_sets[i] =
+                *(VkDescriptorSet *)vector_get_last_element(free_sets);
+            vector_remove_last_element(free_sets);
+            continue;
+        }
+
+        VkDescriptorSetAllocateInfo alloc_info = {0};
+        alloc_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+        alloc_info.descriptorPool = shader->descriptor_pool;
+        alloc_info.descriptorSetCount = 1;
+        alloc_info.pSetLayouts = &shader->descriptor_set_layouts[i];
+        VkResult vk_res = vkAllocateDescriptorSets(shader->device, &alloc_info,
+                                                   &descriptor_sets[i]);
+        /* in case out of pool error, signal out of resources rather than
+         * default vulkan error */
+        if (vk_res == VK_ERROR_OUT_OF_POOL_MEMORY) {
+            error = sccl_out_of_resources_error;
+            goto error_return;
+        }
+        CHECK_VKRESULT_GOTO(vk_res, error_return, error);
+    }
+    pthread_mutex_unlock(&shader->descriptor_sets_mutex);
+
+    return sccl_success;
+
+error_return:
+    pthread_mutex_unlock(&shader->descriptor_sets_mutex);
+    for (size_t i = 0; i < acquired_count; ++i) {
+        release_descriptor_set(shader, i, descriptor_sets[i]);
+    }
+    return error;
+}
+
+void release_descriptor_set(struct sccl_shader *shader, size_t layout_index,
+                            VkDescriptorSet descriptor_set)
+{
+    pthread_mutex_lock(&shader->descriptor_sets_mutex);
+    if (vector_add_element(&shader->free_descriptor_sets[layout_index],
+                           &descriptor_set) != sccl_success) {
+        vkFreeDescriptorSets(shader->device, shader->descriptor_pool, 1,
+                             &descriptor_set);
+    }
+    pthread_mutex_unlock(&shader->descriptor_sets_mutex);
+}
+
 sccl_error_t sccl_create_shader(const sccl_device_t device,
                                 sccl_shader_t *shader,
                                 const sccl_shader_config_t *config)
@@ -312,13 +759,25 @@ sccl_error_t sccl_create_shader(const sccl_device_t device,
 
     struct sccl_shader *shader_internal = NULL;
     VkPushConstantRange *push_constant_ranges = NULL;
-    VkSpecializationMapEntry *specialization_map_entries = NULL;
-    void *specialization_data = NULL;
 
     /* validate config */
     CHECK_SCCL_NULL_RET(config);
-    CHECK_SCCL_NULL_RET(config->shader_source_code);
-    if (config->shader_source_code_length <= 0) {
+    /* exactly one of source code and shader module must be set */
+    if ((config->shader_source_code == NULL) ==
+        (config->shader_module == NULL)) {
+        return sccl_invalid_argument;
+    }
+    if (config->shader_source_code != NULL &&
+        config->shader_source_code_length <= 0) {
+        return sccl_invalid_argument;
+    }
+    CHECK_SCCL_ERROR_RET(validate_subgroup_config(device, config));
+    if (!validate_auto_specializations(config)) {
+        return sccl_invalid_argument;
+    }
+    if (!verify_specialization_constants(
+            config->specialization_constants,
+            config->specialization_constants_count)) {
         return sccl_invalid_argument;
     }
 
@@ -327,20 +786,48 @@ sccl_error_t sccl_create_shader(const sccl_device_t device,
         sccl_calloc((void **)&shader_internal, 1, sizeof(struct sccl_shader)),
         error_return, error);
 
+    if (pthread_mutex_init(&shader_internal->mutex, NULL) != 0) {
+        error = sccl_system_error;
+        goto error_return;
+    }
+    shader_internal->mutex_initialized = true;
+
     shader_internal->device = device->device;
+    shader_internal->required_subgroup_size = config->required_subgroup_size;
+    shader_internal->require_full_subgroups = config->require_full_subgroups;
 
-    /* create shader module */
-    VkShaderModuleCreateInfo shader_module_create_info = {0};
-    shader_module_create_info.sType =
-        VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-    shader_module_create_info.codeSize = config->shader_source_code_length;
-    shader_module_create_info.pCode =
-        (const uint32_t *)config->shader_source_code;
-    CHECK_VKRESULT_GOTO(
-        vkCreateShaderModule(device->device, &shader_module_create_info,
-                             VK_NULL_HANDLE, &shader_internal->shader_module),
+    CHECK_SCCL_ERROR_GOTO(
+        hash_map_init(&shader_internal->pipeline_variants,
+                      sizeof(pipeline_variant_t)),
         error_return, error);
 
+    /* store specialization constants so variants can be derived from them */
+    CHECK_SCCL_ERROR_GOTO(
+        store_specialization_constants(shader_internal,
+                                       config->specialization_constants,
+                                       config->specialization_constants_count),
+        error_return, error);
+
+    /* use provided shader module or create one from source code */
+    if (config->shader_module != NULL) {
+        retain_shader_module(config->shader_module);
+        shader_internal->shader_module = config->shader_module;
+    } else {
+        CHECK_SCCL_ERROR_GOTO(
+            sccl_create_shader_module(device, &shader_internal->shader_module,
+                                      config->shader_source_code,
+                                      config->shader_source_code_length),
+            error_return, error);
+    }
+
+    /* copy entry point name */
+    const char *entry_point =
+        (config->entry_point != NULL) ? config->entry_point : "main";
+    CHECK_SCCL_ERROR_GOTO(sccl_calloc((void **)&shader_internal->entry_point,
+                                      strlen(entry_point) + 1, sizeof(char)),
+                          error_return, error);
+    strcpy(shader_internal->entry_point, entry_point);
+
     /* create descriptor set layout based on provided config */
     if (config->buffer_layouts != NULL) {
         CHECK_SCCL_ERROR_GOTO(
@@ -371,50 +858,12 @@ sccl_error_t sccl_create_shader(const sccl_device_t device,
                                   uniform_buffer_count, max_descriptor_sets,
                                   &shader_internal->descriptor_pool),
                               error_return, error);
+        shader_internal->descriptor_count =
+            (storage_buffer_count + uniform_buffer_count) * max_descriptor_sets;
+        CHECK_SCCL_ERROR_GOTO(init_descriptor_set_cache(shader_internal),
+                              error_return, error);
     }
 
-    /* prepare specialization info */
-    /* verify */
-    if (!verify_specialization_constants(
-            config->specialization_constants,
-            config->specialization_constants_count)) {
-        error = sccl_invalid_argument;
-        goto error_return;
-    }
-    /* count total data size (in bytes) */
-    size_t total_specialization_constant_size = 0;
-    for (size_t i = 0; i < config->specialization_constants_count; ++i) {
-        total_specialization_constant_size +=
-            config->specialization_constants[i].size;
-    }
-    /* allocate specialization data memory and entries */
-    CHECK_SCCL_ERROR_GOTO(sccl_calloc(&specialization_data,
-                                      total_specialization_constant_size,
-                                      sizeof(uint8_t)),
-                          error_return, error);
-
-    CHECK_SCCL_ERROR_GOTO(sccl_calloc((void **)&specialization_map_entries,
-                                      config->specialization_constants_count,
-                                      sizeof(VkSpecializationMapEntry)),
-                          error_return, error);
-    /* init entries and copy data */
-    size_t offset = 0;
-    for (size_t i = 0; i < config->specialization_constants_count; ++i) {
-        sccl_shader_specialization_constant_t *constant =
-            &config->specialization_constants[i];
-        memcpy((uint8_t *)specialization_data + offset, constant->data,
-               constant->size);
-        specialization_map_entries[i].constantID = constant->constant_id;
-        specialization_map_entries[i].offset = offset;
-        specialization_map_entries[i].size = constant->size;
-        offset += constant->size;
-    }
-    VkSpecializationInfo specialization_info = {};
-    specialization_info.mapEntryCount = config->specialization_constants_count;
-    specialization_info.pMapEntries = specialization_map_entries;
-    specialization_info.dataSize = total_specialization_constant_size;
-    specialization_info.pData = specialization_data;
-
     /* prepare push constants */
     /* create push constant range for each entry */
     if (config->push_constant_layouts_count > 0) {
@@ -456,36 +905,36 @@ sccl_error_t sccl_create_shader(const sccl_device_t device,
         config->push_constant_layouts_count;
     CHECK_VKRESULT_GOTO(
         vkCreatePipelineLayout(device->device, &pipeline_layout_create_info,
-                               NULL, &shader_internal->pipeline_layout),
+                               sccl_get_vk_allocator(),
+                               &shader_internal->pipeline_layout),
         error_return, error);
 
-    VkPipelineShaderStageCreateInfo pipeline_shader_stage_create_info = {0};
-    pipeline_shader_stage_create_info.sType =
-        VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-    pipeline_shader_stage_create_info.stage = VK_SHADER_STAGE_COMPUTE_BIT;
-    pipeline_shader_stage_create_info.module = shader_internal->shader_module;
-    pipeline_shader_stage_create_info.pName = "main";
-    pipeline_shader_stage_create_info.pSpecializationInfo =
-        &specialization_info;
-
-    VkComputePipelineCreateInfo compute_pipeline_create_info = {0};
-    compute_pipeline_create_info.sType =
-        VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
-    compute_pipeline_create_info.layout = shader_internal->pipeline_layout;
-    compute_pipeline_create_info.stage = pipeline_shader_stage_create_info;
-    CHECK_VKRESULT_GOTO(
-        vkCreateComputePipelines(device->device, NULL, 1,
-                                 &compute_pipeline_create_info, NULL,
-                                 &shader_internal->compute_pipeline),
+    CHECK_SCCL_ERROR_GOTO(
+        create_compute_pipeline(shader_internal,
+                                shader_internal->specialization_constants,
+                                shader_internal->specialization_constants_count,
+                                &shader_internal->compute_pipeline),
         error_return, error);
 
+    /* start auto specialization worker last, so it never sees a partially
+     * created shader */
+    if (config->auto_specializations_count > 0) {
+        CHECK_SCCL_ERROR_GOTO(init_auto_specialization(shader_internal, config),
+                              error_return, error);
+    }
+
+    shader_internal->device_usage = &device->usage;
+    if (shader_internal->descriptor_pool != VK_NULL_HANDLE) {
+        atomic_fetch_add(&device->usage.descriptor_pool_count, 1);
+        atomic_fetch_add(&device->usage.descriptor_count,
+                         shader_internal->descriptor_count);
+    }
+
     /* set public handle */
     *shader = (sccl_shader_t)shader_internal;
 
     /* cleanup */
     sccl_free(push_constant_ranges);
-    sccl_free(specialization_map_entries);
-    sccl_free(specialization_data);
 
     return sccl_success;
 
@@ -493,41 +942,53 @@ error_return:
     if (push_constant_ranges != NULL) {
         sccl_free(push_constant_ranges);
     }
-    if (specialization_map_entries != NULL) {
-        sccl_free(specialization_map_entries);
-    }
-    if (specialization_data != NULL) {
-        sccl_free(specialization_data);
-    }
 
     if (shader_internal != NULL) {
+        destroy_auto_specialization(shader_internal);
         if (shader_internal->compute_pipeline != VK_NULL_HANDLE) {
             vkDestroyPipeline(device->device, shader_internal->compute_pipeline,
-                              NULL);
+                              sccl_get_vk_allocator());
         }
         if (shader_internal->pipeline_layout != VK_NULL_HANDLE) {
             vkDestroyPipelineLayout(device->device,
-                                    shader_internal->pipeline_layout, NULL);
+                                    shader_internal->pipeline_layout,
+                                    sccl_get_vk_allocator());
         }
         if (shader_internal->push_constant_layouts != NULL) {
             sccl_free(shader_internal->push_constant_layouts);
         }
+        destroy_descriptor_set_cache(shader_internal);
         if (shader_internal->descriptor_pool != VK_NULL_HANDLE) {
             vkDestroyDescriptorPool(device->device,
-                                    shader_internal->descriptor_pool, NULL);
+                                    shader_internal->descriptor_pool,
+                                    sccl_get_vk_allocator());
         }
         if (shader_internal->descriptor_set_layouts != NULL) {
             for (size_t i = 0;
                  i < shader_internal->descriptor_set_layouts_count; ++i) {
                 vkDestroyDescriptorSetLayout(
                     device->device, shader_internal->descriptor_set_layouts[i],
-                    NULL);
+                    sccl_get_vk_allocator());
             }
             sccl_free(shader_internal->descriptor_set_layouts);
         }
-        if (shader_internal->shader_module != VK_NULL_HANDLE) {
-            vkDestroyShaderModule(device->device,
-                                  shader_internal->shader_module, NULL);
+        if (shader_internal->entry_point != NULL) {
+            sccl_free(shader_internal->entry_point);
+        }
+        if (shader_internal->shader_module != NULL) {
+            release_shader_module(shader_internal->shader_module);
+        }
+        if (shader_internal->specialization_constants != NULL) {
+            sccl_free(shader_internal->specialization_constants);
+        }
+        if (shader_internal->specialization_data != NULL) {
+            sccl_free(shader_internal->specialization_data);
+        }
+        if (shader_internal->pipeline_variants.slots != NULL) {
+            hash_map_destroy(&shader_internal->pipeline_variants);
+        }
+        if (shader_internal->mutex_initialized) {
+            pthread_mutex_destroy(&shader_internal->mutex);
         }
         sccl_free(shader_internal);
     }
@@ -537,104 +998,156 @@ error_return:
 
 void sccl_destroy_shader(sccl_shader_t shader)
 {
-    vkDestroyPipeline(shader->device, shader->compute_pipeline, NULL);
-    vkDestroyPipelineLayout(shader->device, shader->pipeline_layout, NULL);
+    /* stop worker before destroying pipelines it may be building */
+    destroy_auto_specialization(shader);
+
+    vkDestroyPipeline(shader->device, shader->compute_pipeline,
+                      sccl_get_vk_allocator());
+    for (size_t i = 0; i < hash_map_get_capacity(&shader->pipeline_variants);
+         ++i) {
+        pipeline_variant_t *variant =
+            hash_map_get_value_at(&shader->pipeline_variants, i);
+        if (variant != NULL) {
+            vkDestroyPipeline(shader->device, variant->pipeline,
+                              sccl_get_vk_allocator());
+        }
+    }
+    hash_map_destroy(&shader->pipeline_variants);
+    vkDestroyPipelineLayout(shader->device, shader->pipeline_layout,
+                            sccl_get_vk_allocator());
 
     if (shader->push_constant_layouts != NULL) {
         sccl_free(shader->push_constant_layouts);
     }
 
+    destroy_descriptor_set_cache(shader);
     if (shader->descriptor_pool != VK_NULL_HANDLE) {
-        vkDestroyDescriptorPool(shader->device, shader->descriptor_pool, NULL);
+        vkDestroyDescriptorPool(shader->device, shader->descriptor_pool,
+                                sccl_get_vk_allocator());
+        atomic_fetch_sub(&shader->device_usage->descriptor_pool_count, 1);
+        atomic_fetch_sub(&shader->device_usage->descriptor_count,
+                         shader->descriptor_count);
     }
     if (shader->descriptor_set_layouts != NULL) {
         for (size_t i = 0; i < shader->descriptor_set_layouts_count; ++i) {
-            vkDestroyDescriptorSetLayout(
-                shader->device, shader->descriptor_set_layouts[i], NULL);
+            vkDestroyDescriptorSetLayout(shader->device,
+                                         shader->descriptor_set_layouts[i],
+                                         sccl_get_vk_allocator());
         }
         sccl_free(shader->descriptor_set_layouts);
     }
 
-    vkDestroyShaderModule(shader->device, shader->shader_module, NULL);
+    sccl_free(shader->entry_point);
+    release_shader_module(shader->shader_module);
+
+    if (shader->specialization_constants != NULL) {
+        sccl_free(shader->specialization_constants);
+    }
+    if (shader->specialization_data != NULL) {
+        sccl_free(shader->specialization_data);
+    }
+
+    pthread_mutex_destroy(&shader->mutex);
 
     sccl_free(shader);
 }
 
-sccl_error_t sccl_run_shader(const sccl_stream_t stream,
-                             const sccl_shader_t shader,
-                             const sccl_shader_run_params_t *params)
+/**
+ * Record dispatch of shader with provided pipeline, pipeline must be created
+ * with the pipeline layout of shader.
+ */
+static sccl_error_t record_shader_dispatch(
+    const sccl_stream_t stream, const sccl_shader_t shader, VkPipeline pipeline,
+    const sccl_shader_run_params_t *params)
 {
     sccl_error_t error = sccl_success;
-    VkDescriptorSet *descriptor_sets = NULL;
-    VkWriteDescriptorSet *write_descriptor_sets = NULL;
-    VkDescriptorBufferInfo *descriptor_buffer_infos = NULL;
-
-    /* determine command buffer to record to */
-    VkCommandBuffer command_buffer;
-    CHECK_SCCL_ERROR_RET(determine_next_command_buffer(
-        stream, command_buffer_type_compute, &command_buffer));
+    size_t stream_descriptor_sets_count = 0;
 
-    /* validate */
+    /* validate before anything is recorded */
     /* check if push constants are in range */
     if (params->push_constant_bindings_count >
         shader->push_constant_layouts_count) {
         return sccl_invalid_argument;
     }
-
-    /* allocate descriptor set, store in stream, will be freed when stream is
-     * complete */
-    CHECK_SCCL_ERROR_GOTO(sccl_calloc((void **)&descriptor_sets,
-                                      shader->descriptor_set_layouts_count,
-                                      sizeof(VkDescriptorSet)),
-                          error_return, error);
-    for (size_t i = 0; i < shader->descriptor_set_layouts_count; ++i) {
-        VkDescriptorSetAllocateInfo alloc_info = {0};
-        alloc_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-        alloc_info.descriptorPool = shader->descriptor_pool;
-        alloc_info.descriptorSetCount = 1;
-        alloc_info.pSetLayouts = &shader->descriptor_set_layouts[i];
-        VkResult vk_res = vkAllocateDescriptorSets(
-            stream->device->device, &alloc_info, &descriptor_sets[i]);
-        /* in case out of pool error, signal out of resources rather than
-         * default vulkan error */
-        if (vk_res == VK_ERROR_OUT_OF_POOL_MEMORY) {
-            error = sccl_out_of_resources_error;
-            goto error_return;
+    /* validate bind sizes, a whole view must not be empty */
+    for (size_t i = 0; i < params->buffer_bindings_count; ++i) {
+        const sccl_shader_buffer_binding_t *binding =
+            &params->buffer_bindings[i];
+        if (binding->size == 0) {
+            return sccl_invalid_argument;
+        }
+        if (binding->size == SCCL_BIND_WHOLE_BUFFER &&
+            binding->buffer->parent != NULL &&
+            binding->offset >= binding->buffer->size) {
+            return sccl_invalid_argument;
         }
-        CHECK_VKRESULT_GOTO(vk_res, error_return, error);
     }
-    /* add to stream after all sets are allocated, so we don't have to clean up
-     * in case one allocation fails */
-    for (size_t i = 0; i < shader->descriptor_set_layouts_count; ++i) {
+
+    /* upload managed buffers before the dispatch, shaders may write to any
+     * storage buffer */
+    for (size_t i = 0; i < params->buffer_bindings_count; ++i) {
+        CHECK_SCCL_ERROR_RET(prepare_managed_buffer_device_access(
+            stream, params->buffer_bindings[i].buffer, true));
+    }
+
+    /* determine command buffer to record to */
+    VkCommandBuffer command_buffer;
+    CHECK_SCCL_ERROR_RET(determine_next_command_buffer(
+        stream, command_buffer_type_compute, &command_buffer));
+
+    /* descriptor sets, writes and buffer infos are carved from the stream
+     * scratch memory so recording does not allocate once it is warmed up */
+    const size_t infos_offset =
+        params->buffer_bindings_count * sizeof(VkWriteDescriptorSet);
+    const size_t sets_offset =
+        infos_offset +
+        params->buffer_bindings_count * sizeof(VkDescriptorBufferInfo);
+    const size_t scratch_size =
+        sets_offset +
+        shader->descriptor_set_layouts_count * sizeof(VkDescriptorSet);
+    uint8_t *scratch = NULL;
+    CHECK_SCCL_ERROR_RET(
+        get_stream_scratch(stream, scratch_size, (void **)&scratch));
+    VkWriteDescriptorSet *write_descriptor_sets =
+        (VkWriteDescriptorSet *)scratch;
+    VkDescriptorBufferInfo *descriptor_buffer_infos =
+        (VkDescriptorBufferInfo *)(scratch + infos_offset);
+    VkDescriptorSet *descriptor_sets =
+        (VkDescriptorSet *)(scratch + sets_offset);
+
+    /* take descriptor sets, store in stream, will be released when stream is
+     * complete */
+    CHECK_SCCL_ERROR_RET(acquire_descriptor_sets(shader, descriptor_sets));
+    for (; stream_descriptor_sets_count < shader->descriptor_set_layouts_count;
+         ++stream_descriptor_sets_count) {
         CHECK_SCCL_ERROR_GOTO(
-            add_descriptor_set_to_stream(stream, shader->descriptor_pool,
-                                         descriptor_sets[i]),
+            add_descriptor_set_to_stream(
+                stream, shader, stream_descriptor_sets_count,
+                descriptor_sets[stream_descriptor_sets_count]),
             error_return, error);
     }
 
     /* update descriptor sets */
-    CHECK_SCCL_ERROR_GOTO(sccl_calloc((void **)&write_descriptor_sets,
-                                      params->buffer_bindings_count,
-                                      sizeof(VkWriteDescriptorSet)),
-                          error_return, error);
-    CHECK_SCCL_ERROR_GOTO(sccl_calloc((void **)&descriptor_buffer_infos,
-                                      params->buffer_bindings_count,
-                                      sizeof(VkDescriptorBufferInfo)),
-                          error_return, error);
+    memset(write_descriptor_sets, 0,
+           params->buffer_bindings_count * sizeof(VkWriteDescriptorSet));
+    memset(descriptor_buffer_infos, 0,
+           params->buffer_bindings_count * sizeof(VkDescriptorBufferInfo));
     for (size_t i = 0; i < params->buffer_bindings_count; ++i) {
         descriptor_buffer_infos[i].buffer =
             params->buffer_bindings[i].buffer->buffer;
-        descriptor_buffer_infos[i].offset = params->buffer_bindings[i].offset;
-        /* validate bind size */
-        if (params->buffer_bindings[i].size == 0 &&
-            params->buffer_bindings[i].size != SCCL_BIND_WHOLE_BUFFER) {
-            error = sccl_invalid_argument;
-            goto error_return;
+        descriptor_buffer_infos[i].offset =
+            params->buffer_bindings[i].buffer->view_offset +
+            params->buffer_bindings[i].offset;
+        if (params->buffer_bindings[i].size != SCCL_BIND_WHOLE_BUFFER) {
+            descriptor_buffer_infos[i].range = params->buffer_bindings[i].size;
+        } else if (params->buffer_bindings[i].buffer->parent != NULL) {
+            /* whole view, not whole underlying buffer */
+            descriptor_buffer_infos[i].range =
+                params->buffer_bindings[i].buffer->size -
+                params->buffer_bindings[i].offset;
+        } else {
+            descriptor_buffer_infos[i].range = VK_WHOLE_SIZE;
         }
-        descriptor_buffer_infos[i].range =
-            (params->buffer_bindings[i].size == SCCL_BIND_WHOLE_BUFFER)
-                ? VK_WHOLE_SIZE
-                : params->buffer_bindings[i].size;
 
         write_descriptor_sets[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
         write_descriptor_sets[i].dstSet =
@@ -656,7 +1169,7 @@ sccl_error_t sccl_run_shader(const sccl_stream_t stream,
 
     /* bind the compute pipeline */
     vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE,
-                      shader->compute_pipeline);
+                      pipeline);
 
     /* bind descriptor sets */
     if (shader->descriptor_set_layouts_count > 0) {
@@ -691,28 +1204,406 @@ sccl_error_t sccl_run_shader(const sccl_stream_t stream,
                          VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 1,
                          &memory_barrier, 0, NULL, 0, NULL);
 
-    /* cleanup */
-    sccl_free(descriptor_buffer_infos);
-    sccl_free(write_descriptor_sets);
-    sccl_free(descriptor_sets); /* vulkan handles will be destroyed when stream
-                                   is done executing */
-
     return sccl_success;
 
 error_return:
-    if (descriptor_buffer_infos != NULL) {
-        sccl_free(descriptor_buffer_infos);
+    /* return sets the stream does not own yet */
+    for (size_t i = stream_descriptor_sets_count;
+         i < shader->descriptor_set_layouts_count; ++i) {
+        release_descriptor_set(shader, i, descriptor_sets[i]);
     }
-    if (write_descriptor_sets != NULL) {
-        sccl_free(write_descriptor_sets);
+
+    return error;
+}
+
+/**
+ * Next constant of the shader's specialization constants merged with
+ * overrides in order of constant id, the first one if `previous` is NULL.
+ * Overrides take precedence. Returns NULL after the last constant.
+ */
+static const sccl_shader_specialization_constant_t *get_next_merged_constant(
+    const sccl_shader_t shader,
+    const sccl_shader_specialization_constant_t *overrides,
+    size_t overrides_count,
+    const sccl_shader_specialization_constant_t *previous)
+{
+    const sccl_shader_specialization_constant_t *next = NULL;
+    for (size_t i = 0; i < overrides_count; ++i) {
+        const sccl_shader_specialization_constant_t *constant = &overrides[i];
+        if ((previous == NULL ||
+             constant->constant_id > previous->constant_id) &&
+            (next == NULL || constant->constant_id < next->constant_id)) {
+            next = constant;
+        }
     }
-    if (descriptor_sets != NULL) {
-        sccl_free(descriptor_sets);
+    /* strict comparison keeps an override with the same id */
+    for (size_t i = 0; i < shader->specialization_constants_count; ++i) {
+        const sccl_shader_specialization_constant_t *constant =
+            &shader->specialization_constants[i];
+        if ((previous == NULL ||
+             constant->constant_id > previous->constant_id) &&
+            (next == NULL || constant->constant_id < next->constant_id)) {
+            next = constant;
+        }
     }
+    return next;
+}
+
+/**
+ * Build variant key from specialization constants stored in shader merged
+ * with overrides. Constants are serialized sorted by id as
+ * `[constant_id, size, data]` entries so equal constant sets map to equal
+ * keys. The key is stored in the stream's scratch memory, so lookups of
+ * cached variants do not allocate.
+ */
+static sccl_error_t
+build_variant_key(const sccl_stream_t stream, const sccl_shader_t shader,
+                  const sccl_shader_specialization_constant_t *overrides,
+                  size_t overrides_count, void **key, size_t *key_size)
+{
+    *key_size = 0;
+    for (const sccl_shader_specialization_constant_t *constant =
+             get_next_merged_constant(shader, overrides, overrides_count,
+                                      NULL);
+         constant != NULL;
+         constant = get_next_merged_constant(shader, overrides,
+                                             overrides_count, constant)) {
+        *key_size += 2 * sizeof(uint32_t) + constant->size;
+    }
+
+    CHECK_SCCL_ERROR_RET(get_stream_scratch(stream, *key_size, key));
+
+    uint8_t *p = (uint8_t *)*key;
+    for (const sccl_shader_specialization_constant_t *constant =
+             get_next_merged_constant(shader, overrides, overrides_count,
+                                      NULL);
+         constant != NULL;
+         constant = get_next_merged_constant(shader, overrides,
+                                             overrides_count, constant)) {
+        const uint32_t size = (uint32_t)constant->size;
+        memcpy(p, &constant->constant_id, sizeof(uint32_t));
+        p += sizeof(uint32_t);
+        memcpy(p, &size, sizeof(uint32_t));
+        p += sizeof(uint32_t);
+        memcpy(p, constant->data, constant->size);
+        p += constant->size;
+    }
+
+    return sccl_success;
+}
+
+/**
+ * Inverse of `build_variant_key`, data pointers in
+ * `constants` point into `key`.
+ */
+static sccl_error_t deserialize_specialization_constants(const void *key,
+                                                         size_t key_size,
+                                                         vector_t *constants)
+{
+    const uint8_t *p = (const uint8_t *)key;
+    const uint8_t *end = p + key_size;
+    while (p < end) {
+        sccl_shader_specialization_constant_t constant = {0};
+        uint32_t size;
+        memcpy(&constant.constant_id, p, sizeof(uint32_t));
+        p += sizeof(uint32_t);
+        memcpy(&size, p, sizeof(uint32_t));
+        p += sizeof(uint32_t);
+        constant.size = size;
+        constant.data = (void *)p;
+        p += size;
+        CHECK_SCCL_ERROR_RET(vector_add_element(constants, &constant));
+    }
+    return sccl_success;
+}
+
+static sccl_error_t create_pipeline_from_key(const sccl_shader_t shader,
+                                             const void *key, size_t key_size,
+                                             VkPipeline *pipeline)
+{
+    vector_t constants = {0};
+    CHECK_SCCL_ERROR_RET(
+        vector_init(&constants, sizeof(sccl_shader_specialization_constant_t)));
+    sccl_error_t error =
+        deserialize_specialization_constants(key, key_size, &constants);
+    if (error == sccl_success) {
+        error = create_compute_pipeline(
+            shader,
+            vector_get_size(&constants) > 0
+                ? vector_get_first_element(&constants)
+                : NULL,
+            vector_get_size(&constants), pipeline);
+    }
+    vector_destroy(&constants);
+    return error;
+}
+
+/**
+ * Store pipeline as variant for key, if a variant already exists for key the
+ * pipeline is destroyed and the existing variant is returned. Takes ownership
+ * of pipeline. Caller must hold shader mutex.
+ */
+static sccl_error_t insert_pipeline_variant(const sccl_shader_t shader,
+                                            const void *key, size_t key_size,
+                                            VkPipeline pipeline,
+                                            pipeline_variant_t *variant)
+{
+    pipeline_variant_t *existing =
+        hash_map_find(&shader->pipeline_variants, key, key_size);
+    if (existing != NULL) {
+        vkDestroyPipeline(shader->device, pipeline, sccl_get_vk_allocator());
+        *variant = *existing;
+        return sccl_success;
+    }
+
+    pipeline_variant_t new_variant = {0};
+    new_variant.pipeline = pipeline;
+    new_variant.index = hash_map_get_size(&shader->pipeline_variants) + 1;
+    sccl_error_t error = hash_map_insert(&shader->pipeline_variants, key,
+                                         key_size, &new_variant);
+    if (error != sccl_success) {
+        vkDestroyPipeline(shader->device, pipeline, sccl_get_vk_allocator());
+        return error;
+    }
+    *variant = new_variant;
+    return sccl_success;
+}
+
+/**
+ * Find pipeline variant matching the merged specialization constants, create
+ * and cache it if it does not exist.
+ */
+static sccl_error_t get_pipeline_variant(
+    const sccl_stream_t stream, const sccl_shader_t shader,
+    const sccl_shader_specialization_constant_t *specialization_constants,
+    size_t specialization_constants_count, pipeline_variant_t *variant)
+{
+    sccl_error_t error = sccl_success;
+
+    void *key = NULL;
+    size_t key_size = 0;
+    CHECK_SCCL_ERROR_RET(build_variant_key(stream, shader,
+                                           specialization_constants,
+                                           specialization_constants_count,
+                                           &key, &key_size));
+
+    pthread_mutex_lock(&shader->mutex);
+    pipeline_variant_t *cached_variant =
+        hash_map_find(&shader->pipeline_variants, key, key_size);
+    if (cached_variant != NULL) {
+        *variant = *cached_variant;
+    } else {
+        VkPipeline new_pipeline = VK_NULL_HANDLE;
+        error = create_pipeline_from_key(shader, key, key_size, &new_pipeline);
+        if (error == sccl_success) {
+            error = insert_pipeline_variant(shader, key, key_size,
+                                            new_pipeline, variant);
+        }
+    }
+    pthread_mutex_unlock(&shader->mutex);
+
+    return error;
+}
+
+/**
+ * Background worker building auto specialized pipeline variants.
+ */
+static void *auto_specialization_worker(void *arg)
+{
+    struct sccl_shader *shader = (struct sccl_shader *)arg;
+
+    pthread_mutex_lock(&shader->mutex);
+    while (true) {
+        while (!shader->worker_stop &&
+               vector_get_size(&shader->auto_specialization_jobs) == 0) {
+            pthread_cond_wait(&shader->worker_cond, &shader->mutex);
+        }
+        if (shader->worker_stop) {
+            break;
+        }
+        auto_specialization_job_t job =
+            *(auto_specialization_job_t *)vector_get_last_element(
+                &shader->auto_specialization_jobs);
+        vector_remove_last_element(&shader->auto_specialization_jobs);
+
+        /* pipeline creation does not touch shared state */
+        pthread_mutex_unlock(&shader->mutex);
+        VkPipeline pipeline = VK_NULL_HANDLE;
+        sccl_error_t error =
+            create_pipeline_from_key(shader, job.key, job.key_size, &pipeline);
+        pthread_mutex_lock(&shader->mutex);
+
+        /* on failure the counter stays queued, so the variant is not retried
+         * and dispatches keep using the base pipeline */
+        if (error == sccl_success) {
+            pipeline_variant_t variant;
+            (void)insert_pipeline_variant(shader, job.key, job.key_size,
+                                          pipeline, &variant);
+        }
+        sccl_free(job.key);
+    }
+    pthread_mutex_unlock(&shader->mutex);
+
+    return NULL;
+}
+
+/**
+ * Select pipeline for dispatch based on tagged push constant values. Falls back
+ * to base pipeline until a specialized variant is ready.
+ */
+static sccl_error_t
+select_auto_specialized_pipeline(const sccl_stream_t stream,
+                                 const sccl_shader_t shader,
+                                 const sccl_shader_run_params_t *params,
+                                 VkPipeline *pipeline, size_t *variant_index)
+{
+    sccl_error_t error = sccl_success;
+
+    *pipeline = shader->compute_pipeline;
+    *variant_index = 0;
+
+    /* all tagged push constants must be provided */
+    for (size_t i = 0; i < shader->auto_specializations_count; ++i) {
+        if (shader->auto_specializations[i].push_constant_index >=
+            params->push_constant_bindings_count) {
+            return sccl_success;
+        }
+    }
+
+    void *key = NULL;
+    size_t key_size = 0;
+
+    pthread_mutex_lock(&shader->mutex);
+
+    for (size_t i = 0; i < shader->auto_specializations_count; ++i) {
+        const sccl_shader_auto_specialization_t *tag =
+            &shader->auto_specializations[i];
+        sccl_shader_specialization_constant_t *constant =
+            &shader->auto_specialization_constants[i];
+        constant->constant_id = tag->constant_id;
+        constant->size = tag->size;
+        constant->data =
+            (uint8_t *)params->push_constant_bindings[tag->push_constant_index]
+                .data +
+            tag->offset;
+    }
+    CHECK_SCCL_ERROR_GOTO(
+        build_variant_key(stream, shader, shader->auto_specialization_constants,
+                          shader->auto_specializations_count, &key, &key_size),
+        error_return, error);
+
+    /* use variant if ready */
+    pipeline_variant_t *variant =
+        hash_map_find(&shader->pipeline_variants, key, key_size);
+    if (variant != NULL) {
+        *pipeline = variant->pipeline;
+        *variant_index = variant->index;
+        goto error_return;
+    }
+
+    /* count occurrences, stop tracking new values when limit is reached */
+    auto_specialization_counter_t *counter =
+        hash_map_find(&shader->auto_specialization_counters, key, key_size);
+    if (counter == NULL) {
+        if (hash_map_get_size(&shader->auto_specialization_counters) >=
+            AUTO_SPECIALIZATION_MAX_TRACKED_VALUES) {
+            goto error_return;
+        }
+        auto_specialization_counter_t new_counter = {0};
+        CHECK_SCCL_ERROR_GOTO(
+            hash_map_insert(&shader->auto_specialization_counters, key,
+                            key_size, &new_counter),
+            error_return, error);
+        counter =
+            hash_map_find(&shader->auto_specialization_counters, key, key_size);
+    }
+    ++counter->count;
+
+    /* queue build of variant, the job owns a copy of the key */
+    if (counter->count > shader->auto_specialization_threshold &&
+        !counter->queued) {
+        auto_specialization_job_t job = {0};
+        CHECK_SCCL_ERROR_GOTO(sccl_calloc(&job.key, key_size, sizeof(uint8_t)),
+                              error_return, error);
+        memcpy(job.key, key, key_size);
+        job.key_size = key_size;
+        error = vector_add_element(&shader->auto_specialization_jobs, &job);
+        if (error != sccl_success) {
+            sccl_free(job.key);
+            goto error_return;
+        }
+        counter->queued = true;
+        pthread_cond_signal(&shader->worker_cond);
+    }
+
+error_return:
+    pthread_mutex_unlock(&shader->mutex);
 
     return error;
 }
 
+static void set_run_statistics(const sccl_shader_run_params_t *params,
+                               size_t variant_index)
+{
+    if (params->statistics != NULL) {
+        params->statistics->specialized = variant_index != 0;
+        params->statistics->variant_index = variant_index;
+    }
+}
+
+sccl_error_t sccl_run_shader(const sccl_stream_t stream,
+                             const sccl_shader_t shader,
+                             const sccl_shader_run_params_t *params)
+{
+    VkPipeline pipeline = shader->compute_pipeline;
+    size_t variant_index = 0;
+
+    if (shader->auto_specializations_count > 0) {
+        CHECK_SCCL_ERROR_RET(select_auto_specialized_pipeline(
+            stream, shader, params, &pipeline, &variant_index));
+    }
+
+    CHECK_SCCL_ERROR_RET(
+        record_shader_dispatch(stream, shader, pipeline, params));
+
+    set_run_statistics(params, variant_index);
+
+    return sccl_success;
+}
+
+sccl_error_t sccl_run_shader_specialized(
+    const sccl_stream_t stream, const sccl_shader_t shader,
+    const sccl_shader_specialization_constant_t *specialization_constants,
+    size_t specialization_constants_count,
+    const sccl_shader_run_params_t *params)
+{
+    if (specialization_constants_count > 0) {
+        CHECK_SCCL_NULL_RET(specialization_constants);
+    }
+    if (!verify_specialization_constants(specialization_constants,
+                                         specialization_constants_count)) {
+        return sccl_invalid_argument;
+    }
+
+    /* no overrides, use base pipeline */
+    if (specialization_constants_count == 0) {
+        return sccl_run_shader(stream, shader, params);
+    }
+
+    pipeline_variant_t variant;
+    CHECK_SCCL_ERROR_RET(get_pipeline_variant(stream, shader,
+                                              specialization_constants,
+                                              specialization_constants_count,
+                                              &variant));
+
+    CHECK_SCCL_ERROR_RET(
+        record_shader_dispatch(stream, shader, variant.pipeline, params));
+
+    set_run_statistics(params, variant.index);
+
+    return sccl_success;
+}
+
 void sccl_set_buffer_layout_binding(
     const sccl_buffer_t buffer, uint32_t set, uint32_t binding,
     sccl_shader_buffer_layout_t *buffer_layout,
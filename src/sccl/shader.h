@@ -2,19 +2,101 @@
 #ifndef SHADER_HEADER
 #define SHADER_HEADER
 
+#include "hash_map.h"
 #include "sccl.h"
+#include "vector.h"
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
 #include <vulkan/vulkan.h>
 
-struct sccl_shader {
+/**
+ * Reference counted, shaders created from a module hold a reference so the
+ * module can be destroyed by the user while shaders still use it.
+ */
+struct sccl_shader_module {
     VkDevice device;
     VkShaderModule shader_module;
+    atomic_size_t reference_count;
+};
+
+void retain_shader_module(struct sccl_shader_module *shader_module);
+
+void release_shader_module(struct sccl_shader_module *shader_module);
+
+typedef struct {
+    VkPipeline pipeline;
+    size_t index; /**< starts at 1, base pipeline has index 0 */
+} pipeline_variant_t;
+
+typedef struct {
+    size_t count;
+    bool queued; /**< variant is queued for build or built */
+} auto_specialization_counter_t;
+
+typedef struct {
+    void *key; /**< serialized specialization constants, owned by job */
+    size_t key_size;
+} auto_specialization_job_t;
+
+struct sccl_shader {
+    VkDevice device;
+    struct sccl_shader_module *shader_module; /**< holds a reference */
+    char *entry_point;
     VkDescriptorSetLayout *descriptor_set_layouts;
     size_t descriptor_set_layouts_count;
     VkDescriptorPool descriptor_pool;
+    size_t descriptor_count; /**< reserved in `descriptor_pool` */
+    /* descriptor sets released by completed streams for reuse, one vector of
+     * `VkDescriptorSet` per descriptor set layout. Protected by
+     * `descriptor_sets_mutex`, which also guards `descriptor_pool`. */
+    vector_t *free_descriptor_sets;
+    pthread_mutex_t descriptor_sets_mutex;
+    bool descriptor_sets_mutex_initialized;
+    struct device_usage *device_usage; /**< counts descriptor pools */
     sccl_shader_push_constant_layout_t *push_constant_layouts;
     size_t push_constant_layouts_count;
     VkPipelineLayout pipeline_layout;
-    VkPipeline compute_pipeline;
+    VkPipeline compute_pipeline; /**< specialized with constants from config */
+
+    /* specialization constants from config, data points into
+     * `specialization_data` */
+    sccl_shader_specialization_constant_t *specialization_constants;
+    size_t specialization_constants_count;
+    void *specialization_data;
+
+    uint32_t required_subgroup_size;
+    bool require_full_subgroups;
+
+    /* protects `pipeline_variants` and auto specialization state */
+    pthread_mutex_t mutex;
+    bool mutex_initialized;
+
+    /* lazily created pipelines, key is serialized specialization constants,
+     * value is `pipeline_variant_t` */
+    hash_map_t pipeline_variants;
+
+    /* auto specialization, only used if `auto_specializations_count` > 0 */
+    sccl_shader_auto_specialization_t *auto_specializations;
+    size_t auto_specializations_count;
+    size_t auto_specialization_threshold;
+    /* scratch for building overrides from push constants */
+    sccl_shader_specialization_constant_t *auto_specialization_constants;
+    /* key is serialized specialization constants, value is
+     * `auto_specialization_counter_t` */
+    hash_map_t auto_specialization_counters;
+    vector_t auto_specialization_jobs; /* `auto_specialization_job_t` */
+    pthread_t worker_thread;
+    pthread_cond_t worker_cond;
+    bool worker_started;
+    bool worker_stop;
 };
 
+/**
+ * Return a descriptor set allocated for layout `layout_index` of `shader` once
+ * the stream using it is complete. The set is reused by later dispatches.
+ */
+void release_descriptor_set(struct sccl_shader *shader, size_t layout_index,
+                            VkDescriptorSet descriptor_set);
+
 #endif // SHADER_HEADER
\ No newline at end of file
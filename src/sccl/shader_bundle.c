@@ -0,0 +1,282 @@
+#include "shader_bundle.h"
+#include "alloc.h"
+#include "error.h"
+
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static bool range_in_bundle(const struct sccl_shader_bundle *bundle,
+                            uint64_t offset, uint64_t size)
+{
+    return offset <= bundle->size && size <= bundle->size - offset;
+}
+
+/**
+ * Check that all entries reference data inside the mapped file and are sorted
+ * by name, so later accesses do not need bounds checks.
+ */
+static bool validate_bundle(const struct sccl_shader_bundle *bundle)
+{
+    if (bundle->size < sizeof(shader_bundle_header_t)) {
+        return false;
+    }
+    const shader_bundle_header_t *header = bundle->header;
+    if (memcmp(header->magic, SHADER_BUNDLE_MAGIC, SHADER_BUNDLE_MAGIC_SIZE) !=
+            0 ||
+        header->version != SHADER_BUNDLE_VERSION) {
+        return false;
+    }
+    if (!range_in_bundle(bundle, sizeof(shader_bundle_header_t),
+                         (uint64_t)header->entry_count *
+                             sizeof(shader_bundle_entry_t))) {
+        return false;
+    }
+    for (uint32_t i = 0; i < header->entry_count; ++i) {
+        const shader_bundle_entry_t *entry = &bundle->entries[i];
+        if (memchr(entry->name, '\0', SHADER_BUNDLE_MAX_NAME_LENGTH) == NULL) {
+            return false;
+        }
+        if (entry->code_size == 0 || entry->code_size % sizeof(uint32_t) != 0 ||
+            entry->code_offset % SHADER_BUNDLE_CODE_ALIGNMENT != 0 ||
+            !range_in_bundle(bundle, entry->code_offset, entry->code_size)) {
+            return false;
+        }
+        if (!range_in_bundle(bundle, entry->buffer_layouts_offset,
+                             (uint64_t)entry->buffer_layouts_count *
+                                 sizeof(shader_bundle_buffer_layout_t))) {
+            return false;
+        }
+        if (!range_in_bundle(
+                bundle, entry->specialization_constants_offset,
+                (uint64_t)entry->specialization_constants_count *
+                    sizeof(shader_bundle_specialization_constant_t))) {
+            return false;
+        }
+        const shader_bundle_buffer_layout_t *buffer_layouts =
+            (const shader_bundle_buffer_layout_t
+                 *)((const uint8_t *)bundle->data +
+                    entry->buffer_layouts_offset);
+        for (uint32_t j = 0; j < entry->buffer_layouts_count; ++j) {
+            if (buffer_layouts[j].descriptor_type !=
+                    SHADER_BUNDLE_DESCRIPTOR_TYPE_STORAGE &&
+                buffer_layouts[j].descriptor_type !=
+                    SHADER_BUNDLE_DESCRIPTOR_TYPE_UNIFORM) {
+                return false;
+            }
+        }
+        const shader_bundle_specialization_constant_t
+            *specialization_constants =
+                (const shader_bundle_specialization_constant_t
+                     *)((const uint8_t *)bundle->data +
+                        entry->specialization_constants_offset);
+        for (uint32_t j = 0; j < entry->specialization_constants_count; ++j) {
+            if (specialization_constants[j].size == 0 ||
+                specialization_constants[j].size >
+                    SHADER_BUNDLE_MAX_SPECIALIZATION_CONSTANT_SIZE) {
+                return false;
+            }
+        }
+        /* entries are looked up with binary search */
+        if (i > 0 && strcmp(bundle->entries[i - 1].name, entry->name) >= 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+sccl_error_t sccl_open_shader_bundle(const char *path,
+                                     sccl_shader_bundle_t *bundle)
+{
+    sccl_error_t error = sccl_success;
+
+    struct sccl_shader_bundle *bundle_internal = NULL;
+    int fd = -1;
+
+    CHECK_SCCL_NULL_RET(path);
+
+    CHECK_SCCL_ERROR_GOTO(sccl_calloc((void **)&bundle_internal, 1,
+                                      sizeof(struct sccl_shader_bundle)),
+                          error_return, error);
+    bundle_internal->data = MAP_FAILED;
+
+    fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        error = sccl_system_error;
+        goto error_return;
+    }
+    struct stat file_stat;
+    if (fstat(fd, &file_stat) != 0) {
+        error = sccl_system_error;
+        goto error_return;
+    }
+    if ((size_t)file_stat.st_size < sizeof(shader_bundle_header_t)) {
+        error = sccl_invalid_argument;
+        goto error_return;
+    }
+    bundle_internal->size = (size_t)file_stat.st_size;
+
+    /* mapping stays valid after fd is closed */
+    bundle_internal->data = mmap(NULL, bundle_internal->size, PROT_READ,
+                                 MAP_PRIVATE, fd, 0);
+    if (bundle_internal->data == MAP_FAILED) {
+        error = sccl_system_error;
+        goto error_return;
+    }
+    close(fd);
+    fd = -1;
+
+    bundle_internal->header =
+        (const shader_bundle_header_t *)bundle_internal->data;
+    bundle_internal->entries =
+        (const shader_bundle_entry_t *)((const uint8_t *)bundle_internal->data +
+                                        sizeof(shader_bundle_header_t));
+    if (!validate_bundle(bundle_internal)) {
+        error = sccl_invalid_argument;
+        goto error_return;
+    }
+
+    /* set public handle */
+    *bundle = (sccl_shader_bundle_t)bundle_internal;
+
+    return sccl_success;
+
+error_return:
+    if (fd >= 0) {
+        close(fd);
+    }
+    if (bundle_internal != NULL) {
+        if (bundle_internal->data != MAP_FAILED) {
+            munmap(bundle_internal->data, bundle_internal->size);
+        }
+        sccl_free(bundle_internal);
+    }
+
+    return error;
+}
+
+void sccl_close_shader_bundle(sccl_shader_bundle_t bundle)
+{
+    munmap(bundle->data, bundle->size);
+    sccl_free(bundle);
+}
+
+static int compare_entry_name(const void *key, const void *element)
+{
+    return strcmp((const char *)key,
+                  ((const shader_bundle_entry_t *)element)->name);
+}
+
+sccl_error_t sccl_create_shader_from_bundle(const sccl_device_t device,
+                                            const sccl_shader_bundle_t bundle,
+                                            const char *name,
+                                            const sccl_shader_config_t *config,
+                                            sccl_shader_t *shader)
+{
+    sccl_error_t error = sccl_success;
+
+    sccl_shader_buffer_layout_t *buffer_layouts = NULL;
+    sccl_shader_specialization_constant_t *specialization_constants = NULL;
+
+    CHECK_SCCL_NULL_RET(name);
+    if (config != NULL &&
+        (config->shader_source_code != NULL || config->shader_module != NULL)) {
+        return sccl_invalid_argument;
+    }
+
+    /* entries are sorted by name */
+    const shader_bundle_entry_t *entry =
+        bsearch(name, bundle->entries, bundle->header->entry_count,
+                sizeof(shader_bundle_entry_t), compare_entry_name);
+    if (entry == NULL) {
+        return sccl_invalid_argument;
+    }
+
+    sccl_shader_config_t bundle_config = {0};
+    if (config != NULL) {
+        bundle_config = *config;
+    }
+
+    /* code is used directly from the mapping */
+    bundle_config.shader_source_code =
+        (char *)bundle->data + entry->code_offset;
+    bundle_config.shader_source_code_length = entry->code_size;
+
+    /* reflected layouts are used unless provided in config */
+    if (bundle_config.buffer_layouts_count == 0 &&
+        entry->buffer_layouts_count > 0) {
+        const shader_bundle_buffer_layout_t *bundle_buffer_layouts =
+            (const shader_bundle_buffer_layout_t *)((const uint8_t *)
+                                                        bundle->data +
+                                                    entry
+                                                        ->buffer_layouts_offset);
+        CHECK_SCCL_ERROR_GOTO(sccl_calloc((void **)&buffer_layouts,
+                                          entry->buffer_layouts_count,
+                                          sizeof(sccl_shader_buffer_layout_t)),
+                              error_return, error);
+        for (uint32_t i = 0; i < entry->buffer_layouts_count; ++i) {
+            buffer_layouts[i].position.set = bundle_buffer_layouts[i].set;
+            buffer_layouts[i].position.binding =
+                bundle_buffer_layouts[i].binding;
+            /* only storage or uniform matters for the layout */
+            buffer_layouts[i].type =
+                (bundle_buffer_layouts[i].descriptor_type ==
+                 SHADER_BUNDLE_DESCRIPTOR_TYPE_UNIFORM)
+                    ? sccl_buffer_type_device_uniform
+                    : sccl_buffer_type_device_storage;
+        }
+        bundle_config.buffer_layouts = buffer_layouts;
+        bundle_config.buffer_layouts_count = entry->buffer_layouts_count;
+    }
+
+    /* default specialization constants are used unless provided in config */
+    if (bundle_config.specialization_constants_count == 0 &&
+        entry->specialization_constants_count > 0) {
+        const shader_bundle_specialization_constant_t
+            *bundle_specialization_constants =
+                (const shader_bundle_specialization_constant_t
+                     *)((const uint8_t *)bundle->data +
+                        entry->specialization_constants_offset);
+        CHECK_SCCL_ERROR_GOTO(
+            sccl_calloc((void **)&specialization_constants,
+                        entry->specialization_constants_count,
+                        sizeof(sccl_shader_specialization_constant_t)),
+            error_return, error);
+        for (uint32_t i = 0; i < entry->specialization_constants_count; ++i) {
+            specialization_constants[i].constant_id =
+                bundle_specialization_constants[i].constant_id;
+            specialization_constants[i].size =
+                bundle_specialization_constants[i].size;
+            specialization_constants[i].data =
+                (void *)bundle_specialization_constants[i].data;
+        }
+        bundle_config.specialization_constants = specialization_constants;
+        bundle_config.specialization_constants_count =
+            entry->specialization_constants_count;
+    }
+
+    /* reflected push constant block is used unless provided in config */
+    sccl_shader_push_constant_layout_t push_constant_layout = {0};
+    if (bundle_config.push_constant_layouts_count == 0 &&
+        entry->push_constant_size > 0) {
+        push_constant_layout.size = entry->push_constant_size;
+        bundle_config.push_constant_layouts = &push_constant_layout;
+        bundle_config.push_constant_layouts_count = 1;
+    }
+
+    CHECK_SCCL_ERROR_GOTO(sccl_create_shader(device, shader, &bundle_config),
+                          error_return, error);
+
+error_return:
+    if (buffer_layouts != NULL) {
+        sccl_free(buffer_layouts);
+    }
+    if (specialization_constants != NULL) {
+        sccl_free(specialization_constants);
+    }
+
+    return error;
+}
@@ -0,0 +1,15 @@
+#pragma once
+#ifndef SHADER_BUNDLE_HEADER
+#define SHADER_BUNDLE_HEADER
+
+#include "sccl.h"
+#include "shader_bundle_format.h"
+
+struct sccl_shader_bundle {
+    void *data; /**< read only mapping of bundle file */
+    size_t size;
+    const shader_bundle_header_t *header;
+    const shader_bundle_entry_t *entries;
+};
+
+#endif // SHADER_BUNDLE_HEADER
@@ -0,0 +1,65 @@
+#pragma once
+#ifndef SHADER_BUNDLE_FORMAT_HEADER
+#define SHADER_BUNDLE_FORMAT_HEADER
+
+/**
+ * On disk layout of shader bundles, shared between the library and the
+ * `shader_bundle_packer` tool. All values are little endian and all offsets
+ * are relative to the start of the file.
+ *
+ * ```
+ * shader_bundle_header_t
+ * shader_bundle_entry_t[entry_count]            (sorted by name)
+ * per entry:
+ *   shader_bundle_buffer_layout_t[buffer_layouts_count]
+ *   shader_bundle_specialization_constant_t[specialization_constants_count]
+ *   SPIR-V code                                 (8 byte aligned)
+ * ```
+ */
+
+#include <stdint.h>
+
+#define SHADER_BUNDLE_MAGIC "SCCLBNDL"
+#define SHADER_BUNDLE_MAGIC_SIZE 8
+#define SHADER_BUNDLE_VERSION 1
+/* includes null terminator */
+#define SHADER_BUNDLE_MAX_NAME_LENGTH 64
+#define SHADER_BUNDLE_MAX_SPECIALIZATION_CONSTANT_SIZE 8
+/* alignment of the SPIR-V code offset, in bytes */
+#define SHADER_BUNDLE_CODE_ALIGNMENT 8
+
+#define SHADER_BUNDLE_DESCRIPTOR_TYPE_STORAGE 0
+#define SHADER_BUNDLE_DESCRIPTOR_TYPE_UNIFORM 1
+
+typedef struct {
+    char magic[SHADER_BUNDLE_MAGIC_SIZE];
+    uint32_t version;
+    uint32_t entry_count;
+} shader_bundle_header_t;
+
+typedef struct {
+    char name[SHADER_BUNDLE_MAX_NAME_LENGTH]; /* null terminated */
+    uint64_t code_offset;
+    uint64_t code_size; /* in bytes */
+    uint64_t buffer_layouts_offset;
+    uint64_t specialization_constants_offset;
+    uint32_t buffer_layouts_count;
+    uint32_t specialization_constants_count;
+    uint32_t push_constant_size; /* 0 if no push constants */
+    uint32_t reserved;
+} shader_bundle_entry_t;
+
+typedef struct {
+    uint32_t set;
+    uint32_t binding;
+    uint32_t descriptor_type; /* `SHADER_BUNDLE_DESCRIPTOR_TYPE_*` */
+} shader_bundle_buffer_layout_t;
+
+typedef struct {
+    uint32_t constant_id;
+    uint32_t size; /* in bytes */
+    /* default value */
+    uint8_t data[SHADER_BUNDLE_MAX_SPECIALIZATION_CONSTANT_SIZE];
+} shader_bundle_specialization_constant_t;
+
+#endif // SHADER_BUNDLE_FORMAT_HEADER
@@ -0,0 +1,243 @@
+#include "staging_ring.h"
+#include "device.h"
+#include "error.h"
+#include <string.h>
+
+static size_t align_size(size_t size)
+{
+    return (size + STAGING_RING_ALIGNMENT - 1) / STAGING_RING_ALIGNMENT *
+           STAGING_RING_ALIGNMENT;
+}
+
+/* must hold ring mutex, remove live region at `position` */
+static void remove_live_region(struct staging_ring *ring, uint32_t position)
+{
+    ring->free_regions[ring->free_regions_count++] =
+        ring->live_regions[position];
+    memmove(&ring->live_regions[position], &ring->live_regions[position + 1],
+            (ring->live_regions_count - position - 1) * sizeof(uint32_t));
+    ring->live_regions_count--;
+}
+
+/* must hold ring mutex */
+static uint32_t find_live_region(const struct staging_ring *ring,
+                                 uint32_t region)
+{
+    uint32_t position = 0;
+    while (position < ring->live_regions_count &&
+           ring->live_regions[position] != region) {
+        position++;
+    }
+    assert(position < ring->live_regions_count);
+    return position;
+}
+
+/* must hold ring mutex, start of the gap before live region `position`, or
+ * after the last region if `position` is `live_regions_count` */
+static size_t get_gap_begin(const struct staging_ring *ring, uint32_t position)
+{
+    if (position == 0) {
+        return 0;
+    }
+    const staging_ring_region_t *previous =
+        &ring->regions[ring->live_regions[position - 1]];
+    return previous->offset + previous->size;
+}
+
+/* must hold ring mutex */
+static size_t get_gap_end(const struct staging_ring *ring, uint32_t position)
+{
+    if (position == ring->live_regions_count) {
+        return STAGING_RING_SIZE;
+    }
+    return ring->regions[ring->live_regions[position]].offset;
+}
+
+/**
+ * Must hold ring mutex. Find a gap of `size` bytes, preferring the first one
+ * at or after `head` so regions are handed out like in a ring. `position` is
+ * where the new region goes in `live_regions`.
+ */
+static bool find_space(const struct staging_ring *ring, size_t size,
+                       size_t *offset, uint32_t *position)
+{
+    for (uint32_t i = 0; i <= ring->live_regions_count; ++i) {
+        const size_t end = get_gap_end(ring, i);
+        size_t begin = get_gap_begin(ring, i);
+        if (begin < ring->head) {
+            begin = ring->head;
+        }
+        if (begin <= end && end - begin >= size) {
+            *offset = begin;
+            *position = i;
+            return true;
+        }
+    }
+    /* wrap around */
+    for (uint32_t i = 0; i <= ring->live_regions_count; ++i) {
+        const size_t begin = get_gap_begin(ring, i);
+        if (get_gap_end(ring, i) - begin >= size) {
+            *offset = begin;
+            *position = i;
+            return true;
+        }
+    }
+    return false;
+}
+
+/* must hold ring mutex, free retired regions whose stream has completed */
+static void reclaim_retired(struct staging_ring *ring, VkDevice device)
+{
+    uint32_t position = 0;
+    while (position < ring->live_regions_count) {
+        const staging_ring_region_t *region =
+            &ring->regions[ring->live_regions[position]];
+        uint64_t value = 0;
+        if (region->semaphore != VK_NULL_HANDLE &&
+            vkGetSemaphoreCounterValue(device, region->semaphore, &value) ==
+                VK_SUCCESS &&
+            value >= region->value) {
+            remove_live_region(ring, position);
+            continue;
+        }
+        position++;
+    }
+}
+
+sccl_error_t staging_ring_init(struct staging_ring *ring,
+                               sccl_buffer_type_t buffer_type,
+                               bool host_memory)
+{
+    ring->buffer_type = buffer_type;
+    ring->host_memory = host_memory;
+    ring->buffer = NULL;
+    ring->data = NULL;
+    ring->live_regions_count = 0;
+    for (uint32_t i = 0; i < STAGING_RING_MAX_REGIONS; ++i) {
+        ring->free_regions[i] = STAGING_RING_MAX_REGIONS - 1 - i;
+    }
+    ring->free_regions_count = STAGING_RING_MAX_REGIONS;
+    ring->head = 0;
+    if (pthread_mutex_init(&ring->mutex, NULL) != 0) {
+        return sccl_system_error;
+    }
+    return sccl_success;
+}
+
+void staging_ring_destroy(struct staging_ring *ring)
+{
+    assert(ring->live_regions_count == 0);
+    if (ring->buffer != NULL) {
+        sccl_destroy_buffer(ring->buffer);
+    }
+    pthread_mutex_destroy(&ring->mutex);
+}
+
+sccl_error_t staging_ring_allocate(struct staging_ring *ring,
+                                   const sccl_device_t device, size_t size,
+                                   bool *allocated, uint32_t *region,
+                                   size_t *offset)
+{
+    sccl_error_t error = sccl_success;
+    *allocated = false;
+
+    const size_t aligned_size = align_size(size);
+    if (aligned_size > STAGING_RING_SIZE) {
+        return sccl_success;
+    }
+
+    pthread_mutex_lock(&ring->mutex);
+
+    if (ring->buffer == NULL) {
+        CHECK_SCCL_ERROR_GOTO(staging_ring_create_buffer(ring, device,
+                                                         STAGING_RING_SIZE,
+                                                         &ring->buffer),
+                              error_return, error);
+        CHECK_SCCL_ERROR_GOTO(
+            sccl_get_buffer_host_pointer(ring->buffer, (void **)&ring->data),
+            error_return, error);
+    }
+
+    /* only look at semaphores when the ring seems full */
+    uint32_t position = 0;
+    bool found = ring->free_regions_count > 0 &&
+                 find_space(ring, aligned_size, offset, &position);
+    if (!found) {
+        reclaim_retired(ring, device->device);
+        found = ring->free_regions_count > 0 &&
+                find_space(ring, aligned_size, offset, &position);
+    }
+
+    if (found) {
+        *region = ring->free_regions[--ring->free_regions_count];
+        ring->regions[*region].offset = *offset;
+        ring->regions[*region].size = aligned_size;
+        ring->regions[*region].semaphore = VK_NULL_HANDLE;
+        ring->regions[*region].value = 0;
+        memmove(&ring->live_regions[position + 1],
+                &ring->live_regions[position],
+                (ring->live_regions_count - position) * sizeof(uint32_t));
+        ring->live_regions[position] = *region;
+        ring->live_regions_count++;
+        ring->head = *offset + aligned_size;
+        *allocated = true;
+    }
+
+    pthread_mutex_unlock(&ring->mutex);
+    return sccl_success;
+
+error_return:
+    if (ring->buffer != NULL) {
+        sccl_destroy_buffer(ring->buffer);
+        ring->buffer = NULL;
+        ring->data = NULL;
+    }
+    pthread_mutex_unlock(&ring->mutex);
+    return error;
+}
+
+void staging_ring_release(struct staging_ring *ring, uint32_t region)
+{
+    pthread_mutex_lock(&ring->mutex);
+    remove_live_region(ring, find_live_region(ring, region));
+    pthread_mutex_unlock(&ring->mutex);
+}
+
+void staging_ring_retire(struct staging_ring *ring, uint32_t region,
+                         VkSemaphore semaphore, uint64_t value)
+{
+    pthread_mutex_lock(&ring->mutex);
+    ring->regions[region].semaphore = semaphore;
+    ring->regions[region].value = value;
+    pthread_mutex_unlock(&ring->mutex);
+}
+
+void staging_ring_release_retired(struct staging_ring *ring,
+                                  VkSemaphore semaphore)
+{
+    pthread_mutex_lock(&ring->mutex);
+    uint32_t position = 0;
+    while (position < ring->live_regions_count) {
+        if (ring->regions[ring->live_regions[position]].semaphore ==
+            semaphore) {
+            remove_live_region(ring, position);
+            continue;
+        }
+        position++;
+    }
+    pthread_mutex_unlock(&ring->mutex);
+}
+
+sccl_error_t staging_ring_create_buffer(const struct staging_ring *ring,
+                                        const sccl_device_t device,
+                                        size_t size, sccl_buffer_t *buffer)
+{
+    /* fall back to driver memory if host memory can not be imported */
+    if (ring->host_memory &&
+        sccl_create_buffer(device, buffer,
+                           sccl_buffer_type_external_host_pointer_storage,
+                           size) == sccl_success) {
+        return sccl_success;
+    }
+    return sccl_create_buffer(device, buffer, ring->buffer_type, size);
+}
@@ -0,0 +1,90 @@
+#pragma once
+#ifndef STAGING_RING_HEADER
+#define STAGING_RING_HEADER
+
+#include "sccl.h"
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <vulkan/vulkan.h>
+
+/**
+ * Persistently mapped ring buffer shared by all streams of a device for
+ * `sccl_upload` and `sccl_download`. Regions are handed out in address order,
+ * wrapping around at the end of the ring. A region is reused once it has been
+ * released, or once the timeline semaphore it was retired with reached the
+ * stream's completion value. Free space between live regions is reused, so a
+ * stream that keeps its regions for long does not block other streams.
+ */
+
+#define STAGING_RING_SIZE ((size_t)16 << 20) /* 16 MiB */
+/* offsets are aligned for fast copies and to `nonCoherentAtomSize` */
+#define STAGING_RING_ALIGNMENT 256
+#define STAGING_RING_MAX_REGIONS 1024
+
+typedef struct {
+    size_t offset;
+    size_t size;
+    /* set by `staging_ring_retire`, the region is free once `semaphore`
+     * reaches `value`. `VK_NULL_HANDLE` while a stream owns the region */
+    VkSemaphore semaphore;
+    uint64_t value;
+} staging_ring_region_t;
+
+struct staging_ring {
+    sccl_buffer_type_t buffer_type;
+    /* back staging buffers with host memory allocated by SCCL */
+    bool host_memory;
+    sccl_buffer_t buffer; /* created on first use */
+    uint8_t *data;
+    pthread_mutex_t mutex;
+    staging_ring_region_t regions[STAGING_RING_MAX_REGIONS];
+    /* indices into `regions` of live regions sorted by offset */
+    uint32_t live_regions[STAGING_RING_MAX_REGIONS];
+    uint32_t live_regions_count;
+    /* indices into `regions` that are not in use */
+    uint32_t free_regions[STAGING_RING_MAX_REGIONS];
+    uint32_t free_regions_count;
+    size_t head; /* end of the last allocation, searches for space start here */
+};
+
+sccl_error_t staging_ring_init(struct staging_ring *ring,
+                               sccl_buffer_type_t buffer_type,
+                               bool host_memory);
+
+void staging_ring_destroy(struct staging_ring *ring);
+
+/**
+ * Allocate `size` bytes from the ring. `allocated` is set to false if the ring
+ * is full or `size` is larger than the ring, the caller must then use a
+ * temporary staging buffer.
+ */
+sccl_error_t staging_ring_allocate(struct staging_ring *ring,
+                                   const sccl_device_t device, size_t size,
+                                   bool *allocated, uint32_t *region,
+                                   size_t *offset);
+
+/* free `region` now, the device must no longer access it */
+void staging_ring_release(struct staging_ring *ring, uint32_t region);
+
+/* free `region` once `semaphore` reaches `value` */
+void staging_ring_retire(struct staging_ring *ring, uint32_t region,
+                         VkSemaphore semaphore, uint64_t value);
+
+/**
+ * Free all regions retired with `semaphore` now, before it is destroyed. The
+ * semaphore must have reached the values of the regions.
+ */
+void staging_ring_release_retired(struct staging_ring *ring,
+                                  VkSemaphore semaphore);
+
+/**
+ * Create a host visible staging buffer for the ring's direction, used for the
+ * ring itself and for transfers that do not fit into it.
+ */
+sccl_error_t staging_ring_create_buffer(const struct staging_ring *ring,
+                                        const sccl_device_t device,
+                                        size_t size, sccl_buffer_t *buffer);
+
+#endif // STAGING_RING_HEADER
@@ -4,13 +4,61 @@
 #include "buffer.h"
 #include "device.h"
 #include "error.h"
+#include "file_io.h"
+#include "shader.h"
+#include "staging_ring.h"
 #include <stdbool.h>
+#include <string.h>
+#include <unistd.h>
+
+/* fences of up to this many streams are waited for without allocating */
+#define WAIT_STREAMS_INLINE_COUNT 16
+
+/* host staged `sccl_copy_peer` transfers are split into chunks of this size */
+#define PEER_COPY_CHUNK_SIZE ((size_t)4 << 20) /* 4 MiB */
 
 typedef struct {
-    VkDescriptorPool descriptor_pool;
+    struct sccl_shader *shader;
+    size_t layout_index;
     VkDescriptorSet descriptor_set;
 } descriptor_set_entry_t;
 
+typedef struct {
+    struct staging_ring *ring;
+    uint32_t region;
+    bool retired; /* handed back to the ring when the stream was dispatched */
+} staging_region_entry_t;
+
+typedef struct {
+    sccl_buffer_t staging_buffer;
+    size_t staging_offset;
+    void *host_pointer;
+    size_t size;
+} pending_download_t;
+
+typedef struct {
+    file_io_request_t *request; /* allocated, the kernel refers to it */
+    sccl_buffer_t buffer;       /* flushed once the read has completed */
+    size_t offset;
+} file_read_t;
+
+typedef struct {
+    void *data; /* host mapping of `buffer` at `offset` */
+    sccl_buffer_t buffer;
+    size_t offset;
+    int fd;
+    size_t file_offset;
+    size_t size;
+} pending_file_write_t;
+
+typedef struct {
+    sccl_buffer_t staging_buffer; /* holds the data once the stream completes */
+    size_t staging_offset;
+    sccl_buffer_t dst; /* on another device */
+    size_t dst_offset;
+    size_t size;
+} pending_peer_copy_t;
+
 // static sccl_error_t reset_command_buffer(const sccl_stream_t stream)
 //{
 //     CHECK_VKRESULT_RET(vkResetCommandBuffer(stream->command_buffer, 0));
@@ -54,12 +102,9 @@ static VkCommandPool get_command_pool(const sccl_stream_t stream,
     return VK_NULL_HANDLE;
 }
 
-/**
- * Allocate and begin command buffer.
- */
-static sccl_error_t allocate_command_buffer(VkDevice device,
-                                            VkCommandPool command_pool,
-                                            VkCommandBuffer *command_buffer)
+static sccl_error_t allocate_new_command_buffer(VkDevice device,
+                                                VkCommandPool command_pool,
+                                                VkCommandBuffer *command_buffer)
 {
     VkCommandBufferAllocateInfo command_buffer_allocate_info = {0};
     command_buffer_allocate_info.sType =
@@ -71,6 +116,47 @@ static sccl_error_t allocate_command_buffer(VkDevice device,
     CHECK_VKRESULT_RET(vkAllocateCommandBuffers(
         device, &command_buffer_allocate_info, command_buffer));
 
+    return sccl_success;
+}
+
+/**
+ * Take a command buffer of `type` from the free command buffers, returns false
+ * if there is none.
+ */
+static bool reuse_command_buffer(sccl_stream_t stream,
+                                 command_buffer_type_t type,
+                                 VkCommandBuffer *command_buffer)
+{
+    const size_t count = vector_get_size(&stream->free_command_buffers);
+    for (size_t i = count; i > 0; --i) {
+        command_buffer_entry_t *e =
+            vector_get_element(&stream->free_command_buffers, i - 1);
+        if (e->type != type) {
+            continue;
+        }
+        *command_buffer = e->command_buffer;
+        *e = *(command_buffer_entry_t *)vector_get_last_element(
+            &stream->free_command_buffers);
+        vector_remove_last_element(&stream->free_command_buffers);
+        return true;
+    }
+    return false;
+}
+
+/**
+ * Allocate, or reuse a command buffer of a previous dispatch, and begin it.
+ */
+static sccl_error_t allocate_command_buffer(sccl_stream_t stream,
+                                            command_buffer_type_t type,
+                                            VkCommandBuffer *command_buffer)
+{
+    if (!reuse_command_buffer(stream, type, command_buffer)) {
+        CHECK_SCCL_ERROR_RET(allocate_new_command_buffer(
+            stream->device->device, get_command_pool(stream, type),
+            command_buffer));
+        atomic_fetch_add(&stream->device->usage.command_buffer_count, 1);
+    }
+
     VkCommandBufferBeginInfo begin_info = {0};
     begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
     begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
@@ -79,16 +165,47 @@ static sccl_error_t allocate_command_buffer(VkDevice device,
     return sccl_success;
 }
 
-static void free_command_buffers(sccl_stream_t stream)
+static void free_command_buffers(sccl_stream_t stream,
+                                 vector_t *command_buffers)
 {
-    for (size_t i = 0; i < vector_get_size(&stream->command_buffers); ++i) {
-        command_buffer_entry_t *e =
-            vector_get_element(&stream->command_buffers, i);
+    for (size_t i = 0; i < vector_get_size(command_buffers); ++i) {
+        command_buffer_entry_t *e = vector_get_element(command_buffers, i);
         VkCommandPool command_pool = get_command_pool(stream, e->type);
         vkFreeCommandBuffers(stream->device->device, command_pool, 1,
                              &e->command_buffer);
     }
+    atomic_fetch_sub(&stream->device->usage.command_buffer_count,
+                     vector_get_size(command_buffers));
+    vector_clear(command_buffers);
+}
+
+/**
+ * Reset command pools and keep recorded command buffers for reuse, frees them
+ * if they can not be kept.
+ */
+static sccl_error_t recycle_command_buffers(sccl_stream_t stream)
+{
+    CHECK_VKRESULT_RET(vkResetCommandPool(stream->device->device,
+                                          stream->compute_command_pool, 0));
+    if (has_seperate_transfer_queue(stream->device)) {
+        CHECK_VKRESULT_RET(vkResetCommandPool(
+            stream->device->device, stream->transfer_command_pool, 0));
+    }
+
+    for (size_t i = 0; i < vector_get_size(&stream->command_buffers); ++i) {
+        command_buffer_entry_t *e =
+            vector_get_element(&stream->command_buffers, i);
+        if (vector_add_element(&stream->free_command_buffers, e) !=
+            sccl_success) {
+            vkFreeCommandBuffers(stream->device->device,
+                                 get_command_pool(stream, e->type), 1,
+                                 &e->command_buffer);
+            atomic_fetch_sub(&stream->device->usage.command_buffer_count, 1);
+        }
+    }
     vector_clear(&stream->command_buffers);
+
+    return sccl_success;
 }
 
 static uint32_t get_queue_family_index(const sccl_device_t device,
@@ -105,18 +222,233 @@ static uint32_t get_queue_family_index(const sccl_device_t device,
     return ~0;
 }
 
-static sccl_error_t free_descriptor_sets(VkDevice device,
-                                         vector_t *descriptor_sets)
+/* return descriptor sets to their shaders for reuse */
+static void release_descriptor_sets(vector_t *descriptor_sets)
 {
     for (size_t i = 0; i < vector_get_size(descriptor_sets); ++i) {
         descriptor_set_entry_t *e = vector_get_element(descriptor_sets, i);
-        CHECK_VKRESULT_RET(vkFreeDescriptorSets(device, e->descriptor_pool, 1,
-                                                &e->descriptor_set));
+        release_descriptor_set(e->shader, e->layout_index, e->descriptor_set);
     }
     vector_clear(descriptor_sets);
+}
+
+/**
+ * Block until the command buffers submitted by the last dispatch have
+ * completed, also if only some of them were submitted. `completed` is set to
+ * true if the whole dispatch ran.
+ */
+static sccl_error_t wait_stream_submissions(sccl_stream_t stream,
+                                            bool *completed)
+{
+    VkSemaphoreWaitInfo wait_info = {0};
+    wait_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+    wait_info.semaphoreCount = 1;
+    wait_info.pSemaphores = &stream->timeline_semaphore;
+    wait_info.pValues = &stream->timeline_value;
+    CHECK_VKRESULT_RET(
+        vkWaitSemaphores(stream->device->device, &wait_info, UINT64_MAX));
+
+    /* fence is signaled with the last command buffer */
+    *completed = false;
+    if (stream->fence_submitted) {
+        CHECK_VKRESULT_RET(vkWaitForFences(stream->device->device, 1,
+                                           &stream->fence, VK_TRUE,
+                                           UINT64_MAX));
+        *completed = true;
+    }
     return sccl_success;
 }
 
+/**
+ * Upload staging is only read by the submitted commands, so it is handed back
+ * to the ring to be reused once the stream reaches the value signaled by this
+ * dispatch. Download staging is kept until the stream is reset.
+ */
+static void retire_upload_staging(sccl_stream_t stream)
+{
+    for (size_t i = 0; i < vector_get_size(&stream->staging_regions); ++i) {
+        staging_region_entry_t *e =
+            vector_get_element(&stream->staging_regions, i);
+        if (e->ring == &stream->device->upload_ring && !e->retired) {
+            staging_ring_retire(e->ring, e->region,
+                                stream->timeline_semaphore,
+                                stream->timeline_value);
+            e->retired = true;
+        }
+    }
+}
+
+/**
+ * Copy pending downloads to host memory if `completed`, then return staging
+ * memory to the device ring and destroy temporary staging buffers. The device
+ * must no longer access the stream's staging memory.
+ */
+static sccl_error_t release_staging(sccl_stream_t stream, bool completed)
+{
+    sccl_error_t error = sccl_success;
+
+    for (size_t i = 0; i < vector_get_size(&stream->pending_downloads) &&
+                       completed;
+         ++i) {
+        pending_download_t *e =
+            vector_get_element(&stream->pending_downloads, i);
+        void *staging_data;
+        error = sccl_invalidate_buffer_range(e->staging_buffer,
+                                             e->staging_offset, e->size);
+        if (error != sccl_success) {
+            break;
+        }
+        error = sccl_get_buffer_host_pointer(e->staging_buffer, &staging_data);
+        if (error != sccl_success) {
+            break;
+        }
+        memcpy(e->host_pointer, (char *)staging_data + e->staging_offset,
+               e->size);
+    }
+    vector_clear(&stream->pending_downloads);
+
+    for (size_t i = 0; i < vector_get_size(&stream->staging_regions); ++i) {
+        staging_region_entry_t *e =
+            vector_get_element(&stream->staging_regions, i);
+        if (!e->retired) {
+            staging_ring_release(e->ring, e->region);
+        }
+    }
+    vector_clear(&stream->staging_regions);
+
+    for (size_t i = 0; i < vector_get_size(&stream->staging_buffers); ++i) {
+        sccl_destroy_buffer(
+            *(sccl_buffer_t *)vector_get_element(&stream->staging_buffers, i));
+    }
+    vector_clear(&stream->staging_buffers);
+
+    return error;
+}
+
+/**
+ * Wait for file reads into buffers and flush the written ranges, so the device
+ * sees the data. Returns the first error.
+ */
+static sccl_error_t complete_file_reads(sccl_stream_t stream)
+{
+    sccl_error_t error = sccl_success;
+
+    for (size_t i = 0; i < vector_get_size(&stream->file_reads); ++i) {
+        file_read_t *e = vector_get_element(&stream->file_reads, i);
+        sccl_error_t read_error =
+            file_io_wait(&stream->device->file_io, e->request);
+        if (read_error == sccl_success) {
+            read_error = sccl_flush_buffer_range(e->buffer, e->offset,
+                                                 e->request->size);
+        }
+        if (error == sccl_success) {
+            error = read_error;
+        }
+        sccl_free(e->request);
+    }
+    vector_clear(&stream->file_reads);
+
+    return error;
+}
+
+/**
+ * Write pending buffer ranges to their files if `completed`. All writes are
+ * submitted before waiting so they are in flight together.
+ */
+static sccl_error_t write_pending_files(sccl_stream_t stream, bool completed)
+{
+    sccl_error_t error = sccl_success;
+    const size_t count = vector_get_size(&stream->pending_file_writes);
+    file_io_request_t *requests = NULL;
+
+    if (!completed || count == 0) {
+        goto cleanup;
+    }
+    CHECK_SCCL_ERROR_GOTO(get_stream_scratch(stream,
+                                             count * sizeof(file_io_request_t),
+                                             (void **)&requests),
+                          cleanup, error);
+
+    for (size_t i = 0; i < count; ++i) {
+        pending_file_write_t *e =
+            vector_get_element(&stream->pending_file_writes, i);
+        const sccl_error_t invalidate_error =
+            sccl_invalidate_buffer_range(e->buffer, e->offset, e->size);
+        if (invalidate_error != sccl_success) {
+            /* nothing to wait for */
+            memset(&requests[i], 0, sizeof(file_io_request_t));
+            if (error == sccl_success) {
+                error = invalidate_error;
+            }
+            continue;
+        }
+        file_io_submit(&stream->device->file_io, true, e->fd, e->file_offset,
+                       e->data, e->size, &requests[i]);
+    }
+
+    for (size_t i = 0; i < count; ++i) {
+        const sccl_error_t write_error =
+            file_io_wait(&stream->device->file_io, &requests[i]);
+        if (error == sccl_success) {
+            error = write_error;
+        }
+    }
+
+cleanup:
+    vector_clear(&stream->pending_file_writes);
+    return error;
+}
+
+static sccl_error_t bounce_peer_copy(const sccl_device_t device,
+                                     const sccl_buffer_t buffer,
+                                     size_t offset, void *data, size_t size,
+                                     bool to_host);
+
+/**
+ * Forward data of `sccl_copy_peer` calls to buffers of other devices if
+ * `completed`, must run before the staging memory is released.
+ */
+static sccl_error_t complete_peer_copies(sccl_stream_t stream, bool completed)
+{
+    sccl_error_t error = sccl_success;
+
+    for (size_t i = 0; i < vector_get_size(&stream->pending_peer_copies) &&
+                       completed;
+         ++i) {
+        pending_peer_copy_t *e =
+            vector_get_element(&stream->pending_peer_copies, i);
+        void *staging_data;
+        error = sccl_invalidate_buffer_range(e->staging_buffer,
+                                             e->staging_offset, e->size);
+        if (error != sccl_success) {
+            break;
+        }
+        error = sccl_get_buffer_host_pointer(e->staging_buffer, &staging_data);
+        if (error != sccl_success) {
+            break;
+        }
+        error = bounce_peer_copy(e->dst->device, e->dst, e->dst_offset,
+                                 (char *)staging_data + e->staging_offset,
+                                 e->size, false);
+        if (error != sccl_success) {
+            break;
+        }
+    }
+    vector_clear(&stream->pending_peer_copies);
+
+    return error;
+}
+
+static void complete_pool_releases(sccl_stream_t stream)
+{
+    for (size_t i = 0; i < vector_get_size(&stream->pool_releases); ++i) {
+        buffer_pool_complete_release(*(struct buffer_pool_release **)
+                                         vector_get_element(
+                                             &stream->pool_releases, i));
+    }
+    vector_clear(&stream->pool_releases);
+}
+
 static sccl_error_t wait_streams(const sccl_device_t device,
                                  const sccl_stream_t *streams,
                                  size_t streams_count,
@@ -124,11 +456,14 @@ static sccl_error_t wait_streams(const sccl_device_t device,
 {
     sccl_error_t error = sccl_success;
 
-    VkFence *fences = NULL;
+    VkFence inline_fences[WAIT_STREAMS_INLINE_COUNT];
+    VkFence *fences = inline_fences;
 
-    CHECK_SCCL_ERROR_GOTO(
-        sccl_calloc((void **)&fences, streams_count, sizeof(VkFence)),
-        error_return, error);
+    if (streams_count > WAIT_STREAMS_INLINE_COUNT) {
+        CHECK_SCCL_ERROR_GOTO(
+            sccl_calloc((void **)&fences, streams_count, sizeof(VkFence)),
+            error_return, error);
+    }
     /* copy fences */
     for (size_t i = 0; i < streams_count; ++i) {
         fences[i] = streams[i]->fence;
@@ -163,10 +498,12 @@ static sccl_error_t wait_streams(const sccl_device_t device,
         }
     }
 
-    sccl_free(fences);
+    if (fences != inline_fences) {
+        sccl_free(fences);
+    }
     return sccl_success;
 error_return:
-    if (fences != NULL && completed_streams != NULL) {
+    if (fences != NULL && fences != inline_fences) {
         sccl_free(fences);
     }
     return error;
@@ -185,22 +522,59 @@ static sccl_error_t create_timeline_semaphore(const VkDevice device,
     semaphore_create_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
     semaphore_create_info.pNext = &timeline_semapore_create_info;
     semaphore_create_info.flags = 0;
-    CHECK_VKRESULT_RET(vkCreateSemaphore(device, &semaphore_create_info, NULL,
+    CHECK_VKRESULT_RET(vkCreateSemaphore(device, &semaphore_create_info,
+                                         sccl_get_vk_allocator(),
                                          timeline_semaphore));
 
     return sccl_success;
 }
 
 sccl_error_t add_descriptor_set_to_stream(const sccl_stream_t stream,
-                                          VkDescriptorPool descriptor_pool,
+                                          struct sccl_shader *shader,
+                                          size_t layout_index,
                                           VkDescriptorSet descriptor_set)
 {
     descriptor_set_entry_t entry = {0};
-    entry.descriptor_pool = descriptor_pool;
+    entry.shader = shader;
+    entry.layout_index = layout_index;
     entry.descriptor_set = descriptor_set;
     return vector_add_element(&stream->descriptor_sets, &entry);
 }
 
+sccl_error_t get_stream_scratch(const sccl_stream_t stream, size_t size,
+                                void **scratch)
+{
+    if (size > stream->scratch_size) {
+        CHECK_SCCL_ERROR_RET(sccl_reallocarray(&stream->scratch, size, 1));
+        stream->scratch_size = size;
+    }
+    *scratch = stream->scratch;
+    return sccl_success;
+}
+
+sccl_error_t add_buffer_pool_release_to_stream(
+    const sccl_stream_t stream, struct buffer_pool_release *release)
+{
+    return vector_add_element(&stream->pool_releases, &release);
+}
+
+void remove_buffer_pool_release_from_stream(
+    const sccl_stream_t stream, const struct buffer_pool_release *release)
+{
+    const size_t count = vector_get_size(&stream->pool_releases);
+    for (size_t i = count; i > 0; --i) {
+        struct buffer_pool_release **e =
+            vector_get_element(&stream->pool_releases, i - 1);
+        if (*e != release) {
+            continue;
+        }
+        *e = *(struct buffer_pool_release **)vector_get_last_element(
+            &stream->pool_releases);
+        vector_remove_last_element(&stream->pool_releases);
+        return;
+    }
+}
+
 sccl_error_t
 determine_next_command_buffer(const sccl_stream_t stream,
                               command_buffer_type_t next_command_buffer_type,
@@ -218,9 +592,8 @@ determine_next_command_buffer(const sccl_stream_t stream,
         /* alloc new command buffer */
         command_buffer_entry_t e = {0};
         e.type = next_command_buffer_type;
-        CHECK_SCCL_ERROR_RET(allocate_command_buffer(
-            stream->device->device, get_command_pool(stream, e.type),
-            &e.command_buffer));
+        CHECK_SCCL_ERROR_RET(
+            allocate_command_buffer(stream, e.type, &e.command_buffer));
 
         /* append to command buffers */
         CHECK_SCCL_ERROR_RET(vector_add_element(&stream->command_buffers, &e));
@@ -257,7 +630,8 @@ sccl_error_t sccl_create_stream(const sccl_device_t device,
          * will be used once */
         command_pool_create_info.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
         CHECK_VKRESULT_GOTO(
-            vkCreateCommandPool(device->device, &command_pool_create_info, NULL,
+            vkCreateCommandPool(device->device, &command_pool_create_info,
+                                sccl_get_vk_allocator(),
                                 &stream_internal->compute_command_pool),
             error_return, error);
     }
@@ -273,7 +647,8 @@ sccl_error_t sccl_create_stream(const sccl_device_t device,
          * will be used once */
         command_pool_create_info.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
         CHECK_VKRESULT_GOTO(
-            vkCreateCommandPool(device->device, &command_pool_create_info, NULL,
+            vkCreateCommandPool(device->device, &command_pool_create_info,
+                                sccl_get_vk_allocator(),
                                 &stream_internal->transfer_command_pool),
             error_return, error);
     } else {
@@ -308,7 +683,8 @@ sccl_error_t sccl_create_stream(const sccl_device_t device,
     /* create fence */
     VkFenceCreateInfo fence_create_info = {0};
     fence_create_info.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
-    CHECK_VKRESULT_GOTO(vkCreateFence(device->device, &fence_create_info, NULL,
+    CHECK_VKRESULT_GOTO(vkCreateFence(device->device, &fence_create_info,
+                                      sccl_get_vk_allocator(),
                                       &stream_internal->fence),
                         error_return, error);
 
@@ -316,6 +692,34 @@ sccl_error_t sccl_create_stream(const sccl_device_t device,
     CHECK_SCCL_ERROR_GOTO(vector_init(&stream_internal->command_buffers,
                                       sizeof(command_buffer_entry_t)),
                           error_return, error);
+    CHECK_SCCL_ERROR_GOTO(vector_init(&stream_internal->free_command_buffers,
+                                      sizeof(command_buffer_entry_t)),
+                          error_return, error);
+
+    /* create staging containers */
+    CHECK_SCCL_ERROR_GOTO(vector_init(&stream_internal->staging_regions,
+                                      sizeof(staging_region_entry_t)),
+                          error_return, error);
+    CHECK_SCCL_ERROR_GOTO(vector_init(&stream_internal->staging_buffers,
+                                      sizeof(sccl_buffer_t)),
+                          error_return, error);
+    CHECK_SCCL_ERROR_GOTO(vector_init(&stream_internal->pending_downloads,
+                                      sizeof(pending_download_t)),
+                          error_return, error);
+    CHECK_SCCL_ERROR_GOTO(vector_init(&stream_internal->pool_releases,
+                                      sizeof(struct buffer_pool_release *)),
+                          error_return, error);
+
+    /* create file transfer containers */
+    CHECK_SCCL_ERROR_GOTO(
+        vector_init(&stream_internal->file_reads, sizeof(file_read_t)),
+        error_return, error);
+    CHECK_SCCL_ERROR_GOTO(vector_init(&stream_internal->pending_file_writes,
+                                      sizeof(pending_file_write_t)),
+                          error_return, error);
+    CHECK_SCCL_ERROR_GOTO(vector_init(&stream_internal->pending_peer_copies,
+                                      sizeof(pending_peer_copy_t)),
+                          error_return, error);
 
     /* create timeline semaphore */
     CHECK_SCCL_ERROR_GOTO(
@@ -332,7 +736,32 @@ error_return:
     if (stream_internal != NULL) {
         if (stream_internal->timeline_semaphore != VK_NULL_HANDLE) {
             vkDestroySemaphore(device->device,
-                               stream_internal->timeline_semaphore, NULL);
+                               stream_internal->timeline_semaphore,
+                               sccl_get_vk_allocator());
+        }
+        if (vector_is_initilized(&stream_internal->pending_peer_copies)) {
+            vector_destroy(&stream_internal->pending_peer_copies);
+        }
+        if (vector_is_initilized(&stream_internal->pending_file_writes)) {
+            vector_destroy(&stream_internal->pending_file_writes);
+        }
+        if (vector_is_initilized(&stream_internal->file_reads)) {
+            vector_destroy(&stream_internal->file_reads);
+        }
+        if (vector_is_initilized(&stream_internal->pool_releases)) {
+            vector_destroy(&stream_internal->pool_releases);
+        }
+        if (vector_is_initilized(&stream_internal->pending_downloads)) {
+            vector_destroy(&stream_internal->pending_downloads);
+        }
+        if (vector_is_initilized(&stream_internal->staging_buffers)) {
+            vector_destroy(&stream_internal->staging_buffers);
+        }
+        if (vector_is_initilized(&stream_internal->staging_regions)) {
+            vector_destroy(&stream_internal->staging_regions);
+        }
+        if (vector_is_initilized(&stream_internal->free_command_buffers)) {
+            vector_destroy(&stream_internal->free_command_buffers);
         }
         if (vector_is_initilized(&stream_internal->command_buffers)) {
             /* command buffers should be empty at this stage */
@@ -343,11 +772,11 @@ error_return:
             vector_destroy(&stream_internal->command_buffers);
         }
         if (stream_internal->fence != VK_NULL_HANDLE) {
-            vkDestroyFence(device->device, stream_internal->fence, NULL);
+            vkDestroyFence(device->device, stream_internal->fence,
+                           sccl_get_vk_allocator());
         }
         if (vector_is_initilized(&stream_internal->descriptor_sets)) {
-            free_descriptor_sets(device->device,
-                                 &stream_internal->descriptor_sets);
+            release_descriptor_sets(&stream_internal->descriptor_sets);
             vector_destroy(&stream_internal->descriptor_sets);
         }
         // if (stream_internal->command_pool != VK_NULL_HANDLE) {
@@ -363,11 +792,13 @@ error_return:
         if (has_seperate_transfer_queue(device) &&
             stream_internal->transfer_command_pool != VK_NULL_HANDLE) {
             vkDestroyCommandPool(device->device,
-                                 stream_internal->transfer_command_pool, NULL);
+                                 stream_internal->transfer_command_pool,
+                                 sccl_get_vk_allocator());
         }
         if (stream_internal->compute_command_pool != VK_NULL_HANDLE) {
             vkDestroyCommandPool(device->device,
-                                 stream_internal->compute_command_pool, NULL);
+                                 stream_internal->compute_command_pool,
+                                 sccl_get_vk_allocator());
         }
         sccl_free(stream_internal);
     }
@@ -377,15 +808,45 @@ error_return:
 
 void sccl_destroy_stream(sccl_stream_t stream)
 {
+    /* reads may still write to buffer memory, files of pending writes may
+     * already be closed */
+    complete_file_reads(stream);
+    vector_destroy(&stream->file_reads);
+    write_pending_files(stream, false);
+    vector_destroy(&stream->pending_file_writes);
+
+    /* staging memory may still be in use, and regions retired to the rings
+     * refer to the timeline semaphore */
+    bool completed = false;
+    wait_stream_submissions(stream, &completed);
+    /* host memory of pending downloads may already be gone */
+    complete_peer_copies(stream, false);
+    vector_destroy(&stream->pending_peer_copies);
+    release_staging(stream, false);
+    vector_destroy(&stream->pending_downloads);
+    vector_destroy(&stream->staging_buffers);
+    vector_destroy(&stream->staging_regions);
+    staging_ring_release_retired(&stream->device->upload_ring,
+                                 stream->timeline_semaphore);
+    staging_ring_release_retired(&stream->device->download_ring,
+                                 stream->timeline_semaphore);
+
     vkDestroySemaphore(stream->device->device, stream->timeline_semaphore,
-                       NULL);
+                       sccl_get_vk_allocator());
 
-    free_command_buffers(stream);
+    free_command_buffers(stream, &stream->command_buffers);
     vector_destroy(&stream->command_buffers);
+    free_command_buffers(stream, &stream->free_command_buffers);
+    vector_destroy(&stream->free_command_buffers);
+    sccl_free(stream->scratch);
+
+    complete_pool_releases(stream);
+    vector_destroy(&stream->pool_releases);
 
-    vkDestroyFence(stream->device->device, stream->fence, NULL);
+    vkDestroyFence(stream->device->device, stream->fence,
+                   sccl_get_vk_allocator());
 
-    free_descriptor_sets(stream->device->device, &stream->descriptor_sets);
+    release_descriptor_sets(&stream->descriptor_sets);
     vector_destroy(&stream->descriptor_sets);
 
     // vkFreeCommandBuffers(stream->device->device, stream->command_pool, 1,
@@ -395,16 +856,20 @@ void sccl_destroy_stream(sccl_stream_t stream)
     /* only set if seperate transfer queue */
     if (has_seperate_transfer_queue(stream->device)) {
         vkDestroyCommandPool(stream->device->device,
-                             stream->transfer_command_pool, NULL);
+                             stream->transfer_command_pool,
+                             sccl_get_vk_allocator());
     }
     vkDestroyCommandPool(stream->device->device, stream->compute_command_pool,
-                         NULL);
+                         sccl_get_vk_allocator());
 
     sccl_free(stream);
 }
 
 sccl_error_t sccl_dispatch_stream(const sccl_stream_t stream)
 {
+    /* recorded commands may use data read from files */
+    CHECK_SCCL_ERROR_RET(complete_file_reads(stream));
+
     if (vector_get_size(&stream->command_buffers) <= 0) {
         /* if no command buffers, submit without command buffer to fence is
          * signaled */
@@ -420,6 +885,7 @@ sccl_error_t sccl_dispatch_stream(const sccl_stream_t stream)
             SCCL_QUEUE_INDEX, &queue);
         CHECK_VKRESULT_RET(
             vkQueueSubmit(queue, 1, &submit_info, stream->fence));
+        stream->fence_submitted = true;
 
         return sccl_success;
     }
@@ -437,9 +903,10 @@ sccl_error_t sccl_dispatch_stream(const sccl_stream_t stream)
         command_buffer_entry_t *command_buffer_entry =
             vector_get_element(&stream->command_buffers, i);
 
-        const uint64_t wait_value = i;
-        /* last command buffer will reset timeline semaphore back to 0 */
-        const uint64_t signal_value = i + 1;
+        /* the timeline semaphore keeps counting across dispatches so it does
+         * not need to be recreated on reset */
+        const uint64_t wait_value = stream->timeline_value;
+        const uint64_t signal_value = stream->timeline_value + 1;
 
         VkTimelineSemaphoreSubmitInfo timeline_semaphore_submit_info = {0};
         timeline_semaphore_submit_info.sType =
@@ -472,7 +939,11 @@ sccl_error_t sccl_dispatch_stream(const sccl_stream_t stream)
                             ? stream->fence
                             : VK_NULL_HANDLE;
         CHECK_VKRESULT_RET(vkQueueSubmit(queue, 1, &submit_info, fence));
+        /* if a later submit fails, waits only cover what was submitted */
+        stream->timeline_value = signal_value;
     }
+    stream->fence_submitted = true;
+    retire_upload_staging(stream);
 
     return sccl_success;
 }
@@ -490,27 +961,36 @@ sccl_error_t sccl_join_stream(const sccl_stream_t stream)
 
 sccl_error_t sccl_reset_stream(const sccl_stream_t stream)
 {
-    /* free descriptor sets */
-    CHECK_SCCL_ERROR_RET(
-        free_descriptor_sets(stream->device->device, &stream->descriptor_sets));
-
-    /* reset command buffer here so we can record for next dispatch */
-    // CHECK_SCCL_ERROR_RET(reset_command_buffer(stream));
-
-    /* free command buffers */
-    free_command_buffers(stream);
-
-    /* reset timeline semaphore */
-    vkDestroySemaphore(stream->device->device, stream->timeline_semaphore,
-                       NULL);
-    CHECK_SCCL_ERROR_RET(create_timeline_semaphore(
-        stream->device->device, &stream->timeline_semaphore));
+    /* submitted commands can not be discarded, wait for them before staging
+     * memory and command buffers are reused. Downloads are only valid if the
+     * stream ran to completion, a stream that was never dispatched is also
+     * reset */
+    bool completed = false;
+    CHECK_SCCL_ERROR_RET(wait_stream_submissions(stream, &completed));
+    const sccl_error_t peer_error = complete_peer_copies(stream, completed);
+    const sccl_error_t staging_error = release_staging(stream, completed);
+    const sccl_error_t read_error = complete_file_reads(stream);
+    const sccl_error_t write_error = write_pending_files(stream, completed);
+    complete_pool_releases(stream);
+
+    /* return descriptor sets to their shaders */
+    release_descriptor_sets(&stream->descriptor_sets);
+
+    /* keep command buffers for the next dispatch */
+    CHECK_SCCL_ERROR_RET(recycle_command_buffers(stream));
 
     /* reset fence */
     CHECK_VKRESULT_RET(
         vkResetFences(stream->device->device, 1, &stream->fence));
+    stream->fence_submitted = false;
 
-    return sccl_success;
+    if (peer_error != sccl_success) {
+        return peer_error;
+    }
+    if (staging_error != sccl_success) {
+        return staging_error;
+    }
+    return read_error != sccl_success ? read_error : write_error;
 }
 
 sccl_error_t sccl_wait_streams(const sccl_device_t device,
@@ -528,10 +1008,14 @@ sccl_error_t sccl_wait_streams_all(const sccl_device_t device,
     return wait_streams(device, streams, streams_count, NULL, true);
 }
 
-sccl_error_t sccl_copy_buffer(const sccl_stream_t stream,
-                              const sccl_buffer_t src, size_t src_offset,
-                              const sccl_buffer_t dst, size_t dst_offset,
-                              size_t size)
+/**
+ * Record copy of `regions`, offsets are relative to the underlying
+ * `VkBuffer`s.
+ */
+static sccl_error_t record_copy_regions(const sccl_stream_t stream,
+                                        VkBuffer src, VkBuffer dst,
+                                        const VkBufferCopy *regions,
+                                        uint32_t regions_count)
 {
     /* determine command buffer to record to */
     VkCommandBuffer command_buffer;
@@ -539,11 +1023,7 @@ sccl_error_t sccl_copy_buffer(const sccl_stream_t stream,
         stream, command_buffer_type_transfer, &command_buffer));
 
     /* record command */
-    VkBufferCopy buffer_copy = {0};
-    buffer_copy.srcOffset = src_offset;
-    buffer_copy.dstOffset = dst_offset;
-    buffer_copy.size = size;
-    vkCmdCopyBuffer(command_buffer, src->buffer, dst->buffer, 1, &buffer_copy);
+    vkCmdCopyBuffer(command_buffer, src, dst, regions_count, regions);
 
     /* create barrier so next command will wait until this is finished */
     VkMemoryBarrier memory_barrier = {};
@@ -556,3 +1036,622 @@ sccl_error_t sccl_copy_buffer(const sccl_stream_t stream,
 
     return sccl_success;
 }
+
+sccl_error_t prepare_managed_buffer_device_access(const sccl_stream_t stream,
+                                                 const sccl_buffer_t buffer,
+                                                 bool write)
+{
+    struct sccl_buffer *root = buffer->parent != NULL ? buffer->parent : buffer;
+    if (!is_buffer_type_managed(root->type) || root->staging == NULL) {
+        return sccl_success;
+    }
+
+    if (root->device_copy_stale) {
+        VkBufferCopy buffer_copy = {0};
+        buffer_copy.size = root->size;
+        CHECK_SCCL_ERROR_RET(record_copy_regions(stream, root->staging->buffer,
+                                                 root->buffer, &buffer_copy,
+                                                 1));
+        root->device_copy_stale = false;
+    }
+    if (write) {
+        root->host_copy_stale = true;
+    }
+
+    return sccl_success;
+}
+
+/* copy without managed buffer migration */
+static sccl_error_t copy_buffer_range(const sccl_stream_t stream,
+                                      const sccl_buffer_t src,
+                                      size_t src_offset,
+                                      const sccl_buffer_t dst,
+                                      size_t dst_offset, size_t size)
+{
+    VkBufferCopy buffer_copy = {0};
+    buffer_copy.srcOffset = src->view_offset + src_offset;
+    buffer_copy.dstOffset = dst->view_offset + dst_offset;
+    buffer_copy.size = size;
+    return record_copy_regions(stream, src->buffer, dst->buffer, &buffer_copy,
+                               1);
+}
+
+sccl_error_t sccl_copy_buffer(const sccl_stream_t stream,
+                              const sccl_buffer_t src, size_t src_offset,
+                              const sccl_buffer_t dst, size_t dst_offset,
+                              size_t size)
+{
+    CHECK_SCCL_ERROR_RET(
+        prepare_managed_buffer_device_access(stream, src, false));
+    CHECK_SCCL_ERROR_RET(
+        prepare_managed_buffer_device_access(stream, dst, true));
+    return copy_buffer_range(stream, src, src_offset, dst, dst_offset, size);
+}
+
+static bool is_range_in_buffer(const sccl_buffer_t buffer, size_t offset,
+                               size_t size)
+{
+    return offset <= buffer->size && size <= buffer->size - offset;
+}
+
+sccl_error_t sccl_copy_buffer_regions(const sccl_stream_t stream,
+                                      const sccl_buffer_t src,
+                                      const sccl_buffer_t dst,
+                                      const sccl_buffer_copy_region_t *regions,
+                                      size_t regions_count)
+{
+    if (regions_count == 0) {
+        return sccl_success;
+    }
+    CHECK_SCCL_NULL_RET(regions);
+    if (regions_count > UINT32_MAX) {
+        return sccl_invalid_argument;
+    }
+
+    VkBufferCopy *buffer_copies = NULL;
+    CHECK_SCCL_ERROR_RET(get_stream_scratch(
+        stream, regions_count * sizeof(VkBufferCopy), (void **)&buffer_copies));
+    for (size_t i = 0; i < regions_count; ++i) {
+        if (regions[i].size == 0 ||
+            !is_range_in_buffer(src, regions[i].src_offset, regions[i].size) ||
+            !is_range_in_buffer(dst, regions[i].dst_offset, regions[i].size)) {
+            return sccl_invalid_argument;
+        }
+        buffer_copies[i].srcOffset = src->view_offset + regions[i].src_offset;
+        buffer_copies[i].dstOffset = dst->view_offset + regions[i].dst_offset;
+        buffer_copies[i].size = regions[i].size;
+    }
+
+    CHECK_SCCL_ERROR_RET(
+        prepare_managed_buffer_device_access(stream, src, false));
+    CHECK_SCCL_ERROR_RET(
+        prepare_managed_buffer_device_access(stream, dst, true));
+
+    return record_copy_regions(stream, src->buffer, dst->buffer, buffer_copies,
+                               (uint32_t)regions_count);
+}
+
+/**
+ * Find runs of dirty pages of `root` and store them as copies from the staging
+ * buffer in `regions` if not NULL. Returns the number of runs.
+ */
+static size_t get_dirty_regions(const struct sccl_buffer *root,
+                                VkBufferCopy *regions)
+{
+    const size_t page_count = get_dirty_page_count(root->size);
+    size_t regions_count = 0;
+    size_t page = 0;
+    while (page < page_count) {
+        /* skip clean pages a word at a time */
+        const uint64_t word = root->dirty_pages[page / 64] >> (page % 64);
+        if (word == 0) {
+            page = (page / 64 + 1) * 64;
+            continue;
+        }
+        page += __builtin_ctzll(word);
+
+        const size_t first = page;
+        while (page < page_count &&
+               ((root->dirty_pages[page / 64] >> (page % 64)) & 1) != 0) {
+            ++page;
+        }
+
+        if (regions != NULL) {
+            const size_t offset = first * SCCL_MIRRORED_BUFFER_PAGE_SIZE;
+            size_t end = page * SCCL_MIRRORED_BUFFER_PAGE_SIZE;
+            if (end > root->size) {
+                end = root->size;
+            }
+            regions[regions_count].srcOffset = offset;
+            regions[regions_count].dstOffset = offset;
+            regions[regions_count].size = end - offset;
+        }
+        ++regions_count;
+    }
+    return regions_count;
+}
+
+sccl_error_t sccl_sync_dirty_to_device(const sccl_stream_t stream,
+                                       const sccl_buffer_t buffer)
+{
+    struct sccl_buffer *root = buffer->parent != NULL ? buffer->parent : buffer;
+    if (root->dirty_pages == NULL) {
+        return sccl_success;
+    }
+
+    const size_t regions_count = get_dirty_regions(root, NULL);
+    if (regions_count == 0) {
+        return sccl_success;
+    }
+
+    VkBufferCopy *regions = NULL;
+    CHECK_SCCL_ERROR_RET(get_stream_scratch(
+        stream, regions_count * sizeof(VkBufferCopy), (void **)&regions));
+    get_dirty_regions(root, regions);
+    CHECK_SCCL_ERROR_RET(record_copy_regions(stream, root->staging->buffer,
+                                             root->buffer, regions,
+                                             (uint32_t)regions_count));
+
+    /* pages are clean once the copy is recorded */
+    memset(root->dirty_pages, 0,
+           (get_dirty_page_count(root->size) + 63) / 64 * sizeof(uint64_t));
+
+    return sccl_success;
+}
+
+/* resolve `SCCL_WHOLE_SIZE` and check range is inside buffer */
+static sccl_error_t get_sync_range(const sccl_buffer_t buffer, size_t offset,
+                                   size_t *size)
+{
+    if (offset > buffer->size) {
+        return sccl_invalid_argument;
+    }
+    if (*size == SCCL_WHOLE_SIZE) {
+        *size = buffer->size - offset;
+    }
+    if (*size > buffer->size - offset) {
+        return sccl_invalid_argument;
+    }
+    return sccl_success;
+}
+
+sccl_error_t sccl_sync_buffer_to_device(const sccl_stream_t stream,
+                                        const sccl_buffer_t buffer,
+                                        size_t offset, size_t size)
+{
+    CHECK_SCCL_ERROR_RET(get_sync_range(buffer, offset, &size));
+    if (size == 0) {
+        return sccl_success;
+    }
+
+    /* mirrored user memory is copied right away, like `sccl_upload` */
+    if (buffer->wrapped_host_pointer != NULL) {
+        void *data;
+        CHECK_SCCL_ERROR_RET(sccl_get_buffer_host_pointer(buffer, &data));
+        memcpy((char *)data + offset,
+               (char *)buffer->wrapped_host_pointer + buffer->view_offset +
+                   offset,
+               size);
+        return sccl_flush_buffer_range(buffer, offset, size);
+    }
+
+    if (buffer->staging == NULL) {
+        return sccl_success;
+    }
+
+    /* staging buffer mirrors the root buffer, views index it by view offset */
+    return copy_buffer_range(stream, buffer->staging,
+                             buffer->view_offset + offset, buffer, offset,
+                             size);
+}
+
+sccl_error_t sccl_sync_buffer_to_host(const sccl_stream_t stream,
+                                      const sccl_buffer_t buffer,
+                                      size_t offset, size_t size)
+{
+    CHECK_SCCL_ERROR_RET(get_sync_range(buffer, offset, &size));
+    if (size == 0) {
+        return sccl_success;
+    }
+
+    /* mirrored user memory is written once the stream completes, like
+     * `sccl_download` */
+    if (buffer->wrapped_host_pointer != NULL) {
+        pending_download_t pending_download = {0};
+        pending_download.staging_buffer = buffer;
+        pending_download.staging_offset = offset;
+        pending_download.host_pointer = (char *)buffer->wrapped_host_pointer +
+                                        buffer->view_offset + offset;
+        pending_download.size = size;
+        return vector_add_element(&stream->pending_downloads,
+                                  &pending_download);
+    }
+
+    if (buffer->staging == NULL) {
+        return sccl_success;
+    }
+
+    return copy_buffer_range(stream, buffer, offset, buffer->staging,
+                             buffer->view_offset + offset, size);
+}
+
+/**
+ * Get `size` bytes of staging memory from `ring` for the lifetime of the
+ * recorded commands. Falls back to a temporary buffer of the ring's type when
+ * the ring is full.
+ */
+static sccl_error_t acquire_staging(const sccl_stream_t stream,
+                                    struct staging_ring *ring, size_t size,
+                                    sccl_buffer_t *staging_buffer,
+                                    size_t *staging_offset, void **data)
+{
+    bool allocated = false;
+    staging_region_entry_t entry = {0};
+    entry.ring = ring;
+    CHECK_SCCL_ERROR_RET(staging_ring_allocate(ring, stream->device, size,
+                                               &allocated, &entry.region,
+                                               staging_offset));
+    if (allocated) {
+        sccl_error_t error =
+            vector_add_element(&stream->staging_regions, &entry);
+        if (error != sccl_success) {
+            staging_ring_release(ring, entry.region);
+            return error;
+        }
+        *staging_buffer = ring->buffer;
+        *data = ring->data + *staging_offset;
+        return sccl_success;
+    }
+
+    CHECK_SCCL_ERROR_RET(staging_ring_create_buffer(ring, stream->device, size,
+                                                    staging_buffer));
+    sccl_error_t error =
+        vector_add_element(&stream->staging_buffers, staging_buffer);
+    if (error != sccl_success) {
+        sccl_destroy_buffer(*staging_buffer);
+        return error;
+    }
+    *staging_offset = 0;
+    return sccl_get_buffer_host_pointer(*staging_buffer, data);
+}
+
+sccl_error_t sccl_upload(const sccl_stream_t stream, const sccl_buffer_t dst,
+                         size_t dst_offset, const void *host_pointer,
+                         size_t size)
+{
+    if (dst_offset > dst->size || size > dst->size - dst_offset) {
+        return sccl_invalid_argument;
+    }
+    if (size == 0) {
+        return sccl_success;
+    }
+
+    sccl_buffer_t staging_buffer;
+    size_t staging_offset;
+    void *data;
+    CHECK_SCCL_ERROR_RET(acquire_staging(stream, &stream->device->upload_ring,
+                                         size, &staging_buffer, &staging_offset,
+                                         &data));
+
+    memcpy(data, host_pointer, size);
+    CHECK_SCCL_ERROR_RET(
+        sccl_flush_buffer_range(staging_buffer, staging_offset, size));
+
+    return sccl_copy_buffer(stream, staging_buffer, staging_offset, dst,
+                            dst_offset, size);
+}
+
+sccl_error_t sccl_download(const sccl_stream_t stream, const sccl_buffer_t src,
+                           size_t src_offset, void *host_pointer, size_t size)
+{
+    if (src_offset > src->size || size > src->size - src_offset) {
+        return sccl_invalid_argument;
+    }
+    if (size == 0) {
+        return sccl_success;
+    }
+
+    pending_download_t pending_download = {0};
+    void *data;
+    CHECK_SCCL_ERROR_RET(acquire_staging(
+        stream, &stream->device->download_ring, size,
+        &pending_download.staging_buffer, &pending_download.staging_offset,
+        &data));
+    pending_download.host_pointer = host_pointer;
+    pending_download.size = size;
+
+    CHECK_SCCL_ERROR_RET(sccl_copy_buffer(stream, src, src_offset,
+                                          pending_download.staging_buffer,
+                                          pending_download.staging_offset,
+                                          size));
+
+    return vector_add_element(&stream->pending_downloads, &pending_download);
+}
+
+/**
+ * Copy `size` bytes between `buffer` and host memory through the peer streams
+ * of `device` in chunks. Streams alternate between chunks, so host copies of
+ * one chunk overlap the device copy of the next. Must hold `peer_mutex`.
+ */
+static sccl_error_t bounce_chunks(const sccl_device_t device,
+                                  const sccl_buffer_t buffer, size_t offset,
+                                  char *data, size_t size, bool to_host)
+{
+    sccl_error_t error = sccl_success;
+    bool pending[PEER_COPY_STREAMS] = {0};
+
+    for (size_t i = 0; i * PEER_COPY_CHUNK_SIZE < size; ++i) {
+        const size_t slot = i % PEER_COPY_STREAMS;
+        const sccl_stream_t stream = device->peer_streams[slot];
+        if (pending[slot]) {
+            pending[slot] = false;
+            CHECK_SCCL_ERROR_GOTO(sccl_join_stream(stream), error_return,
+                                  error);
+        }
+
+        const size_t chunk_offset = i * PEER_COPY_CHUNK_SIZE;
+        size_t chunk_size = size - chunk_offset;
+        if (chunk_size > PEER_COPY_CHUNK_SIZE) {
+            chunk_size = PEER_COPY_CHUNK_SIZE;
+        }
+        if (to_host) {
+            CHECK_SCCL_ERROR_GOTO(sccl_download(stream, buffer,
+                                                offset + chunk_offset,
+                                                data + chunk_offset,
+                                                chunk_size),
+                                  error_return, error);
+        } else {
+            CHECK_SCCL_ERROR_GOTO(sccl_upload(stream, buffer,
+                                              offset + chunk_offset,
+                                              data + chunk_offset, chunk_size),
+                                  error_return, error);
+        }
+        CHECK_SCCL_ERROR_GOTO(sccl_dispatch_stream(stream), error_return,
+                              error);
+        pending[slot] = true;
+    }
+
+    for (size_t i = 0; i < PEER_COPY_STREAMS; ++i) {
+        if (pending[i]) {
+            pending[i] = false;
+            CHECK_SCCL_ERROR_GOTO(sccl_join_stream(device->peer_streams[i]),
+                                  error_return, error);
+        }
+    }
+
+    return sccl_success;
+
+error_return:
+    /* wait for chunks in flight and drop commands of the failed chunk */
+    for (size_t i = 0; i < PEER_COPY_STREAMS; ++i) {
+        if (pending[i]) {
+            sccl_join_stream(device->peer_streams[i]);
+        } else {
+            sccl_reset_stream(device->peer_streams[i]);
+        }
+    }
+    return error;
+}
+
+static sccl_error_t bounce_peer_copy(const sccl_device_t device,
+                                     const sccl_buffer_t buffer,
+                                     size_t offset, void *data, size_t size,
+                                     bool to_host)
+{
+    sccl_error_t error = sccl_success;
+
+    pthread_mutex_lock(&device->peer_mutex);
+    for (size_t i = 0; i < PEER_COPY_STREAMS; ++i) {
+        if (device->peer_streams[i] == NULL) {
+            CHECK_SCCL_ERROR_GOTO(
+                sccl_create_stream(device, &device->peer_streams[i]),
+                error_return, error);
+        }
+    }
+    error = bounce_chunks(device, buffer, offset, data, size, to_host);
+
+error_return:
+    pthread_mutex_unlock(&device->peer_mutex);
+    return error;
+}
+
+/**
+ * Get the import of root dmabuf buffer `root` on `device`, importing it on
+ * first use. `import` is set to NULL if the buffer can not be imported, which
+ * is remembered so the import is not attempted again.
+ */
+static sccl_error_t get_peer_import(struct sccl_buffer *root,
+                                    const sccl_device_t device,
+                                    sccl_buffer_t *import)
+{
+    sccl_error_t error = sccl_success;
+
+    *import = NULL;
+    if (!is_buffer_type_dmabuf(root->type) ||
+        !root->device->dmabuf_buffer_supported ||
+        !device->dmabuf_buffer_supported) {
+        return sccl_success;
+    }
+
+    pthread_mutex_lock(&root->device->peer_mutex);
+    if (!vector_is_initilized(&root->peer_imports)) {
+        CHECK_SCCL_ERROR_GOTO(
+            vector_init(&root->peer_imports, sizeof(peer_import_t)),
+            error_return, error);
+    }
+    for (size_t i = 0; i < vector_get_size(&root->peer_imports); ++i) {
+        peer_import_t *e = vector_get_element(&root->peer_imports, i);
+        if (e->device == device) {
+            *import = e->import;
+            goto error_return;
+        }
+    }
+
+    /* imported buffers can not be exported again */
+    peer_import_t entry = {0};
+    entry.device = device;
+    int fd;
+    if (sccl_export_dmabuf_buffer(root, &fd) == sccl_success) {
+        if (sccl_import_dmabuf_buffer(device, &entry.import, fd,
+                                      sccl_buffer_type_external_dmabuf_storage,
+                                      root->size) != sccl_success) {
+            entry.import = NULL;
+        }
+        close(fd);
+    }
+    error = vector_add_element(&root->peer_imports, &entry);
+    if (error != sccl_success) {
+        if (entry.import != NULL) {
+            sccl_destroy_buffer(entry.import);
+        }
+        goto error_return;
+    }
+    *import = entry.import;
+
+error_return:
+    pthread_mutex_unlock(&root->device->peer_mutex);
+    return error;
+}
+
+sccl_error_t sccl_copy_peer(const sccl_stream_t stream,
+                            const sccl_buffer_t src, size_t src_offset,
+                            const sccl_buffer_t dst, size_t dst_offset,
+                            size_t size)
+{
+    if (!is_range_in_buffer(src, src_offset, size) ||
+        !is_range_in_buffer(dst, dst_offset, size)) {
+        return sccl_invalid_argument;
+    }
+    if (src->device != stream->device && dst->device != stream->device) {
+        return sccl_invalid_argument;
+    }
+    if (size == 0) {
+        return sccl_success;
+    }
+    if (src->device == dst->device) {
+        return sccl_copy_buffer(stream, src, src_offset, dst, dst_offset,
+                                size);
+    }
+
+    /* the buffer on the other device */
+    const bool pull = src->device != stream->device;
+    const sccl_buffer_t peer = pull ? src : dst;
+    struct sccl_buffer *peer_root = peer->parent != NULL ? peer->parent : peer;
+
+    /* direct copy between device memories through the imported dmabuf */
+    sccl_buffer_t import;
+    CHECK_SCCL_ERROR_RET(get_peer_import(peer_root, stream->device, &import));
+    if (import != NULL && pull) {
+        return sccl_copy_buffer(stream, import, src->view_offset + src_offset,
+                                dst, dst_offset, size);
+    }
+    if (import != NULL) {
+        return sccl_copy_buffer(stream, src, src_offset, import,
+                                dst->view_offset + dst_offset, size);
+    }
+
+    sccl_buffer_t staging_buffer;
+    size_t staging_offset;
+    void *data;
+    if (pull) {
+        /* read the source now into staging memory of the stream's device */
+        CHECK_SCCL_ERROR_RET(acquire_staging(stream,
+                                             &stream->device->upload_ring,
+                                             size, &staging_buffer,
+                                             &staging_offset, &data));
+        CHECK_SCCL_ERROR_RET(
+            bounce_peer_copy(src->device, src, src_offset, data, size, true));
+        CHECK_SCCL_ERROR_RET(
+            sccl_flush_buffer_range(staging_buffer, staging_offset, size));
+        return sccl_copy_buffer(stream, staging_buffer, staging_offset, dst,
+                                dst_offset, size);
+    }
+
+    /* forward to the destination once the stream has completed */
+    pending_peer_copy_t pending_peer_copy = {0};
+    CHECK_SCCL_ERROR_RET(acquire_staging(
+        stream, &stream->device->download_ring, size,
+        &pending_peer_copy.staging_buffer, &pending_peer_copy.staging_offset,
+        &data));
+    pending_peer_copy.dst = dst;
+    pending_peer_copy.dst_offset = dst_offset;
+    pending_peer_copy.size = size;
+    CHECK_SCCL_ERROR_RET(sccl_copy_buffer(stream, src, src_offset,
+                                          pending_peer_copy.staging_buffer,
+                                          pending_peer_copy.staging_offset,
+                                          size));
+
+    return vector_add_element(&stream->pending_peer_copies,
+                              &pending_peer_copy);
+}
+
+/* file I/O uses the host mapping directly, which misses the migrations of
+ * managed buffers and is the staging buffer of staged auto buffers */
+static bool is_file_io_supported(const sccl_buffer_t buffer)
+{
+    const struct sccl_buffer *root =
+        buffer->parent != NULL ? buffer->parent : buffer;
+    return !is_buffer_type_managed(root->type) &&
+           !(is_buffer_type_auto(root->type) && root->staging != NULL);
+}
+
+sccl_error_t sccl_read_file_into_buffer(const sccl_stream_t stream, int fd,
+                                        size_t file_offset,
+                                        const sccl_buffer_t dst,
+                                        size_t dst_offset, size_t size)
+{
+    if (!is_range_in_buffer(dst, dst_offset, size) ||
+        !is_file_io_supported(dst)) {
+        return sccl_invalid_argument;
+    }
+    if (size == 0) {
+        return sccl_success;
+    }
+
+    void *data;
+    CHECK_SCCL_ERROR_RET(sccl_get_buffer_host_pointer(dst, &data));
+
+    file_read_t file_read = {0};
+    file_read.buffer = dst;
+    file_read.offset = dst_offset;
+    CHECK_SCCL_ERROR_RET(sccl_calloc((void **)&file_read.request, 1,
+                                     sizeof(file_io_request_t)));
+    sccl_error_t error = vector_add_element(&stream->file_reads, &file_read);
+    if (error != sccl_success) {
+        sccl_free(file_read.request);
+        return error;
+    }
+
+    /* failures are reported when the read is waited for */
+    file_io_submit(&stream->device->file_io, false, fd, file_offset,
+                   (char *)data + dst_offset, size, file_read.request);
+
+    return sccl_success;
+}
+
+sccl_error_t sccl_write_buffer_to_file(const sccl_stream_t stream,
+                                       const sccl_buffer_t src,
+                                       size_t src_offset, int fd,
+                                       size_t file_offset, size_t size)
+{
+    if (!is_range_in_buffer(src, src_offset, size) ||
+        !is_file_io_supported(src)) {
+        return sccl_invalid_argument;
+    }
+    if (size == 0) {
+        return sccl_success;
+    }
+
+    pending_file_write_t pending_file_write = {0};
+    void *data;
+    CHECK_SCCL_ERROR_RET(sccl_get_buffer_host_pointer(src, &data));
+    pending_file_write.data = (char *)data + src_offset;
+    pending_file_write.buffer = src;
+    pending_file_write.offset = src_offset;
+    pending_file_write.fd = fd;
+    pending_file_write.file_offset = file_offset;
+    pending_file_write.size = size;
+
+    return vector_add_element(&stream->pending_file_writes,
+                              &pending_file_write);
+}
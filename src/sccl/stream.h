@@ -2,8 +2,10 @@
 #ifndef STREAM_HEADER
 #define STREAM_HEADER
 
+#include "buffer_pool.h"
 #include "sccl.h"
 #include "vector.h"
+#include <stdbool.h>
 #include <vulkan/vulkan.h>
 
 typedef enum {
@@ -24,21 +26,80 @@ struct sccl_stream {
      * == false`*/
     VkCommandPool transfer_command_pool;
 
-    /* contains descriptor_set_entry_t to free when command buffer is done
+    /* contains descriptor_set_entry_t to release when command buffer is done
      * executing */
     vector_t descriptor_sets;
     VkFence fence;
+    bool fence_submitted; /* fence is signaled by the last dispatch */
 
     /* contains command buffers of recorded commands */
     vector_t command_buffers;
-    /* timeline semaphore for syncing between transfer and compute queue */
+    /* command buffers of previous dispatches, reused after the command pools
+     * are reset. Contains `command_buffer_entry_t` */
+    vector_t free_command_buffers;
+    /* timeline semaphore for syncing between transfer and compute queue,
+     * signaled values increase monotonically so it is never recreated */
     VkSemaphore timeline_semaphore;
+    uint64_t timeline_value; /* value signaled by the last dispatch */
+
+    /* reused by `get_stream_scratch`, grows as needed */
+    void *scratch;
+    size_t scratch_size;
+
+    /* staging used by `sccl_upload` and `sccl_download`, released when the
+     * stream is reset. Contains `staging_region_entry_t`, temporary
+     * `sccl_buffer_t` used when the device staging ring is full, and
+     * `pending_download_t` to copy to host memory once the stream completes */
+    vector_t staging_regions;
+    vector_t staging_buffers;
+    vector_t pending_downloads;
+
+    /* contains `struct buffer_pool_release *` completed when the stream is
+     * reset */
+    vector_t pool_releases;
+
+    /* file reads into buffers, waited for before the stream is dispatched.
+     * Contains `file_read_t` */
+    vector_t file_reads;
+    /* `pending_file_write_t` written to files when the stream is reset after
+     * completing */
+    vector_t pending_file_writes;
+
+    /* `pending_peer_copy_t` forwarded to buffers of other devices when the
+     * stream is reset after completing */
+    vector_t pending_peer_copies;
 };
 
 sccl_error_t add_descriptor_set_to_stream(const sccl_stream_t stream,
-                                          VkDescriptorPool descriptor_pool,
+                                          struct sccl_shader *shader,
+                                          size_t layout_index,
                                           VkDescriptorSet descriptor_set);
 
+/**
+ * Get `size` bytes of scratch memory owned by the stream, valid until the next
+ * call. Only allocates if the scratch memory has to grow.
+ */
+sccl_error_t get_stream_scratch(const sccl_stream_t stream, size_t size,
+                                void **scratch);
+
+/**
+ * Record upload of the host copy of a managed buffer if the device copy is
+ * stale, marks the host copy stale if the recorded commands `write` to the
+ * buffer. Does nothing for other buffers.
+ */
+sccl_error_t prepare_managed_buffer_device_access(const sccl_stream_t stream,
+                                                 const sccl_buffer_t buffer,
+                                                 bool write);
+
+sccl_error_t add_buffer_pool_release_to_stream(
+    const sccl_stream_t stream, struct buffer_pool_release *release);
+
+/**
+ * Undo `add_buffer_pool_release_to_stream`, the release is not completed.
+ */
+void remove_buffer_pool_release_from_stream(
+    const sccl_stream_t stream, const struct buffer_pool_release *release);
+
 sccl_error_t
 determine_next_command_buffer(const sccl_stream_t stream,
                               command_buffer_type_t next_command_buffer_type,
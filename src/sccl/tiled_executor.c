@@ -0,0 +1,250 @@
+#include "tiled_executor.h"
+#include "alloc.h"
+#include "error.h"
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+
+static void destroy_slot(tile_slot_t *slot)
+{
+    if (slot->stream != NULL) {
+        sccl_destroy_stream(slot->stream);
+    }
+    if (slot->upload_buffer != NULL) {
+        sccl_destroy_buffer(slot->upload_buffer);
+    }
+    if (slot->input_buffer != NULL) {
+        sccl_destroy_buffer(slot->input_buffer);
+    }
+    if (slot->output_buffer != NULL) {
+        sccl_destroy_buffer(slot->output_buffer);
+    }
+    if (slot->readback_buffer != NULL) {
+        sccl_destroy_buffer(slot->readback_buffer);
+    }
+}
+
+/* on error the slot is partially initialized and must be destroyed */
+static sccl_error_t init_slot(const sccl_device_t device,
+                              const sccl_tiled_executor_config_t *config,
+                              tile_slot_t *slot)
+{
+    CHECK_SCCL_ERROR_RET(sccl_create_stream(device, &slot->stream));
+
+    CHECK_SCCL_ERROR_RET(sccl_create_buffer(device, &slot->upload_buffer,
+                                            sccl_buffer_type_upload_storage,
+                                            config->input_tile_size));
+    CHECK_SCCL_ERROR_RET(
+        sccl_get_buffer_host_pointer(slot->upload_buffer, &slot->upload_data));
+    CHECK_SCCL_ERROR_RET(sccl_create_buffer(device, &slot->input_buffer,
+                                            sccl_buffer_type_device_storage,
+                                            config->input_tile_size));
+
+    if (config->output_tile_size > 0) {
+        CHECK_SCCL_ERROR_RET(sccl_create_buffer(
+            device, &slot->output_buffer, sccl_buffer_type_device_storage,
+            config->output_tile_size));
+        CHECK_SCCL_ERROR_RET(sccl_create_buffer(
+            device, &slot->readback_buffer, sccl_buffer_type_readback_storage,
+            config->output_tile_size));
+        CHECK_SCCL_ERROR_RET(sccl_get_buffer_host_pointer(
+            slot->readback_buffer, &slot->readback_data));
+    }
+
+    return sccl_success;
+}
+
+sccl_error_t
+sccl_create_tiled_executor(const sccl_device_t device,
+                           const sccl_tiled_executor_config_t *config,
+                           sccl_tiled_executor_t *executor)
+{
+    sccl_error_t error = sccl_success;
+    struct sccl_tiled_executor *executor_internal = NULL;
+
+    CHECK_SCCL_NULL_RET(config);
+    CHECK_SCCL_NULL_RET(executor);
+    if (config->input_tile_size == 0 || config->record_tile == NULL) {
+        return sccl_invalid_argument;
+    }
+
+    CHECK_SCCL_ERROR_GOTO(sccl_calloc((void **)&executor_internal, 1,
+                                      sizeof(struct sccl_tiled_executor)),
+                          error_return, error);
+    executor_internal->device = device;
+    executor_internal->config = *config;
+    if (executor_internal->config.depth == 0) {
+        executor_internal->config.depth = SCCL_DEFAULT_TILED_EXECUTOR_DEPTH;
+    }
+
+    CHECK_SCCL_ERROR_GOTO(sccl_calloc((void **)&executor_internal->slots,
+                                      executor_internal->config.depth,
+                                      sizeof(tile_slot_t)),
+                          error_return, error);
+    for (size_t i = 0; i < executor_internal->config.depth; ++i) {
+        CHECK_SCCL_ERROR_GOTO(init_slot(device, &executor_internal->config,
+                                        &executor_internal->slots[i]),
+                              error_return, error);
+    }
+
+    /* set public handle */
+    *executor = (sccl_tiled_executor_t)executor_internal;
+
+    return sccl_success;
+
+error_return:
+    if (executor_internal != NULL) {
+        sccl_destroy_tiled_executor(executor_internal);
+    }
+    return error;
+}
+
+void sccl_destroy_tiled_executor(sccl_tiled_executor_t executor)
+{
+    if (executor->slots != NULL) {
+        for (size_t i = 0; i < executor->config.depth; ++i) {
+            destroy_slot(&executor->slots[i]);
+        }
+        sccl_free(executor->slots);
+    }
+    sccl_free(executor);
+}
+
+static sccl_error_t read_tile_input(const sccl_tiled_run_params_t *params,
+                                    size_t offset, size_t size, void *data)
+{
+    if (params->input != NULL) {
+        memcpy(data, (const char *)params->input + offset, size);
+        return sccl_success;
+    }
+
+    size_t read_size = 0;
+    while (read_size < size) {
+        const ssize_t result =
+            pread(params->input_fd, (char *)data + read_size, size - read_size,
+                  (off_t)(params->input_file_offset + offset + read_size));
+        if (result < 0 && errno == EINTR) {
+            continue;
+        }
+        if (result <= 0) {
+            /* error or input shorter than `input_size` */
+            return sccl_system_error;
+        }
+        read_size += (size_t)result;
+    }
+
+    return sccl_success;
+}
+
+/* wait for the tile in flight on `slot` and copy its output to the run
+ * output */
+static sccl_error_t complete_slot(tile_slot_t *slot, void *output)
+{
+    if (!slot->pending) {
+        return sccl_success;
+    }
+    slot->pending = false;
+
+    CHECK_SCCL_ERROR_RET(sccl_join_stream(slot->stream));
+    if (slot->output_size > 0) {
+        CHECK_SCCL_ERROR_RET(sccl_invalidate_buffer_range(
+            slot->readback_buffer, 0, slot->output_size));
+        memcpy((char *)output + slot->output_offset, slot->readback_data,
+               slot->output_size);
+    }
+
+    return sccl_success;
+}
+
+sccl_error_t sccl_tiled_executor_run(const sccl_tiled_executor_t executor,
+                                     const sccl_tiled_run_params_t *params)
+{
+    sccl_error_t error = sccl_success;
+    const sccl_tiled_executor_config_t *config = &executor->config;
+
+    CHECK_SCCL_NULL_RET(params);
+    if (config->output_tile_size > 0 && params->output == NULL) {
+        return sccl_invalid_argument;
+    }
+
+    const size_t tile_count =
+        (params->input_size + config->input_tile_size - 1) /
+        config->input_tile_size;
+    for (size_t i = 0; i < tile_count; ++i) {
+        tile_slot_t *slot = &executor->slots[i % config->depth];
+
+        /* the slot is free once tile `i - depth` has completed */
+        CHECK_SCCL_ERROR_GOTO(complete_slot(slot, params->output),
+                              error_return, error);
+
+        sccl_tile_t tile = {0};
+        tile.index = i;
+        tile.input_offset = i * config->input_tile_size;
+        tile.input_size = params->input_size - tile.input_offset;
+        if (tile.input_size > config->input_tile_size) {
+            tile.input_size = config->input_tile_size;
+        }
+        tile.output_offset = i * config->output_tile_size;
+        if (tile.output_offset < params->output_size) {
+            tile.output_size = params->output_size - tile.output_offset;
+            if (tile.output_size > config->output_tile_size) {
+                tile.output_size = config->output_tile_size;
+            }
+        }
+        tile.input_buffer = slot->input_buffer;
+        tile.output_buffer = slot->output_buffer;
+
+        /* read on the host while the device works on the previous tiles */
+        CHECK_SCCL_ERROR_GOTO(read_tile_input(params, tile.input_offset,
+                                              tile.input_size,
+                                              slot->upload_data),
+                              error_return, error);
+        CHECK_SCCL_ERROR_GOTO(sccl_flush_buffer_range(slot->upload_buffer, 0,
+                                                      tile.input_size),
+                              error_return, error);
+
+        CHECK_SCCL_ERROR_GOTO(sccl_copy_buffer(slot->stream,
+                                               slot->upload_buffer, 0,
+                                               slot->input_buffer, 0,
+                                               tile.input_size),
+                              error_return, error);
+        CHECK_SCCL_ERROR_GOTO(
+            config->record_tile(config->user_data, slot->stream, &tile),
+            error_return, error);
+        if (tile.output_size > 0) {
+            CHECK_SCCL_ERROR_GOTO(sccl_copy_buffer(slot->stream,
+                                                   slot->output_buffer, 0,
+                                                   slot->readback_buffer, 0,
+                                                   tile.output_size),
+                                  error_return, error);
+        }
+
+        CHECK_SCCL_ERROR_GOTO(sccl_dispatch_stream(slot->stream),
+                              error_return, error);
+        slot->pending = true;
+        slot->output_offset = tile.output_offset;
+        slot->output_size = tile.output_size;
+    }
+
+    for (size_t i = 0; i < config->depth; ++i) {
+        CHECK_SCCL_ERROR_GOTO(
+            complete_slot(&executor->slots[i], params->output), error_return,
+            error);
+    }
+
+    return sccl_success;
+
+error_return:
+    /* wait for tiles in flight and drop commands recorded for the failed
+     * tile */
+    for (size_t i = 0; i < config->depth; ++i) {
+        tile_slot_t *slot = &executor->slots[i];
+        if (slot->pending) {
+            slot->pending = false;
+            sccl_join_stream(slot->stream);
+        } else {
+            sccl_reset_stream(slot->stream);
+        }
+    }
+    return error;
+}
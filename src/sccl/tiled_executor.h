@@ -0,0 +1,32 @@
+#pragma once
+#ifndef TILED_EXECUTOR_HEADER
+#define TILED_EXECUTOR_HEADER
+
+#include "sccl.h"
+#include <stdbool.h>
+
+/* buffers and stream processing one tile at a time */
+typedef struct {
+    sccl_stream_t stream;
+    sccl_buffer_t upload_buffer;   /* host visible input staging */
+    sccl_buffer_t input_buffer;    /* device */
+    sccl_buffer_t output_buffer;   /* device, NULL without output */
+    sccl_buffer_t readback_buffer; /* host visible, NULL without output */
+    void *upload_data;
+    void *readback_data;
+
+    /* tile in flight, its output is copied to the run output once the stream
+     * completes */
+    bool pending;
+    size_t output_offset;
+    size_t output_size;
+} tile_slot_t;
+
+struct sccl_tiled_executor {
+    sccl_device_t device;
+    sccl_tiled_executor_config_t config;
+
+    tile_slot_t *slots; /* `config.depth` slots */
+};
+
+#endif // TILED_EXECUTOR_HEADER
@@ -56,6 +56,12 @@ void *vector_get_last_element(const vector_t *vec)
     return vector_get_element(vec, vector_get_size(vec) - 1);
 }
 
+void vector_remove_last_element(vector_t *vec)
+{
+    assert(vector_get_size(vec) > 0);
+    --vec->size;
+}
+
 void vector_destroy(vector_t *vec)
 {
     assert(vec != NULL);
@@ -36,6 +36,11 @@ void *vector_get_first_element(const vector_t *vec);
  */
 void *vector_get_last_element(const vector_t *vec);
 
+/**
+ * Assumes size > 0.
+ */
+void vector_remove_last_element(vector_t *vec);
+
 void vector_destroy(vector_t *vec);
 
 void vector_sort(vector_t *vec, int (*compar)(const void *, const void *));
@@ -0,0 +1,168 @@
+/**
+ * Packs compiled SPIR-V modules into a single shader bundle that can be loaded
+ * with `sccl_open_shader_bundle`.
+ *
+ * Usage: shader_bundle_packer <output> <name>=<path.spv> [<name>=<path.spv>...]
+ */
+
+#include "spirv_reflect.hpp"
+
+#include <shader_bundle_format.h>
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace {
+
+struct bundle_input {
+    std::string name;
+    std::string code;
+    spirv_reflection reflection;
+};
+
+std::optional<std::string> read_file(const std::string &path)
+{
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open()) {
+        return std::nullopt;
+    }
+    return std::string(std::istreambuf_iterator<char>(file),
+                       std::istreambuf_iterator<char>());
+}
+
+uint64_t align_up(uint64_t value, uint64_t alignment)
+{
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+template <typename T> void write_at(std::string &output, uint64_t offset,
+                                    const T *data, size_t count)
+{
+    std::memcpy(output.data() + offset, data, sizeof(T) * count);
+}
+
+std::string pack_bundle(const std::vector<bundle_input> &inputs)
+{
+    shader_bundle_header_t header = {};
+    std::memcpy(header.magic, SHADER_BUNDLE_MAGIC, SHADER_BUNDLE_MAGIC_SIZE);
+    header.version = SHADER_BUNDLE_VERSION;
+    header.entry_count = static_cast<uint32_t>(inputs.size());
+
+    std::vector<shader_bundle_entry_t> entries(inputs.size());
+    uint64_t offset = sizeof(shader_bundle_header_t) +
+                      sizeof(shader_bundle_entry_t) * inputs.size();
+    for (size_t i = 0; i < inputs.size(); ++i) {
+        const bundle_input &input = inputs[i];
+        shader_bundle_entry_t &entry = entries[i];
+        std::strncpy(entry.name, input.name.c_str(),
+                     SHADER_BUNDLE_MAX_NAME_LENGTH - 1);
+        entry.buffer_layouts_count =
+            static_cast<uint32_t>(input.reflection.buffer_layouts.size());
+        entry.specialization_constants_count = static_cast<uint32_t>(
+            input.reflection.specialization_constants.size());
+        entry.push_constant_size = input.reflection.push_constant_size;
+
+        entry.buffer_layouts_offset = offset;
+        offset += sizeof(shader_bundle_buffer_layout_t) *
+                  entry.buffer_layouts_count;
+        entry.specialization_constants_offset = offset;
+        offset += sizeof(shader_bundle_specialization_constant_t) *
+                  entry.specialization_constants_count;
+        entry.code_offset = align_up(offset, SHADER_BUNDLE_CODE_ALIGNMENT);
+        entry.code_size = input.code.size();
+        offset = entry.code_offset + entry.code_size;
+    }
+
+    std::string output(offset, '\0');
+    write_at(output, 0, &header, 1);
+    write_at(output, sizeof(shader_bundle_header_t), entries.data(),
+             entries.size());
+    for (size_t i = 0; i < inputs.size(); ++i) {
+        const bundle_input &input = inputs[i];
+        const shader_bundle_entry_t &entry = entries[i];
+        write_at(output, entry.buffer_layouts_offset,
+                 input.reflection.buffer_layouts.data(),
+                 input.reflection.buffer_layouts.size());
+        write_at(output, entry.specialization_constants_offset,
+                 input.reflection.specialization_constants.data(),
+                 input.reflection.specialization_constants.size());
+        write_at(output, entry.code_offset, input.code.data(),
+                 input.code.size());
+    }
+    return output;
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+    if (argc < 3) {
+        std::cerr << "Usage: " << argv[0]
+                  << " <output> <name>=<path.spv> [<name>=<path.spv>...]"
+                  << std::endl;
+        return 1;
+    }
+
+    std::vector<bundle_input> inputs;
+    for (int i = 2; i < argc; ++i) {
+        const std::string argument = argv[i];
+        const size_t separator = argument.find('=');
+        if (separator == std::string::npos || separator == 0) {
+            std::cerr << "Invalid argument: " << argument << std::endl;
+            return 1;
+        }
+        bundle_input input;
+        input.name = argument.substr(0, separator);
+        const std::string path = argument.substr(separator + 1);
+        if (input.name.size() >= SHADER_BUNDLE_MAX_NAME_LENGTH) {
+            std::cerr << "Shader name too long: " << input.name << std::endl;
+            return 1;
+        }
+
+        std::optional<std::string> code = read_file(path);
+        if (!code.has_value()) {
+            std::cerr << "Failed to read: " << path << std::endl;
+            return 1;
+        }
+        input.code = std::move(*code);
+
+        std::string error;
+        std::optional<spirv_reflection> reflection =
+            reflect_spirv(input.code, error);
+        if (!reflection.has_value()) {
+            std::cerr << path << ": " << error << std::endl;
+            return 1;
+        }
+        input.reflection = std::move(*reflection);
+        inputs.push_back(std::move(input));
+    }
+
+    /* library looks up entries with binary search */
+    std::sort(inputs.begin(), inputs.end(),
+              [](const bundle_input &a, const bundle_input &b) {
+                  return a.name < b.name;
+              });
+    for (size_t i = 1; i < inputs.size(); ++i) {
+        if (inputs[i - 1].name == inputs[i].name) {
+            std::cerr << "Duplicate shader name: " << inputs[i].name
+                      << std::endl;
+            return 1;
+        }
+    }
+
+    const std::string output = pack_bundle(inputs);
+    std::ofstream file(argv[1], std::ios::binary | std::ios::trunc);
+    if (!file.is_open() ||
+        !file.write(output.data(),
+                    static_cast<std::streamsize>(output.size()))) {
+        std::cerr << "Failed to write: " << argv[1] << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,413 @@
+#include "spirv_reflect.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <map>
+#include <unordered_map>
+
+namespace {
+
+/* subset of the SPIR-V specification used for reflection */
+constexpr uint32_t spirv_magic = 0x07230203;
+constexpr size_t spirv_header_word_count = 5;
+
+constexpr uint32_t op_decorate = 71;
+constexpr uint32_t op_member_decorate = 72;
+constexpr uint32_t op_type_bool = 20;
+constexpr uint32_t op_type_int = 21;
+constexpr uint32_t op_type_float = 22;
+constexpr uint32_t op_type_vector = 23;
+constexpr uint32_t op_type_matrix = 24;
+constexpr uint32_t op_type_array = 28;
+constexpr uint32_t op_type_runtime_array = 29;
+constexpr uint32_t op_type_struct = 30;
+constexpr uint32_t op_type_pointer = 32;
+constexpr uint32_t op_constant = 43;
+constexpr uint32_t op_spec_constant_true = 48;
+constexpr uint32_t op_spec_constant_false = 49;
+constexpr uint32_t op_spec_constant = 50;
+constexpr uint32_t op_variable = 59;
+
+constexpr uint32_t decoration_spec_id = 1;
+constexpr uint32_t decoration_buffer_block = 3;
+constexpr uint32_t decoration_array_stride = 6;
+constexpr uint32_t decoration_matrix_stride = 7;
+constexpr uint32_t decoration_binding = 33;
+constexpr uint32_t decoration_descriptor_set = 34;
+constexpr uint32_t decoration_offset = 35;
+
+constexpr uint32_t storage_class_uniform = 2;
+constexpr uint32_t storage_class_push_constant = 9;
+constexpr uint32_t storage_class_storage_buffer = 12;
+
+struct spirv_type {
+    uint32_t opcode = 0;
+    uint32_t width = 0;        /* bool, int and float, in bits */
+    uint32_t element_type = 0; /* vector, matrix, array and pointer */
+    uint32_t element_count = 0; /* vector and matrix */
+    uint32_t length_id = 0;     /* array */
+    uint32_t storage_class = 0; /* pointer */
+    std::vector<uint32_t> members; /* struct */
+};
+
+struct spirv_decorations {
+    std::optional<uint32_t> spec_id;
+    std::optional<uint32_t> binding;
+    std::optional<uint32_t> descriptor_set;
+    std::optional<uint32_t> array_stride;
+    bool buffer_block = false;
+    std::map<uint32_t, uint32_t> member_offsets;
+    std::map<uint32_t, uint32_t> member_matrix_strides;
+};
+
+struct spirv_variable {
+    uint32_t id;
+    uint32_t pointer_type;
+    uint32_t storage_class;
+};
+
+struct spirv_spec_constant {
+    uint32_t id;
+    uint32_t type;
+    std::vector<uint32_t> value;
+};
+
+struct spirv_module {
+    std::unordered_map<uint32_t, spirv_type> types;
+    std::unordered_map<uint32_t, spirv_decorations> decorations;
+    std::unordered_map<uint32_t, uint32_t> constants; /* 32 bit and smaller */
+    std::vector<spirv_variable> variables;
+    std::vector<spirv_spec_constant> spec_constants;
+};
+
+std::optional<spirv_module> parse_module(const std::string &code,
+                                         std::string &error)
+{
+    if (code.size() % sizeof(uint32_t) != 0 ||
+        code.size() < spirv_header_word_count * sizeof(uint32_t)) {
+        error = "invalid SPIR-V size";
+        return std::nullopt;
+    }
+    std::vector<uint32_t> words(code.size() / sizeof(uint32_t));
+    std::memcpy(words.data(), code.data(), code.size());
+    if (words[0] != spirv_magic) {
+        error = "invalid SPIR-V magic";
+        return std::nullopt;
+    }
+
+    spirv_module module;
+    size_t i = spirv_header_word_count;
+    while (i < words.size()) {
+        const uint32_t opcode = words[i] & 0xffff;
+        const uint32_t word_count = words[i] >> 16;
+        if (word_count == 0 || i + word_count > words.size()) {
+            error = "truncated SPIR-V instruction";
+            return std::nullopt;
+        }
+        const uint32_t *operands = &words[i + 1];
+        const uint32_t operand_count = word_count - 1;
+
+        switch (opcode) {
+        case op_decorate:
+            if (operand_count >= 2) {
+                spirv_decorations &decorations =
+                    module.decorations[operands[0]];
+                const uint32_t decoration = operands[1];
+                const bool has_value = operand_count >= 3;
+                if (decoration == decoration_spec_id && has_value) {
+                    decorations.spec_id = operands[2];
+                } else if (decoration == decoration_binding && has_value) {
+                    decorations.binding = operands[2];
+                } else if (decoration == decoration_descriptor_set &&
+                           has_value) {
+                    decorations.descriptor_set = operands[2];
+                } else if (decoration == decoration_array_stride &&
+                           has_value) {
+                    decorations.array_stride = operands[2];
+                } else if (decoration == decoration_buffer_block) {
+                    decorations.buffer_block = true;
+                }
+            }
+            break;
+        case op_member_decorate:
+            if (operand_count >= 4) {
+                spirv_decorations &decorations =
+                    module.decorations[operands[0]];
+                if (operands[2] == decoration_offset) {
+                    decorations.member_offsets[operands[1]] = operands[3];
+                } else if (operands[2] == decoration_matrix_stride) {
+                    decorations.member_matrix_strides[operands[1]] =
+                        operands[3];
+                }
+            }
+            break;
+        case op_type_bool:
+            if (operand_count >= 1) {
+                /* booleans are specialized as `VkBool32` */
+                spirv_type &type = module.types[operands[0]];
+                type.opcode = opcode;
+                type.width = 32;
+            }
+            break;
+        case op_type_int:
+        case op_type_float:
+            if (operand_count >= 2) {
+                spirv_type &type = module.types[operands[0]];
+                type.opcode = opcode;
+                type.width = operands[1];
+            }
+            break;
+        case op_type_vector:
+        case op_type_matrix:
+            if (operand_count >= 3) {
+                spirv_type &type = module.types[operands[0]];
+                type.opcode = opcode;
+                type.element_type = operands[1];
+                type.element_count = operands[2];
+            }
+            break;
+        case op_type_array:
+            if (operand_count >= 3) {
+                spirv_type &type = module.types[operands[0]];
+                type.opcode = opcode;
+                type.element_type = operands[1];
+                type.length_id = operands[2];
+            }
+            break;
+        case op_type_runtime_array:
+            if (operand_count >= 2) {
+                spirv_type &type = module.types[operands[0]];
+                type.opcode = opcode;
+                type.element_type = operands[1];
+            }
+            break;
+        case op_type_struct:
+            if (operand_count >= 1) {
+                spirv_type &type = module.types[operands[0]];
+                type.opcode = opcode;
+                type.members.assign(operands + 1, operands + operand_count);
+            }
+            break;
+        case op_type_pointer:
+            if (operand_count >= 3) {
+                spirv_type &type = module.types[operands[0]];
+                type.opcode = opcode;
+                type.element_type = operands[2];
+                type.storage_class = operands[1];
+            }
+            break;
+        case op_constant:
+            if (operand_count >= 3) {
+                module.constants[operands[1]] = operands[2];
+            }
+            break;
+        case op_spec_constant_true:
+        case op_spec_constant_false:
+            if (operand_count >= 2) {
+                module.spec_constants.push_back(
+                    {.id = operands[1],
+                     .type = operands[0],
+                     .value = {opcode == op_spec_constant_true ? 1u : 0u}});
+            }
+            break;
+        case op_spec_constant:
+            if (operand_count >= 3) {
+                module.spec_constants.push_back(
+                    {.id = operands[1],
+                     .type = operands[0],
+                     .value = std::vector<uint32_t>(
+                         operands + 2, operands + operand_count)});
+            }
+            break;
+        case op_variable:
+            if (operand_count >= 3) {
+                module.variables.push_back({.id = operands[1],
+                                            .pointer_type = operands[0],
+                                            .storage_class = operands[2]});
+            }
+            break;
+        default:
+            break;
+        }
+        i += word_count;
+    }
+    return module;
+}
+
+const spirv_type *find_type(const spirv_module &module, uint32_t id)
+{
+    const auto it = module.types.find(id);
+    return it == module.types.end() ? nullptr : &it->second;
+}
+
+const spirv_decorations *find_decorations(const spirv_module &module,
+                                          uint32_t id)
+{
+    const auto it = module.decorations.find(id);
+    return it == module.decorations.end() ? nullptr : &it->second;
+}
+
+/* size of type in an explicitly laid out block, `matrix_stride` is only used
+ * for matrix types */
+std::optional<uint32_t> get_type_size(const spirv_module &module,
+                                      uint32_t type_id, uint32_t matrix_stride)
+{
+    const spirv_type *type = find_type(module, type_id);
+    if (type == nullptr) {
+        return std::nullopt;
+    }
+    switch (type->opcode) {
+    case op_type_bool:
+    case op_type_int:
+    case op_type_float:
+        return type->width / 8;
+    case op_type_vector: {
+        const std::optional<uint32_t> element_size =
+            get_type_size(module, type->element_type, 0);
+        if (!element_size.has_value()) {
+            return std::nullopt;
+        }
+        return *element_size * type->element_count;
+    }
+    case op_type_matrix:
+        if (matrix_stride == 0) {
+            return std::nullopt;
+        }
+        return matrix_stride * type->element_count;
+    case op_type_array: {
+        const spirv_decorations *decorations =
+            find_decorations(module, type_id);
+        const auto length = module.constants.find(type->length_id);
+        if (decorations == nullptr || !decorations->array_stride.has_value() ||
+            length == module.constants.end()) {
+            return std::nullopt;
+        }
+        return *decorations->array_stride * length->second;
+    }
+    case op_type_struct: {
+        const spirv_decorations *decorations =
+            find_decorations(module, type_id);
+        uint32_t size = 0;
+        for (uint32_t member = 0; member < type->members.size(); ++member) {
+            if (decorations == nullptr ||
+                !decorations->member_offsets.contains(member)) {
+                return std::nullopt;
+            }
+            const auto stride = decorations->member_matrix_strides.find(member);
+            const std::optional<uint32_t> member_size = get_type_size(
+                module, type->members[member],
+                stride == decorations->member_matrix_strides.end()
+                    ? 0
+                    : stride->second);
+            if (!member_size.has_value()) {
+                return std::nullopt;
+            }
+            size = std::max(size, decorations->member_offsets.at(member) +
+                                      *member_size);
+        }
+        return size;
+    }
+    default:
+        return std::nullopt;
+    }
+}
+
+} // namespace
+
+std::optional<spirv_reflection> reflect_spirv(const std::string &code,
+                                              std::string &error)
+{
+    std::optional<spirv_module> module = parse_module(code, error);
+    if (!module.has_value()) {
+        return std::nullopt;
+    }
+
+    spirv_reflection reflection;
+
+    for (const spirv_variable &variable : module->variables) {
+        const spirv_type *pointer = find_type(*module, variable.pointer_type);
+        if (pointer == nullptr || pointer->opcode != op_type_pointer) {
+            error = "variable without pointer type";
+            return std::nullopt;
+        }
+
+        if (variable.storage_class == storage_class_push_constant) {
+            const std::optional<uint32_t> size =
+                get_type_size(*module, pointer->element_type, 0);
+            if (!size.has_value()) {
+                error = "unable to determine push constant block size";
+                return std::nullopt;
+            }
+            reflection.push_constant_size =
+                std::max(reflection.push_constant_size, *size);
+            continue;
+        }
+
+        if (variable.storage_class != storage_class_uniform &&
+            variable.storage_class != storage_class_storage_buffer) {
+            continue;
+        }
+
+        const spirv_decorations *decorations =
+            find_decorations(*module, variable.id);
+        if (decorations == nullptr || !decorations->binding.has_value()) {
+            error = "buffer variable without binding";
+            return std::nullopt;
+        }
+        const spirv_type *block = find_type(*module, pointer->element_type);
+        if (block == nullptr || block->opcode != op_type_struct) {
+            error = "descriptor arrays are not supported";
+            return std::nullopt;
+        }
+
+        /* `BufferBlock` is the SPIR-V 1.0 way of declaring storage buffers */
+        const spirv_decorations *block_decorations =
+            find_decorations(*module, pointer->element_type);
+        const bool storage =
+            variable.storage_class == storage_class_storage_buffer ||
+            (block_decorations != nullptr && block_decorations->buffer_block);
+
+        reflection.buffer_layouts.push_back(
+            {.set = decorations->descriptor_set.value_or(0),
+             .binding = *decorations->binding,
+             .descriptor_type =
+                 storage ? uint32_t{SHADER_BUNDLE_DESCRIPTOR_TYPE_STORAGE}
+                         : uint32_t{SHADER_BUNDLE_DESCRIPTOR_TYPE_UNIFORM}});
+    }
+
+    for (const spirv_spec_constant &constant : module->spec_constants) {
+        const spirv_decorations *decorations =
+            find_decorations(*module, constant.id);
+        if (decorations == nullptr || !decorations->spec_id.has_value()) {
+            continue;
+        }
+        const std::optional<uint32_t> size =
+            get_type_size(*module, constant.type, 0);
+        if (!size.has_value() || *size == 0 ||
+            *size > SHADER_BUNDLE_MAX_SPECIALIZATION_CONSTANT_SIZE ||
+            *size > constant.value.size() * sizeof(uint32_t)) {
+            error = "unsupported specialization constant type";
+            return std::nullopt;
+        }
+        shader_bundle_specialization_constant_t entry = {
+            .constant_id = *decorations->spec_id, .size = *size, .data = {}};
+        std::memcpy(entry.data, constant.value.data(), *size);
+        reflection.specialization_constants.push_back(entry);
+    }
+
+    std::sort(reflection.buffer_layouts.begin(),
+              reflection.buffer_layouts.end(),
+              [](const shader_bundle_buffer_layout_t &a,
+                 const shader_bundle_buffer_layout_t &b) {
+                  return a.set != b.set ? a.set < b.set
+                                        : a.binding < b.binding;
+              });
+    std::sort(reflection.specialization_constants.begin(),
+              reflection.specialization_constants.end(),
+              [](const shader_bundle_specialization_constant_t &a,
+                 const shader_bundle_specialization_constant_t &b) {
+                  return a.constant_id < b.constant_id;
+              });
+
+    return reflection;
+}
@@ -0,0 +1,30 @@
+#pragma once
+#ifndef SPIRV_REFLECT_HEADER
+#define SPIRV_REFLECT_HEADER
+
+#include <shader_bundle_format.h>
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+/**
+ * Minimal SPIR-V reflection, only what is needed to create a compute shader in
+ * sccl. Reflection is module wide, resources of all entry points are reported.
+ */
+struct spirv_reflection {
+    std::vector<shader_bundle_buffer_layout_t> buffer_layouts;
+    std::vector<shader_bundle_specialization_constant_t>
+        specialization_constants;
+    uint32_t push_constant_size = 0;
+};
+
+/**
+ * Returns reflection of module, or error message in `error` if module is
+ * invalid or uses unsupported features.
+ */
+std::optional<spirv_reflection> reflect_spirv(const std::string &code,
+                                              std::string &error);
+
+#endif // SPIRV_REFLECT_HEADER
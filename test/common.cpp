@@ -20,7 +20,13 @@ void create_buffer_generic(const sccl_device_t device, sccl_buffer_t *buffer,
     case sccl_buffer_type_shared_storage:
     case sccl_buffer_type_host_uniform:
     case sccl_buffer_type_device_uniform:
-    case sccl_buffer_type_shared_uniform: {
+    case sccl_buffer_type_shared_uniform:
+    case sccl_buffer_type_readback_storage:
+    case sccl_buffer_type_upload_storage:
+    case sccl_buffer_type_readback_uniform:
+    case sccl_buffer_type_upload_uniform:
+    case sccl_buffer_type_auto_storage:
+    case sccl_buffer_type_managed_storage: {
         SCCL_TEST_ASSERT(sccl_create_buffer(device, buffer, type, size));
         break;
     }
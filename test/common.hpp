@@ -2,6 +2,7 @@
 #ifndef COMMON_HEADER
 #define COMMON_HEADER
 
+#include <gtest/gtest.h>
 #include <inttypes.h>
 #include <optional>
 #include <sccl.h>
@@ -83,6 +84,49 @@ inline std::optional<std::string> read_test_shader(const char *shader_file_name)
                          .c_str());
 }
 
+/* device whose auto storage buffers always use a staging buffer, so the staged
+ * path is tested on UMA and resizable BAR devices too */
+inline sccl_error_t create_staged_device(const sccl_instance_t instance,
+                                         sccl_device_t *device)
+{
+    setenv(SCCL_FORCE_STAGED_BUFFERS, "1", 1);
+    sccl_error_t error =
+        sccl_create_device(instance, device, get_environment_gpu_index());
+    unsetenv(SCCL_FORCE_STAGED_BUFFERS);
+    return error;
+}
+
+/* runs `function` when the scope is left, also if an assertion returns early */
+template <typename function_t> class scope_exit
+{
+public:
+    explicit scope_exit(function_t function) : function(function) {}
+    ~scope_exit() { function(); }
+    scope_exit(const scope_exit &) = delete;
+    scope_exit &operator=(const scope_exit &) = delete;
+
+private:
+    function_t function;
+};
+
+/* replace `device` and `stream` with ones that always stage auto buffers */
+inline void use_staged_device(const sccl_instance_t instance,
+                              sccl_device_t *device, sccl_stream_t *stream)
+{
+    sccl_device_t staged_device;
+    sccl_stream_t staged_stream;
+    SCCL_TEST_ASSERT(create_staged_device(instance, &staged_device));
+    SCCL_TEST_ASSERT(sccl_create_stream(staged_device, &staged_stream));
+    sccl_destroy_stream(*stream);
+    sccl_destroy_device(*device);
+    *device = staged_device;
+    *stream = staged_stream;
+
+    sccl_device_properties_t device_properties = {};
+    sccl_get_device_properties(*device, &device_properties);
+    ASSERT_FALSE(device_properties.host_visible_device_memory);
+}
+
 void create_buffer_generic(const sccl_device_t device, sccl_buffer_t *buffer,
                            sccl_buffer_type_t type, size_t size,
                            void **external_ptr, bool *supported);
@@ -5,6 +5,10 @@
 #include "common.hpp"
 #include <gtest/gtest.h>
 #include <stdlib.h>
+#include <string>
+#include <sys/mman.h>
+#include <thread>
+#include <unistd.h>
 
 class buffer_test : public testing::Test
 {
@@ -77,8 +81,218 @@ TEST_F(buffer_test, host_map_buffer)
 
         sccl_host_unmap_buffer(buffer);
 
+        /* ranges outside the buffer are rejected */
+        ASSERT_EQ(sccl_host_map_buffer(buffer, &data_ptr, size, 1),
+                  sccl_invalid_argument);
+        ASSERT_EQ(sccl_host_map_buffer(buffer, &data_ptr, 0x10, size),
+                  sccl_invalid_argument);
+
+        sccl_destroy_buffer(buffer);
+    }
+}
+
+TEST_F(buffer_test, buffer_host_pointer)
+{
+    /* larger than a memory block so it gets a dedicated allocation */
+    for (size_t size : {size_t{0x1000}, size_t{0x4000000}}) {
+        sccl_buffer_t buffer;
+        SCCL_TEST_ASSERT(sccl_create_buffer(
+            device, &buffer, sccl_buffer_type_shared_storage, size));
+
+        uint32_t *host_ptr = nullptr;
+        SCCL_TEST_ASSERT(
+            sccl_get_buffer_host_pointer(buffer, (void **)&host_ptr));
+        ASSERT_NE(host_ptr, nullptr);
+
+        /* threads write disjoint ranges through the persistent mapping */
+        const size_t thread_count = 4;
+        const size_t elements_per_thread =
+            size / sizeof(uint32_t) / thread_count;
+        std::vector<std::thread> threads;
+        for (size_t t = 0; t < thread_count; ++t) {
+            threads.emplace_back([=]() {
+                for (size_t i = 0; i < elements_per_thread; ++i) {
+                    host_ptr[t * elements_per_thread + i] =
+                        static_cast<uint32_t>(t);
+                }
+            });
+        }
+        for (std::thread &thread : threads) {
+            thread.join();
+        }
+
+        /* map returns the same memory */
+        uint32_t *mapped_ptr = nullptr;
+        SCCL_TEST_ASSERT(
+            sccl_host_map_buffer(buffer, (void **)&mapped_ptr, 0, size));
+        for (size_t t = 0; t < thread_count; ++t) {
+            ASSERT_EQ(mapped_ptr[t * elements_per_thread], t);
+        }
+        sccl_host_unmap_buffer(buffer);
+
+        /* pointer is still valid after unmap */
+        host_ptr[0] = 0xffffffff;
+        ASSERT_EQ(host_ptr[0], 0xffffffff);
+
         sccl_destroy_buffer(buffer);
     }
+
+    sccl_buffer_t device_buffer;
+    SCCL_TEST_ASSERT(sccl_create_buffer(device, &device_buffer,
+                                        sccl_buffer_type_device, 0x1000));
+    void *device_ptr = nullptr;
+    ASSERT_EQ(sccl_get_buffer_host_pointer(device_buffer, &device_ptr),
+              sccl_invalid_argument);
+    sccl_destroy_buffer(device_buffer);
+}
+
+TEST_F(buffer_test, flush_invalidate_buffer_range)
+{
+    const size_t size = 0x1000;
+    for (sccl_buffer_type_t type :
+         {sccl_buffer_type_readback_storage, sccl_buffer_type_upload_storage,
+          sccl_buffer_type_readback_uniform, sccl_buffer_type_upload_uniform,
+          sccl_buffer_type_host_storage}) {
+        sccl_buffer_t buffer;
+        SCCL_TEST_ASSERT(sccl_create_buffer(device, &buffer, type, size));
+
+        uint8_t *data = nullptr;
+        SCCL_TEST_ASSERT(sccl_get_buffer_host_pointer(buffer, (void **)&data));
+        memset(data + 3, 0x5a, 7);
+        /* unaligned ranges are expanded internally */
+        SCCL_TEST_ASSERT(sccl_flush_buffer_range(buffer, 3, 7));
+        SCCL_TEST_ASSERT(sccl_invalidate_buffer_range(buffer, 3, 7));
+        ASSERT_EQ(data[3], 0x5a);
+        SCCL_TEST_ASSERT(sccl_flush_buffer_range(buffer, 0, SCCL_WHOLE_SIZE));
+        SCCL_TEST_ASSERT(
+            sccl_invalidate_buffer_range(buffer, size, SCCL_WHOLE_SIZE));
+
+        ASSERT_EQ(sccl_flush_buffer_range(buffer, 0, size + 1),
+                  sccl_invalid_argument);
+        ASSERT_EQ(sccl_invalidate_buffer_range(buffer, size + 1, 1),
+                  sccl_invalid_argument);
+
+        sccl_destroy_buffer(buffer);
+    }
+
+    sccl_buffer_t device_buffer;
+    SCCL_TEST_ASSERT(sccl_create_buffer(device, &device_buffer,
+                                        sccl_buffer_type_device, size));
+    ASSERT_EQ(sccl_flush_buffer_range(device_buffer, 0, size),
+              sccl_invalid_argument);
+    sccl_destroy_buffer(device_buffer);
+}
+
+TEST_F(buffer_test, many_buffers_do_not_overlap)
+{
+    /* buffers are sub-allocated from shared memory blocks, make sure they
+     * never alias each other while buffers are created and destroyed */
+    const size_t buffer_count = 256;
+    const size_t size = 0x3000;
+    std::vector<sccl_buffer_t> buffers(buffer_count);
+    std::vector<uint8_t *> mapped(buffer_count);
+
+    for (size_t round = 0; round < 2; ++round) {
+        for (size_t i = 0; i < buffer_count; ++i) {
+            if (round > 0 && i % 2 == 0) {
+                continue; /* keep even buffers from previous round */
+            }
+            SCCL_TEST_ASSERT(sccl_create_buffer(
+                device, &buffers[i], sccl_buffer_type_host_storage, size));
+            SCCL_TEST_ASSERT(sccl_host_map_buffer(
+                buffers[i], (void **)&mapped[i], 0, size));
+            memset(mapped[i], static_cast<int>(i & 0xff), size);
+        }
+
+        for (size_t i = 0; i < buffer_count; ++i) {
+            for (size_t j = 0; j < size; j += 0x100) {
+                ASSERT_EQ(mapped[i][j], static_cast<uint8_t>(i & 0xff));
+            }
+        }
+
+        /* destroy odd buffers */
+        for (size_t i = 1; i < buffer_count; i += 2) {
+            sccl_host_unmap_buffer(buffers[i]);
+            sccl_destroy_buffer(buffers[i]);
+        }
+    }
+
+    for (size_t i = 0; i < buffer_count; i += 2) {
+        sccl_host_unmap_buffer(buffers[i]);
+        sccl_destroy_buffer(buffers[i]);
+    }
+}
+
+TEST_F(buffer_test, create_large_buffer)
+{
+    /* large buffers get a dedicated allocation */
+    const size_t size = 0x4000000;
+    void *data_ptr = nullptr;
+
+    sccl_buffer_t small_buffer;
+    SCCL_TEST_ASSERT(sccl_create_buffer(device, &small_buffer,
+                                        sccl_buffer_type_host, 0x1000));
+
+    sccl_buffer_t buffer;
+    SCCL_TEST_ASSERT(
+        sccl_create_buffer(device, &buffer, sccl_buffer_type_host, size));
+    SCCL_TEST_ASSERT(sccl_host_map_buffer(buffer, &data_ptr, 0, size));
+    memset(data_ptr, 0xab, size);
+    ASSERT_EQ(static_cast<uint8_t *>(data_ptr)[size - 1], 0xab);
+    sccl_host_unmap_buffer(buffer);
+
+    sccl_destroy_buffer(buffer);
+    sccl_destroy_buffer(small_buffer);
+}
+
+TEST_F(buffer_test, create_buffer_view)
+{
+    const size_t size = 0x4000;
+    sccl_buffer_t buffer;
+    SCCL_TEST_ASSERT(
+        sccl_create_buffer(device, &buffer, sccl_buffer_type_shared, size));
+    const size_t alignment = sccl_get_buffer_min_offset_alignment(buffer);
+
+    /* view of a view */
+    sccl_buffer_t view;
+    sccl_buffer_t nested_view;
+    SCCL_TEST_ASSERT(
+        sccl_create_buffer_view(buffer, alignment, size - alignment, &view));
+    SCCL_TEST_ASSERT(
+        sccl_create_buffer_view(view, alignment, alignment, &nested_view));
+    ASSERT_EQ(sccl_get_buffer_type(nested_view), sccl_buffer_type_shared);
+
+    uint32_t *view_data = nullptr;
+    SCCL_TEST_ASSERT(sccl_host_map_buffer(nested_view, (void **)&view_data, 0,
+                                          sizeof(uint32_t)));
+    *view_data = 0xdeadbeef;
+    sccl_host_unmap_buffer(nested_view);
+
+    uint8_t *data = nullptr;
+    SCCL_TEST_ASSERT(sccl_host_map_buffer(buffer, (void **)&data, 0, size));
+    ASSERT_EQ(*reinterpret_cast<uint32_t *>(data + 2 * alignment), 0xdeadbeef);
+    sccl_host_unmap_buffer(buffer);
+
+    /* invalid views */
+    sccl_buffer_t invalid_view;
+    ASSERT_EQ(sccl_create_buffer_view(buffer, 0, 0, &invalid_view),
+              sccl_invalid_argument);
+    ASSERT_EQ(sccl_create_buffer_view(buffer, 0, size + 1, &invalid_view),
+              sccl_invalid_argument);
+    ASSERT_EQ(sccl_create_buffer_view(view, alignment, size, &invalid_view),
+              sccl_invalid_argument);
+    if (alignment > 1) {
+        ASSERT_EQ(sccl_create_buffer_view(buffer, 1, 1, &invalid_view),
+                  sccl_invalid_argument);
+    }
+    ASSERT_EQ(sccl_create_buffer_view(NULL, 0, size, &invalid_view),
+              sccl_invalid_argument);
+    ASSERT_EQ(sccl_create_buffer_view(buffer, 0, size, NULL),
+              sccl_invalid_argument);
+
+    sccl_destroy_buffer(nested_view);
+    sccl_destroy_buffer(view);
+    sccl_destroy_buffer(buffer);
 }
 
 TEST_F(buffer_test, create_external_host_pointer_buffer)
@@ -117,6 +331,108 @@ TEST_F(buffer_test, create_external_host_pointer_buffer)
     free(data_ptr);
 }
 
+TEST_F(buffer_test, create_host_memory_buffer)
+{
+    sccl_device_properties_t device_properties = {};
+    sccl_get_device_properties(device, &device_properties);
+    EXPECT_GE(device_properties.numa_node, -1);
+
+    /* unaligned size and a size using huge pages */
+    for (size_t size : {size_t{0x1003}, size_t{0x800000}}) {
+        sccl_buffer_t buffer;
+        sccl_error_t error = sccl_create_buffer(
+            device, &buffer, sccl_buffer_type_external_host_pointer_storage,
+            size);
+        if (error == sccl_unsupported_error) {
+            GTEST_SKIP() << "Skipping test, sccl_unsupported_error";
+        }
+        SCCL_TEST_ASSERT(error);
+
+        uint8_t *data_ptr = nullptr;
+        SCCL_TEST_ASSERT(
+            sccl_get_buffer_host_pointer(buffer, (void **)&data_ptr));
+        ASSERT_NE(data_ptr, nullptr);
+        /* memory is zero initialized */
+        ASSERT_EQ(data_ptr[0], 0);
+        ASSERT_EQ(data_ptr[size - 1], 0);
+        memset(data_ptr, 0xab, size);
+
+        sccl_destroy_buffer(buffer);
+    }
+}
+
+TEST_F(buffer_test, create_shm_buffer)
+{
+    /* second buffer on the same region stands in for another process */
+    const size_t size = 0x10003;
+    const std::string name = "/sccl_test_" + std::to_string(getpid());
+    const int memfd = memfd_create("sccl_test", MFD_CLOEXEC);
+    ASSERT_GE(memfd, 0);
+    scope_exit remove_regions([&] {
+        shm_unlink(name.c_str());
+        close(memfd);
+    });
+
+    sccl_stream_t stream;
+    SCCL_TEST_ASSERT(sccl_create_stream(device, &stream));
+    scope_exit destroy_stream([&] { sccl_destroy_stream(stream); });
+    sccl_buffer_t readback_buffer;
+    SCCL_TEST_ASSERT(sccl_create_buffer(device, &readback_buffer,
+                                        sccl_buffer_type_readback_storage,
+                                        size));
+    scope_exit destroy_readback([&] { sccl_destroy_buffer(readback_buffer); });
+
+    for (const bool named : {true, false}) {
+        const char *region_name = named ? name.c_str() : nullptr;
+        const int region_fd = named ? -1 : memfd;
+
+        sccl_buffer_t producer;
+        sccl_error_t error = sccl_create_shm_buffer(device, region_name,
+                                                    region_fd, size, &producer);
+        if (error == sccl_unsupported_error) {
+            GTEST_SKIP() << "Skipping test, sccl_unsupported_error";
+        }
+        SCCL_TEST_ASSERT(error);
+        sccl_buffer_t consumer;
+        SCCL_TEST_ASSERT(sccl_create_shm_buffer(device, region_name, region_fd,
+                                                size, &consumer));
+        ASSERT_EQ(sccl_get_buffer_type(consumer),
+                  sccl_buffer_type_external_host_pointer_storage);
+
+        uint8_t *producer_data = nullptr;
+        uint8_t *consumer_data = nullptr;
+        SCCL_TEST_ASSERT(
+            sccl_get_buffer_host_pointer(producer, (void **)&producer_data));
+        SCCL_TEST_ASSERT(
+            sccl_get_buffer_host_pointer(consumer, (void **)&consumer_data));
+        ASSERT_NE(producer_data, consumer_data);
+        for (size_t i = 0; i < size; ++i) {
+            producer_data[i] = static_cast<uint8_t>(i * 7 + named);
+        }
+        ASSERT_EQ(memcmp(producer_data, consumer_data, size), 0);
+
+        /* the device reads the imported region */
+        SCCL_TEST_ASSERT(
+            sccl_copy_buffer(stream, consumer, 0, readback_buffer, 0, size));
+        SCCL_TEST_ASSERT(sccl_dispatch_stream(stream));
+        SCCL_TEST_ASSERT(sccl_join_stream(stream));
+        void *readback_data = nullptr;
+        SCCL_TEST_ASSERT(
+            sccl_host_map_buffer(readback_buffer, &readback_data, 0, size));
+        ASSERT_EQ(memcmp(readback_data, producer_data, size), 0);
+        sccl_host_unmap_buffer(readback_buffer);
+
+        sccl_destroy_buffer(consumer);
+        sccl_destroy_buffer(producer);
+    }
+
+    sccl_buffer_t buffer;
+    ASSERT_EQ(sccl_create_shm_buffer(device, nullptr, -1, size, &buffer),
+              sccl_invalid_argument);
+    ASSERT_EQ(sccl_create_shm_buffer(device, name.c_str(), -1, 0, &buffer),
+              sccl_invalid_argument);
+}
+
 TEST_F(buffer_test, create_dmabuf_buffer)
 {
     /* dmabuf does not work well inside docker containers atm */
@@ -169,4 +485,170 @@ TEST_F(buffer_test, create_dmabuf_buffer)
     sccl_destroy_buffer(import_buffer);
     close(fd);
     sccl_destroy_buffer(buffer);
-}
\ No newline at end of file
+}
+
+TEST_F(buffer_test, import_dmabuf_buffer_cached)
+{
+    if (get_environment_platform_docker()) {
+        GTEST_SKIP() << "Skipping test, dmabuf can't be tested inside a docker "
+                        "container";
+    }
+
+    sccl_device_properties_t device_properties = {};
+    sccl_get_device_properties(device, &device_properties);
+    const size_t size =
+        device_properties.min_external_buffer_host_pointer_alignment;
+
+    sccl_buffer_t buffer;
+    sccl_error_t error = sccl_create_dmabuf_buffer(
+        device, &buffer, sccl_buffer_type_host_dmabuf_storage, size);
+    if (error == sccl_unsupported_error) {
+        GTEST_SKIP() << "Skipping test, sccl_unsupported_error";
+    }
+    SCCL_TEST_ASSERT(error);
+
+    /* separate descriptors of the same dmabuf share one import */
+    int fds[2];
+    SCCL_TEST_ASSERT(sccl_export_dmabuf_buffer(buffer, &fds[0]));
+    fds[1] = dup(fds[0]);
+    ASSERT_GE(fds[1], 0);
+
+    sccl_memory_usage_t usage_before = {};
+    sccl_get_memory_usage(device, &usage_before);
+
+    sccl_buffer_t imports[3];
+    for (size_t i = 0; i < 3; ++i) {
+        SCCL_TEST_ASSERT(sccl_import_dmabuf_buffer(
+            device, &imports[i], fds[i % 2],
+            sccl_buffer_type_host_dmabuf_storage, size));
+        ASSERT_EQ(imports[i], imports[0]);
+    }
+    sccl_memory_usage_t usage = {};
+    sccl_get_memory_usage(device, &usage);
+    ASSERT_EQ(usage.buffer_count, usage_before.buffer_count + 1);
+
+    /* import stays alive until the last handle is destroyed */
+    sccl_destroy_buffer(imports[0]);
+    sccl_destroy_buffer(imports[1]);
+    void *data_ptr = nullptr;
+    SCCL_TEST_ASSERT(sccl_host_map_buffer(imports[2], &data_ptr, 0, size));
+    sccl_host_unmap_buffer(imports[2]);
+    sccl_destroy_buffer(imports[2]);
+    sccl_get_memory_usage(device, &usage);
+    ASSERT_EQ(usage.buffer_count, usage_before.buffer_count);
+
+    /* a different type is a separate import */
+    sccl_buffer_t import_buffer;
+    SCCL_TEST_ASSERT(sccl_import_dmabuf_buffer(
+        device, &import_buffer, fds[0], sccl_buffer_type_host_dmabuf_storage,
+        size));
+    sccl_buffer_t uniform_import;
+    SCCL_TEST_ASSERT(sccl_import_dmabuf_buffer(
+        device, &uniform_import, fds[1], sccl_buffer_type_host_dmabuf_uniform,
+        size));
+    ASSERT_NE(uniform_import, import_buffer);
+    sccl_destroy_buffer(uniform_import);
+    sccl_destroy_buffer(import_buffer);
+
+    close(fds[1]);
+    close(fds[0]);
+    sccl_destroy_buffer(buffer);
+}
+
+TEST_F(buffer_test, buffer_pool)
+{
+    sccl_buffer_pool_t pool;
+    SCCL_TEST_ASSERT(sccl_create_buffer_pool(device, &pool, 0x100000));
+
+    /* sizes in the same size class share buffers */
+    sccl_buffer_t buffer;
+    SCCL_TEST_ASSERT(sccl_buffer_pool_acquire(
+        pool, &buffer, sccl_buffer_type_device_storage, 1000));
+    SCCL_TEST_ASSERT(sccl_buffer_pool_release(pool, buffer, nullptr, 0));
+    sccl_buffer_t recycled;
+    SCCL_TEST_ASSERT(sccl_buffer_pool_acquire(
+        pool, &recycled, sccl_buffer_type_device_storage, 3000));
+    ASSERT_EQ(recycled, buffer);
+
+    /* buffer used by a stream is idle after the stream is joined */
+    sccl_stream_t stream;
+    SCCL_TEST_ASSERT(sccl_create_stream(device, &stream));
+    sccl_buffer_t other;
+    SCCL_TEST_ASSERT(sccl_buffer_pool_acquire(
+        pool, &other, sccl_buffer_type_device_storage, 4096));
+    SCCL_TEST_ASSERT(sccl_copy_buffer(stream, recycled, 0, other, 0, 4096));
+    SCCL_TEST_ASSERT(sccl_buffer_pool_release(pool, recycled, &stream, 1));
+    SCCL_TEST_ASSERT(sccl_buffer_pool_release(pool, other, &stream, 1));
+    sccl_memory_usage_t usage = {};
+    sccl_get_memory_usage(device, &usage);
+    ASSERT_EQ(usage.buffer_count, 2u);
+    SCCL_TEST_ASSERT(sccl_dispatch_stream(stream));
+    SCCL_TEST_ASSERT(sccl_join_stream(stream));
+    SCCL_TEST_ASSERT(sccl_buffer_pool_acquire(
+        pool, &buffer, sccl_buffer_type_device_storage, 4096));
+    ASSERT_TRUE(buffer == recycled || buffer == other);
+    sccl_get_memory_usage(device, &usage);
+    ASSERT_EQ(usage.buffer_count, 2u);
+    SCCL_TEST_ASSERT(sccl_buffer_pool_release(pool, buffer, nullptr, 0));
+    sccl_destroy_stream(stream);
+
+    /* idle buffers are destroyed with the pool */
+    sccl_destroy_buffer_pool(pool);
+    sccl_get_memory_usage(device, &usage);
+    ASSERT_EQ(usage.buffer_count, 0u);
+
+    /* no idle memory allowed */
+    SCCL_TEST_ASSERT(sccl_create_buffer_pool(device, &pool, 0));
+    SCCL_TEST_ASSERT(sccl_buffer_pool_acquire(
+        pool, &buffer, sccl_buffer_type_host_storage, 0x10000));
+    SCCL_TEST_ASSERT(sccl_buffer_pool_release(pool, buffer, nullptr, 0));
+    sccl_get_memory_usage(device, &usage);
+    ASSERT_EQ(usage.buffer_count, 0u);
+
+    /* buffers not acquired from the pool are rejected, also if their size is a
+     * size class */
+    SCCL_TEST_ASSERT(sccl_create_buffer(device, &buffer,
+                                        sccl_buffer_type_device_storage, 4096));
+    ASSERT_EQ(sccl_buffer_pool_release(pool, buffer, nullptr, 0),
+              sccl_invalid_argument);
+    sccl_buffer_pool_t other_pool;
+    SCCL_TEST_ASSERT(sccl_create_buffer_pool(device, &other_pool, 0));
+    SCCL_TEST_ASSERT(sccl_buffer_pool_acquire(
+        other_pool, &other, sccl_buffer_type_device_storage, 4096));
+    ASSERT_EQ(sccl_buffer_pool_release(pool, other, nullptr, 0),
+              sccl_invalid_argument);
+    SCCL_TEST_ASSERT(sccl_buffer_pool_release(other_pool, other, nullptr, 0));
+    sccl_destroy_buffer_pool(other_pool);
+    sccl_destroy_buffer(buffer);
+    sccl_destroy_buffer_pool(pool);
+}
+
+TEST_F(buffer_test, buffer_pool_pending_release)
+{
+    sccl_buffer_pool_t pool;
+    SCCL_TEST_ASSERT(sccl_create_buffer_pool(device, &pool, 0x100000));
+    sccl_stream_t stream;
+    SCCL_TEST_ASSERT(sccl_create_stream(device, &stream));
+
+    sccl_buffer_t buffer;
+    sccl_buffer_t other;
+    SCCL_TEST_ASSERT(sccl_buffer_pool_acquire(
+        pool, &buffer, sccl_buffer_type_device_storage, 4096));
+    SCCL_TEST_ASSERT(sccl_buffer_pool_acquire(
+        pool, &other, sccl_buffer_type_device_storage, 4096));
+    SCCL_TEST_ASSERT(sccl_copy_buffer(stream, buffer, 0, other, 0, 4096));
+    SCCL_TEST_ASSERT(sccl_buffer_pool_release(pool, buffer, &stream, 1));
+    SCCL_TEST_ASSERT(sccl_dispatch_stream(stream));
+
+    /* the stream was not reset yet, so the buffer is not handed out again */
+    sccl_buffer_t acquired;
+    SCCL_TEST_ASSERT(sccl_buffer_pool_acquire(
+        pool, &acquired, sccl_buffer_type_device_storage, 4096));
+    ASSERT_NE(acquired, buffer);
+    SCCL_TEST_ASSERT(sccl_buffer_pool_release(pool, acquired, nullptr, 0));
+
+    SCCL_TEST_ASSERT(sccl_join_stream(stream));
+    SCCL_TEST_ASSERT(sccl_buffer_pool_release(pool, other, nullptr, 0));
+    sccl_destroy_stream(stream);
+    sccl_destroy_buffer_pool(pool);
+}
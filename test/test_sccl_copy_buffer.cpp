@@ -3,7 +3,11 @@
 #include <sccl.h>
 
 #include "common.hpp"
+#include <errno.h>
+#include <fcntl.h>
 #include <gtest/gtest.h>
+#include <stdlib.h>
+#include <unistd.h>
 
 class copy_buffer_test : public testing::Test
 {
@@ -40,6 +44,9 @@ protected:
 
     void buffer_write_read_test(sccl_buffer_type_t source_type,
                                 sccl_buffer_type_t target_type);
+    void auto_buffers_test();
+    void mirrored_buffer_test(bool staged);
+    void read_write_file_test();
 };
 
 void copy_buffer_test::buffer_write_read_test(sccl_buffer_type_t source_type,
@@ -88,6 +95,9 @@ void copy_buffer_test::buffer_write_read_test(sccl_buffer_type_t source_type,
                      test_data.data(), test_data_byte_size),
               0);
     sccl_host_unmap_buffer(source_buffer);
+    /* memory may not be host coherent */
+    SCCL_TEST_ASSERT(sccl_flush_buffer_range(source_buffer, 0,
+                                             source_buffer_size));
 
     /* copy to device */
     SCCL_TEST_ASSERT(sccl_copy_buffer(stream, source_buffer, 0, target_buffer,
@@ -101,6 +111,8 @@ void copy_buffer_test::buffer_write_read_test(sccl_buffer_type_t source_type,
     SCCL_TEST_ASSERT(sccl_join_stream(stream));
 
     /* map host buffer at offset and check data */
+    SCCL_TEST_ASSERT(sccl_invalidate_buffer_range(
+        source_buffer, test_data_byte_size, test_data_byte_size));
     SCCL_TEST_ASSERT(sccl_host_map_buffer(source_buffer, &host_data_ptr,
                                           test_data_byte_size,
                                           test_data_byte_size));
@@ -127,14 +139,739 @@ TEST_F(copy_buffer_test, all_valid_permutations)
          {sccl_buffer_type_host_storage, sccl_buffer_type_shared_storage,
           sccl_buffer_type_host_uniform, sccl_buffer_type_shared_uniform,
           sccl_buffer_type_external_host_pointer_storage,
-          sccl_buffer_type_external_host_pointer_uniform}) {
+          sccl_buffer_type_external_host_pointer_uniform,
+          sccl_buffer_type_readback_storage, sccl_buffer_type_upload_storage,
+          sccl_buffer_type_readback_uniform, sccl_buffer_type_upload_uniform}) {
         for (sccl_buffer_type_t dst_type :
              {sccl_buffer_type_host_storage, sccl_buffer_type_shared_storage,
               sccl_buffer_type_host_uniform, sccl_buffer_type_shared_uniform,
               sccl_buffer_type_device_storage, sccl_buffer_type_device_uniform,
               sccl_buffer_type_external_host_pointer_storage,
-              sccl_buffer_type_external_host_pointer_uniform}) {
+              sccl_buffer_type_external_host_pointer_uniform,
+              sccl_buffer_type_readback_storage,
+              sccl_buffer_type_upload_storage,
+              sccl_buffer_type_readback_uniform,
+              sccl_buffer_type_upload_uniform,
+              sccl_buffer_type_auto_storage,
+              sccl_buffer_type_managed_storage}) {
             buffer_write_read_test(src_type, dst_type);
         }
     }
 }
+
+TEST_F(copy_buffer_test, all_valid_permutations_staged)
+{
+    /* buffers that migrate through a staging buffer */
+    ASSERT_NO_FATAL_FAILURE(use_staged_device(instance, &device, &stream));
+    for (sccl_buffer_type_t src_type :
+         {sccl_buffer_type_host_storage, sccl_buffer_type_upload_storage}) {
+        for (sccl_buffer_type_t dst_type : {sccl_buffer_type_auto_storage,
+                                            sccl_buffer_type_managed_storage}) {
+            buffer_write_read_test(src_type, dst_type);
+        }
+    }
+}
+
+TEST_F(copy_buffer_test, copy_buffer_views)
+{
+    /* carve two slices out of one arena and copy between them */
+    sccl_buffer_t arena;
+    const size_t alignment = 0x1000;
+    const size_t slice_offset = alignment;
+    SCCL_TEST_ASSERT(sccl_create_buffer(
+        device, &arena, sccl_buffer_type_host_storage,
+        slice_offset + test_data_byte_size * 2));
+    ASSERT_EQ(alignment % sccl_get_buffer_min_offset_alignment(arena), 0u);
+
+    sccl_buffer_t source_view;
+    sccl_buffer_t target_view;
+    SCCL_TEST_ASSERT(sccl_create_buffer_view(arena, 0, test_data_byte_size,
+                                             &source_view));
+    SCCL_TEST_ASSERT(sccl_create_buffer_view(arena, slice_offset,
+                                             test_data_byte_size * 2,
+                                             &target_view));
+
+    void *host_data_ptr;
+    SCCL_TEST_ASSERT(sccl_host_map_buffer(source_view, &host_data_ptr, 0,
+                                          test_data_byte_size));
+    memcpy(host_data_ptr, test_data.data(), test_data_byte_size);
+    sccl_host_unmap_buffer(source_view);
+
+    /* offsets are relative to views */
+    SCCL_TEST_ASSERT(sccl_copy_buffer(stream, source_view, 0, target_view,
+                                      test_data_byte_size,
+                                      test_data_byte_size));
+    SCCL_TEST_ASSERT(sccl_dispatch_stream(stream));
+    SCCL_TEST_ASSERT(sccl_join_stream(stream));
+
+    /* check through parent */
+    SCCL_TEST_ASSERT(sccl_host_map_buffer(
+        arena, &host_data_ptr, slice_offset + test_data_byte_size,
+        test_data_byte_size));
+    ASSERT_EQ(memcmp(host_data_ptr, test_data.data(), test_data_byte_size), 0);
+    sccl_host_unmap_buffer(arena);
+
+    sccl_destroy_buffer(target_view);
+    sccl_destroy_buffer(source_view);
+    sccl_destroy_buffer(arena);
+}
+
+void copy_buffer_test::auto_buffers_test()
+{
+    /* same code works whether auto buffers are mapped or staged */
+    sccl_buffer_t source_buffer;
+    sccl_buffer_t target_buffer;
+    SCCL_TEST_ASSERT(sccl_create_buffer(device, &source_buffer,
+                                        sccl_buffer_type_auto_storage,
+                                        test_data_byte_size));
+    SCCL_TEST_ASSERT(sccl_create_buffer(device, &target_buffer,
+                                        sccl_buffer_type_auto_storage,
+                                        test_data_byte_size * 2));
+
+    /* write second half of target through a view */
+    sccl_buffer_t target_view;
+    SCCL_TEST_ASSERT(sccl_create_buffer_view(target_buffer,
+                                             test_data_byte_size,
+                                             test_data_byte_size,
+                                             &target_view));
+
+    void *source_ptr;
+    SCCL_TEST_ASSERT(sccl_get_buffer_host_pointer(source_buffer, &source_ptr));
+    memcpy(source_ptr, test_data.data(), test_data_byte_size);
+    SCCL_TEST_ASSERT(sccl_sync_buffer_to_device(stream, source_buffer, 0,
+                                                SCCL_WHOLE_SIZE));
+    SCCL_TEST_ASSERT(sccl_copy_buffer(stream, source_buffer, 0, target_view, 0,
+                                      test_data_byte_size));
+    SCCL_TEST_ASSERT(sccl_sync_buffer_to_host(stream, target_view, 0,
+                                              SCCL_WHOLE_SIZE));
+    SCCL_TEST_ASSERT(sccl_dispatch_stream(stream));
+    SCCL_TEST_ASSERT(sccl_join_stream(stream));
+
+    void *target_ptr;
+    SCCL_TEST_ASSERT(sccl_get_buffer_host_pointer(target_view, &target_ptr));
+    ASSERT_EQ(memcmp(target_ptr, test_data.data(), test_data_byte_size), 0);
+    void *target_root_ptr;
+    SCCL_TEST_ASSERT(
+        sccl_get_buffer_host_pointer(target_buffer, &target_root_ptr));
+    ASSERT_EQ(static_cast<char *>(target_root_ptr) + test_data_byte_size,
+              target_ptr);
+
+    ASSERT_EQ(sccl_sync_buffer_to_device(stream, target_view, 1,
+                                         test_data_byte_size),
+              sccl_invalid_argument);
+
+    sccl_destroy_buffer(target_view);
+    sccl_destroy_buffer(target_buffer);
+    sccl_destroy_buffer(source_buffer);
+}
+
+TEST_F(copy_buffer_test, copy_auto_buffers) { auto_buffers_test(); }
+
+TEST_F(copy_buffer_test, copy_auto_buffers_staged)
+{
+    ASSERT_NO_FATAL_FAILURE(use_staged_device(instance, &device, &stream));
+    auto_buffers_test();
+}
+
+TEST_F(copy_buffer_test, copy_buffer_regions)
+{
+    sccl_buffer_t source_buffer;
+    sccl_buffer_t target_buffer;
+    SCCL_TEST_ASSERT(sccl_create_buffer(device, &source_buffer,
+                                        sccl_buffer_type_host_storage,
+                                        test_data_byte_size));
+    SCCL_TEST_ASSERT(sccl_create_buffer(device, &target_buffer,
+                                        sccl_buffer_type_host_storage,
+                                        test_data_byte_size));
+
+    void *source_ptr;
+    void *target_ptr;
+    SCCL_TEST_ASSERT(sccl_host_map_buffer(source_buffer, &source_ptr, 0,
+                                          test_data_byte_size));
+    SCCL_TEST_ASSERT(sccl_host_map_buffer(target_buffer, &target_ptr, 0,
+                                          test_data_byte_size));
+    memcpy(source_ptr, test_data.data(), test_data_byte_size);
+    memset(target_ptr, 0, test_data_byte_size);
+
+    /* swap the two halves */
+    const size_t half = test_data_byte_size / 2;
+    sccl_buffer_copy_region_t regions[2] = {{0, half, half}, {half, 0, half}};
+    SCCL_TEST_ASSERT(sccl_copy_buffer_regions(stream, source_buffer,
+                                              target_buffer, regions, 2));
+    SCCL_TEST_ASSERT(sccl_dispatch_stream(stream));
+    SCCL_TEST_ASSERT(sccl_join_stream(stream));
+
+    ASSERT_EQ(memcmp(static_cast<char *>(target_ptr) + half, test_data.data(),
+                     half),
+              0);
+    ASSERT_EQ(memcmp(target_ptr,
+                     reinterpret_cast<char *>(test_data.data()) + half, half),
+              0);
+
+    sccl_buffer_copy_region_t out_of_range = {half + 1, 0, half};
+    ASSERT_EQ(sccl_copy_buffer_regions(stream, source_buffer, target_buffer,
+                                       &out_of_range, 1),
+              sccl_invalid_argument);
+
+    sccl_host_unmap_buffer(source_buffer);
+    sccl_host_unmap_buffer(target_buffer);
+    sccl_destroy_buffer(target_buffer);
+    sccl_destroy_buffer(source_buffer);
+}
+
+/* `staged` if the device copy is not host visible, so only dirty pages reach
+ * the device */
+void copy_buffer_test::mirrored_buffer_test(bool staged)
+{
+    const size_t page_size = SCCL_MIRRORED_BUFFER_PAGE_SIZE;
+    const size_t size = 16 * page_size;
+    sccl_buffer_t mirrored_buffer;
+    sccl_buffer_t readback_buffer;
+    SCCL_TEST_ASSERT(
+        sccl_create_mirrored_buffer(device, &mirrored_buffer, size));
+    SCCL_TEST_ASSERT(sccl_create_buffer(device, &readback_buffer,
+                                        sccl_buffer_type_readback_storage,
+                                        size));
+
+    void *mirror_ptr;
+    void *readback_ptr;
+    SCCL_TEST_ASSERT(
+        sccl_get_buffer_host_pointer(mirrored_buffer, &mirror_ptr));
+    SCCL_TEST_ASSERT(
+        sccl_host_map_buffer(readback_buffer, &readback_ptr, 0, size));
+    char *mirror = static_cast<char *>(mirror_ptr);
+
+    auto sync_and_read_back = [&]() {
+        SCCL_TEST_ASSERT(sccl_sync_dirty_to_device(stream, mirrored_buffer));
+        SCCL_TEST_ASSERT(sccl_copy_buffer(stream, mirrored_buffer, 0,
+                                          readback_buffer, 0, size));
+        SCCL_TEST_ASSERT(sccl_dispatch_stream(stream));
+        SCCL_TEST_ASSERT(sccl_join_stream(stream));
+        SCCL_TEST_ASSERT(sccl_invalidate_buffer_range(readback_buffer, 0,
+                                                      SCCL_WHOLE_SIZE));
+    };
+
+    /* initial upload of everything */
+    memset(mirror, 0x11, size);
+    SCCL_TEST_ASSERT(
+        sccl_mark_buffer_dirty(mirrored_buffer, 0, SCCL_WHOLE_SIZE));
+    sync_and_read_back();
+    ASSERT_EQ(memcmp(readback_ptr, mirror, size), 0);
+
+    /* partial writes, marked ranges do not need to be page aligned */
+    memset(mirror + 3 * page_size + 10, 0x22, 5);
+    SCCL_TEST_ASSERT(
+        sccl_mark_buffer_dirty(mirrored_buffer, 3 * page_size + 10, 5));
+    memset(mirror + 7 * page_size - 1, 0x33, page_size + 2);
+    SCCL_TEST_ASSERT(sccl_mark_buffer_dirty(
+        mirrored_buffer, 7 * page_size - 1, page_size + 2));
+    memset(mirror + size - 1, 0x44, 1);
+    SCCL_TEST_ASSERT(sccl_mark_buffer_dirty(mirrored_buffer, size - 1, 1));
+    sync_and_read_back();
+    ASSERT_EQ(memcmp(readback_ptr, mirror, size), 0);
+
+    /* nothing dirty */
+    sync_and_read_back();
+    ASSERT_EQ(memcmp(readback_ptr, mirror, size), 0);
+
+    /* writes that are not marked are not uploaded */
+    memset(mirror + 5 * page_size, 0x55, page_size);
+    sync_and_read_back();
+    if (staged) {
+        ASSERT_EQ(static_cast<char *>(readback_ptr)[5 * page_size], 0x11);
+    }
+    SCCL_TEST_ASSERT(
+        sccl_mark_buffer_dirty(mirrored_buffer, 5 * page_size, page_size));
+    sync_and_read_back();
+    ASSERT_EQ(memcmp(readback_ptr, mirror, size), 0);
+
+    ASSERT_EQ(sccl_mark_buffer_dirty(mirrored_buffer, size, 1),
+              sccl_invalid_argument);
+
+    sccl_host_unmap_buffer(readback_buffer);
+    sccl_destroy_buffer(readback_buffer);
+    sccl_destroy_buffer(mirrored_buffer);
+}
+
+TEST_F(copy_buffer_test, mirrored_buffer_sync_dirty)
+{
+    sccl_device_properties_t device_properties = {};
+    sccl_get_device_properties(device, &device_properties);
+    mirrored_buffer_test(!device_properties.host_visible_device_memory);
+}
+
+TEST_F(copy_buffer_test, mirrored_buffer_sync_dirty_staged)
+{
+    ASSERT_NO_FATAL_FAILURE(use_staged_device(instance, &device, &stream));
+    mirrored_buffer_test(true);
+}
+
+TEST_F(copy_buffer_test, upload_download)
+{
+    sccl_buffer_t device_buffer;
+    SCCL_TEST_ASSERT(sccl_create_buffer(device, &device_buffer,
+                                        sccl_buffer_type_device_storage,
+                                        test_data_byte_size * 2));
+
+    /* staging ring wraps around over many iterations */
+    std::vector<uint32_t> output(test_data_size);
+    for (uint32_t iteration = 0; iteration < 0x1000; ++iteration) {
+        for (size_t i = 0; i < test_data_size; ++i) {
+            test_data[i] = iteration + static_cast<uint32_t>(i);
+        }
+        SCCL_TEST_ASSERT(sccl_upload(stream, device_buffer,
+                                     test_data_byte_size, test_data.data(),
+                                     test_data_byte_size));
+        /* host data is copied immediately */
+        std::fill(test_data.begin(), test_data.end(), 0);
+        SCCL_TEST_ASSERT(sccl_download(stream, device_buffer,
+                                       test_data_byte_size, output.data(),
+                                       test_data_byte_size));
+        SCCL_TEST_ASSERT(sccl_dispatch_stream(stream));
+        SCCL_TEST_ASSERT(sccl_join_stream(stream));
+        ASSERT_EQ(output[0], iteration);
+        ASSERT_EQ(output[test_data_size - 1],
+                  iteration + test_data_size - 1);
+    }
+
+    ASSERT_EQ(sccl_upload(stream, device_buffer, 1, test_data.data(),
+                          test_data_byte_size * 2),
+              sccl_invalid_argument);
+    ASSERT_EQ(sccl_download(stream, device_buffer, test_data_byte_size * 2 + 1,
+                            output.data(), 0),
+              sccl_invalid_argument);
+
+    sccl_destroy_buffer(device_buffer);
+}
+
+TEST_F(copy_buffer_test, upload_download_long_lived_stream)
+{
+    sccl_buffer_t device_buffer;
+    SCCL_TEST_ASSERT(sccl_create_buffer(device, &device_buffer,
+                                        sccl_buffer_type_device_storage,
+                                        test_data_byte_size * 2));
+    SCCL_TEST_ASSERT(sccl_upload(stream, device_buffer, 0, test_data.data(),
+                                 test_data_byte_size));
+    SCCL_TEST_ASSERT(sccl_dispatch_stream(stream));
+    SCCL_TEST_ASSERT(sccl_join_stream(stream));
+
+    /* download staging of this stream stays in the ring until it is reset */
+    sccl_stream_t long_lived_stream;
+    SCCL_TEST_ASSERT(sccl_create_stream(device, &long_lived_stream));
+    std::vector<uint32_t> long_lived_output(test_data_size);
+    SCCL_TEST_ASSERT(sccl_download(long_lived_stream, device_buffer, 0,
+                                   long_lived_output.data(),
+                                   test_data_byte_size));
+    SCCL_TEST_ASSERT(sccl_dispatch_stream(long_lived_stream));
+
+    /* other transfers wrap around the ring many times meanwhile, and must not
+     * overwrite the region still owned by the long lived stream */
+    std::vector<uint32_t> input(test_data_size);
+    std::vector<uint32_t> output(test_data_size);
+    for (uint32_t iteration = 0; iteration < 0x1000; ++iteration) {
+        std::fill(input.begin(), input.end(), iteration);
+        SCCL_TEST_ASSERT(sccl_upload(stream, device_buffer,
+                                     test_data_byte_size, input.data(),
+                                     test_data_byte_size));
+        SCCL_TEST_ASSERT(sccl_download(stream, device_buffer,
+                                       test_data_byte_size, output.data(),
+                                       test_data_byte_size));
+        SCCL_TEST_ASSERT(sccl_dispatch_stream(stream));
+        /* reset waits for the dispatched commands */
+        SCCL_TEST_ASSERT(sccl_reset_stream(stream));
+        ASSERT_EQ(output, input);
+    }
+
+    SCCL_TEST_ASSERT(sccl_join_stream(long_lived_stream));
+    ASSERT_EQ(long_lived_output, test_data);
+
+    sccl_destroy_stream(long_lived_stream);
+    sccl_destroy_buffer(device_buffer);
+}
+
+TEST_F(copy_buffer_test, upload_download_larger_than_staging_ring)
+{
+    /* falls back to temporary staging buffers */
+    const size_t size = 64 << 20;
+    std::vector<uint8_t> input(size);
+    std::vector<uint8_t> output(size);
+    for (size_t i = 0; i < size; ++i) {
+        input[i] = static_cast<uint8_t>(i * 7);
+    }
+
+    sccl_buffer_t device_buffer;
+    SCCL_TEST_ASSERT(sccl_create_buffer(device, &device_buffer,
+                                        sccl_buffer_type_device_storage, size));
+    SCCL_TEST_ASSERT(
+        sccl_upload(stream, device_buffer, 0, input.data(), size));
+    SCCL_TEST_ASSERT(
+        sccl_download(stream, device_buffer, 0, output.data(), size));
+    SCCL_TEST_ASSERT(sccl_dispatch_stream(stream));
+    SCCL_TEST_ASSERT(sccl_join_stream(stream));
+    ASSERT_EQ(input, output);
+
+    sccl_destroy_buffer(device_buffer);
+}
+
+TEST_F(copy_buffer_test, wrap_unaligned_host_memory)
+{
+    /* odd offset and size, copied through a device buffer */
+    const size_t offset = 3;
+    const size_t size = test_data_byte_size + 5;
+    const size_t trailing = 7;
+    std::vector<uint8_t> input(offset + size + trailing);
+    std::vector<uint8_t> output(offset + size + trailing, 0);
+    for (size_t i = 0; i < input.size(); ++i) {
+        input[i] = static_cast<uint8_t>(i * 13);
+    }
+
+    sccl_buffer_t input_buffer;
+    sccl_buffer_t output_buffer;
+    sccl_buffer_t device_buffer;
+    SCCL_TEST_ASSERT(sccl_wrap_host_memory(
+        device, &input_buffer, sccl_buffer_type_external_host_pointer_storage,
+        input.data() + offset, size));
+    SCCL_TEST_ASSERT(sccl_wrap_host_memory(
+        device, &output_buffer, sccl_buffer_type_external_host_pointer_storage,
+        output.data() + offset, size));
+    SCCL_TEST_ASSERT(sccl_create_buffer(device, &device_buffer,
+                                        sccl_buffer_type_device_storage, size));
+
+    SCCL_TEST_ASSERT(sccl_sync_buffer_to_device(stream, input_buffer, 0,
+                                                SCCL_WHOLE_SIZE));
+    SCCL_TEST_ASSERT(
+        sccl_copy_buffer(stream, input_buffer, 0, device_buffer, 0, size));
+    SCCL_TEST_ASSERT(
+        sccl_copy_buffer(stream, device_buffer, 0, output_buffer, 0, size));
+    SCCL_TEST_ASSERT(sccl_sync_buffer_to_host(stream, output_buffer, 0,
+                                              SCCL_WHOLE_SIZE));
+    SCCL_TEST_ASSERT(sccl_dispatch_stream(stream));
+    SCCL_TEST_ASSERT(sccl_join_stream(stream));
+
+    /* bytes around the wrapped range are untouched */
+    for (size_t i = 0; i < offset; ++i) {
+        ASSERT_EQ(output[i], 0);
+    }
+    for (size_t i = offset + size; i < output.size(); ++i) {
+        ASSERT_EQ(output[i], 0);
+    }
+    ASSERT_EQ(memcmp(output.data() + offset, input.data() + offset, size), 0);
+
+    sccl_destroy_buffer(device_buffer);
+    sccl_destroy_buffer(output_buffer);
+    sccl_destroy_buffer(input_buffer);
+
+    sccl_buffer_t invalid_buffer;
+    ASSERT_EQ(sccl_wrap_host_memory(device, &invalid_buffer,
+                                    sccl_buffer_type_host_storage,
+                                    input.data(), size),
+              sccl_invalid_argument);
+}
+
+TEST_F(copy_buffer_test, create_buffer_from_file)
+{
+    const size_t file_size = test_data_byte_size + 0x1000;
+    std::vector<uint8_t> file_data(file_size);
+    for (size_t i = 0; i < file_data.size(); ++i) {
+        file_data[i] = static_cast<uint8_t>(i * 7);
+    }
+
+    char path[] = "/tmp/sccl_test_XXXXXX";
+    const int fd = mkstemp(path);
+    ASSERT_GE(fd, 0);
+    scope_exit remove_file([&] { unlink(path); });
+    const ssize_t written = write(fd, file_data.data(), file_size);
+    close(fd);
+    ASSERT_EQ(written, static_cast<ssize_t>(file_size));
+
+    /* unaligned range not reaching the end of file */
+    const size_t offset = 0x1003;
+    const size_t size = test_data_byte_size - 9;
+    std::vector<uint8_t> output(size, 0);
+
+    sccl_buffer_t file_buffer;
+    sccl_buffer_t device_buffer;
+    SCCL_TEST_ASSERT(
+        sccl_create_buffer_from_file(device, path, offset, size, &file_buffer));
+    SCCL_TEST_ASSERT(sccl_create_buffer(device, &device_buffer,
+                                        sccl_buffer_type_device_storage, size));
+
+    SCCL_TEST_ASSERT(
+        sccl_copy_buffer(stream, file_buffer, 0, device_buffer, 0, size));
+    SCCL_TEST_ASSERT(
+        sccl_download(stream, device_buffer, 0, output.data(), size));
+    SCCL_TEST_ASSERT(sccl_dispatch_stream(stream));
+    SCCL_TEST_ASSERT(sccl_join_stream(stream));
+    ASSERT_EQ(memcmp(output.data(), file_data.data() + offset, size), 0);
+
+    sccl_destroy_buffer(device_buffer);
+    sccl_destroy_buffer(file_buffer);
+
+    sccl_buffer_t invalid_buffer;
+    ASSERT_EQ(sccl_create_buffer_from_file(device, path, file_size - 1, 2,
+                                           &invalid_buffer),
+              sccl_invalid_argument);
+    unlink(path);
+    ASSERT_EQ(sccl_create_buffer_from_file(device, path, 0, 1, &invalid_buffer),
+              sccl_system_error);
+}
+
+void copy_buffer_test::read_write_file_test()
+{
+    /* several io chunks and an unaligned tail */
+    const size_t size = (3 << 20) + 0x123;
+    std::vector<uint8_t> file_data(size);
+    for (size_t i = 0; i < size; ++i) {
+        file_data[i] = static_cast<uint8_t>(i * 7 + i / 4096);
+    }
+
+    char path[] = "/tmp/sccl_test_XXXXXX";
+    const int fd = mkstemp(path);
+    ASSERT_GE(fd, 0);
+    unlink(path);
+    ASSERT_EQ(write(fd, file_data.data(), size), static_cast<ssize_t>(size));
+
+    sccl_buffer_t upload_buffer;
+    sccl_buffer_t device_buffer;
+    sccl_buffer_t readback_buffer;
+    SCCL_TEST_ASSERT(sccl_create_buffer(device, &upload_buffer,
+                                        sccl_buffer_type_upload_storage,
+                                        size + 0x10));
+    SCCL_TEST_ASSERT(sccl_create_buffer(device, &device_buffer,
+                                        sccl_buffer_type_device_storage, size));
+    SCCL_TEST_ASSERT(sccl_create_buffer(device, &readback_buffer,
+                                        sccl_buffer_type_readback_storage,
+                                        size));
+
+    /* file to device and back to the file behind the original data, the
+     * copy only runs once the read has landed */
+    SCCL_TEST_ASSERT(
+        sccl_read_file_into_buffer(stream, fd, 0, upload_buffer, 0x10, size));
+    SCCL_TEST_ASSERT(
+        sccl_copy_buffer(stream, upload_buffer, 0x10, device_buffer, 0, size));
+    SCCL_TEST_ASSERT(
+        sccl_copy_buffer(stream, device_buffer, 0, readback_buffer, 0, size));
+    SCCL_TEST_ASSERT(
+        sccl_write_buffer_to_file(stream, readback_buffer, 0, fd, size, size));
+    SCCL_TEST_ASSERT(sccl_dispatch_stream(stream));
+    SCCL_TEST_ASSERT(sccl_join_stream(stream));
+
+    std::vector<uint8_t> output(size, 0);
+    ASSERT_EQ(pread(fd, output.data(), size, static_cast<off_t>(size)),
+              static_cast<ssize_t>(size));
+    ASSERT_EQ(output, file_data);
+
+    /* reading past the end of the file fails when the stream is dispatched */
+    SCCL_TEST_ASSERT(sccl_read_file_into_buffer(stream, fd, size * 2 - 1,
+                                                upload_buffer, 0, 2));
+    ASSERT_EQ(sccl_dispatch_stream(stream), sccl_system_error);
+    SCCL_TEST_ASSERT(sccl_reset_stream(stream));
+
+    ASSERT_EQ(
+        sccl_read_file_into_buffer(stream, fd, 0, device_buffer, 0, size),
+        sccl_invalid_argument);
+    ASSERT_EQ(
+        sccl_read_file_into_buffer(stream, fd, 0, upload_buffer, 0x11, size),
+        sccl_invalid_argument);
+    ASSERT_EQ(sccl_write_buffer_to_file(stream, readback_buffer, 1, fd, 0,
+                                        size),
+              sccl_invalid_argument);
+
+    close(fd);
+    sccl_destroy_buffer(readback_buffer);
+    sccl_destroy_buffer(device_buffer);
+    sccl_destroy_buffer(upload_buffer);
+}
+
+/* io_uring if the kernel allows it */
+TEST_F(copy_buffer_test, read_write_file) { read_write_file_test(); }
+
+TEST_F(copy_buffer_test, read_write_file_without_io_uring)
+{
+    /* the fallback is chosen when the device is created */
+    sccl_device_t pread_device;
+    setenv(SCCL_DISABLE_IO_URING, "1", 1);
+    const sccl_error_t error = sccl_create_device(instance, &pread_device,
+                                                  get_environment_gpu_index());
+    unsetenv(SCCL_DISABLE_IO_URING);
+    SCCL_TEST_ASSERT(error);
+    sccl_stream_t pread_stream;
+    SCCL_TEST_ASSERT(sccl_create_stream(pread_device, &pread_stream));
+    sccl_destroy_stream(stream);
+    sccl_destroy_device(device);
+    device = pread_device;
+    stream = pread_stream;
+
+    read_write_file_test();
+}
+
+TEST_F(copy_buffer_test, read_write_file_staged_buffers)
+{
+    /* the host copy is not what the device uses */
+    ASSERT_NO_FATAL_FAILURE(use_staged_device(instance, &device, &stream));
+    const size_t size = 0x1000;
+    sccl_buffer_t managed_buffer;
+    sccl_buffer_t auto_buffer;
+    SCCL_TEST_ASSERT(sccl_create_buffer(device, &managed_buffer,
+                                        sccl_buffer_type_managed_storage,
+                                        size));
+    SCCL_TEST_ASSERT(sccl_create_buffer(device, &auto_buffer,
+                                        sccl_buffer_type_auto_storage, size));
+
+    char path[] = "/tmp/sccl_test_XXXXXX";
+    const int fd = mkstemp(path);
+    ASSERT_GE(fd, 0);
+    unlink(path);
+    for (const sccl_buffer_t buffer : {managed_buffer, auto_buffer}) {
+        ASSERT_EQ(sccl_read_file_into_buffer(stream, fd, 0, buffer, 0, size),
+                  sccl_invalid_argument);
+        ASSERT_EQ(sccl_write_buffer_to_file(stream, buffer, 0, fd, 0, size),
+                  sccl_invalid_argument);
+    }
+
+    close(fd);
+    sccl_destroy_buffer(auto_buffer);
+    sccl_destroy_buffer(managed_buffer);
+}
+
+TEST_F(copy_buffer_test, read_file_direct)
+{
+    const size_t size = 4 << 20;
+    std::vector<uint8_t> file_data(size);
+    for (size_t i = 0; i < size; ++i) {
+        file_data[i] = static_cast<uint8_t>(i * 11 + i / 4096);
+    }
+
+    char path[] = "/tmp/sccl_test_XXXXXX";
+    const int fd = mkstemp(path);
+    ASSERT_GE(fd, 0);
+    scope_exit remove_file([&] { unlink(path); });
+    const ssize_t written = write(fd, file_data.data(), size);
+    close(fd);
+    ASSERT_EQ(written, static_cast<ssize_t>(size));
+
+    const int direct_fd = open(path, O_RDONLY | O_DIRECT | O_CLOEXEC);
+    if (direct_fd < 0 && errno == EINVAL) {
+        GTEST_SKIP() << "file system does not support O_DIRECT";
+    }
+    ASSERT_GE(direct_fd, 0);
+    scope_exit close_file([&] { close(direct_fd); });
+
+    /* memory from the host allocator is page aligned */
+    sccl_buffer_t host_buffer;
+    sccl_buffer_t device_buffer;
+    sccl_buffer_t readback_buffer;
+    SCCL_TEST_ASSERT(sccl_create_buffer(
+        device, &host_buffer, sccl_buffer_type_external_host_pointer_storage,
+        size + 0x1000));
+    SCCL_TEST_ASSERT(sccl_create_buffer(device, &device_buffer,
+                                        sccl_buffer_type_device_storage, size));
+    SCCL_TEST_ASSERT(sccl_create_buffer(device, &readback_buffer,
+                                        sccl_buffer_type_readback_storage,
+                                        size));
+
+    SCCL_TEST_ASSERT(sccl_read_file_into_buffer(stream, direct_fd, 0,
+                                                host_buffer, 0x1000, size));
+    SCCL_TEST_ASSERT(sccl_copy_buffer(stream, host_buffer, 0x1000,
+                                      device_buffer, 0, size));
+    SCCL_TEST_ASSERT(
+        sccl_copy_buffer(stream, device_buffer, 0, readback_buffer, 0, size));
+    SCCL_TEST_ASSERT(sccl_dispatch_stream(stream));
+    SCCL_TEST_ASSERT(sccl_join_stream(stream));
+
+    void *readback_ptr;
+    SCCL_TEST_ASSERT(
+        sccl_host_map_buffer(readback_buffer, &readback_ptr, 0, size));
+    ASSERT_EQ(memcmp(readback_ptr, file_data.data(), size), 0);
+    sccl_host_unmap_buffer(readback_buffer);
+
+    /* host address not aligned to the logical block size */
+    SCCL_TEST_ASSERT(sccl_read_file_into_buffer(stream, direct_fd, 0,
+                                                host_buffer, 1, size));
+    ASSERT_EQ(sccl_dispatch_stream(stream), sccl_invalid_argument);
+    SCCL_TEST_ASSERT(sccl_reset_stream(stream));
+
+    sccl_destroy_buffer(readback_buffer);
+    sccl_destroy_buffer(device_buffer);
+    sccl_destroy_buffer(host_buffer);
+}
+
+TEST_F(copy_buffer_test, copy_peer)
+{
+    /* a second device on the same gpu stands in for a peer gpu */
+    sccl_device_t peer_device;
+    SCCL_TEST_ASSERT(sccl_create_device(instance, &peer_device,
+                                        get_environment_gpu_index()));
+    sccl_stream_t peer_stream;
+    SCCL_TEST_ASSERT(sccl_create_stream(peer_device, &peer_stream));
+
+    /* several host staged chunks and an unaligned tail */
+    const size_t size = (9 << 20) + 0x44;
+    std::vector<uint8_t> input(size);
+    for (size_t i = 0; i < size; ++i) {
+        input[i] = static_cast<uint8_t>(i * 7 + i / 4096);
+    }
+
+    sccl_buffer_t local_buffer;
+    SCCL_TEST_ASSERT(sccl_create_buffer(device, &local_buffer,
+                                        sccl_buffer_type_device_storage,
+                                        size + 0x10));
+
+    std::vector<sccl_buffer_t> peer_buffers;
+    sccl_buffer_t peer_buffer;
+    SCCL_TEST_ASSERT(sccl_create_buffer(peer_device, &peer_buffer,
+                                        sccl_buffer_type_device_storage,
+                                        size));
+    peer_buffers.push_back(peer_buffer);
+    /* direct path if dmabuf can be used */
+    if (!get_environment_platform_docker() &&
+        sccl_create_dmabuf_buffer(peer_device, &peer_buffer,
+                                  sccl_buffer_type_device_dmabuf_storage,
+                                  size) == sccl_success) {
+        peer_buffers.push_back(peer_buffer);
+    }
+
+    for (sccl_buffer_t peer : peer_buffers) {
+        std::vector<uint8_t> output(size, 0);
+
+        /* push to the peer, forwarded when the stream is joined */
+        SCCL_TEST_ASSERT(
+            sccl_upload(stream, local_buffer, 0x10, input.data(), size));
+        SCCL_TEST_ASSERT(
+            sccl_copy_peer(stream, local_buffer, 0x10, peer, 0, size));
+        SCCL_TEST_ASSERT(sccl_dispatch_stream(stream));
+        SCCL_TEST_ASSERT(sccl_join_stream(stream));
+
+        SCCL_TEST_ASSERT(
+            sccl_download(peer_stream, peer, 0, output.data(), size));
+        SCCL_TEST_ASSERT(sccl_dispatch_stream(peer_stream));
+        SCCL_TEST_ASSERT(sccl_join_stream(peer_stream));
+        ASSERT_EQ(output, input);
+
+        /* pull from the peer, repeated to reuse cached imports */
+        for (size_t i = 0; i < 2; ++i) {
+            std::fill(output.begin(), output.end(), 0);
+            SCCL_TEST_ASSERT(
+                sccl_copy_peer(stream, peer, 0, local_buffer, 0, size));
+            SCCL_TEST_ASSERT(
+                sccl_download(stream, local_buffer, 0, output.data(), size));
+            SCCL_TEST_ASSERT(sccl_dispatch_stream(stream));
+            SCCL_TEST_ASSERT(sccl_join_stream(stream));
+            ASSERT_EQ(output, input);
+        }
+    }
+
+    ASSERT_EQ(
+        sccl_copy_peer(stream, local_buffer, 0, peer_buffers[0], 1, size),
+        sccl_invalid_argument);
+    ASSERT_EQ(sccl_copy_peer(peer_stream, local_buffer, 0, local_buffer,
+                             0x10, size),
+              sccl_invalid_argument);
+
+    for (sccl_buffer_t peer : peer_buffers) {
+        sccl_destroy_buffer(peer);
+    }
+    sccl_destroy_buffer(local_buffer);
+    sccl_destroy_stream(peer_stream);
+    sccl_destroy_device(peer_device);
+}
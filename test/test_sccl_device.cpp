@@ -40,4 +40,84 @@ TEST_F(device_test, create_device_invalid_index)
     sccl_device_t device;
     ASSERT_NE(sccl_create_device(instance, &device, device_count + 1),
               sccl_success);
-}
\ No newline at end of file
+}
+
+TEST_F(device_test, get_device_properties_subgroup)
+{
+    sccl_device_t device;
+    SCCL_TEST_ASSERT(
+        sccl_create_device(instance, &device, get_environment_gpu_index()));
+
+    sccl_device_properties_t device_properties = {};
+    sccl_get_device_properties(device, &device_properties);
+
+    EXPECT_GT(device_properties.native_work_group_size, 0);
+    EXPECT_GT(device_properties.min_subgroup_size, 0);
+    EXPECT_LE(device_properties.min_subgroup_size,
+              device_properties.max_subgroup_size);
+    EXPECT_GE(device_properties.native_work_group_size,
+              device_properties.min_subgroup_size);
+    EXPECT_LE(device_properties.native_work_group_size,
+              device_properties.max_subgroup_size);
+    /* basic subgroup operations are required in compute stage */
+    EXPECT_TRUE(device_properties.subgroup_supported_operations &
+                sccl_subgroup_feature_basic);
+    EXPECT_TRUE(device_properties.subgroup_supported_stages &
+                sccl_shader_stage_compute);
+
+    sccl_destroy_device(device);
+}
+
+TEST_F(device_test, get_memory_usage)
+{
+    sccl_device_t device;
+    SCCL_TEST_ASSERT(
+        sccl_create_device(instance, &device, get_environment_gpu_index()));
+
+    sccl_memory_usage_t usage = {};
+    sccl_get_memory_usage(device, &usage);
+    ASSERT_GT(usage.heaps_count, 0u);
+    ASSERT_LE(usage.heaps_count, SCCL_MAX_MEMORY_HEAPS);
+    for (uint32_t i = 0; i < usage.heaps_count; ++i) {
+        EXPECT_GT(usage.heaps[i].size, 0u);
+        EXPECT_GT(usage.heaps[i].budget, 0u);
+    }
+    EXPECT_EQ(usage.buffer_count, 0u);
+    EXPECT_EQ(usage.command_buffer_count, 0u);
+
+    const size_t size = 0x10000;
+    sccl_buffer_t host_buffer;
+    sccl_buffer_t device_buffer;
+    SCCL_TEST_ASSERT(sccl_create_buffer(device, &host_buffer,
+                                        sccl_buffer_type_host_storage, size));
+    SCCL_TEST_ASSERT(sccl_create_buffer(device, &device_buffer,
+                                        sccl_buffer_type_device_storage, size));
+    sccl_stream_t stream;
+    SCCL_TEST_ASSERT(sccl_create_stream(device, &stream));
+    SCCL_TEST_ASSERT(
+        sccl_copy_buffer(stream, host_buffer, 0, device_buffer, 0, size));
+
+    sccl_get_memory_usage(device, &usage);
+    EXPECT_EQ(usage.buffer_count, 2u);
+    EXPECT_EQ(usage.buffer_bytes[sccl_buffer_type_host_storage], size);
+    EXPECT_EQ(usage.buffer_bytes[sccl_buffer_type_device_storage], size);
+    EXPECT_GE(usage.command_buffer_count, 1u);
+    uint64_t allocated_size = 0;
+    for (uint32_t i = 0; i < usage.heaps_count; ++i) {
+        allocated_size += usage.heaps[i].allocated_size;
+    }
+    EXPECT_GE(allocated_size, 2 * size);
+
+    SCCL_TEST_ASSERT(sccl_dispatch_stream(stream));
+    SCCL_TEST_ASSERT(sccl_join_stream(stream));
+    sccl_destroy_stream(stream);
+    sccl_destroy_buffer(device_buffer);
+    sccl_destroy_buffer(host_buffer);
+
+    sccl_get_memory_usage(device, &usage);
+    EXPECT_EQ(usage.buffer_count, 0u);
+    EXPECT_EQ(usage.buffer_bytes[sccl_buffer_type_host_storage], 0u);
+    EXPECT_EQ(usage.command_buffer_count, 0u);
+
+    sccl_destroy_device(device);
+}
@@ -0,0 +1,116 @@
+#include <sccl.h>
+
+#include "common.hpp"
+#include <gtest/gtest.h>
+#include <stdint.h>
+#include <vector>
+
+/* internal header of SCCL */
+extern "C" {
+#include "hash_map.h"
+}
+
+/* FNV-1a as used by the map, to pick keys with the same home slot */
+static uint64_t hash_key(uint32_t key)
+{
+    uint64_t hash = 0xcbf29ce484222325ull;
+    for (size_t i = 0; i < sizeof(key); ++i) {
+        hash ^= reinterpret_cast<const uint8_t *>(&key)[i];
+        hash *= 0x100000001b3ull;
+    }
+    return hash;
+}
+
+/* `count` keys whose home slot is `home` in a map of `capacity` slots */
+static std::vector<uint32_t> get_colliding_keys(size_t capacity, size_t home,
+                                                size_t count)
+{
+    std::vector<uint32_t> keys;
+    for (uint32_t key = 0; keys.size() < count; ++key) {
+        if ((hash_key(key) & (capacity - 1)) == home) {
+            keys.push_back(key);
+        }
+    }
+    return keys;
+}
+
+static uint32_t *find(const hash_map_t *map, uint32_t key)
+{
+    return static_cast<uint32_t *>(hash_map_find(map, &key, sizeof(key)));
+}
+
+static void insert(hash_map_t *map, uint32_t key)
+{
+    const uint32_t value = key * 3;
+    SCCL_TEST_ASSERT(hash_map_insert(map, &key, sizeof(key), &value));
+}
+
+TEST(hash_map, remove_from_probe_chain)
+{
+    /* stays at the initial capacity of 8 slots with up to 6 keys */
+    const size_t capacity = 8;
+    hash_map_t map;
+    SCCL_TEST_ASSERT(hash_map_init(&map, sizeof(uint32_t)));
+    ASSERT_EQ(hash_map_get_capacity(&map), capacity);
+
+    /* chain in slots 6, 7 and 0 wraps around the end, the key homed in slot 7
+     * is pushed to slot 1 */
+    const std::vector<uint32_t> chain = get_colliding_keys(capacity, 6, 3);
+    const uint32_t displaced = get_colliding_keys(capacity, 7, 1)[0];
+    for (const uint32_t key : chain) {
+        insert(&map, key);
+    }
+    insert(&map, displaced);
+    ASSERT_EQ(hash_map_get_capacity(&map), capacity);
+
+    /* remove from the middle of the chain */
+    hash_map_remove(&map, &chain[1], sizeof(uint32_t));
+    ASSERT_EQ(hash_map_get_size(&map), 3u);
+    ASSERT_EQ(find(&map, chain[1]), nullptr);
+    for (const uint32_t key : {chain[0], chain[2], displaced}) {
+        const uint32_t *value = find(&map, key);
+        ASSERT_NE(value, nullptr);
+        ASSERT_EQ(*value, key * 3);
+    }
+
+    /* removing a missing key does nothing */
+    hash_map_remove(&map, &chain[1], sizeof(uint32_t));
+    ASSERT_EQ(hash_map_get_size(&map), 3u);
+
+    /* head of the chain, then reinsert */
+    hash_map_remove(&map, &chain[0], sizeof(uint32_t));
+    ASSERT_EQ(find(&map, chain[0]), nullptr);
+    ASSERT_NE(find(&map, chain[2]), nullptr);
+    ASSERT_NE(find(&map, displaced), nullptr);
+    insert(&map, chain[1]);
+    ASSERT_EQ(*find(&map, chain[1]), chain[1] * 3);
+    ASSERT_EQ(hash_map_get_size(&map), 3u);
+
+    hash_map_destroy(&map);
+}
+
+TEST(hash_map, remove_many)
+{
+    hash_map_t map;
+    SCCL_TEST_ASSERT(hash_map_init(&map, sizeof(uint32_t)));
+
+    const uint32_t count = 1000;
+    for (uint32_t key = 0; key < count; ++key) {
+        insert(&map, key);
+    }
+    for (uint32_t key = 0; key < count; key += 3) {
+        hash_map_remove(&map, &key, sizeof(key));
+    }
+    ASSERT_EQ(hash_map_get_size(&map), count - (count + 2) / 3);
+    for (uint32_t key = 0; key < count; ++key) {
+        const uint32_t *value = find(&map, key);
+        if (key % 3 == 0) {
+            ASSERT_EQ(value, nullptr);
+        } else {
+            ASSERT_NE(value, nullptr);
+            ASSERT_EQ(*value, key * 3);
+        }
+    }
+
+    hash_map_destroy(&map);
+}
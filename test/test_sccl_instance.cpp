@@ -3,7 +3,12 @@
 #include <sccl.h>
 
 #include "common.hpp"
+#include <algorithm>
 #include <gtest/gtest.h>
+#include <mutex>
+#include <stdlib.h>
+#include <string.h>
+#include <unordered_map>
 
 TEST(sccl_instance, create_instance)
 {
@@ -13,3 +18,112 @@ TEST(sccl_instance, create_instance)
 
     sccl_destroy_instance(instance);
 }
+
+/* allocator tracking live allocations, state is static since the callbacks
+ * are plain functions */
+static std::mutex counting_mutex;
+static std::unordered_map<void *, size_t> counting_allocations;
+static size_t counting_total = 0;
+
+static void *counting_allocate(void *user_data, size_t size, size_t alignment)
+{
+    (void)user_data;
+    void *pointer = nullptr;
+    if (posix_memalign(&pointer, std::max(alignment, sizeof(void *)),
+                       size) != 0) {
+        return nullptr;
+    }
+    std::lock_guard<std::mutex> lock(counting_mutex);
+    counting_allocations[pointer] = size;
+    counting_total++;
+    return pointer;
+}
+
+static void counting_free(void *user_data, void *pointer)
+{
+    (void)user_data;
+    if (pointer == nullptr) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(counting_mutex);
+        counting_allocations.erase(pointer);
+    }
+    free(pointer);
+}
+
+static void *counting_reallocate(void *user_data, void *pointer, size_t size,
+                                 size_t alignment)
+{
+    if (size == 0) {
+        counting_free(user_data, pointer);
+        return nullptr;
+    }
+    void *new_pointer = counting_allocate(user_data, size, alignment);
+    if (new_pointer == nullptr || pointer == nullptr) {
+        return new_pointer;
+    }
+    size_t old_size = 0;
+    {
+        std::lock_guard<std::mutex> lock(counting_mutex);
+        old_size = counting_allocations[pointer];
+    }
+    memcpy(new_pointer, pointer, std::min(old_size, size));
+    counting_free(user_data, pointer);
+    return new_pointer;
+}
+
+TEST(sccl_instance, create_instance_with_allocator)
+{
+    sccl_allocator_t allocator = {};
+    allocator.allocate = counting_allocate;
+    allocator.reallocate = counting_reallocate;
+    allocator.free = counting_free;
+    sccl_instance_config_t config = {};
+    config.allocator = &allocator;
+
+    sccl_instance_t instance;
+    SCCL_TEST_ASSERT(sccl_create_instance_with_config(&config, &instance));
+
+    /* instances existing at the same time share the allocator */
+    sccl_allocator_t other_allocator = allocator;
+    other_allocator.user_data = &other_allocator;
+    sccl_instance_config_t other_config = {};
+    other_config.allocator = &other_allocator;
+    sccl_instance_t other_instance;
+    ASSERT_EQ(sccl_create_instance_with_config(&other_config, &other_instance),
+              sccl_invalid_argument);
+
+    sccl_device_t device;
+    SCCL_TEST_ASSERT(
+        sccl_create_device(instance, &device, get_environment_gpu_index()));
+    sccl_buffer_t buffer;
+    SCCL_TEST_ASSERT(sccl_create_buffer(device, &buffer,
+                                        sccl_buffer_type_device_storage,
+                                        0x1000));
+    {
+        std::lock_guard<std::mutex> lock(counting_mutex);
+        EXPECT_GT(counting_total, 0u);
+        EXPECT_GT(counting_allocations.size(), 0u);
+    }
+
+    sccl_destroy_buffer(buffer);
+    sccl_destroy_device(device);
+    sccl_destroy_instance(instance);
+
+    size_t total = 0;
+    {
+        std::lock_guard<std::mutex> lock(counting_mutex);
+        EXPECT_EQ(counting_allocations.size(), 0u);
+        total = counting_total;
+    }
+
+    /* the allocator is removed with the last instance */
+    SCCL_TEST_ASSERT(sccl_create_instance(&instance));
+    SCCL_TEST_ASSERT(
+        sccl_create_device(instance, &device, get_environment_gpu_index()));
+    sccl_destroy_device(device);
+    sccl_destroy_instance(instance);
+    std::lock_guard<std::mutex> lock(counting_mutex);
+    EXPECT_EQ(counting_total, total);
+}
@@ -1,7 +1,14 @@
 #include <sccl.h>
 
 #include "common.hpp"
+#include <algorithm>
 #include <gtest/gtest.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <vector>
+
+/* internal allocation counter of SCCL, see alloc.h */
+extern "C" size_t sccl_get_allocation_count(void);
 
 class shader_test : public testing::Test
 {
@@ -27,6 +34,7 @@ protected:
 
     void buffer_passthrough_test(sccl_buffer_type_t source_type,
                                  sccl_buffer_type_t target_type);
+    void managed_buffers_test();
 };
 
 static void
@@ -219,6 +227,111 @@ TEST_F(shader_test, shader_specialization_constants)
     sccl_destroy_buffer(output_buffer);
 }
 
+TEST_F(shader_test, shader_specialization_constants_variants)
+{
+    const size_t specialization_constant_count = 4;
+    const size_t run_count = 3;
+    std::string shader_source =
+        read_test_shader("specialization_constants_shader.spv").value();
+
+    /* setup output buffer to verify results */
+    sccl_buffer_t output_buffer;
+    uint32_t *output_data;
+    const size_t output_buffer_size =
+        sizeof(uint32_t) * specialization_constant_count; // in bytes
+    sccl_shader_buffer_layout_t output_buffer_layout = {};
+    sccl_shader_buffer_binding_t output_buffer_binding = {};
+    init_output_buffer(device, output_buffer_size, &output_buffer,
+                       &output_buffer_layout, &output_buffer_binding);
+
+    /* base constants, c_3 is left to its default value */
+    uint32_t base_values[3] = {10, 11, 12};
+    sccl_shader_specialization_constant_t base_constants[3];
+    for (size_t i = 0; i < 3; ++i) {
+        base_constants[i].constant_id = i;
+        base_constants[i].size = sizeof(uint32_t);
+        base_constants[i].data = &base_values[i];
+    }
+
+    sccl_shader_config_t shader_config = {};
+    shader_config.shader_source_code = shader_source.data();
+    shader_config.shader_source_code_length = shader_source.size();
+    shader_config.specialization_constants = base_constants;
+    shader_config.specialization_constants_count = 3;
+    shader_config.buffer_layouts = &output_buffer_layout;
+    shader_config.buffer_layouts_count = 1;
+
+    sccl_shader_t shader;
+    SCCL_TEST_ASSERT(sccl_create_shader(device, &shader, &shader_config));
+
+    sccl_shader_run_params_t params = {};
+    params.group_count_x = 1;
+    params.group_count_y = 1;
+    params.group_count_z = 1;
+    params.buffer_bindings = &output_buffer_binding;
+    params.buffer_bindings_count = 1;
+
+    /* run each variant twice, second run uses cached pipeline */
+    for (size_t i = 0; i < run_count * 2; ++i) {
+        uint32_t c_1 = 100 + (i % run_count);
+        uint32_t c_3 = 300 + (i % run_count);
+        sccl_shader_specialization_constant_t overrides[2];
+        overrides[0].constant_id = 1;
+        overrides[0].size = sizeof(uint32_t);
+        overrides[0].data = &c_1;
+        overrides[1].constant_id = 3;
+        overrides[1].size = sizeof(uint32_t);
+        overrides[1].data = &c_3;
+
+        const size_t allocation_count = sccl_get_allocation_count();
+        SCCL_TEST_ASSERT(
+            sccl_run_shader_specialized(stream, shader, overrides, 2, &params));
+        /* cached variants are looked up without allocating */
+        if (i >= run_count) {
+            ASSERT_EQ(sccl_get_allocation_count(), allocation_count);
+        }
+        SCCL_TEST_ASSERT(sccl_dispatch_stream(stream));
+        SCCL_TEST_ASSERT(sccl_join_stream(stream));
+        SCCL_TEST_ASSERT(sccl_reset_stream(stream));
+
+        SCCL_TEST_ASSERT(sccl_host_map_buffer(
+            output_buffer, (void **)&output_data, 0, output_buffer_size));
+        ASSERT_EQ(*(output_data + 0), base_values[0]);
+        ASSERT_EQ(*(output_data + 1), c_1);
+        ASSERT_EQ(*(output_data + 2), base_values[2]);
+        ASSERT_EQ(*(output_data + 3), c_3);
+        sccl_host_unmap_buffer(output_buffer);
+    }
+
+    /* base pipeline is unaffected by variants */
+    SCCL_TEST_ASSERT(sccl_run_shader(stream, shader, &params));
+    SCCL_TEST_ASSERT(sccl_dispatch_stream(stream));
+    SCCL_TEST_ASSERT(sccl_join_stream(stream));
+    SCCL_TEST_ASSERT(sccl_host_map_buffer(output_buffer, (void **)&output_data,
+                                          0, output_buffer_size));
+    ASSERT_EQ(*(output_data + 0), base_values[0]);
+    ASSERT_EQ(*(output_data + 1), base_values[1]);
+    ASSERT_EQ(*(output_data + 2), base_values[2]);
+    ASSERT_EQ(*(output_data + 3), 0);
+    sccl_host_unmap_buffer(output_buffer);
+
+    /* duplicate constant ids are rejected */
+    uint32_t duplicate_value = 0;
+    sccl_shader_specialization_constant_t duplicates[2];
+    for (size_t i = 0; i < 2; ++i) {
+        duplicates[i].constant_id = 0;
+        duplicates[i].size = sizeof(uint32_t);
+        duplicates[i].data = &duplicate_value;
+    }
+    ASSERT_EQ(
+        sccl_run_shader_specialized(stream, shader, duplicates, 2, &params),
+        sccl_invalid_argument);
+
+    /* cleanup */
+    sccl_destroy_shader(shader);
+    sccl_destroy_buffer(output_buffer);
+}
+
 TEST_F(shader_test, shader_push_constants)
 {
     const size_t push_constant_count = 1;
@@ -292,6 +405,273 @@ TEST_F(shader_test, shader_push_constants)
     sccl_destroy_buffer(output_buffer);
 }
 
+TEST_F(shader_test, shader_auto_specialization)
+{
+    const size_t threshold = 4;
+    const size_t max_runs = 10000;
+    std::string shader_source =
+        read_test_shader("auto_specialization_shader.spv").value();
+
+    /* setup output buffer to verify results */
+    sccl_buffer_t output_buffer;
+    uint32_t *output_data;
+    const size_t output_buffer_size = sizeof(uint32_t) * 2; /* in bytes */
+    sccl_shader_buffer_layout_t output_buffer_layout = {};
+    sccl_shader_buffer_binding_t output_buffer_binding = {};
+    init_output_buffer(device, output_buffer_size, &output_buffer,
+                       &output_buffer_layout, &output_buffer_binding);
+
+    sccl_shader_push_constant_layout_t push_constant_layout = {};
+    push_constant_layout.size = sizeof(uint32_t);
+
+    sccl_shader_auto_specialization_t auto_specialization = {};
+    auto_specialization.push_constant_index = 0;
+    auto_specialization.offset = 0;
+    auto_specialization.size = sizeof(uint32_t);
+    auto_specialization.constant_id = 0;
+
+    sccl_shader_config_t shader_config = {};
+    shader_config.shader_source_code = shader_source.data();
+    shader_config.shader_source_code_length = shader_source.size();
+    shader_config.push_constant_layouts = &push_constant_layout;
+    shader_config.push_constant_layouts_count = 1;
+    shader_config.buffer_layouts = &output_buffer_layout;
+    shader_config.buffer_layouts_count = 1;
+    shader_config.auto_specializations = &auto_specialization;
+    shader_config.auto_specializations_count = 1;
+    shader_config.auto_specialization_threshold = threshold;
+
+    sccl_shader_t shader;
+    SCCL_TEST_ASSERT(sccl_create_shader(device, &shader, &shader_config));
+
+    uint32_t value = 42;
+    sccl_shader_push_constant_binding_t push_constant_binding = {};
+    push_constant_binding.data = &value;
+
+    sccl_shader_run_statistics_t statistics = {};
+    sccl_shader_run_params_t params = {};
+    params.group_count_x = 1;
+    params.group_count_y = 1;
+    params.group_count_z = 1;
+    params.push_constant_bindings = &push_constant_binding;
+    params.push_constant_bindings_count = 1;
+    params.buffer_bindings = &output_buffer_binding;
+    params.buffer_bindings_count = 1;
+    params.statistics = &statistics;
+
+    /* variant is built in background, run until it is used */
+    size_t run = 0;
+    for (; run < max_runs; ++run) {
+        SCCL_TEST_ASSERT(sccl_run_shader(stream, shader, &params));
+        SCCL_TEST_ASSERT(sccl_dispatch_stream(stream));
+        SCCL_TEST_ASSERT(sccl_join_stream(stream));
+        SCCL_TEST_ASSERT(sccl_reset_stream(stream));
+
+        SCCL_TEST_ASSERT(sccl_host_map_buffer(
+            output_buffer, (void **)&output_data, 0, output_buffer_size));
+        ASSERT_EQ(output_data[0], value);
+        if (statistics.specialized) {
+            ASSERT_EQ(output_data[1], value);
+            ASSERT_EQ(statistics.variant_index, 1);
+        } else {
+            ASSERT_EQ(output_data[1], 0);
+            ASSERT_EQ(statistics.variant_index, 0);
+        }
+        sccl_host_unmap_buffer(output_buffer);
+
+        if (statistics.specialized) {
+            break;
+        }
+    }
+    ASSERT_LT(run, max_runs);
+    ASSERT_GE(run, threshold);
+
+    /* dispatches using the ready variant do not allocate */
+    for (size_t i = 0; i < 4; ++i) {
+        const size_t allocation_count = sccl_get_allocation_count();
+        SCCL_TEST_ASSERT(sccl_run_shader(stream, shader, &params));
+        ASSERT_EQ(sccl_get_allocation_count(), allocation_count);
+        ASSERT_TRUE(statistics.specialized);
+        SCCL_TEST_ASSERT(sccl_dispatch_stream(stream));
+        SCCL_TEST_ASSERT(sccl_join_stream(stream));
+    }
+
+    /* other values still use base pipeline */
+    value = 7;
+    SCCL_TEST_ASSERT(sccl_run_shader(stream, shader, &params));
+    SCCL_TEST_ASSERT(sccl_dispatch_stream(stream));
+    SCCL_TEST_ASSERT(sccl_join_stream(stream));
+    ASSERT_FALSE(statistics.specialized);
+    SCCL_TEST_ASSERT(sccl_host_map_buffer(output_buffer, (void **)&output_data,
+                                          0, output_buffer_size));
+    ASSERT_EQ(output_data[0], value);
+    ASSERT_EQ(output_data[1], 0);
+    sccl_host_unmap_buffer(output_buffer);
+
+    /* cleanup */
+    sccl_destroy_shader(shader);
+    sccl_destroy_buffer(output_buffer);
+}
+
+TEST_F(shader_test, shader_auto_specialization_invalid_range)
+{
+    std::string shader_source =
+        read_test_shader("auto_specialization_shader.spv").value();
+
+    sccl_shader_push_constant_layout_t push_constant_layout = {};
+    push_constant_layout.size = sizeof(uint32_t);
+
+    /* range outside of push constant layout */
+    sccl_shader_auto_specialization_t auto_specialization = {};
+    auto_specialization.push_constant_index = 0;
+    auto_specialization.offset = sizeof(uint32_t);
+    auto_specialization.size = sizeof(uint32_t);
+    auto_specialization.constant_id = 0;
+
+    sccl_shader_config_t shader_config = {};
+    shader_config.shader_source_code = shader_source.data();
+    shader_config.shader_source_code_length = shader_source.size();
+    shader_config.push_constant_layouts = &push_constant_layout;
+    shader_config.push_constant_layouts_count = 1;
+    shader_config.auto_specializations = &auto_specialization;
+    shader_config.auto_specializations_count = 1;
+
+    sccl_shader_t shader;
+    ASSERT_EQ(sccl_create_shader(device, &shader, &shader_config),
+              sccl_invalid_argument);
+}
+
+TEST_F(shader_test, shader_buffer_view_offset_out_of_range)
+{
+    std::string shader_source =
+        read_test_shader("specialization_constants_shader.spv").value();
+
+    sccl_buffer_t buffer;
+    sccl_buffer_t view;
+    sccl_shader_buffer_layout_t buffer_layout = {};
+    sccl_shader_buffer_binding_t buffer_binding = {};
+    SCCL_TEST_ASSERT(
+        sccl_create_buffer(device, &buffer, sccl_buffer_type_shared, 0x2000));
+    SCCL_TEST_ASSERT(sccl_create_buffer_view(buffer, 0, 0x1000, &view));
+    sccl_set_buffer_layout_binding(view, 0, 0, &buffer_layout,
+                                   &buffer_binding);
+
+    sccl_shader_config_t shader_config = {};
+    shader_config.shader_source_code = shader_source.data();
+    shader_config.shader_source_code_length = shader_source.size();
+    shader_config.buffer_layouts = &buffer_layout;
+    shader_config.buffer_layouts_count = 1;
+
+    sccl_shader_t shader;
+    SCCL_TEST_ASSERT(sccl_create_shader(device, &shader, &shader_config));
+
+    sccl_shader_run_params_t params = {};
+    params.group_count_x = 1;
+    params.group_count_y = 1;
+    params.group_count_z = 1;
+    params.buffer_bindings = &buffer_binding;
+    params.buffer_bindings_count = 1;
+
+    /* whole view binding would start at or past the end of the view */
+    for (size_t offset : {0x1000, 0x1100}) {
+        buffer_binding.offset = offset;
+        ASSERT_EQ(sccl_run_shader(stream, shader, &params),
+                  sccl_invalid_argument);
+    }
+
+    sccl_destroy_shader(shader);
+    sccl_destroy_buffer(view);
+    sccl_destroy_buffer(buffer);
+}
+
+TEST_F(shader_test, shader_module_multiple_entry_points)
+{
+    std::string shader_source =
+        read_test_shader("multiple_entry_points_shader.spv").value();
+
+    /* setup output buffer to verify results */
+    sccl_buffer_t output_buffer;
+    uint32_t *output_data;
+    const size_t output_buffer_size = sizeof(uint32_t); /* in bytes */
+    sccl_shader_buffer_layout_t output_buffer_layout = {};
+    sccl_shader_buffer_binding_t output_buffer_binding = {};
+    init_output_buffer(device, output_buffer_size, &output_buffer,
+                       &output_buffer_layout, &output_buffer_binding);
+
+    sccl_shader_module_t shader_module;
+    SCCL_TEST_ASSERT(sccl_create_shader_module(device, &shader_module,
+                                               shader_source.data(),
+                                               shader_source.size()));
+
+    const char *entry_points[] = {"write_first", "write_second"};
+    const uint32_t expected_values[] = {1, 2};
+    sccl_shader_t shaders[2];
+    for (size_t i = 0; i < 2; ++i) {
+        sccl_shader_config_t shader_config = {};
+        shader_config.shader_module = shader_module;
+        shader_config.entry_point = entry_points[i];
+        shader_config.buffer_layouts = &output_buffer_layout;
+        shader_config.buffer_layouts_count = 1;
+        SCCL_TEST_ASSERT(
+            sccl_create_shader(device, &shaders[i], &shader_config));
+    }
+
+    /* shaders keep module alive */
+    sccl_destroy_shader_module(shader_module);
+
+    sccl_shader_run_params_t params = {};
+    params.group_count_x = 1;
+    params.group_count_y = 1;
+    params.group_count_z = 1;
+    params.buffer_bindings = &output_buffer_binding;
+    params.buffer_bindings_count = 1;
+
+    for (size_t i = 0; i < 2; ++i) {
+        SCCL_TEST_ASSERT(sccl_run_shader(stream, shaders[i], &params));
+        SCCL_TEST_ASSERT(sccl_dispatch_stream(stream));
+        SCCL_TEST_ASSERT(sccl_join_stream(stream));
+        SCCL_TEST_ASSERT(sccl_reset_stream(stream));
+
+        SCCL_TEST_ASSERT(sccl_host_map_buffer(
+            output_buffer, (void **)&output_data, 0, output_buffer_size));
+        ASSERT_EQ(output_data[0], expected_values[i]);
+        sccl_host_unmap_buffer(output_buffer);
+    }
+
+    /* cleanup */
+    for (size_t i = 0; i < 2; ++i) {
+        sccl_destroy_shader(shaders[i]);
+    }
+    sccl_destroy_buffer(output_buffer);
+}
+
+TEST_F(shader_test, shader_module_and_source_code_exclusive)
+{
+    std::string shader_source = read_test_shader("noop_shader.spv").value();
+
+    sccl_shader_module_t shader_module;
+    SCCL_TEST_ASSERT(sccl_create_shader_module(device, &shader_module,
+                                               shader_source.data(),
+                                               shader_source.size()));
+
+    sccl_shader_config_t shader_config = {};
+    shader_config.shader_source_code = shader_source.data();
+    shader_config.shader_source_code_length = shader_source.size();
+    shader_config.shader_module = shader_module;
+
+    sccl_shader_t shader;
+    ASSERT_EQ(sccl_create_shader(device, &shader, &shader_config),
+              sccl_invalid_argument);
+
+    /* neither set */
+    shader_config.shader_source_code = NULL;
+    shader_config.shader_module = NULL;
+    ASSERT_EQ(sccl_create_shader(device, &shader, &shader_config),
+              sccl_invalid_argument);
+
+    sccl_destroy_shader_module(shader_module);
+}
+
 TEST_F(shader_test, shader_copy_buffer)
 {
     /* number of times to rerun pipeline to test if stream can be used again
@@ -392,6 +772,184 @@ TEST_F(shader_test, shader_copy_buffer)
     sccl_destroy_buffer(device_output_buffer);
 }
 
+void shader_test::managed_buffers_test()
+{
+    const size_t buffer_element_count = 0x1000;
+    const size_t buffer_size = buffer_element_count * sizeof(uint32_t);
+    std::string shader_source =
+        read_test_shader("copy_buffer_shader.spv").value();
+
+    /* no explicit copies, data migrates when the buffers are used and mapped */
+    sccl_buffer_t input_buffer;
+    sccl_buffer_t output_buffer;
+    SCCL_TEST_ASSERT(sccl_create_buffer(device, &input_buffer,
+                                        sccl_buffer_type_managed_storage,
+                                        buffer_size));
+    SCCL_TEST_ASSERT(sccl_create_buffer(device, &output_buffer,
+                                        sccl_buffer_type_managed_storage,
+                                        buffer_size));
+    sccl_shader_buffer_layout_t buffer_layouts[2] = {};
+    sccl_shader_buffer_binding_t buffer_bindings[2] = {};
+    sccl_set_buffer_layout_binding(input_buffer, 0, 0, &buffer_layouts[0],
+                                   &buffer_bindings[0]);
+    sccl_set_buffer_layout_binding(output_buffer, 0, 1, &buffer_layouts[1],
+                                   &buffer_bindings[1]);
+
+    sccl_shader_config_t shader_config = {};
+    shader_config.shader_source_code = shader_source.data();
+    shader_config.shader_source_code_length = shader_source.size();
+    shader_config.buffer_layouts = buffer_layouts;
+    shader_config.buffer_layouts_count = 2;
+    sccl_shader_t shader;
+    SCCL_TEST_ASSERT(sccl_create_shader(device, &shader, &shader_config));
+
+    sccl_shader_run_params_t params = {};
+    params.group_count_x = buffer_element_count;
+    params.group_count_y = 1;
+    params.group_count_z = 1;
+    params.buffer_bindings = buffer_bindings;
+    params.buffer_bindings_count = 2;
+
+    /* invalid parameters are rejected before any data migrates */
+    buffer_bindings[1].size = 0;
+    ASSERT_EQ(sccl_run_shader(stream, shader, &params), sccl_invalid_argument);
+    buffer_bindings[1].size = SCCL_BIND_WHOLE_BUFFER;
+
+    for (uint32_t run = 0; run < 3; ++run) {
+        uint32_t *input_data;
+        SCCL_TEST_ASSERT(sccl_host_map_buffer(
+            input_buffer, (void **)&input_data, 0, buffer_size));
+        for (uint32_t i = 0; i < buffer_element_count; ++i) {
+            input_data[i] = i * (run + 1);
+        }
+        sccl_host_unmap_buffer(input_buffer);
+
+        SCCL_TEST_ASSERT(sccl_run_shader(stream, shader, &params));
+        SCCL_TEST_ASSERT(sccl_dispatch_stream(stream));
+        SCCL_TEST_ASSERT(sccl_join_stream(stream));
+
+        uint32_t *output_data;
+        SCCL_TEST_ASSERT(sccl_host_map_buffer(
+            output_buffer, (void **)&output_data, 0, buffer_size));
+        for (uint32_t i = 0; i < buffer_element_count; ++i) {
+            ASSERT_EQ(output_data[i], i * (run + 1) / 2);
+        }
+        sccl_host_unmap_buffer(output_buffer);
+    }
+
+    sccl_destroy_shader(shader);
+    sccl_destroy_buffer(input_buffer);
+    sccl_destroy_buffer(output_buffer);
+}
+
+TEST_F(shader_test, shader_managed_buffers) { managed_buffers_test(); }
+
+TEST_F(shader_test, shader_managed_buffers_staged)
+{
+    /* data migrates between the host and device copies */
+    ASSERT_NO_FATAL_FAILURE(use_staged_device(instance, &device, &stream));
+    managed_buffers_test();
+}
+
+/* halves every element of a tile with `copy_buffer_shader` */
+static sccl_error_t record_halve_tile(void *user_data, sccl_stream_t stream,
+                                     const sccl_tile_t *tile)
+{
+    sccl_shader_t shader = static_cast<sccl_shader_t>(user_data);
+    sccl_shader_buffer_binding_t buffer_bindings[2] = {};
+    sccl_set_buffer_layout_binding(tile->input_buffer, 0, 0, nullptr,
+                                   &buffer_bindings[0]);
+    sccl_set_buffer_layout_binding(tile->output_buffer, 0, 1, nullptr,
+                                   &buffer_bindings[1]);
+    sccl_shader_run_params_t params = {};
+    params.group_count_x = tile->input_size / sizeof(uint32_t);
+    params.group_count_y = 1;
+    params.group_count_z = 1;
+    params.buffer_bindings = buffer_bindings;
+    params.buffer_bindings_count = 2;
+    return sccl_run_shader(stream, shader, &params);
+}
+
+TEST_F(shader_test, shader_tiled_executor)
+{
+    const size_t tile_element_count = 0x400;
+    const size_t tile_size = tile_element_count * sizeof(uint32_t);
+    /* last tile is partial */
+    const size_t element_count = tile_element_count * 10 + 0x80;
+    const size_t size = element_count * sizeof(uint32_t);
+    std::string shader_source =
+        read_test_shader("copy_buffer_shader.spv").value();
+
+    sccl_shader_buffer_layout_t buffer_layouts[2] = {};
+    buffer_layouts[0].position = {0, 0};
+    buffer_layouts[0].type = sccl_buffer_type_device_storage;
+    buffer_layouts[1].position = {0, 1};
+    buffer_layouts[1].type = sccl_buffer_type_device_storage;
+    sccl_shader_config_t shader_config = {};
+    shader_config.shader_source_code = shader_source.data();
+    shader_config.shader_source_code_length = shader_source.size();
+    shader_config.buffer_layouts = buffer_layouts;
+    shader_config.buffer_layouts_count = 2;
+    shader_config.max_concurrent_buffer_bindings =
+        SCCL_DEFAULT_TILED_EXECUTOR_DEPTH;
+    sccl_shader_t shader;
+    SCCL_TEST_ASSERT(sccl_create_shader(device, &shader, &shader_config));
+
+    sccl_tiled_executor_config_t executor_config = {};
+    executor_config.input_tile_size = tile_size;
+    executor_config.output_tile_size = tile_size;
+    executor_config.record_tile = record_halve_tile;
+    executor_config.user_data = shader;
+    sccl_tiled_executor_t executor;
+    SCCL_TEST_ASSERT(
+        sccl_create_tiled_executor(device, &executor_config, &executor));
+
+    std::vector<uint32_t> input(element_count);
+    for (size_t i = 0; i < element_count; ++i) {
+        input[i] = static_cast<uint32_t>(i * 3);
+    }
+
+    /* host input */
+    std::vector<uint32_t> output(element_count, 0);
+    sccl_tiled_run_params_t params = {};
+    params.input = input.data();
+    params.input_size = size;
+    params.output = output.data();
+    params.output_size = size;
+    SCCL_TEST_ASSERT(sccl_tiled_executor_run(executor, &params));
+    for (size_t i = 0; i < element_count; ++i) {
+        ASSERT_EQ(output[i], input[i] / 2);
+    }
+
+    /* file input at an offset */
+    char path[] = "/tmp/sccl_tiled_executor_XXXXXX";
+    int fd = mkstemp(path);
+    ASSERT_GE(fd, 0);
+    unlink(path);
+    const size_t file_offset = 0x10;
+    std::vector<char> file_data(file_offset + size);
+    memcpy(file_data.data() + file_offset, input.data(), size);
+    ASSERT_EQ(write(fd, file_data.data(), file_data.size()),
+              static_cast<ssize_t>(file_data.size()));
+
+    std::fill(output.begin(), output.end(), 0);
+    params.input = nullptr;
+    params.input_fd = fd;
+    params.input_file_offset = file_offset;
+    SCCL_TEST_ASSERT(sccl_tiled_executor_run(executor, &params));
+    for (size_t i = 0; i < element_count; ++i) {
+        ASSERT_EQ(output[i], input[i] / 2);
+    }
+
+    /* input past the end of the file */
+    params.input_size = size + tile_size;
+    ASSERT_EQ(sccl_tiled_executor_run(executor, &params), sccl_system_error);
+    close(fd);
+
+    sccl_destroy_tiled_executor(executor);
+    sccl_destroy_shader(shader);
+}
+
 TEST_F(shader_test, shader_copy_buffer_concurrent_streams)
 {
     const size_t stream_count = 10; /* number of concurrent streams */
@@ -679,4 +1237,189 @@ TEST_F(shader_test, shader_passthrough_all_valid_buffer_permutations)
             buffer_passthrough_test(src_type, dst_type);
         }
     }
-}
\ No newline at end of file
+}
+
+TEST_F(shader_test, shader_required_subgroup_size)
+{
+    sccl_device_properties_t device_properties = {};
+    sccl_get_device_properties(device, &device_properties);
+    if (!device_properties.subgroup_size_control_supported ||
+        !device_properties.compute_full_subgroups_supported) {
+        GTEST_SKIP() << "Subgroup size control not supported";
+    }
+    if (!(device_properties.subgroup_supported_operations &
+          sccl_subgroup_feature_arithmetic)) {
+        GTEST_SKIP() << "Subgroup arithmetic not supported";
+    }
+
+    std::string shader_source = read_test_shader("subgroup_shader.spv").value();
+
+    /* work group size must be multiple of all tested subgroup sizes */
+    uint32_t work_group_size = device_properties.max_subgroup_size;
+    sccl_shader_specialization_constant_t work_group_size_constant = {};
+    work_group_size_constant.constant_id = 0;
+    work_group_size_constant.size = sizeof(uint32_t);
+    work_group_size_constant.data = &work_group_size;
+
+    /* one entry for subgroup size and one for each subgroup sum */
+    sccl_buffer_t output_buffer;
+    uint32_t *output_data;
+    const size_t output_buffer_size =
+        sizeof(uint32_t) * (1 + work_group_size); // in bytes
+    sccl_shader_buffer_layout_t output_buffer_layout = {};
+    sccl_shader_buffer_binding_t output_buffer_binding = {};
+    init_output_buffer(device, output_buffer_size, &output_buffer,
+                       &output_buffer_layout, &output_buffer_binding);
+
+    for (uint32_t subgroup_size = device_properties.min_subgroup_size;
+         subgroup_size <= device_properties.max_subgroup_size;
+         subgroup_size *= 2) {
+        sccl_shader_config_t shader_config = {};
+        shader_config.shader_source_code = shader_source.data();
+        shader_config.shader_source_code_length = shader_source.size();
+        shader_config.specialization_constants = &work_group_size_constant;
+        shader_config.specialization_constants_count = 1;
+        shader_config.buffer_layouts = &output_buffer_layout;
+        shader_config.buffer_layouts_count = 1;
+        shader_config.required_subgroup_size = subgroup_size;
+        shader_config.require_full_subgroups = true;
+
+        sccl_shader_t shader;
+        SCCL_TEST_ASSERT(sccl_create_shader(device, &shader, &shader_config));
+
+        /* run */
+        sccl_shader_run_params_t params = {};
+        params.group_count_x = 1;
+        params.group_count_y = 1;
+        params.group_count_z = 1;
+        params.buffer_bindings = &output_buffer_binding;
+        params.buffer_bindings_count = 1;
+
+        SCCL_TEST_ASSERT(sccl_run_shader(stream, shader, &params));
+        SCCL_TEST_ASSERT(sccl_dispatch_stream(stream));
+        SCCL_TEST_ASSERT(sccl_join_stream(stream));
+        SCCL_TEST_ASSERT(sccl_reset_stream(stream));
+
+        /* verify subgroup size and that every subgroup is full */
+        SCCL_TEST_ASSERT(sccl_host_map_buffer(
+            output_buffer, (void **)&output_data, 0, output_buffer_size));
+        ASSERT_EQ(output_data[0], subgroup_size);
+        for (uint32_t i = 0; i < work_group_size / subgroup_size; ++i) {
+            ASSERT_EQ(output_data[1 + i], subgroup_size);
+        }
+        sccl_host_unmap_buffer(output_buffer);
+
+        sccl_destroy_shader(shader);
+    }
+
+    /* cleanup */
+    sccl_destroy_buffer(output_buffer);
+}
+
+TEST_F(shader_test, shader_required_subgroup_size_invalid)
+{
+    sccl_device_properties_t device_properties = {};
+    sccl_get_device_properties(device, &device_properties);
+    if (!device_properties.subgroup_size_control_supported) {
+        GTEST_SKIP() << "Subgroup size control not supported";
+    }
+
+    std::string shader_source = read_test_shader("noop_shader.spv").value();
+
+    sccl_shader_config_t shader_config = {};
+    shader_config.shader_source_code = shader_source.data();
+    shader_config.shader_source_code_length = shader_source.size();
+
+    sccl_shader_t shader;
+
+    /* not power of two */
+    shader_config.required_subgroup_size =
+        device_properties.max_subgroup_size + 1;
+    ASSERT_EQ(sccl_create_shader(device, &shader, &shader_config),
+              sccl_invalid_argument);
+
+    /* out of range */
+    shader_config.required_subgroup_size =
+        device_properties.max_subgroup_size * 2;
+    ASSERT_EQ(sccl_create_shader(device, &shader, &shader_config),
+              sccl_invalid_argument);
+}
+
+TEST(shader_allocation, steady_state_dispatch_does_not_allocate)
+{
+    const size_t warm_up_count = 4;
+    const size_t iteration_count = 10000;
+    const size_t buffer_element_count = 0x100;
+    const size_t buffer_size = buffer_element_count * sizeof(uint32_t);
+    std::string shader_source =
+        read_test_shader("copy_buffer_shader.spv").value();
+
+    sccl_instance_t instance;
+    sccl_device_t device;
+    sccl_stream_t stream;
+    SCCL_TEST_ASSERT(sccl_create_instance(&instance));
+    SCCL_TEST_ASSERT(
+        sccl_create_device(instance, &device, get_environment_gpu_index()));
+    SCCL_TEST_ASSERT(sccl_create_stream(device, &stream));
+
+    sccl_buffer_t host_buffer;
+    sccl_buffer_t device_input_buffer;
+    sccl_buffer_t device_output_buffer;
+    SCCL_TEST_ASSERT(sccl_create_buffer(device, &host_buffer,
+                                        sccl_buffer_type_host, buffer_size));
+    SCCL_TEST_ASSERT(sccl_create_buffer(device, &device_input_buffer,
+                                        sccl_buffer_type_device, buffer_size));
+    SCCL_TEST_ASSERT(sccl_create_buffer(device, &device_output_buffer,
+                                        sccl_buffer_type_device, buffer_size));
+    sccl_shader_buffer_layout_t buffer_layouts[2] = {};
+    sccl_shader_buffer_binding_t buffer_bindings[2] = {};
+    sccl_set_buffer_layout_binding(device_input_buffer, 0, 0,
+                                   &buffer_layouts[0], &buffer_bindings[0]);
+    sccl_set_buffer_layout_binding(device_output_buffer, 0, 1,
+                                   &buffer_layouts[1], &buffer_bindings[1]);
+
+    sccl_shader_config_t shader_config = {};
+    shader_config.shader_source_code = shader_source.data();
+    shader_config.shader_source_code_length = shader_source.size();
+    shader_config.buffer_layouts = buffer_layouts;
+    shader_config.buffer_layouts_count = 2;
+    sccl_shader_t shader;
+    SCCL_TEST_ASSERT(sccl_create_shader(device, &shader, &shader_config));
+
+    sccl_shader_run_params_t params = {};
+    params.group_count_x = buffer_element_count;
+    params.group_count_y = 1;
+    params.group_count_z = 1;
+    params.buffer_bindings = buffer_bindings;
+    params.buffer_bindings_count = 2;
+
+    /* record, dispatch, wait and reset */
+    auto run = [&]() {
+        SCCL_TEST_ASSERT(sccl_copy_buffer(stream, host_buffer, 0,
+                                          device_input_buffer, 0, buffer_size));
+        SCCL_TEST_ASSERT(sccl_run_shader(stream, shader, &params));
+        SCCL_TEST_ASSERT(sccl_copy_buffer(stream, device_output_buffer, 0,
+                                          host_buffer, 0, buffer_size));
+        SCCL_TEST_ASSERT(sccl_dispatch_stream(stream));
+        SCCL_TEST_ASSERT(sccl_join_stream(stream));
+    };
+
+    for (size_t i = 0; i < warm_up_count; ++i) {
+        run();
+    }
+
+    /* only SCCL allocations are counted, drivers may allocate on submit */
+    const size_t warm_allocation_count = sccl_get_allocation_count();
+    for (size_t i = 0; i < iteration_count; ++i) {
+        run();
+    }
+    EXPECT_EQ(sccl_get_allocation_count(), warm_allocation_count);
+
+    sccl_destroy_shader(shader);
+    sccl_destroy_buffer(host_buffer);
+    sccl_destroy_buffer(device_input_buffer);
+    sccl_destroy_buffer(device_output_buffer);
+    sccl_destroy_stream(stream);
+    sccl_destroy_device(device);
+    sccl_destroy_instance(instance);
+}
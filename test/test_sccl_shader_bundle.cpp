@@ -0,0 +1,407 @@
+#include <sccl.h>
+#include <shader_bundle_format.h>
+
+#include "common.hpp"
+#include <gtest/gtest.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <utility>
+
+class shader_bundle_test : public testing::Test
+{
+protected:
+    void SetUp() override
+    {
+        SCCL_TEST_ASSERT(sccl_create_instance(&instance));
+        SCCL_TEST_ASSERT(
+            sccl_create_device(instance, &device, get_environment_gpu_index()));
+        SCCL_TEST_ASSERT(sccl_create_stream(device, &stream));
+        SCCL_TEST_ASSERT(sccl_open_shader_bundle(
+            (std::string(get_environment_shaders_dir()) +
+             "/test_shader_bundle.bundle")
+                .c_str(),
+            &bundle));
+    }
+
+    void TearDown() override
+    {
+        sccl_close_shader_bundle(bundle);
+        sccl_destroy_stream(stream);
+        sccl_destroy_device(device);
+        sccl_destroy_instance(instance);
+    }
+
+    sccl_instance_t instance;
+    sccl_device_t device;
+    sccl_stream_t stream;
+    sccl_shader_bundle_t bundle;
+};
+
+static void init_output_buffer(const sccl_device_t device, size_t size,
+                               sccl_buffer_t *output_buffer,
+                               sccl_shader_buffer_binding_t *output_binding)
+{
+    void *data;
+    sccl_shader_buffer_layout_t output_layout = {};
+    SCCL_TEST_ASSERT(sccl_create_buffer(device, output_buffer,
+                                        sccl_buffer_type_shared, size));
+    /* init buffer to 0xff so default specialization constants are visible */
+    SCCL_TEST_ASSERT(
+        sccl_host_map_buffer(*output_buffer, (void **)&data, 0, size));
+    memset((void *)data, 0xff, size);
+    sccl_host_unmap_buffer(*output_buffer);
+    sccl_set_buffer_layout_binding(*output_buffer, 0, 0, &output_layout,
+                                   output_binding);
+}
+
+TEST_F(shader_bundle_test, shader_bundle_noop)
+{
+    sccl_shader_t shader;
+    SCCL_TEST_ASSERT(
+        sccl_create_shader_from_bundle(device, bundle, "noop", NULL, &shader));
+
+    sccl_shader_run_params_t params = {};
+    params.group_count_x = 1;
+
+    SCCL_TEST_ASSERT(sccl_run_shader(stream, shader, &params));
+    SCCL_TEST_ASSERT(sccl_dispatch_stream(stream));
+    SCCL_TEST_ASSERT(sccl_join_stream(stream));
+
+    sccl_destroy_shader(shader);
+}
+
+TEST_F(shader_bundle_test, shader_bundle_closed_before_run)
+{
+    sccl_shader_t shader;
+    SCCL_TEST_ASSERT(
+        sccl_create_shader_from_bundle(device, bundle, "noop", NULL, &shader));
+
+    /* shader must stay valid after bundle is closed */
+    sccl_close_shader_bundle(bundle);
+    SCCL_TEST_ASSERT(sccl_open_shader_bundle(
+        (std::string(get_environment_shaders_dir()) +
+         "/test_shader_bundle.bundle")
+            .c_str(),
+        &bundle));
+
+    sccl_shader_run_params_t params = {};
+    params.group_count_x = 1;
+
+    SCCL_TEST_ASSERT(sccl_run_shader(stream, shader, &params));
+    SCCL_TEST_ASSERT(sccl_dispatch_stream(stream));
+    SCCL_TEST_ASSERT(sccl_join_stream(stream));
+
+    sccl_destroy_shader(shader);
+}
+
+static std::string read_test_bundle()
+{
+    return read_file((std::string(get_environment_shaders_dir()) +
+                      "/test_shader_bundle.bundle")
+                         .c_str())
+        .value();
+}
+
+static shader_bundle_entry_t *get_bundle_entries(std::string &bundle_data)
+{
+    return reinterpret_cast<shader_bundle_entry_t *>(
+        bundle_data.data() + sizeof(shader_bundle_header_t));
+}
+
+static shader_bundle_entry_t *find_bundle_entry(std::string &bundle_data,
+                                                const char *name)
+{
+    shader_bundle_header_t header;
+    memcpy(&header, bundle_data.data(), sizeof(header));
+    shader_bundle_entry_t *entries = get_bundle_entries(bundle_data);
+    for (uint32_t i = 0; i < header.entry_count; ++i) {
+        if (strcmp(entries[i].name, name) == 0) {
+            return &entries[i];
+        }
+    }
+    return NULL;
+}
+
+/* write modified bundle data to a temporary file and open it */
+static sccl_error_t open_bundle_data(const std::string &bundle_data,
+                                     sccl_shader_bundle_t *bundle)
+{
+    char path[] = "/tmp/sccl_test_bundle_XXXXXX";
+    int fd = mkstemp(path);
+    if (fd < 0) {
+        return sccl_system_error;
+    }
+    const bool written =
+        write(fd, bundle_data.data(), bundle_data.size()) ==
+        static_cast<ssize_t>(bundle_data.size());
+    close(fd);
+    /* bundle stays mapped after the file is removed */
+    sccl_error_t error =
+        written ? sccl_open_shader_bundle(path, bundle) : sccl_system_error;
+    unlink(path);
+    return error;
+}
+
+TEST_F(shader_bundle_test, shader_bundle_default_specialization_constants)
+{
+    const size_t specialization_constant_count = 4;
+    const size_t output_buffer_size =
+        sizeof(uint32_t) * specialization_constant_count;
+
+    /* shader defaults are 0, so replace the bundle defaults with non-zero
+     * values to tell them apart */
+    std::string bundle_data = read_test_bundle();
+    shader_bundle_entry_t *entry =
+        find_bundle_entry(bundle_data, "specialization_constants");
+    ASSERT_NE(entry, nullptr);
+    ASSERT_EQ(entry->specialization_constants_count,
+              specialization_constant_count);
+    shader_bundle_specialization_constant_t *bundle_constants =
+        reinterpret_cast<shader_bundle_specialization_constant_t *>(
+            bundle_data.data() + entry->specialization_constants_offset);
+    for (size_t i = 0; i < specialization_constant_count; ++i) {
+        ASSERT_EQ(bundle_constants[i].size, sizeof(uint32_t));
+        const uint32_t value = 11 + bundle_constants[i].constant_id;
+        memcpy(bundle_constants[i].data, &value, sizeof(value));
+    }
+    sccl_shader_bundle_t modified_bundle;
+    SCCL_TEST_ASSERT(open_bundle_data(bundle_data, &modified_bundle));
+
+    sccl_buffer_t output_buffer;
+    sccl_shader_buffer_binding_t output_buffer_binding = {};
+    init_output_buffer(device, output_buffer_size, &output_buffer,
+                       &output_buffer_binding);
+
+    /* buffer layouts and specialization constants are reflected */
+    sccl_shader_t shader;
+    SCCL_TEST_ASSERT(sccl_create_shader_from_bundle(
+        device, modified_bundle, "specialization_constants", NULL, &shader));
+
+    sccl_shader_run_params_t params = {};
+    params.group_count_x = 1;
+    params.group_count_y = 1;
+    params.group_count_z = 1;
+    params.buffer_bindings = &output_buffer_binding;
+    params.buffer_bindings_count = 1;
+
+    SCCL_TEST_ASSERT(sccl_run_shader(stream, shader, &params));
+    SCCL_TEST_ASSERT(sccl_dispatch_stream(stream));
+    SCCL_TEST_ASSERT(sccl_join_stream(stream));
+
+    uint32_t *output_data;
+    SCCL_TEST_ASSERT(sccl_host_map_buffer(output_buffer, (void **)&output_data,
+                                          0, output_buffer_size));
+    for (size_t i = 0; i < specialization_constant_count; ++i) {
+        EXPECT_EQ(output_data[i], static_cast<uint32_t>(11 + i));
+    }
+    sccl_host_unmap_buffer(output_buffer);
+
+    sccl_destroy_shader(shader);
+    sccl_destroy_buffer(output_buffer);
+    sccl_close_shader_bundle(modified_bundle);
+}
+
+TEST_F(shader_bundle_test, shader_bundle_override_specialization_constants)
+{
+    const size_t specialization_constant_count = 4;
+    const size_t output_buffer_size =
+        sizeof(uint32_t) * specialization_constant_count;
+
+    sccl_buffer_t output_buffer;
+    sccl_shader_buffer_binding_t output_buffer_binding = {};
+    init_output_buffer(device, output_buffer_size, &output_buffer,
+                       &output_buffer_binding);
+
+    uint32_t values[specialization_constant_count] = {4, 5, 6, 7};
+    sccl_shader_specialization_constant_t
+        specialization_constants[specialization_constant_count];
+    for (size_t i = 0; i < specialization_constant_count; ++i) {
+        specialization_constants[i].constant_id = static_cast<uint32_t>(i);
+        specialization_constants[i].size = sizeof(uint32_t);
+        specialization_constants[i].data = &values[i];
+    }
+
+    sccl_shader_config_t shader_config = {};
+    shader_config.specialization_constants = specialization_constants;
+    shader_config.specialization_constants_count =
+        specialization_constant_count;
+
+    sccl_shader_t shader;
+    SCCL_TEST_ASSERT(sccl_create_shader_from_bundle(
+        device, bundle, "specialization_constants", &shader_config, &shader));
+
+    sccl_shader_run_params_t params = {};
+    params.group_count_x = 1;
+    params.group_count_y = 1;
+    params.group_count_z = 1;
+    params.buffer_bindings = &output_buffer_binding;
+    params.buffer_bindings_count = 1;
+
+    SCCL_TEST_ASSERT(sccl_run_shader(stream, shader, &params));
+    SCCL_TEST_ASSERT(sccl_dispatch_stream(stream));
+    SCCL_TEST_ASSERT(sccl_join_stream(stream));
+
+    uint32_t *output_data;
+    SCCL_TEST_ASSERT(sccl_host_map_buffer(output_buffer, (void **)&output_data,
+                                          0, output_buffer_size));
+    ASSERT_EQ(memcmp(output_data, values, sizeof(values)), 0);
+    sccl_host_unmap_buffer(output_buffer);
+
+    sccl_destroy_shader(shader);
+    sccl_destroy_buffer(output_buffer);
+}
+
+TEST_F(shader_bundle_test, shader_bundle_push_constants)
+{
+    struct PushConstant {
+        uint32_t c_0;
+        uint32_t c_1;
+        uint32_t c_2;
+        uint32_t c_3;
+    };
+
+    sccl_buffer_t output_buffer;
+    sccl_shader_buffer_binding_t output_buffer_binding = {};
+    init_output_buffer(device, sizeof(PushConstant), &output_buffer,
+                       &output_buffer_binding);
+
+    /* push constant layout is reflected */
+    sccl_shader_t shader;
+    SCCL_TEST_ASSERT(sccl_create_shader_from_bundle(
+        device, bundle, "push_constants", NULL, &shader));
+
+    PushConstant push_constant = {};
+    push_constant.c_0 = 0;
+    push_constant.c_1 = 1;
+    push_constant.c_2 = 2;
+    push_constant.c_3 = 3;
+    sccl_shader_push_constant_binding_t push_constant_binding = {};
+    push_constant_binding.data = &push_constant;
+
+    sccl_shader_run_params_t params = {};
+    params.group_count_x = 1;
+    params.group_count_y = 1;
+    params.group_count_z = 1;
+    params.push_constant_bindings = &push_constant_binding;
+    params.push_constant_bindings_count = 1;
+    params.buffer_bindings = &output_buffer_binding;
+    params.buffer_bindings_count = 1;
+
+    SCCL_TEST_ASSERT(sccl_run_shader(stream, shader, &params));
+    SCCL_TEST_ASSERT(sccl_dispatch_stream(stream));
+    SCCL_TEST_ASSERT(sccl_join_stream(stream));
+
+    uint32_t *output_data;
+    SCCL_TEST_ASSERT(sccl_host_map_buffer(output_buffer, (void **)&output_data,
+                                          0, sizeof(PushConstant)));
+    ASSERT_EQ(memcmp(output_data, &push_constant, sizeof(PushConstant)), 0);
+    sccl_host_unmap_buffer(output_buffer);
+
+    sccl_destroy_shader(shader);
+    sccl_destroy_buffer(output_buffer);
+}
+
+TEST_F(shader_bundle_test, shader_bundle_unknown_name)
+{
+    sccl_shader_t shader;
+    ASSERT_EQ(sccl_create_shader_from_bundle(device, bundle, "does_not_exist",
+                                             NULL, &shader),
+              sccl_invalid_argument);
+}
+
+TEST_F(shader_bundle_test, shader_bundle_source_code_not_allowed)
+{
+    std::string shader_source = read_test_shader("noop_shader.spv").value();
+
+    sccl_shader_config_t shader_config = {};
+    shader_config.shader_source_code = shader_source.data();
+    shader_config.shader_source_code_length = shader_source.size();
+
+    sccl_shader_t shader;
+    ASSERT_EQ(sccl_create_shader_from_bundle(device, bundle, "noop",
+                                             &shader_config, &shader),
+              sccl_invalid_argument);
+}
+
+TEST_F(shader_bundle_test, shader_bundle_invalid_file)
+{
+    /* a plain SPIR-V module is not a bundle */
+    sccl_shader_bundle_t invalid_bundle;
+    ASSERT_EQ(sccl_open_shader_bundle(
+                  (std::string(get_environment_shaders_dir()) +
+                   "/noop_shader.spv")
+                      .c_str(),
+                  &invalid_bundle),
+              sccl_invalid_argument);
+
+    ASSERT_EQ(sccl_open_shader_bundle("does_not_exist.bundle", &invalid_bundle),
+              sccl_system_error);
+}
+
+TEST_F(shader_bundle_test, shader_bundle_unsorted_entries)
+{
+    std::string bundle_data = read_test_bundle();
+    shader_bundle_header_t header;
+    memcpy(&header, bundle_data.data(), sizeof(header));
+    ASSERT_GE(header.entry_count, 2u);
+
+    /* lookups use binary search, so unsorted entries are rejected */
+    shader_bundle_entry_t *entries = get_bundle_entries(bundle_data);
+    std::swap(entries[0], entries[1]);
+    sccl_shader_bundle_t invalid_bundle;
+    ASSERT_EQ(open_bundle_data(bundle_data, &invalid_bundle),
+              sccl_invalid_argument);
+}
+
+TEST_F(shader_bundle_test, shader_bundle_invalid_specialization_constant_size)
+{
+    std::string bundle_data = read_test_bundle();
+    shader_bundle_entry_t *entry =
+        find_bundle_entry(bundle_data, "specialization_constants");
+    ASSERT_NE(entry, nullptr);
+    ASSERT_GT(entry->specialization_constants_count, 0u);
+    shader_bundle_specialization_constant_t *bundle_constants =
+        reinterpret_cast<shader_bundle_specialization_constant_t *>(
+            bundle_data.data() + entry->specialization_constants_offset);
+
+    /* size larger than the stored default value */
+    bundle_constants[0].size =
+        SHADER_BUNDLE_MAX_SPECIALIZATION_CONSTANT_SIZE + 1;
+    sccl_shader_bundle_t invalid_bundle;
+    ASSERT_EQ(open_bundle_data(bundle_data, &invalid_bundle),
+              sccl_invalid_argument);
+}
+
+TEST_F(shader_bundle_test, shader_bundle_misaligned_code)
+{
+    std::string bundle_data = read_test_bundle();
+    shader_bundle_entry_t *entry = find_bundle_entry(bundle_data, "noop");
+    ASSERT_NE(entry, nullptr);
+    ASSERT_GT(entry->code_size, sizeof(uint32_t));
+
+    /* still in the bundle and word aligned, but not at the code alignment */
+    entry->code_offset += sizeof(uint32_t);
+    entry->code_size -= sizeof(uint32_t);
+    sccl_shader_bundle_t invalid_bundle;
+    ASSERT_EQ(open_bundle_data(bundle_data, &invalid_bundle),
+              sccl_invalid_argument);
+}
+
+TEST_F(shader_bundle_test, shader_bundle_unknown_descriptor_type)
+{
+    std::string bundle_data = read_test_bundle();
+    shader_bundle_entry_t *entry =
+        find_bundle_entry(bundle_data, "push_constants");
+    ASSERT_NE(entry, nullptr);
+    ASSERT_GT(entry->buffer_layouts_count, 0u);
+    shader_bundle_buffer_layout_t *bundle_buffer_layouts =
+        reinterpret_cast<shader_bundle_buffer_layout_t *>(
+            bundle_data.data() + entry->buffer_layouts_offset);
+
+    bundle_buffer_layouts[0].descriptor_type =
+        SHADER_BUNDLE_DESCRIPTOR_TYPE_UNIFORM + 1;
+    sccl_shader_bundle_t invalid_bundle;
+    ASSERT_EQ(open_bundle_data(bundle_data, &invalid_bundle),
+              sccl_invalid_argument);
+}